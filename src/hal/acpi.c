@@ -0,0 +1,313 @@
+/**
+ * CompileOS ACPI Tables - Implementation
+ *
+ * Finds the RSDP in the EBDA or the BIOS ROM area, walks the XSDT (or the
+ * RSDT on ACPI 1.0 firmware) and parses SRAT and SLIT into an
+ * acpi_numa_t. Tables are read in place through the identity mapping.
+ */
+
+#include "acpi.h"
+#include <string.h>
+
+// RSDP search areas (the EBDA segment is stored at 0x40E in the BIOS data area)
+#define ACPI_EBDA_POINTER 0x40E
+#define ACPI_EBDA_SEARCH_SIZE 1024
+#define ACPI_BIOS_START 0xE0000
+#define ACPI_BIOS_END 0x100000
+
+// SRAT affinity structure types and flags
+#define ACPI_SRAT_PROCESSOR 0
+#define ACPI_SRAT_MEMORY 1
+#define ACPI_SRAT_X2APIC 2
+#define ACPI_SRAT_ENABLED 0x1
+#define ACPI_SRAT_HOT_PLUGGABLE 0x2
+
+// Root system description pointer (fields past rsdt_address need revision 2)
+typedef struct {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+// SRAT affinity structures (entries start after a 12-byte reserved field)
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) acpi_srat_entry_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+    uint8_t domain_low;
+    uint8_t apic_id;
+    uint32_t flags;
+    uint8_t sapic_eid;
+    uint8_t domain_high[3];
+    uint32_t clock_domain;
+} __attribute__((packed)) acpi_srat_processor_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+    uint32_t domain;
+    uint16_t reserved1;
+    uint64_t base_address;
+    uint64_t size;
+    uint32_t reserved2;
+    uint32_t flags;
+    uint64_t reserved3;
+} __attribute__((packed)) acpi_srat_memory_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+    uint16_t reserved1;
+    uint32_t domain;
+    uint32_t x2apic_id;
+    uint32_t flags;
+    uint32_t clock_domain;
+    uint32_t reserved2;
+} __attribute__((packed)) acpi_srat_x2apic_t;
+
+#define ACPI_SRAT_ENTRIES_OFFSET (sizeof(acpi_sdt_header_t) + 12)
+#define ACPI_SLIT_MATRIX_OFFSET (sizeof(acpi_sdt_header_t) + 8)
+
+// Table pointers found at init
+static struct {
+    bool initialized;
+    const acpi_sdt_header_t* root;
+    bool extended;      // Root is the XSDT (64-bit entries)
+} g_acpi_state = {0};
+
+/**
+ * Check that a structure's bytes sum to zero
+ */
+static bool acpi_checksum(const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t sum = 0;
+    
+    for (size_t i = 0; i < length; i++) {
+        sum = (uint8_t)(sum + bytes[i]);
+    }
+    
+    return sum == 0;
+}
+
+/**
+ * Look for a valid RSDP on 16-byte boundaries of [start, end)
+ */
+static const acpi_rsdp_t* acpi_scan_rsdp(uint64_t start, uint64_t end) {
+    for (uint64_t address = start; address + 20 <= end; address += 16) {
+        const acpi_rsdp_t* rsdp = (const acpi_rsdp_t*)(uintptr_t)address;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 && acpi_checksum(rsdp, 20)) {
+            return rsdp;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Locate the root table
+ */
+int acpi_init(void) {
+    if (g_acpi_state.initialized) {
+        return g_acpi_state.root ? 0 : -1;
+    }
+    g_acpi_state.initialized = true;
+    
+    uint64_t ebda = (uint64_t)*(const volatile uint16_t*)(uintptr_t)ACPI_EBDA_POINTER << 4;
+    const acpi_rsdp_t* rsdp = NULL;
+    
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        rsdp = acpi_scan_rsdp(ebda, ebda + ACPI_EBDA_SEARCH_SIZE);
+    }
+    if (!rsdp) {
+        rsdp = acpi_scan_rsdp(ACPI_BIOS_START, ACPI_BIOS_END);
+    }
+    if (!rsdp) {
+        return -1;
+    }
+    
+    // Prefer the XSDT when the firmware provides one
+    if (rsdp->revision >= 2 && rsdp->xsdt_address && acpi_checksum(rsdp, rsdp->length)) {
+        const acpi_sdt_header_t* xsdt = (const acpi_sdt_header_t*)(uintptr_t)rsdp->xsdt_address;
+        if (memcmp(xsdt->signature, "XSDT", 4) == 0 && acpi_checksum(xsdt, xsdt->length)) {
+            g_acpi_state.root = xsdt;
+            g_acpi_state.extended = true;
+            return 0;
+        }
+    }
+    
+    const acpi_sdt_header_t* rsdt = (const acpi_sdt_header_t*)(uintptr_t)rsdp->rsdt_address;
+    if (!rsdt || memcmp(rsdt->signature, "RSDT", 4) != 0 || !acpi_checksum(rsdt, rsdt->length)) {
+        return -1;
+    }
+    
+    g_acpi_state.root = rsdt;
+    g_acpi_state.extended = false;
+    return 0;
+}
+
+/**
+ * Find a table by its four-character signature
+ */
+const acpi_sdt_header_t* acpi_find_table(const char* signature) {
+    if (!signature || !g_acpi_state.root) {
+        return NULL;
+    }
+    
+    const acpi_sdt_header_t* root = g_acpi_state.root;
+    const uint8_t* entries = (const uint8_t*)root + sizeof(acpi_sdt_header_t);
+    size_t entry_size = g_acpi_state.extended ? 8 : 4;
+    size_t count = (root->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    
+    for (size_t i = 0; i < count; i++) {
+        uint64_t address = 0;
+        memcpy(&address, entries + i * entry_size, entry_size);
+        
+        const acpi_sdt_header_t* table = (const acpi_sdt_header_t*)(uintptr_t)address;
+        if (table && memcmp(table->signature, signature, 4) == 0 && acpi_checksum(table, table->length)) {
+            return table;
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * Node index for a proximity domain, adding it if it is new (domains past
+ * HAL_MAX_NUMA_NODES share the last node)
+ */
+static uint32_t acpi_numa_node(acpi_numa_t* numa, uint32_t domain) {
+    for (uint32_t node = 0; node < numa->node_count; node++) {
+        if (numa->domains[node] == domain) {
+            return node;
+        }
+    }
+    
+    if (numa->node_count == HAL_MAX_NUMA_NODES) {
+        return HAL_MAX_NUMA_NODES - 1;
+    }
+    
+    numa->domains[numa->node_count] = domain;
+    return numa->node_count++;
+}
+
+static void acpi_numa_add_cpu(acpi_numa_t* numa, uint32_t apic_id, uint32_t domain) {
+    uint32_t node = acpi_numa_node(numa, domain);
+    if (numa->cpu_count < ACPI_MAX_NUMA_CPUS) {
+        numa->cpus[numa->cpu_count].apic_id = apic_id;
+        numa->cpus[numa->cpu_count].node = node;
+        numa->cpu_count++;
+    }
+}
+
+/**
+ * Read the CPU and memory affinity structures of the SRAT
+ */
+static void acpi_parse_srat(acpi_numa_t* numa, const acpi_sdt_header_t* srat) {
+    const uint8_t* cursor = (const uint8_t*)srat + ACPI_SRAT_ENTRIES_OFFSET;
+    const uint8_t* end = (const uint8_t*)srat + srat->length;
+    
+    while (cursor + sizeof(acpi_srat_entry_t) <= end) {
+        const acpi_srat_entry_t* entry = (const acpi_srat_entry_t*)cursor;
+        if (entry->length < sizeof(acpi_srat_entry_t) || cursor + entry->length > end) {
+            break;
+        }
+        
+        if (entry->type == ACPI_SRAT_PROCESSOR && entry->length >= sizeof(acpi_srat_processor_t)) {
+            const acpi_srat_processor_t* cpu = (const acpi_srat_processor_t*)cursor;
+            if (cpu->flags & ACPI_SRAT_ENABLED) {
+                uint32_t domain = cpu->domain_low | (uint32_t)cpu->domain_high[0] << 8 |
+                                  (uint32_t)cpu->domain_high[1] << 16 | (uint32_t)cpu->domain_high[2] << 24;
+                acpi_numa_add_cpu(numa, cpu->apic_id, domain);
+            }
+        } else if (entry->type == ACPI_SRAT_X2APIC && entry->length >= sizeof(acpi_srat_x2apic_t)) {
+            const acpi_srat_x2apic_t* cpu = (const acpi_srat_x2apic_t*)cursor;
+            if (cpu->flags & ACPI_SRAT_ENABLED) {
+                acpi_numa_add_cpu(numa, cpu->x2apic_id, cpu->domain);
+            }
+        } else if (entry->type == ACPI_SRAT_MEMORY && entry->length >= sizeof(acpi_srat_memory_t)) {
+            // Hot-pluggable ranges are described up front but not populated
+            const acpi_srat_memory_t* memory = (const acpi_srat_memory_t*)cursor;
+            if ((memory->flags & ACPI_SRAT_ENABLED) && !(memory->flags & ACPI_SRAT_HOT_PLUGGABLE) &&
+                memory->size && numa->range_count < ACPI_MAX_NUMA_RANGES) {
+                numa_memory_region_t* range = &numa->ranges[numa->range_count++];
+                range->base_address = memory->base_address;
+                range->size = memory->size;
+                range->node = acpi_numa_node(numa, memory->domain);
+            }
+        }
+        
+        cursor += entry->length;
+    }
+}
+
+/**
+ * Read node distances from the SLIT (indexed by proximity domain)
+ */
+static void acpi_parse_slit(acpi_numa_t* numa, const acpi_sdt_header_t* slit) {
+    if (slit->length < ACPI_SLIT_MATRIX_OFFSET) {
+        return;
+    }
+    
+    uint64_t localities;
+    memcpy(&localities, (const uint8_t*)slit + sizeof(acpi_sdt_header_t), sizeof(localities));
+    if (localities == 0 || localities > 0xFFFF ||
+        slit->length - ACPI_SLIT_MATRIX_OFFSET < localities * localities) {
+        return;
+    }
+    
+    const uint8_t* matrix = (const uint8_t*)slit + ACPI_SLIT_MATRIX_OFFSET;
+    
+    for (uint32_t from = 0; from < numa->node_count; from++) {
+        for (uint32_t to = 0; to < numa->node_count; to++) {
+            uint64_t row = numa->domains[from];
+            uint64_t column = numa->domains[to];
+            if (row < localities && column < localities) {
+                numa->distances[from][to] = matrix[row * localities + column];
+            }
+        }
+    }
+}
+
+/**
+ * Read the NUMA topology
+ */
+int acpi_read_numa(acpi_numa_t* numa) {
+    if (!numa) {
+        return -1;
+    }
+    
+    memset(numa, 0, sizeof(*numa));
+    
+    const acpi_sdt_header_t* srat = acpi_find_table("SRAT");
+    if (srat && srat->length >= ACPI_SRAT_ENTRIES_OFFSET) {
+        acpi_parse_srat(numa, srat);
+    }
+    
+    // No usable affinity information: everything is one node
+    if (numa->node_count == 0 || numa->range_count == 0) {
+        memset(numa, 0, sizeof(*numa));
+        numa->node_count = 1;
+    }
+    
+    for (uint32_t from = 0; from < HAL_MAX_NUMA_NODES; from++) {
+        for (uint32_t to = 0; to < HAL_MAX_NUMA_NODES; to++) {
+            numa->distances[from][to] = from == to ? ACPI_DISTANCE_LOCAL : ACPI_DISTANCE_REMOTE;
+        }
+    }
+    
+    const acpi_sdt_header_t* slit = acpi_find_table("SLIT");
+    if (slit && numa->node_count > 1) {
+        acpi_parse_slit(numa, slit);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * CompileOS ACPI Tables
+ *
+ * Locates the firmware's ACPI tables and reads the NUMA topology from the
+ * System Resource Affinity Table (SRAT) and the System Locality
+ * Information Table (SLIT)
+ */
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "hal.h"
+
+// Topology limits (CPUs and ranges past these are ignored)
+#define ACPI_MAX_NUMA_CPUS 256
+#define ACPI_MAX_NUMA_RANGES 32
+
+// SLIT distances: a node to itself, and the default between nodes
+#define ACPI_DISTANCE_LOCAL 10
+#define ACPI_DISTANCE_REMOTE 20
+
+// System description table header (common to every table)
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+// NUMA topology (nodes are the SRAT proximity domains renumbered from 0)
+typedef struct {
+    uint32_t node_count;
+    uint32_t domains[HAL_MAX_NUMA_NODES];
+    
+    // CPU affinity by APIC id
+    struct {
+        uint32_t apic_id;
+        uint32_t node;
+    } cpus[ACPI_MAX_NUMA_CPUS];
+    size_t cpu_count;
+    
+    // Memory affinity
+    numa_memory_region_t ranges[ACPI_MAX_NUMA_RANGES];
+    size_t range_count;
+    
+    // Relative access cost, ACPI_DISTANCE_LOCAL for a node to itself
+    uint8_t distances[HAL_MAX_NUMA_NODES][HAL_MAX_NUMA_NODES];
+} acpi_numa_t;
+
+// Table discovery (reads the RSDP from the BIOS areas below 1 MB)
+int acpi_init(void);
+const acpi_sdt_header_t* acpi_find_table(const char* signature);
+
+// NUMA topology (one node covering everything when there is no SRAT)
+int acpi_read_numa(acpi_numa_t* numa);
+
+#endif // ACPI_H
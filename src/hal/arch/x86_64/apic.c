@@ -0,0 +1,108 @@
+/**
+ * CompileOS x86_64 Local APIC Implementation - Bare Metal
+ * 
+ * Local APIC access for inter-processor interrupts
+ */
+
+#include "apic.h"
+
+// IA32_APIC_BASE bits
+#define APIC_BASE_X2APIC (1ULL << 10)
+#define APIC_BASE_ENABLE (1ULL << 11)
+#define APIC_BASE_ADDRESS_MASK 0x000FFFFFFFFFF000ULL
+
+// Register offsets (xAPIC MMIO; the x2APIC MSR is 0x800 + offset / 16)
+#define APIC_REG_ID 0x020
+#define APIC_REG_EOI 0x0B0
+#define APIC_REG_SVR 0x0F0
+#define APIC_REG_ICR_LOW 0x300
+#define APIC_REG_ICR_HIGH 0x310
+#define APIC_X2APIC_MSR_BASE 0x800
+
+// Register bits
+#define APIC_SVR_ENABLE 0x100
+#define APIC_ICR_PENDING (1U << 12)
+
+// Local APIC state
+static struct {
+    bool enabled;
+    bool x2apic;
+    volatile uint32_t* registers;
+} g_apic_state = {0};
+
+static uint32_t apic_read(uint32_t reg) {
+    if (g_apic_state.x2apic) {
+        return (uint32_t)cpu_read_msr(APIC_X2APIC_MSR_BASE + (reg >> 4));
+    }
+    return g_apic_state.registers[reg / 4];
+}
+
+static void apic_write(uint32_t reg, uint32_t value) {
+    if (g_apic_state.x2apic) {
+        cpu_write_msr(APIC_X2APIC_MSR_BASE + (reg >> 4), value);
+    } else {
+        g_apic_state.registers[reg / 4] = value;
+    }
+}
+
+// Enable the local APIC of the calling CPU (x2APIC mode if supported)
+bool apic_init(const cpu_info_t* info) {
+    if (!info || !info->features.apic) {
+        return false;
+    }
+    
+    uint64_t base = cpu_read_msr(CPU_MSR_APIC_BASE) | APIC_BASE_ENABLE;
+    if (info->features.x2apic) {
+        base |= APIC_BASE_X2APIC;
+    }
+    cpu_write_msr(CPU_MSR_APIC_BASE, base);
+    
+    g_apic_state.x2apic = info->features.x2apic;
+    g_apic_state.registers = (volatile uint32_t*)(uintptr_t)(base & APIC_BASE_ADDRESS_MASK);
+    
+    // Software-enable the APIC and route spurious interrupts
+    apic_write(APIC_REG_SVR, APIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    
+    g_apic_state.enabled = true;
+    return true;
+}
+
+bool apic_is_enabled(void) {
+    return g_apic_state.enabled;
+}
+
+// Get the APIC ID of the calling CPU
+uint32_t apic_get_id(void) {
+    if (!g_apic_state.enabled) {
+        return 0;
+    }
+    
+    uint32_t id = apic_read(APIC_REG_ID);
+    return g_apic_state.x2apic ? id : id >> 24;
+}
+
+// Send a fixed interrupt to one CPU
+void apic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    if (!g_apic_state.enabled) {
+        return;
+    }
+    
+    if (g_apic_state.x2apic) {
+        // One MSR write carries both halves of the ICR
+        cpu_write_msr(APIC_X2APIC_MSR_BASE + (APIC_REG_ICR_LOW >> 4), ((uint64_t)apic_id << 32) | vector);
+        return;
+    }
+    
+    while (apic_read(APIC_REG_ICR_LOW) & APIC_ICR_PENDING) {
+        __asm__ volatile ("pause");
+    }
+    apic_write(APIC_REG_ICR_HIGH, apic_id << 24);
+    apic_write(APIC_REG_ICR_LOW, vector);
+}
+
+// Signal the end of an APIC-delivered interrupt
+void apic_eoi(void) {
+    if (g_apic_state.enabled) {
+        apic_write(APIC_REG_EOI, 0);
+    }
+}
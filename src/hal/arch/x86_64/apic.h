@@ -0,0 +1,27 @@
+/**
+ * CompileOS x86_64 Local APIC - Bare Metal
+ * 
+ * Local APIC access (x2APIC through MSRs when available, xAPIC through
+ * its memory-mapped registers otherwise) for inter-processor interrupts
+ */
+
+#ifndef X86_64_APIC_H
+#define X86_64_APIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+// Vector delivered for spurious interrupts (needs no EOI)
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+// Local APIC management
+bool apic_init(const cpu_info_t* info);
+bool apic_is_enabled(void);
+uint32_t apic_get_id(void);
+
+// Interrupts
+void apic_send_ipi(uint32_t apic_id, uint8_t vector);
+void apic_eoi(void);
+
+#endif // X86_64_APIC_H
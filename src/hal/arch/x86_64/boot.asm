@@ -0,0 +1,151 @@
+; CompileOS x86_64 Multiboot Entry - Bare Metal Assembly
+;
+; Multiboot (v1) header and the 32-bit entry point the loader jumps to.
+; The entry identity-maps the low 4 GB with 2 MB pages, switches to long
+; mode and calls kernel_main with the loader's magic (EAX) and boot
+; information address (EBX). paging_init replaces these tables later.
+
+; Multiboot header (flags: page-aligned modules, memory information/map)
+MULTIBOOT_HEADER_MAGIC equ 0x1BADB002
+MULTIBOOT_HEADER_FLAGS equ 0x00000003
+MULTIBOOT_HEADER_CHECKSUM equ -(MULTIBOOT_HEADER_MAGIC + MULTIBOOT_HEADER_FLAGS)
+
+; Boot page directories (one per GB) and stack
+BOOT_PD_COUNT equ 4
+BOOT_STACK_SIZE equ 0x10000
+
+; Segment selectors (interrupt gates use 0x08 for kernel code)
+BOOT_CODE_SELECTOR equ 0x08
+BOOT_DATA_SELECTOR equ 0x10
+
+; Control register, EFER and page table bits
+CR0_PE equ 1 << 0
+CR0_PG equ 1 << 31
+CR4_PAE equ 1 << 5
+MSR_EFER equ 0xC0000080
+EFER_LME equ 1 << 8
+PTE_PRESENT equ 1 << 0
+PTE_WRITABLE equ 1 << 1
+PTE_LARGE equ 1 << 7
+
+extern kernel_main
+
+; Linked first in .text, so it lies within the first 8 KB of the image
+section .multiboot progbits alloc noexec nowrite align=4
+    dd MULTIBOOT_HEADER_MAGIC
+    dd MULTIBOOT_HEADER_FLAGS
+    dd MULTIBOOT_HEADER_CHECKSUM
+
+section .text
+
+; Entered in 32-bit protected mode with paging off; EAX holds the magic
+; and EBX the boot information address
+[BITS 32]
+global kernel_entry
+kernel_entry:
+    cli
+    mov esp, boot_stack_top
+    mov ebp, eax                ; Keep the magic (EBX is left alone)
+
+    ; Clear the PML4 and PDPT
+    mov edi, boot_pml4
+    mov ecx, 2 * 4096 / 4
+    xor eax, eax
+    rep stosd
+
+    ; PML4[0] -> PDPT, PDPT[0 .. 3] -> the page directories
+    mov eax, boot_pdpt
+    or eax, PTE_PRESENT | PTE_WRITABLE
+    mov [boot_pml4], eax
+
+    mov edi, boot_pdpt
+    mov eax, boot_pd
+    or eax, PTE_PRESENT | PTE_WRITABLE
+    mov ecx, BOOT_PD_COUNT
+.fill_pdpt:
+    mov [edi], eax
+    add edi, 8
+    add eax, 4096
+    loop .fill_pdpt
+
+    ; Identity-map 0 .. 4 GB with 2 MB pages
+    mov edi, boot_pd
+    mov eax, PTE_PRESENT | PTE_WRITABLE | PTE_LARGE
+    xor edx, edx
+    mov ecx, BOOT_PD_COUNT * 512
+.fill_pd:
+    mov [edi], eax
+    mov [edi + 4], edx
+    add edi, 8
+    add eax, 0x200000
+    adc edx, 0
+    loop .fill_pd
+
+    ; PAE, tables, long mode enable, then paging (activates long mode)
+    mov eax, cr4
+    or eax, CR4_PAE
+    mov cr4, eax
+
+    mov eax, boot_pml4
+    mov cr3, eax
+
+    mov ecx, MSR_EFER
+    rdmsr
+    or eax, EFER_LME
+    wrmsr
+
+    mov eax, cr0
+    or eax, CR0_PG | CR0_PE
+    mov cr0, eax
+
+    ; Load a GDT with a 64-bit code segment and jump into it
+    lgdt [boot_gdt_descriptor]
+    jmp BOOT_CODE_SELECTOR:kernel_entry_64
+
+[BITS 64]
+kernel_entry_64:
+    mov ax, BOOT_DATA_SELECTOR
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    mov rsp, boot_stack_top
+
+    ; kernel_main(magic, info); the 32-bit moves zero-extend
+    mov edi, ebp
+    mov esi, ebx
+    call kernel_main
+
+    ; kernel_main only returns when initialization failed
+.halt:
+    cli
+    hlt
+    jmp .halt
+
+; GDT (writable: the CPU sets the accessed bits when loading selectors)
+section .data
+align 8
+boot_gdt:
+    dq 0                        ; Null
+    dq 0x00AF9A000000FFFF       ; 0x08: 64-bit kernel code
+    dq 0x00CF92000000FFFF       ; 0x10: kernel data
+boot_gdt_end:
+
+boot_gdt_descriptor:
+    dw boot_gdt_end - boot_gdt - 1
+    dq boot_gdt
+
+; Page tables and stack
+section .bss nobits alloc noexec write align=4096
+boot_pml4:
+    resb 4096
+boot_pdpt:
+    resb 4096
+boot_pd:
+    resb 4096 * BOOT_PD_COUNT
+
+alignb 16
+boot_stack:
+    resb BOOT_STACK_SIZE
+boot_stack_top:
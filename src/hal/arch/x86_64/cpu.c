@@ -58,6 +58,11 @@ void cpu_detect(cpu_info_t* info) {
     if (eax >= 0x80000001) {
         cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
         // Extended features in ECX, EDX
+        info->features.syscall = (edx >> 11) & 1;
+        info->features.nx = (edx >> 20) & 1;
+        info->features.pdpe1gb = (edx >> 26) & 1;
+        info->features.rdtscp = (edx >> 27) & 1;
+        info->features.lm = (edx >> 29) & 1;
     }
     
     // Get basic features (CPUID 1)
@@ -142,6 +147,24 @@ void cpu_detect(cpu_info_t* info) {
         info->features.rdrand = (ecx >> 30) & 1;
         info->features.hypervisor = (ecx >> 31) & 1;
     }
+    
+    // Get structured extended features (CPUID 7)
+    if (info->max_cpuid >= 7) {
+        cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        
+        info->features.fsgsbase = (ebx >> 0) & 1;
+        info->features.bmi1 = (ebx >> 3) & 1;
+        info->features.avx2 = (ebx >> 5) & 1;
+        info->features.smep = (ebx >> 7) & 1;
+        info->features.bmi2 = (ebx >> 8) & 1;
+        info->features.erms = (ebx >> 9) & 1;
+        info->features.invpcid = (ebx >> 10) & 1;
+        info->features.avx512f = (ebx >> 16) & 1;
+        info->features.smap = (ebx >> 20) & 1;
+        info->features.clflushopt = (ebx >> 23) & 1;
+        info->features.clwb = (ebx >> 24) & 1;
+        info->features.fsrm = (edx >> 4) & 1;
+    }
 }
 
 // Get vendor string
@@ -203,6 +226,61 @@ void cpu_write_cr4(uint64_t value) {
     __asm__ volatile ("mov %0, %%cr4" : : "r" (value));
 }
 
+// Extended control registers
+uint64_t cpu_read_xcr(uint32_t index) {
+    uint32_t low, high;
+    __asm__ volatile ("xgetbv" : "=a" (low), "=d" (high) : "c" (index));
+    return ((uint64_t)high << 32) | low;
+}
+
+void cpu_write_xcr(uint32_t index, uint64_t value) {
+    __asm__ volatile ("xsetbv" : : "c" (index), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32)));
+}
+
+// SIMD state
+void cpu_enable_simd(const cpu_info_t* info) {
+    if (!info) return;
+    
+    // SSE: no x87 emulation, FXSAVE and SIMD exceptions enabled
+    cpu_write_cr0((cpu_read_cr0() & ~CPU_CR0_EM) | CPU_CR0_MP);
+    
+    uint64_t cr4 = cpu_read_cr4() | CPU_CR4_OSFXSR | CPU_CR4_OSXMMEXCPT;
+    if (info->features.xsave) {
+        cr4 |= CPU_CR4_OSXSAVE;
+    }
+    cpu_write_cr4(cr4);
+    
+    // AVX: the YMM upper halves must be enabled in XCR0 as well
+    if (info->features.xsave && info->features.avx) {
+        cpu_write_xcr(0, cpu_read_xcr(0) | CPU_XCR0_X87 | CPU_XCR0_SSE | CPU_XCR0_AVX);
+    }
+}
+
+bool cpu_avx_usable(const cpu_info_t* info) {
+    if (!info || !info->features.avx || !info->features.osxsave) return false;
+    
+    uint64_t mask = CPU_XCR0_SSE | CPU_XCR0_AVX;
+    return (cpu_read_xcr(0) & mask) == mask;
+}
+
+// XSAVE area size for the state components currently enabled in XCR0
+uint32_t cpu_xsave_size(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0x0D, 0, &eax, &ebx, &ecx, &edx);
+    return ebx;
+}
+
+// Model-specific registers
+uint64_t cpu_read_msr(uint32_t msr) {
+    uint32_t low, high;
+    __asm__ volatile ("rdmsr" : "=a" (low), "=d" (high) : "c" (msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+void cpu_write_msr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr" : : "c" (msr), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32)));
+}
+
 // RFLAGS access
 uint64_t cpu_read_rflags(void) {
     uint64_t value;
@@ -267,9 +345,9 @@ uint64_t cpu_read_tsc(void) {
 }
 
 uint64_t cpu_read_tsc_aux(void) {
-    uint32_t value;
-    __asm__ volatile ("rdtscp" : "=a" (value) : : "rcx");
-    return value;
+    uint32_t low, high, aux;
+    __asm__ volatile ("rdtscp" : "=a" (low), "=d" (high), "=c" (aux));
+    return aux;
 }
 
 void cpu_serialize(void) {
@@ -285,6 +363,25 @@ void cpu_invalidate_tlb_page(uint64_t address) {
     __asm__ volatile ("invlpg (%0)" : : "r" (address) : "memory");
 }
 
+void cpu_invalidate_tlb_global(void) {
+    // Toggling CR4.PGE drops global entries and those of every PCID
+    uint64_t cr4 = cpu_read_cr4();
+    if (cr4 & CPU_CR4_PGE) {
+        cpu_write_cr4(cr4 & ~CPU_CR4_PGE);
+        cpu_write_cr4(cr4);
+    } else {
+        cpu_invalidate_tlb();
+    }
+}
+
+void cpu_invpcid(uint64_t type, uint64_t pcid, uint64_t address) {
+    struct {
+        uint64_t pcid;
+        uint64_t address;
+    } descriptor = { pcid, address };
+    __asm__ volatile ("invpcid %0, %1" : : "m" (descriptor), "r" (type) : "memory");
+}
+
 void cpu_wbinvd(void) {
     __asm__ volatile ("wbinvd");
 }
@@ -76,6 +76,27 @@ typedef struct {
     bool f16c;
     bool rdrand;
     bool hypervisor;
+    
+    // Structured extended features (CPUID 7, EBX/EDX)
+    bool fsgsbase;
+    bool bmi1;
+    bool avx2;
+    bool smep;
+    bool bmi2;
+    bool erms;
+    bool invpcid;
+    bool avx512f;
+    bool smap;
+    bool clflushopt;
+    bool clwb;
+    bool fsrm;
+    
+    // Extended processor features (CPUID 0x80000001, EDX)
+    bool syscall;
+    bool nx;
+    bool pdpe1gb;
+    bool rdtscp;
+    bool lm;
 } cpu_features_t;
 
 // CPU information
@@ -104,6 +125,25 @@ const char* cpu_get_vendor_string(const cpu_info_t* info);
 const char* cpu_get_brand_string(const cpu_info_t* info);
 bool cpu_has_feature(const cpu_info_t* info, const char* feature_name);
 
+// Control register bits
+#define CPU_CR0_MP (1ULL << 1)
+#define CPU_CR0_EM (1ULL << 2)
+#define CPU_CR0_WP (1ULL << 16)
+#define CPU_CR4_PGE (1ULL << 7)
+#define CPU_CR4_OSFXSR (1ULL << 9)
+#define CPU_CR4_OSXMMEXCPT (1ULL << 10)
+#define CPU_CR4_PCIDE (1ULL << 17)
+#define CPU_CR4_OSXSAVE (1ULL << 18)
+
+// CR3 fields with PCIDs enabled
+#define CPU_CR3_PCID_MASK 0xFFFULL
+#define CPU_CR3_NO_FLUSH (1ULL << 63)
+
+// XCR0 state components
+#define CPU_XCR0_X87 (1ULL << 0)
+#define CPU_XCR0_SSE (1ULL << 1)
+#define CPU_XCR0_AVX (1ULL << 2)
+
 // CPU control registers
 uint64_t cpu_read_cr0(void);
 void cpu_write_cr0(uint64_t value);
@@ -113,6 +153,23 @@ void cpu_write_cr3(uint64_t value);
 uint64_t cpu_read_cr4(void);
 void cpu_write_cr4(uint64_t value);
 
+// Extended control registers (XGETBV/XSETBV)
+uint64_t cpu_read_xcr(uint32_t index);
+void cpu_write_xcr(uint32_t index, uint64_t value);
+
+// SIMD state (SSE always, AVX when XSAVE is available)
+void cpu_enable_simd(const cpu_info_t* info);
+bool cpu_avx_usable(const cpu_info_t* info);
+uint32_t cpu_xsave_size(void);
+
+// Model-specific registers
+#define CPU_MSR_APIC_BASE 0x1B
+#define CPU_MSR_EFER 0xC0000080
+#define CPU_MSR_TSC_AUX 0xC0000103
+#define CPU_EFER_NXE (1ULL << 11)
+uint64_t cpu_read_msr(uint32_t msr);
+void cpu_write_msr(uint32_t msr, uint64_t value);
+
 // CPU flags
 uint64_t cpu_read_rflags(void);
 void cpu_write_rflags(uint64_t value);
@@ -138,6 +195,14 @@ void cpu_serialize(void);
 // CPU cache control
 void cpu_invalidate_tlb(void);
 void cpu_invalidate_tlb_page(uint64_t address);
+void cpu_invalidate_tlb_global(void);
+
+// INVPCID invalidation types
+#define CPU_INVPCID_ADDRESS 0
+#define CPU_INVPCID_CONTEXT 1
+#define CPU_INVPCID_ALL_GLOBAL 2
+#define CPU_INVPCID_ALL 3
+void cpu_invpcid(uint64_t type, uint64_t pcid, uint64_t address);
 void cpu_wbinvd(void);
 void cpu_clflush(void* address);
 void cpu_clflushopt(void* address);
@@ -6,6 +6,12 @@
 
 ; External symbols
 extern interrupt_handler_common
+extern interrupts_simd_mode
+extern interrupts_simd_size
+
+; Extended state save modes (interrupts.h)
+INTERRUPTS_SIMD_FXSAVE equ 1
+INTERRUPTS_SIMD_XSAVE equ 2
 
 ; Macro to create interrupt handler stub
 %macro INTERRUPT_HANDLER 1
@@ -85,64 +91,99 @@ IRQ_HANDLER 45
 IRQ_HANDLER 46
 IRQ_HANDLER 47
 
+; Inter-processor interrupt and APIC spurious vectors
+INTERRUPT_HANDLER 253
+INTERRUPT_HANDLER 255
+
 ; Common interrupt handler stub
 interrupt_handler_common_stub:
-    ; Save all general purpose registers
-    push rax
-    push rbx
-    push rcx
-    push rdx
-    push rsi
-    push rdi
-    push rbp
-    push r8
-    push r9
-    push r10
-    push r11
-    push r12
-    push r13
-    push r14
+    ; Save all general purpose registers in interrupt_context_t order (rax
+    ; ends up lowest; data segment registers are unused in 64-bit mode and
+    ; cannot be pushed)
     push r15
+    push r14
+    push r13
+    push r12
+    push r11
+    push r10
+    push r9
+    push r8
+    push rbp
+    push rdi
+    push rsi
+    push rdx
+    push rcx
+    push rbx
+    push rax
     
-    ; Save segment registers
-    push ds
-    push es
-    push fs
-    push gs
+    ; Save the interrupted code's x87/SSE/AVX state below the registers.
+    ; Handlers are C and may use vector registers (page faults copy and
+    ; zero pages with the SIMD routines), and they nest once a handler
+    ; re-enables interrupts, so the area goes on this stack rather than in
+    ; a per-CPU slot. RBX (saved above) keeps the frame across the call.
+    mov rbx, rsp
+    sub rsp, [rel interrupts_simd_size]
+    and rsp, -64
+    mov eax, [rel interrupts_simd_mode]
+    cmp eax, INTERRUPTS_SIMD_XSAVE
+    jne .save_fx
     
-    ; Set up kernel data segments
-    mov ax, 0x10
-    mov ds, ax
-    mov es, ax
-    mov fs, ax
-    mov gs, ax
+    ; XSAVE writes only XSTATE_BV of the header and XRSTOR rejects stray
+    ; bits in the rest, so clear it first; EDX:EAX = all enabled components
+    xor eax, eax
+    mov [rsp + 512], rax
+    mov [rsp + 520], rax
+    mov [rsp + 528], rax
+    mov [rsp + 536], rax
+    mov [rsp + 544], rax
+    mov [rsp + 552], rax
+    mov [rsp + 560], rax
+    mov [rsp + 568], rax
+    mov eax, -1
+    mov edx, -1
+    xsave [rsp]
+    jmp .saved
+.save_fx:
+    test eax, eax
+    jz .saved
+    fxsave [rsp]
+.saved:
     
     ; Call C interrupt handler
-    mov rdi, rsp    ; Pass stack pointer as context
+    mov rdi, rbx    ; Pass the register frame as context
     call interrupt_handler_common
     
-    ; Restore segment registers
-    pop gs
-    pop fs
-    pop es
-    pop ds
+    ; Restore the extended state and drop the save area
+    mov eax, [rel interrupts_simd_mode]
+    cmp eax, INTERRUPTS_SIMD_XSAVE
+    jne .restore_fx
+    mov eax, -1
+    mov edx, -1
+    xrstor [rsp]
+    jmp .restored
+.restore_fx:
+    test eax, eax
+    jz .restored
+    fxrstor [rsp]
+.restored:
+    mov rsp, rbx
     
     ; Restore all general purpose registers
-    pop r15
-    pop r14
-    pop r13
-    pop r12
-    pop r11
-    pop r10
-    pop r9
-    pop r8
-    pop rbp
-    pop rdi
-    pop rsi
-    pop rdx
-    pop rcx
-    pop rbx
     pop rax
+    pop rbx
+    pop rcx
+    pop rdx
+    pop rsi
+    pop rdi
+    pop rbp
+    pop r8
+    pop r9
+    pop r10
+    pop r11
+    pop r12
+    pop r13
+    pop r14
+    pop r15
     
     ; Remove error code and interrupt number from stack
     add rsp, 16
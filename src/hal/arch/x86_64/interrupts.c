@@ -6,6 +6,7 @@
 
 #include "interrupts.h"
 #include "io.h"
+#include "cpu.h"
 #include <string.h>
 
 // IDT and IDT descriptor
@@ -15,6 +16,13 @@ static idt_descriptor_t idt_desc;
 // Interrupt handler table
 static interrupt_handler_func_t interrupt_handlers[256] = {0};
 
+// Page fault resolver installed by the memory manager
+static page_fault_handler_t page_fault_handler = NULL;
+
+// Extended state save mode and area size, read by the common stub
+uint32_t interrupts_simd_mode = INTERRUPTS_SIMD_NONE;
+uint64_t interrupts_simd_size = 0;
+
 // Initialize interrupts
 void interrupts_init(void) {
     // Clear IDT
@@ -76,6 +84,10 @@ void interrupts_init(void) {
     interrupts_set_handler(46, (interrupt_handler_func_t)irq_handler_14, GATE_TYPE_INTERRUPT);
     interrupts_set_handler(47, (interrupt_handler_func_t)irq_handler_15, GATE_TYPE_INTERRUPT);
     
+    // Set up APIC vectors
+    interrupts_set_handler(INT_IPI, (interrupt_handler_func_t)interrupt_handler_253, GATE_TYPE_INTERRUPT);
+    interrupts_set_handler(INT_APIC_SPURIOUS, (interrupt_handler_func_t)interrupt_handler_255, GATE_TYPE_INTERRUPT);
+    
     // Initialize PIC
     pic_init();
     
@@ -101,8 +113,6 @@ void interrupts_set_handler(uint8_t vector, interrupt_handler_func_t handler, ui
     idt[vector].ist = 0;
     idt[vector].type_attr = type;
     idt[vector].reserved = 0;
-    
-    interrupt_handlers[vector] = handler;
 }
 
 // Enable interrupts
@@ -122,6 +132,29 @@ bool interrupts_are_enabled(void) {
     return (rflags & 0x200) != 0;
 }
 
+// Register a C handler called for a vector before the built-in handling
+void interrupts_register_handler(uint8_t vector, interrupt_handler_func_t handler) {
+    interrupt_handlers[vector] = handler;
+}
+
+// Install the page fault resolver
+void interrupts_set_page_fault_handler(page_fault_handler_t handler) {
+    page_fault_handler = handler;
+}
+
+// Select how the common stub saves vector state; call after
+// cpu_enable_simd and before interrupts are enabled. The area is
+// 64-byte aligned on the stack, so the size includes the alignment slack
+void interrupts_init_simd(bool xsave) {
+    if (xsave) {
+        interrupts_simd_size = cpu_xsave_size() + 64;
+        interrupts_simd_mode = INTERRUPTS_SIMD_XSAVE;
+    } else {
+        interrupts_simd_size = 512 + 64;
+        interrupts_simd_mode = INTERRUPTS_SIMD_FXSAVE;
+    }
+}
+
 // PIC initialization
 void pic_init(void) {
     // ICW1: Initialize PIC
@@ -358,8 +391,24 @@ void exception_general_protection(interrupt_context_t* context) {
 }
 
 void exception_page_fault(interrupt_context_t* context) {
-    // TODO: Implement page fault handling
-    (void)context;
+    // CR2 holds the faulting address; read it before anything can fault again
+    uint64_t address = cpu_read_cr2();
+    
+    // Resolving may wait for other CPUs (TLB shootdown), so run with
+    // interrupts on if the faulting code had them on
+    if (context->rflags & 0x200) {
+        cpu_enable_interrupts();
+    }
+    
+    if (page_fault_handler && page_fault_handler(address, context->error_code) == 0) {
+        return;
+    }
+    
+    // Unresolvable fault: retrying would fault forever, so stop this CPU
+    cpu_disable_interrupts();
+    for (;;) {
+        cpu_halt();
+    }
 }
 
 void exception_fpu_error(interrupt_context_t* context) {
@@ -51,6 +51,13 @@
 #define IRQ_ATA_PRIMARY 14
 #define IRQ_ATA_SECONDARY 15
 
+// Page fault error code bits
+#define PAGE_FAULT_PRESENT 0x01
+#define PAGE_FAULT_WRITE 0x02
+#define PAGE_FAULT_USER 0x04
+#define PAGE_FAULT_RESERVED 0x08
+#define PAGE_FAULT_FETCH 0x10
+
 // Interrupt gate types
 #define GATE_TYPE_INTERRUPT 0x8E
 #define GATE_TYPE_TRAP 0x8F
@@ -102,6 +109,9 @@ typedef struct {
     uint64_t ss;
 } interrupt_context_t;
 
+// Page fault resolver (returns 0 if the faulting access can be retried)
+typedef int (*page_fault_handler_t)(uint64_t address, uint64_t error_code);
+
 // Interrupt management functions
 void interrupts_init(void);
 void interrupts_load_idt(void);
@@ -109,6 +119,15 @@ void interrupts_set_handler(uint8_t vector, interrupt_handler_func_t handler, ui
 void interrupts_enable(void);
 void interrupts_disable(void);
 bool interrupts_are_enabled(void);
+void interrupts_register_handler(uint8_t vector, interrupt_handler_func_t handler);
+void interrupts_set_page_fault_handler(page_fault_handler_t handler);
+
+// Extended state saved by the common stub around every handler, so
+// handlers may use vector registers (modes are mirrored in interrupts.asm)
+#define INTERRUPTS_SIMD_NONE 0
+#define INTERRUPTS_SIMD_FXSAVE 1
+#define INTERRUPTS_SIMD_XSAVE 2
+void interrupts_init_simd(bool xsave);
 
 // PIC (Programmable Interrupt Controller) functions
 void pic_init(void);
@@ -170,6 +189,12 @@ void irq_handler_13(void);
 void irq_handler_14(void);
 void irq_handler_15(void);
 
+// Inter-processor interrupt and APIC spurious vectors
+#define INT_IPI 253
+#define INT_APIC_SPURIOUS 255
+void interrupt_handler_253(void);
+void interrupt_handler_255(void);
+
 // Common interrupt handler
 void interrupt_handler_common(interrupt_context_t* context);
 
@@ -5,9 +5,12 @@
  */
 
 #include "hal.h"
+#include "multiboot.h"
+#include "acpi.h"
 #include "arch/x86_64/cpu.h"
 #include "arch/x86_64/io.h"
 #include "arch/x86_64/interrupts.h"
+#include "arch/x86_64/apic.h"
 #include <stdarg.h>
 
 // Global HAL state
@@ -18,8 +21,25 @@ static struct {
     uint64_t timer_frequency;
     interrupt_handler_t interrupt_handlers[256];
     void* interrupt_contexts[256];
+    uint32_t multiboot_magic;
+    uint64_t multiboot_info;
+    uint32_t apic_ids[HAL_MAX_CPUS];
+    ipi_handler_t ipi_handler;
+    acpi_numa_t numa;
+    uint8_t cpu_nodes[HAL_MAX_CPUS];
 } g_hal_state = {0};
 
+// Kernel image bounds (defined in linker.ld)
+extern char _kernel_start[];
+extern char _kernel_end[];
+
+// Memory below 1 MB holds the IVT, BIOS data, video memory and the boot information
+#define HAL_LOW_MEMORY_END 0x100000
+
+// Debug output: COM1 at 115200 baud, 8N1
+#define HAL_DEBUG_PORT 0x3F8
+#define HAL_DEBUG_BAUD_DIVISOR 1
+
 /**
  * Detect CPU architecture
  */
@@ -35,6 +55,18 @@ static cpu_arch_t hal_detect_cpu_architecture(void) {
     return ARCH_UNKNOWN;
 }
 
+/**
+ * NUMA node of the CPU with the given APIC id (node 0 if the SRAT omits it)
+ */
+static uint8_t hal_numa_apic_node(uint32_t apic_id) {
+    for (size_t i = 0; i < g_hal_state.numa.cpu_count; i++) {
+        if (g_hal_state.numa.cpus[i].apic_id == apic_id) {
+            return (uint8_t)g_hal_state.numa.cpus[i].node;
+        }
+    }
+    return 0;
+}
+
 /**
  * Initialize HAL
  */
@@ -49,10 +81,23 @@ hal_status_t hal_init(void) {
     
     // Initialize architecture-specific components
     switch (g_hal_state.cpu_arch) {
-        case ARCH_X86_64:
+        case ARCH_X86_64: {
             // Initialize x86_64 specific components
+            cpu_info_t cpu_info = {0};
+            cpu_detect(&cpu_info);
+            cpu_enable_simd(&cpu_info);
             interrupts_init();
+            interrupts_init_simd(cpu_info.features.xsave);
+            if (apic_init(&cpu_info)) {
+                g_hal_state.apic_ids[0] = apic_get_id();
+            }
+            
+            // NUMA topology (a single node when there are no ACPI tables)
+            acpi_init();
+            acpi_read_numa(&g_hal_state.numa);
+            g_hal_state.cpu_nodes[0] = hal_numa_apic_node(g_hal_state.apic_ids[0]);
             break;
+        }
         case ARCH_ARM64:
             // TODO: Initialize ARM64 specific components
             break;
@@ -109,25 +154,136 @@ uint32_t hal_get_cpu_count(void) {
 }
 
 /**
- * Memory map (placeholder implementation)
+ * Get the index of the executing CPU (0 .. HAL_MAX_CPUS - 1)
+ */
+uint32_t hal_get_cpu_id(void) {
+    // Each CPU stores its index in TSC_AUX when it comes up; with only the
+    // boot CPU running there is nothing to look up
+    if (g_hal_state.cpu_count <= 1) {
+        return 0;
+    }
+    return (uint32_t)cpu_read_tsc_aux();
+}
+
+/**
+ * Record the index of the executing CPU (called once per CPU at bring-up)
+ */
+hal_status_t hal_set_cpu_id(uint32_t cpu_id) {
+    if (cpu_id >= HAL_MAX_CPUS) {
+        return HAL_ERROR_INVALID_PARAM;
+    }
+    
+    cpu_write_msr(CPU_MSR_TSC_AUX, cpu_id);
+    g_hal_state.apic_ids[cpu_id] = apic_get_id();
+    g_hal_state.cpu_nodes[cpu_id] = hal_numa_apic_node(g_hal_state.apic_ids[cpu_id]);
+    return HAL_SUCCESS;
+}
+
+/**
+ * Record the boot information structure passed by the loader
+ */
+hal_status_t hal_set_multiboot_info(uint32_t magic, uint64_t info_address) {
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || info_address == 0) {
+        return HAL_ERROR_INVALID_PARAM;
+    }
+    
+    g_hal_state.multiboot_magic = magic;
+    g_hal_state.multiboot_info = info_address;
+    return HAL_SUCCESS;
+}
+
+/**
+ * Append a region to a memory map
+ */
+static void hal_memory_add_region(memory_region_t* regions, size_t max_regions, size_t* count,
+                                  uint64_t base, uint64_t size, memory_type_t type, bool available) {
+    if (size == 0 || *count >= max_regions) {
+        return;
+    }
+    
+    regions[*count].base_address = base;
+    regions[*count].size = size;
+    regions[*count].type = type;
+    regions[*count].is_available = available;
+    (*count)++;
+}
+
+/**
+ * Append a usable RAM range, leaving out low memory and the kernel image
+ */
+static void hal_memory_add_ram(memory_region_t* regions, size_t max_regions, size_t* count,
+                               uint64_t base, uint64_t end) {
+    uint64_t kernel_start = (uint64_t)(uintptr_t)_kernel_start;
+    uint64_t kernel_end = (uint64_t)(uintptr_t)_kernel_end;
+    
+    if (base < HAL_LOW_MEMORY_END) {
+        base = HAL_LOW_MEMORY_END;
+    }
+    if (base >= end) {
+        return;
+    }
+    
+    if (kernel_end > base && kernel_start < end) {
+        if (kernel_start > base) {
+            hal_memory_add_region(regions, max_regions, count, base, kernel_start - base, MEMORY_TYPE_RAM, true);
+        }
+        if (kernel_end < end) {
+            hal_memory_add_region(regions, max_regions, count, kernel_end, end - kernel_end, MEMORY_TYPE_RAM, true);
+        }
+        return;
+    }
+    
+    hal_memory_add_region(regions, max_regions, count, base, end - base, MEMORY_TYPE_RAM, true);
+}
+
+/**
+ * Memory map (from the Multiboot memory map when the loader provided one)
  */
 hal_status_t hal_memory_map(memory_region_t* regions, size_t max_regions, size_t* actual_count) {
     if (!regions || !actual_count) {
         return HAL_ERROR_INVALID_PARAM;
     }
     
-    // TODO: Implement proper memory mapping
-    // For now, return a dummy region
-    if (max_regions > 0) {
-        regions[0].base_address = 0x100000; // 1MB
-        regions[0].size = 0x10000000; // 256MB
-        regions[0].type = MEMORY_TYPE_RAM;
-        regions[0].is_available = true;
-        *actual_count = 1;
+    *actual_count = 0;
+    
+    const multiboot_info_t* info = (const multiboot_info_t*)(uintptr_t)g_hal_state.multiboot_info;
+    
+    if (info && (info->flags & MULTIBOOT_INFO_MEM_MAP)) {
+        uint64_t offset = 0;
+        while (offset + sizeof(multiboot_mmap_entry_t) <= info->mmap_length) {
+            const multiboot_mmap_entry_t* entry =
+                (const multiboot_mmap_entry_t*)(uintptr_t)(info->mmap_addr + offset);
+            
+            switch (entry->type) {
+                case MULTIBOOT_MEMORY_AVAILABLE:
+                    hal_memory_add_ram(regions, max_regions, actual_count, entry->addr, entry->addr + entry->len);
+                    break;
+                case MULTIBOOT_MEMORY_ACPI_RECLAIMABLE:
+                    hal_memory_add_region(regions, max_regions, actual_count, entry->addr, entry->len, MEMORY_TYPE_RAM, false);
+                    break;
+                default:
+                    hal_memory_add_region(regions, max_regions, actual_count, entry->addr, entry->len, MEMORY_TYPE_RESERVED, false);
+                    break;
+            }
+            
+            offset += entry->size + sizeof(entry->size);
+        }
+    } else if (info && (info->flags & MULTIBOOT_INFO_MEMORY)) {
+        // Only the upper memory size is known (in KB, starting at 1 MB)
+        hal_debug_puts("hal: no Multiboot memory map, using the upper memory size\n");
+        hal_memory_add_ram(regions, max_regions, actual_count, HAL_LOW_MEMORY_END,
+                           HAL_LOW_MEMORY_END + (uint64_t)info->mem_upper * 1024);
     } else {
-        *actual_count = 0;
+        // No boot information (not started by a Multiboot loader): assume
+        // 256 MB at 1 MB
+        hal_debug_puts("hal: no Multiboot information, assuming 256 MB of RAM at 1 MB\n");
+        hal_memory_add_ram(regions, max_regions, actual_count, HAL_LOW_MEMORY_END, HAL_LOW_MEMORY_END + 0x10000000);
     }
     
+    // Report the kernel image itself as in-use RAM
+    hal_memory_add_region(regions, max_regions, actual_count, (uint64_t)(uintptr_t)_kernel_start,
+                          (uint64_t)(_kernel_end - _kernel_start), MEMORY_TYPE_RAM, false);
+    
     return HAL_SUCCESS;
 }
 
@@ -154,6 +310,51 @@ hal_status_t hal_memory_flush_cache(void* address, size_t size) {
     return HAL_SUCCESS;
 }
 
+/**
+ * Number of NUMA nodes
+ */
+uint32_t hal_numa_node_count(void) {
+    return g_hal_state.numa.node_count ? g_hal_state.numa.node_count : 1;
+}
+
+/**
+ * NUMA node of a CPU
+ */
+uint32_t hal_numa_cpu_node(uint32_t cpu_id) {
+    return cpu_id < HAL_MAX_CPUS ? g_hal_state.cpu_nodes[cpu_id] : 0;
+}
+
+/**
+ * Relative memory access cost between two nodes (10 for a node to itself)
+ */
+uint32_t hal_numa_distance(uint32_t from_node, uint32_t to_node) {
+    if (from_node >= HAL_MAX_NUMA_NODES || to_node >= HAL_MAX_NUMA_NODES) {
+        return 0;
+    }
+    if (g_hal_state.numa.node_count == 0) {
+        return from_node == to_node ? ACPI_DISTANCE_LOCAL : ACPI_DISTANCE_REMOTE;
+    }
+    return g_hal_state.numa.distances[from_node][to_node];
+}
+
+/**
+ * Physical memory ranges with their node (empty when there is one node and
+ * all memory belongs to it)
+ */
+hal_status_t hal_numa_memory_map(numa_memory_region_t* regions, size_t max_regions, size_t* actual_count) {
+    if (!regions || !actual_count) {
+        return HAL_ERROR_INVALID_PARAM;
+    }
+    
+    size_t count = g_hal_state.numa.range_count < max_regions ? g_hal_state.numa.range_count : max_regions;
+    for (size_t i = 0; i < count; i++) {
+        regions[i] = g_hal_state.numa.ranges[i];
+    }
+    
+    *actual_count = count;
+    return HAL_SUCCESS;
+}
+
 /**
  * Register interrupt handler
  */
@@ -204,6 +405,66 @@ hal_status_t hal_interrupt_acknowledge(uint32_t interrupt_number) {
     return HAL_SUCCESS;
 }
 
+/**
+ * Disable interrupts on this CPU, returning the previous state
+ */
+uint64_t hal_interrupt_save(void) {
+    uint64_t flags = cpu_read_rflags();
+    cpu_disable_interrupts();
+    return flags & 0x200;
+}
+
+/**
+ * Restore the interrupt state returned by hal_interrupt_save
+ */
+void hal_interrupt_restore(uint64_t state) {
+    if (state & 0x200) {
+        cpu_enable_interrupts();
+    }
+}
+
+/**
+ * Run the IPI handler and acknowledge the interrupt
+ */
+static void hal_ipi_dispatch(uint32_t interrupt_number, uint32_t error_code, void* context) {
+    (void)interrupt_number;
+    (void)error_code;
+    (void)context;
+    
+    if (g_hal_state.ipi_handler) {
+        g_hal_state.ipi_handler();
+    }
+    apic_eoi();
+}
+
+/**
+ * Install the inter-processor interrupt handler
+ */
+hal_status_t hal_ipi_set_handler(ipi_handler_t handler) {
+    if (g_hal_state.cpu_arch != ARCH_X86_64 || !apic_is_enabled()) {
+        return HAL_ERROR_NOT_IMPLEMENTED;
+    }
+    
+    g_hal_state.ipi_handler = handler;
+    interrupts_register_handler(INT_IPI, handler ? hal_ipi_dispatch : NULL);
+    return HAL_SUCCESS;
+}
+
+/**
+ * Interrupt another CPU
+ */
+hal_status_t hal_ipi_send(uint32_t cpu_id) {
+    if (cpu_id >= g_hal_state.cpu_count || cpu_id >= HAL_MAX_CPUS) {
+        return HAL_ERROR_INVALID_PARAM;
+    }
+    if (!apic_is_enabled()) {
+        return HAL_ERROR_NOT_IMPLEMENTED;
+    }
+    
+    apic_send_ipi(g_hal_state.apic_ids[cpu_id], INT_IPI);
+    return HAL_SUCCESS;
+}
+
 /**
  * Initialize timer
  */
@@ -314,8 +575,15 @@ hal_status_t hal_get_system_info(void* info_buffer, size_t buffer_size) {
  * Debug and logging
  */
 hal_status_t hal_debug_putchar(char c) {
-    // TODO: Implement proper debug output (serial, VGA, etc.)
-    (void)c;
+    if (c == '\n') {
+        hal_debug_putchar('\r');
+    }
+    
+    // Wait for the transmit holding register to empty
+    while (!(io_inb(HAL_DEBUG_PORT + 5) & 0x20)) {
+        cpu_pause();
+    }
+    io_outb(HAL_DEBUG_PORT, (uint8_t)c);
     return HAL_SUCCESS;
 }
 
@@ -331,6 +599,12 @@ hal_status_t hal_debug_puts(const char* str) {
 }
 
 hal_status_t hal_log_init(void) {
-    // TODO: Implement proper logging initialization
+    io_outb(HAL_DEBUG_PORT + 1, 0x00);                          // No UART interrupts
+    io_outb(HAL_DEBUG_PORT + 3, 0x80);                          // Divisor latch access
+    io_outb(HAL_DEBUG_PORT + 0, HAL_DEBUG_BAUD_DIVISOR & 0xFF);
+    io_outb(HAL_DEBUG_PORT + 1, HAL_DEBUG_BAUD_DIVISOR >> 8);
+    io_outb(HAL_DEBUG_PORT + 3, 0x03);                          // 8 bits, no parity, 1 stop bit
+    io_outb(HAL_DEBUG_PORT + 2, 0xC7);                          // FIFOs on and cleared
+    io_outb(HAL_DEBUG_PORT + 4, 0x03);                          // DTR and RTS
     return HAL_SUCCESS;
 }
@@ -47,9 +47,25 @@ typedef struct {
     bool is_available;
 } memory_region_t;
 
+// Maximum number of CPUs the kernel keeps per-CPU state for
+#define HAL_MAX_CPUS 64
+
+// Maximum number of NUMA nodes (memory and CPUs sharing a memory controller)
+#define HAL_MAX_NUMA_NODES 8
+
+// Physical memory range belonging to one NUMA node
+typedef struct {
+    uint64_t base_address;
+    uint64_t size;
+    uint32_t node;
+} numa_memory_region_t;
+
 // Interrupt handler type
 typedef void (*interrupt_handler_t)(uint32_t interrupt_number, void* context);
 
+// Inter-processor interrupt handler type (runs with interrupts off)
+typedef void (*ipi_handler_t)(void);
+
 // Timer callback type
 typedef void (*timer_callback_t)(void* context);
 
@@ -61,18 +77,35 @@ void hal_shutdown(void);
 cpu_arch_t hal_get_cpu_architecture(void);
 const char* hal_get_cpu_architecture_string(void);
 uint32_t hal_get_cpu_count(void);
+uint32_t hal_get_cpu_id(void);
+hal_status_t hal_set_cpu_id(uint32_t cpu_id);
 
 // Memory management
+hal_status_t hal_set_multiboot_info(uint32_t magic, uint64_t info_address);
 hal_status_t hal_memory_map(memory_region_t* regions, size_t max_regions, size_t* actual_count);
 hal_status_t hal_memory_protect(void* address, size_t size, bool read, bool write, bool execute);
 hal_status_t hal_memory_flush_cache(void* address, size_t size);
 
+// NUMA topology (from the ACPI SRAT/SLIT; a single node 0 without them)
+uint32_t hal_numa_node_count(void);
+uint32_t hal_numa_cpu_node(uint32_t cpu_id);
+uint32_t hal_numa_distance(uint32_t from_node, uint32_t to_node);
+hal_status_t hal_numa_memory_map(numa_memory_region_t* regions, size_t max_regions, size_t* actual_count);
+
 // Interrupt handling
 hal_status_t hal_interrupt_register(uint32_t interrupt_number, interrupt_handler_t handler, void* context);
 hal_status_t hal_interrupt_enable(uint32_t interrupt_number);
 hal_status_t hal_interrupt_disable(uint32_t interrupt_number);
 hal_status_t hal_interrupt_acknowledge(uint32_t interrupt_number);
 
+// Local interrupt state (save disables interrupts on this CPU)
+uint64_t hal_interrupt_save(void);
+void hal_interrupt_restore(uint64_t state);
+
+// Inter-processor interrupts (a single vector; the handler finds out why)
+hal_status_t hal_ipi_set_handler(ipi_handler_t handler);
+hal_status_t hal_ipi_send(uint32_t cpu_id);
+
 // Timer functions
 hal_status_t hal_timer_init(uint32_t frequency_hz);
 hal_status_t hal_timer_register_callback(timer_callback_t callback, void* context);
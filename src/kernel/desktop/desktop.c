@@ -6,11 +6,15 @@
 
 #include "desktop.h"
 #include "../../drivers/vga/vga.h"
+#include "../memory/slab.h"
 #include <string.h>
 
 // Desktop state
 static desktop_t g_desktop = {0};
 
+// Window object cache
+static slab_cache_t* g_window_cache = NULL;
+
 // Desktop initialization
 int desktop_init(void) {
     if (g_desktop.running) {
@@ -22,6 +26,14 @@ int desktop_init(void) {
         return -1;
     }
     
+    // Window structures come from a dedicated object cache
+    if (!g_window_cache) {
+        g_window_cache = slab_cache_create("window_t", sizeof(window_t), 0, NULL);
+        if (!g_window_cache) {
+            return -1;
+        }
+    }
+    
     // Set up desktop
     g_desktop.mode = DESKTOP_MODE_TEXT;
     g_desktop.width = 80;
@@ -99,7 +111,7 @@ window_t* desktop_create_window(const char* title, uint16_t x, uint16_t y, uint1
     }
     
     // Allocate window
-    window_t* window = (window_t*)malloc(sizeof(window_t));
+    window_t* window = (window_t*)slab_alloc(g_window_cache);
     if (!window) {
         return NULL;
     }
@@ -167,7 +179,7 @@ int desktop_destroy_window(window_t* window) {
     }
     
     // Free window
-    free(window);
+    slab_free(g_window_cache, window);
     
     return 0;
 }
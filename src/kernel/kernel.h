@@ -33,7 +33,7 @@ typedef struct {
 } kernel_state_t;
 
 // Function declarations
-void kernel_main(void);
+void kernel_main(uint32_t multiboot_magic, uint64_t multiboot_info);
 const char* kernel_get_version_string(void);
 const kernel_state_t* kernel_get_state(void);
 
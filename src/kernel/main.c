@@ -13,6 +13,9 @@
 #include "kernel.h"
 #include "hal/hal.h"
 #include "memory/memory.h"
+#include "memory/page.h"
+#include "memory/paging.h"
+#include "memory/vm.h"
 #include "memory/multibit.h"
 #include "memory/memory_tools.h"
 #include "process/process.h"
@@ -45,6 +48,16 @@ static int kernel_early_init(void) {
         return -1;
     }
     
+    // Switch to the kernel's own page tables
+    if (paging_init() != 0) {
+        return -1;
+    }
+    
+    // Enable demand paging for lazily reserved areas
+    if (vm_init() != 0) {
+        return -1;
+    }
+    
     return 0;
 }
 
@@ -57,37 +70,37 @@ static int kernel_init(void) {
     if (process_init() != 0) {
         return -1;
     }
-
+    
     // Initialize multi-bit memory system
     if (multibit_init() != 0) {
         return -1;
     }
-
+    
     // Initialize memory tools
     if (memory_tools_init() != 0) {
         return -1;
     }
-
+    
     // Initialize debugger
     if (debugger_init() != 0) {
         return -1;
     }
-
+    
     // Initialize terminal
     if (terminal_init() != 0) {
         return -1;
     }
-
+    
     // Initialize REPL
     if (repl_init() != 0) {
         return -1;
     }
-
+    
     // Initialize desktop
     if (desktop_init() != 0) {
         return -1;
     }
-
+    
     return 0;
 }
     
@@ -99,15 +112,19 @@ static int kernel_init(void) {
 
 /**
  * Main kernel entry point
- * Called by the bootloader
+ * Called by kernel_entry (hal/arch/x86_64/boot.asm) in long mode with the
+ * Multiboot magic and boot information address the loader left in EAX/EBX
  */
-void kernel_main(void) {
+void kernel_main(uint32_t multiboot_magic, uint64_t multiboot_info) {
     // Set up kernel state
     g_kernel_state.version_major = KERNEL_VERSION_MAJOR;
     g_kernel_state.version_minor = KERNEL_VERSION_MINOR;
     g_kernel_state.version_patch = KERNEL_VERSION_PATCH;
     g_kernel_state.status = KERNEL_STATUS_INITIALIZING;
     
+    // Hand the loader's memory map to the HAL before memory management starts
+    hal_set_multiboot_info(multiboot_magic, multiboot_info);
+    
     // Early initialization
     if (kernel_early_init() != 0) {
         g_kernel_state.status = KERNEL_STATUS_ERROR;
@@ -143,16 +160,19 @@ void kernel_main(void) {
     while (g_kernel_state.status == KERNEL_STATUS_RUNNING) {
         // Handle terminal input
         terminal_handle_input(0); // This will be called by interrupt handlers
-        
+    
         // Process system calls
         // TODO: Implement system call handling
-        
+    
         // Handle interrupts
         // TODO: Implement interrupt handling
-        
+    
         // Yield to other processes
         process_schedule();
-        
+    
+        // Use idle time to top up the pre-zeroed page pool
+        page_zero_pool_refill(PAGE_ZERO_IDLE_BATCH);
+    
         // Small delay to prevent busy waiting
         hal_halt();
     }
@@ -3,6 +3,15 @@
 
 #include <stdint.h>
 
+/**
+ * Addressing modes for multi-bit memory access.
+ */
+typedef enum {
+    MEMORY_MODE_16BIT = 16,
+    MEMORY_MODE_32BIT = 32,
+    MEMORY_MODE_64BIT = 64
+} memory_mode_t;
+
 /**
  * Access permissions for memory pages/regions.
  */
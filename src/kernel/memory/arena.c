@@ -0,0 +1,237 @@
+/**
+ * CompileOS Arena Allocator - Implementation
+ *
+ * Arenas bump-allocate out of chunks taken from the page allocator. The
+ * arena header lives in its first chunk; reset rewinds to the start of that
+ * chunk and keeps later chunks for reuse, so a reset is O(1).
+ */
+
+#include "arena.h"
+#include "page.h"
+#include <string.h>
+
+// Largest chunk the arena grows to on its own (1 MB)
+#define ARENA_MAX_CHUNK_ORDER 8
+
+static char* arena_align_ptr(char* ptr, size_t alignment) {
+    return (char*)(((uintptr_t)ptr + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+/**
+ * First usable byte of a chunk
+ */
+static char* arena_chunk_start(const arena_t* arena, arena_chunk_t* chunk) {
+    char* start = (char*)chunk + sizeof(arena_chunk_t);
+    if (chunk == arena->first) {
+        start += sizeof(arena_t);
+    }
+    return arena_align_ptr(start, ARENA_ALIGNMENT);
+}
+
+/**
+ * Take a new chunk from the page allocator
+ */
+static arena_chunk_t* arena_chunk_create(unsigned int order) {
+    arena_chunk_t* chunk = (arena_chunk_t*)page_alloc(order);
+    if (!chunk) {
+        return NULL;
+    }
+    
+    chunk->next = NULL;
+    chunk->limit = (char*)chunk + ((size_t)PAGE_SIZE << order);
+    chunk->order = order;
+    return chunk;
+}
+
+/**
+ * Create an arena with room for at least initial_size bytes
+ */
+arena_t* arena_create(size_t initial_size) {
+    if (initial_size > SIZE_MAX / 2) {
+        return NULL;
+    }
+    
+    unsigned int order = page_order_for_size(initial_size + sizeof(arena_chunk_t) + sizeof(arena_t) + ARENA_ALIGNMENT);
+    if (order > PAGE_MAX_ORDER) {
+        return NULL;
+    }
+    
+    arena_chunk_t* chunk = arena_chunk_create(order);
+    if (!chunk) {
+        return NULL;
+    }
+    
+    arena_t* arena = (arena_t*)((char*)chunk + sizeof(arena_chunk_t));
+    arena->first = chunk;
+    arena->current = chunk;
+    arena->chunk_order = order;
+    arena->chunk_count = 1;
+    arena->reset_count = 0;
+    arena->cursor = arena_chunk_start(arena, chunk);
+    arena->limit = chunk->limit;
+    
+    return arena;
+}
+
+/**
+ * Destroy an arena and return all of its chunks
+ */
+void arena_destroy(arena_t* arena) {
+    if (!arena) {
+        return;
+    }
+    
+    // The arena itself lives in the first chunk, so release that one last
+    arena_chunk_t* first = arena->first;
+    arena_chunk_t* chunk = first->next;
+    while (chunk) {
+        arena_chunk_t* next = chunk->next;
+        page_free(chunk, chunk->order);
+        chunk = next;
+    }
+    
+    page_free(first, first->order);
+}
+
+/**
+ * Release everything allocated from an arena
+ */
+void arena_reset(arena_t* arena) {
+    if (!arena) {
+        return;
+    }
+    
+    arena->current = arena->first;
+    arena->cursor = arena_chunk_start(arena, arena->first);
+    arena->limit = arena->first->limit;
+    arena->reset_count++;
+}
+
+/**
+ * Allocate when the current chunk is exhausted
+ */
+void* arena_alloc_slow(arena_t* arena, size_t size, size_t alignment) {
+    if (!arena || size > SIZE_MAX / 2) {
+        return NULL;
+    }
+    
+    size_t rounded = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    
+    // Reuse the chunk retained after the current one if the request fits;
+    // a retained chunk that is too small is given back rather than skipped
+    arena_chunk_t* chunk = arena->current->next;
+    while (chunk) {
+        char* start = arena_align_ptr(arena_chunk_start(arena, chunk), alignment);
+        if (start <= chunk->limit && (size_t)(chunk->limit - start) >= rounded) {
+            arena->current = chunk;
+            arena->cursor = start + rounded;
+            arena->limit = chunk->limit;
+            return start;
+        }
+        
+        arena->current->next = chunk->next;
+        arena->chunk_count--;
+        page_free(chunk, chunk->order);
+        chunk = arena->current->next;
+    }
+    
+    // Otherwise link a new chunk in after the current one, doubling the
+    // chunk size up to ARENA_MAX_CHUNK_ORDER
+    unsigned int order = page_order_for_size(rounded + alignment + sizeof(arena_chunk_t));
+    unsigned int grown = arena->chunk_order < ARENA_MAX_CHUNK_ORDER ? arena->chunk_order + 1 : arena->chunk_order;
+    if (order < grown) {
+        order = grown;
+    }
+    if (order > PAGE_MAX_ORDER) {
+        return NULL;
+    }
+    
+    chunk = arena_chunk_create(order);
+    if (!chunk) {
+        return NULL;
+    }
+    
+    arena->current->next = chunk;
+    arena->chunk_count++;
+    arena->chunk_order = grown;
+    
+    char* start = arena_align_ptr(arena_chunk_start(arena, chunk), alignment);
+    arena->current = chunk;
+    arena->cursor = start + rounded;
+    arena->limit = chunk->limit;
+    return start;
+}
+
+/**
+ * Allocate with a larger alignment than ARENA_ALIGNMENT
+ */
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t alignment) {
+    if (!arena || (alignment & (alignment - 1))) {
+        return NULL;
+    }
+    if (alignment <= ARENA_ALIGNMENT) {
+        return arena_alloc(arena, size);
+    }
+    
+    char* start = arena_align_ptr(arena->cursor, alignment);
+    if (start <= arena->limit && (size_t)(arena->limit - start) >= size) {
+        arena->cursor = start + ((size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1));
+        return start;
+    }
+    
+    return arena_alloc_slow(arena, size, alignment);
+}
+
+/**
+ * Copy a string into an arena
+ */
+char* arena_strdup(arena_t* arena, const char* str) {
+    if (!str) {
+        return NULL;
+    }
+    return arena_strndup(arena, str, strlen(str));
+}
+
+/**
+ * Copy at most length characters of a string into an arena
+ */
+char* arena_strndup(arena_t* arena, const char* str, size_t length) {
+    if (!arena || !str) {
+        return NULL;
+    }
+    
+    size_t actual = 0;
+    while (actual < length && str[actual]) {
+        actual++;
+    }
+    
+    char* copy = (char*)arena_alloc(arena, actual + 1);
+    if (!copy) {
+        return NULL;
+    }
+    
+    memcpy(copy, str, actual);
+    copy[actual] = '\0';
+    return copy;
+}
+
+/**
+ * Remember the current arena position
+ */
+arena_mark_t arena_mark(const arena_t* arena) {
+    arena_mark_t mark = { arena->current, arena->cursor };
+    return mark;
+}
+
+/**
+ * Free everything allocated since a mark
+ */
+void arena_rewind(arena_t* arena, arena_mark_t mark) {
+    if (!arena || !mark.chunk) {
+        return;
+    }
+    
+    arena->current = mark.chunk;
+    arena->cursor = mark.cursor;
+    arena->limit = mark.chunk->limit;
+}
@@ -0,0 +1,68 @@
+/**
+ * CompileOS Arena Allocator - Header
+ *
+ * Region (bump) allocation for short-lived objects that die together
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Default alignment of arena allocations
+#define ARENA_ALIGNMENT 16
+
+// Arena chunk (page-allocator block, header at its start)
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    char* limit;
+    unsigned int order;
+} arena_chunk_t;
+
+// Arena
+typedef struct arena {
+    char* cursor;
+    char* limit;
+    arena_chunk_t* first;
+    arena_chunk_t* current;
+    unsigned int chunk_order;
+    size_t chunk_count;
+    size_t reset_count;
+} arena_t;
+
+// Saved arena position
+typedef struct {
+    arena_chunk_t* chunk;
+    char* cursor;
+} arena_mark_t;
+
+// Arena lifetime
+arena_t* arena_create(size_t initial_size);
+void arena_destroy(arena_t* arena);
+void arena_reset(arena_t* arena);
+
+// Slow path (next chunk or a fresh one)
+void* arena_alloc_slow(arena_t* arena, size_t size, size_t alignment);
+
+// Allocation (bump the cursor; no per-object free). The cursor and limit
+// are always ARENA_ALIGNMENT aligned, so checking the unrounded size is enough.
+static inline void* arena_alloc(arena_t* arena, size_t size) {
+    if ((size_t)(arena->limit - arena->cursor) >= size) {
+        void* ptr = arena->cursor;
+        arena->cursor += (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+        return ptr;
+    }
+    return arena_alloc_slow(arena, size, ARENA_ALIGNMENT);
+}
+
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t alignment);
+char* arena_strdup(arena_t* arena, const char* str);
+char* arena_strndup(arena_t* arena, const char* str, size_t length);
+
+// Scoped rewinding
+arena_mark_t arena_mark(const arena_t* arena);
+void arena_rewind(arena_t* arena, arena_mark_t mark);
+
+#endif // ARENA_H
@@ -0,0 +1,574 @@
+/**
+ * CompileOS Physics Broadphase - Implementation
+ *
+ * An update hashes every position to a bucket and keeps the per-bucket
+ * counts current by moving only the entities whose bucket changed. If none
+ * did, the sorted layout is still valid and the new positions are written
+ * to each entity's slot. Otherwise an exclusive prefix sum over the counts
+ * and a descending scatter re-sort the entities; the scatter leaves each
+ * bucket ordered by entity index.
+ *
+ * A radius query visits every cell overlapping the box of side 2 * radius
+ * around its point, reads each cell's bucket once (a per-query mark skips
+ * buckets that several cells hash to), and tests the entities there by
+ * exact distance, so hash collisions only cost extra candidates.
+ *
+ * The pair search works a bucket at a time rather than an entity at a
+ * time: the entities of a bucket are tested against each other and then
+ * against the buckets of the cells around each of its cells, taking only
+ * buckets with a higher index. Neighbourhoods are symmetric, so every pair
+ * is found exactly once without a per-candidate filter, and the bucket
+ * lookups are shared by all entities of a cell.
+ */
+
+#include "broadphase.h"
+#include "memory.h"
+
+// Multipliers for the block hash (the top bits of the sum pick the block)
+#define BROADPHASE_HASH_X 0x9E3779B97F4A7C15ULL
+#define BROADPHASE_HASH_Y 0xC2B2AE3D27D4EB4FULL
+#define BROADPHASE_HASH_Z 0x165667B19E3779F9ULL
+
+// Query output
+typedef struct {
+    broadphase_pair_t* pairs;
+    uint32_t* entities;
+    size_t max;
+    size_t found;
+} broadphase_sink_t;
+
+/**
+ * Sign-extend a coordinate of width bits
+ */
+static inline int64_t broadphase_load(const char* p, unsigned int width) {
+    switch (width) {
+        case 16: return (int16_t)*(const uint16_t*)p;
+        case 32: return (int32_t)*(const uint32_t*)p;
+        default: return (int64_t)*(const uint64_t*)p;
+    }
+}
+
+/**
+ * Bucket of a cell: the hashed block, then the cell within it
+ */
+static inline uint32_t broadphase_cell_bucket(const broadphase_t* grid, int64_t cx, int64_t cy, int64_t cz) {
+    const uint64_t mask = (1u << BROADPHASE_BLOCK_SHIFT) - 1;
+    uint64_t hash = (uint64_t)(cx >> BROADPHASE_BLOCK_SHIFT) * BROADPHASE_HASH_X +
+                    (uint64_t)(cy >> BROADPHASE_BLOCK_SHIFT) * BROADPHASE_HASH_Y +
+                    (uint64_t)(cz >> BROADPHASE_BLOCK_SHIFT) * BROADPHASE_HASH_Z;
+    uint64_t block = grid->bucket_bits > 3 * BROADPHASE_BLOCK_SHIFT ?
+                     hash >> (64 - (grid->bucket_bits - 3 * BROADPHASE_BLOCK_SHIFT)) : 0;
+    uint64_t cell = ((uint64_t)cz & mask) << (2 * BROADPHASE_BLOCK_SHIFT) |
+                    ((uint64_t)cy & mask) << BROADPHASE_BLOCK_SHIFT | ((uint64_t)cx & mask);
+    return (uint32_t)(block << (3 * BROADPHASE_BLOCK_SHIFT) | cell);
+}
+
+static inline uint32_t broadphase_bucket(const broadphase_t* grid, int64_t x, int64_t y, int64_t z) {
+    return broadphase_cell_bucket(grid, x >> grid->cell_shift, y >> grid->cell_shift, z >> grid->cell_shift);
+}
+
+/**
+ * Distance test. Below 2^31 the squared sum fits in 64 bits; otherwise it
+ * is done in 128 (radius is at most INT64_MAX, so it fits there).
+ */
+static inline bool broadphase_within(int64_t ax, int64_t ay, int64_t az,
+                                     int64_t bx, int64_t by, int64_t bz, uint64_t radius) {
+    uint64_t dx = ax > bx ? (uint64_t)ax - (uint64_t)bx : (uint64_t)bx - (uint64_t)ax;
+    uint64_t dy = ay > by ? (uint64_t)ay - (uint64_t)by : (uint64_t)by - (uint64_t)ay;
+    uint64_t dz = az > bz ? (uint64_t)az - (uint64_t)bz : (uint64_t)bz - (uint64_t)az;
+    if (dx > radius || dy > radius || dz > radius) {
+        return false;
+    }
+    if (radius < 0x80000000ULL) {
+        return dx * dx + dy * dy + dz * dz <= radius * radius;
+    }
+    
+    unsigned __int128 distance = (unsigned __int128)dx * dx + (unsigned __int128)dy * dy +
+                                 (unsigned __int128)dz * dz;
+    return distance <= (unsigned __int128)radius * radius;
+}
+
+/**
+ * Cells covering coordinate - radius .. coordinate + radius on one axis
+ */
+static inline void broadphase_cell_range(const broadphase_t* grid, int64_t coordinate, uint64_t radius,
+                                         int64_t* low, int64_t* high) {
+    __int128 from = (__int128)coordinate - (__int128)radius;
+    __int128 to = (__int128)coordinate + (__int128)radius;
+    if (from < INT64_MIN) from = INT64_MIN;
+    if (to > INT64_MAX) to = INT64_MAX;
+    *low = (int64_t)from >> grid->cell_shift;
+    *high = (int64_t)to >> grid->cell_shift;
+}
+
+/**
+ * Start a query: a fresh mark for the buckets it visits
+ */
+static void broadphase_next_mark(broadphase_t* grid) {
+    if (++grid->mark == 0) {
+        memory_set(grid->bucket_mark, 0, grid->bucket_count * sizeof(uint32_t));
+        grid->mark = 1;
+    }
+}
+
+/**
+ * Emit one match (stored while there is room, always counted)
+ */
+static inline void broadphase_emit(broadphase_sink_t* sink, uint32_t a, uint32_t b) {
+    if (sink->found < sink->max) {
+        if (sink->pairs) {
+            sink->pairs[sink->found].a = a < b ? a : b;
+            sink->pairs[sink->found].b = a < b ? b : a;
+        } else {
+            sink->entities[sink->found] = b;
+        }
+    }
+    sink->found++;
+}
+
+/**
+ * Test the entities of one bucket against a point, unless this query has
+ * already read the bucket
+ */
+static void broadphase_scan_bucket(broadphase_t* grid, uint32_t bucket, int64_t x, int64_t y, int64_t z,
+                                   uint64_t radius, broadphase_sink_t* sink) {
+    if (grid->bucket_mark[bucket] == grid->mark) {
+        return;
+    }
+    grid->bucket_mark[bucket] = grid->mark;
+    
+    const broadphase_entry_t* entry = grid->entries + grid->bucket_start[bucket];
+    const broadphase_entry_t* end = grid->entries + grid->bucket_start[(size_t)bucket + 1];
+    for (; entry < end; entry++) {
+        grid->stats.candidates++;
+        if (broadphase_within(x, y, z, entry->x, entry->y, entry->z, radius)) {
+            broadphase_emit(sink, 0, entry->entity);
+        }
+    }
+}
+
+/**
+ * True when a box of cells is larger than the bucket table, so reading
+ * every bucket is cheaper than visiting the cells
+ */
+static inline bool broadphase_box_too_large(const broadphase_t* grid, uint64_t span_x, uint64_t span_y, uint64_t span_z) {
+    uint64_t limit = grid->bucket_count;
+    return span_x >= limit || span_y >= limit || span_z >= limit || span_x + 1 > limit / (span_y + 1) ||
+           (span_x + 1) * (span_y + 1) > limit / (span_z + 1);
+}
+
+/**
+ * Visit every bucket holding a cell within radius of a point
+ */
+static void broadphase_scan(broadphase_t* grid, int64_t x, int64_t y, int64_t z, uint64_t radius,
+                            broadphase_sink_t* sink) {
+    int64_t low_x, high_x, low_y, high_y, low_z, high_z;
+    broadphase_cell_range(grid, x, radius, &low_x, &high_x);
+    broadphase_cell_range(grid, y, radius, &low_y, &high_y);
+    broadphase_cell_range(grid, z, radius, &low_z, &high_z);
+    
+    broadphase_next_mark(grid);
+    
+    uint64_t span_x = (uint64_t)high_x - (uint64_t)low_x;
+    uint64_t span_y = (uint64_t)high_y - (uint64_t)low_y;
+    uint64_t span_z = (uint64_t)high_z - (uint64_t)low_z;
+    if (broadphase_box_too_large(grid, span_x, span_y, span_z)) {
+        for (size_t b = 0; b < grid->bucket_count; b++) {
+            broadphase_scan_bucket(grid, (uint32_t)b, x, y, z, radius, sink);
+        }
+        return;
+    }
+    
+    for (uint64_t i = 0; i <= span_x; i++) {
+        for (uint64_t j = 0; j <= span_y; j++) {
+            for (uint64_t k = 0; k <= span_z; k++) {
+                uint32_t bucket = broadphase_cell_bucket(grid, (int64_t)((uint64_t)low_x + i),
+                                                         (int64_t)((uint64_t)low_y + j),
+                                                         (int64_t)((uint64_t)low_z + k));
+                broadphase_scan_bucket(grid, bucket, x, y, z, radius, sink);
+            }
+        }
+    }
+}
+
+/**
+ * Test every entity of one run against every entity of another
+ */
+static void broadphase_pairs_between(broadphase_t* grid, const broadphase_entry_t* own, const broadphase_entry_t* own_end,
+                                     const broadphase_entry_t* other, const broadphase_entry_t* other_end,
+                                     uint64_t radius, broadphase_sink_t* sink) {
+    grid->stats.candidates += (size_t)(own_end - own) * (size_t)(other_end - other);
+    
+    for (; other < other_end; other++) {
+        for (const broadphase_entry_t* entry = own; entry < own_end; entry++) {
+            if (broadphase_within(entry->x, entry->y, entry->z, other->x, other->y, other->z, radius)) {
+                broadphase_emit(sink, entry->entity, other->entity);
+            }
+        }
+    }
+}
+
+/**
+ * Pair a bucket's entities with those of a higher bucket, unless this
+ * bucket's search has already read it
+ */
+static inline void broadphase_pairs_bucket(broadphase_t* grid, uint32_t bucket, uint32_t neighbour,
+                                           uint64_t radius, broadphase_sink_t* sink) {
+    if (neighbour <= bucket || grid->bucket_mark[neighbour] == grid->mark) {
+        return;
+    }
+    grid->bucket_mark[neighbour] = grid->mark;
+    
+    broadphase_pairs_between(grid, grid->entries + grid->bucket_start[bucket],
+                             grid->entries + grid->bucket_start[(size_t)bucket + 1],
+                             grid->entries + grid->bucket_start[neighbour],
+                             grid->entries + grid->bucket_start[(size_t)neighbour + 1], radius, sink);
+}
+
+/**
+ * Pair one bucket with the higher buckets around one of its cells (every
+ * point of the cell is covered, so the neighbourhood is symmetric)
+ */
+static void broadphase_pairs_cell(broadphase_t* grid, uint32_t bucket, int64_t cx, int64_t cy, int64_t cz,
+                                  uint64_t radius, broadphase_sink_t* sink) {
+    int64_t edge = (int64_t)1 << grid->cell_shift;
+    int64_t low_x, high_x, low_y, high_y, low_z, high_z, unused;
+    
+    // Low corner minus radius to high corner plus radius on each axis
+    broadphase_cell_range(grid, (int64_t)((uint64_t)cx << grid->cell_shift), radius, &low_x, &unused);
+    broadphase_cell_range(grid, (int64_t)(((uint64_t)cx << grid->cell_shift) + (uint64_t)(edge - 1)), radius, &unused, &high_x);
+    broadphase_cell_range(grid, (int64_t)((uint64_t)cy << grid->cell_shift), radius, &low_y, &unused);
+    broadphase_cell_range(grid, (int64_t)(((uint64_t)cy << grid->cell_shift) + (uint64_t)(edge - 1)), radius, &unused, &high_y);
+    broadphase_cell_range(grid, (int64_t)((uint64_t)cz << grid->cell_shift), radius, &low_z, &unused);
+    broadphase_cell_range(grid, (int64_t)(((uint64_t)cz << grid->cell_shift) + (uint64_t)(edge - 1)), radius, &unused, &high_z);
+    
+    uint64_t span_x = (uint64_t)high_x - (uint64_t)low_x;
+    uint64_t span_y = (uint64_t)high_y - (uint64_t)low_y;
+    uint64_t span_z = (uint64_t)high_z - (uint64_t)low_z;
+    if (broadphase_box_too_large(grid, span_x, span_y, span_z)) {
+        for (size_t b = (size_t)bucket + 1; b < grid->bucket_count; b++) {
+            broadphase_pairs_bucket(grid, bucket, (uint32_t)b, radius, sink);
+        }
+        return;
+    }
+    
+    for (uint64_t i = 0; i <= span_x; i++) {
+        for (uint64_t j = 0; j <= span_y; j++) {
+            for (uint64_t k = 0; k <= span_z; k++) {
+                uint32_t neighbour = broadphase_cell_bucket(grid, (int64_t)((uint64_t)low_x + i),
+                                                            (int64_t)((uint64_t)low_y + j),
+                                                            (int64_t)((uint64_t)low_z + k));
+                broadphase_pairs_bucket(grid, bucket, neighbour, radius, sink);
+            }
+        }
+    }
+}
+
+/**
+ * Free the per-bucket or per-entity arrays
+ */
+static void broadphase_free_buckets(broadphase_t* grid) {
+    if (grid->bucket_size) memory_free_aligned(grid->bucket_size);
+    if (grid->bucket_start) memory_free_aligned(grid->bucket_start);
+    if (grid->bucket_mark) memory_free_aligned(grid->bucket_mark);
+    grid->bucket_size = NULL;
+    grid->bucket_start = NULL;
+    grid->bucket_mark = NULL;
+    grid->bucket_count = 0;
+}
+
+static void broadphase_free_entities(broadphase_t* grid) {
+    if (grid->bucket) memory_free_aligned(grid->bucket);
+    if (grid->slot) memory_free_aligned(grid->slot);
+    if (grid->entries) memory_free_aligned(grid->entries);
+    grid->bucket = NULL;
+    grid->slot = NULL;
+    grid->entries = NULL;
+    grid->capacity = 0;
+}
+
+/**
+ * Size the bucket table and entity arrays for count entities. Either
+ * reallocation drops the sorted layout, so the next update re-sorts.
+ */
+static int broadphase_reserve(broadphase_t* grid, size_t count) {
+    size_t buckets = BROADPHASE_MIN_BUCKETS;
+    unsigned int bits = 3 * BROADPHASE_BLOCK_SHIFT;
+    while (buckets < 2 * count) {
+        buckets <<= 1;
+        bits++;
+    }
+    
+    if (buckets > grid->bucket_count) {
+        uint32_t* size = (uint32_t*)memory_alloc_aligned(buckets * sizeof(uint32_t), MEMORY_CACHE_LINE_SIZE);
+        uint32_t* start = (uint32_t*)memory_alloc_aligned((buckets + 1) * sizeof(uint32_t), MEMORY_CACHE_LINE_SIZE);
+        uint32_t* mark = (uint32_t*)memory_alloc_aligned(buckets * sizeof(uint32_t), MEMORY_CACHE_LINE_SIZE);
+        if (!size || !start || !mark) {
+            if (size) memory_free_aligned(size);
+            if (start) memory_free_aligned(start);
+            if (mark) memory_free_aligned(mark);
+            return -1;
+        }
+        
+        broadphase_free_buckets(grid);
+        memory_set(mark, 0, buckets * sizeof(uint32_t));
+        grid->bucket_size = size;
+        grid->bucket_start = start;
+        grid->bucket_mark = mark;
+        grid->bucket_count = buckets;
+        grid->bucket_bits = bits;
+        grid->mark = 0;
+        grid->built = false;
+    }
+    
+    if (count > grid->capacity) {
+        size_t capacity = grid->capacity * 2 > count ? grid->capacity * 2 : count;
+        uint32_t* bucket = (uint32_t*)memory_alloc_aligned(capacity * sizeof(uint32_t), MEMORY_CACHE_LINE_SIZE);
+        uint32_t* slot = (uint32_t*)memory_alloc_aligned(capacity * sizeof(uint32_t), MEMORY_CACHE_LINE_SIZE);
+        broadphase_entry_t* entries = (broadphase_entry_t*)memory_alloc_aligned(capacity * sizeof(broadphase_entry_t),
+                                                                                MEMORY_CACHE_LINE_SIZE);
+        if (!bucket || !slot || !entries) {
+            if (bucket) memory_free_aligned(bucket);
+            if (slot) memory_free_aligned(slot);
+            if (entries) memory_free_aligned(entries);
+            return -1;
+        }
+        
+        broadphase_free_entities(grid);
+        grid->bucket = bucket;
+        grid->slot = slot;
+        grid->entries = entries;
+        grid->capacity = capacity;
+        grid->built = false;
+    }
+    
+    return 0;
+}
+
+/**
+ * Rebin count entities whose coordinates are width bits wide and stride
+ * bytes apart
+ */
+static int broadphase_update(broadphase_t* grid, const char* px, const char* py, const char* pz,
+                             size_t stride, unsigned int width, size_t count) {
+    if (!grid || (count > 0 && (!px || !py || !pz)) || count > BROADPHASE_MAX_ENTITIES) {
+        return -1;
+    }
+    
+    size_t old_count = grid->count;
+    if (broadphase_reserve(grid, count) != 0) {
+        return -1;
+    }
+    
+    bool built = grid->built;
+    if (!built) {
+        memory_set(grid->bucket_size, 0, grid->bucket_count * sizeof(uint32_t));
+    } else {
+        // Entities past the new count leave their buckets
+        for (size_t i = count; i < old_count; i++) {
+            grid->bucket_size[grid->bucket[i]]--;
+        }
+    }
+    
+    size_t moved = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t offset = i * stride;
+        uint32_t bucket = broadphase_bucket(grid, broadphase_load(px + offset, width),
+                                            broadphase_load(py + offset, width),
+                                            broadphase_load(pz + offset, width));
+        if (!built || i >= old_count) {
+            grid->bucket_size[bucket]++;
+        } else if (grid->bucket[i] != bucket) {
+            grid->bucket_size[grid->bucket[i]]--;
+            grid->bucket_size[bucket]++;
+        } else {
+            continue;
+        }
+        grid->bucket[i] = bucket;
+        moved++;
+    }
+    
+    grid->stats.updates++;
+    grid->stats.moved = moved;
+    
+    if (built && moved == 0 && count == old_count) {
+        // Same layout: refresh the positions in place
+        for (size_t i = 0; i < count; i++) {
+            size_t offset = i * stride;
+            broadphase_entry_t* entry = &grid->entries[grid->slot[i]];
+            entry->x = broadphase_load(px + offset, width);
+            entry->y = broadphase_load(py + offset, width);
+            entry->z = broadphase_load(pz + offset, width);
+        }
+        grid->stats.refreshes++;
+        return 0;
+    }
+    
+    // Each bucket_start[b] holds the end of bucket b; the descending
+    // scatter walks it back to the start
+    uint32_t total = 0;
+    for (size_t b = 0; b < grid->bucket_count; b++) {
+        total += grid->bucket_size[b];
+        grid->bucket_start[b] = total;
+    }
+    grid->bucket_start[grid->bucket_count] = total;
+    
+    for (size_t i = count; i-- > 0;) {
+        size_t offset = i * stride;
+        uint32_t s = --grid->bucket_start[grid->bucket[i]];
+        broadphase_entry_t* entry = &grid->entries[s];
+        grid->slot[i] = s;
+        entry->x = broadphase_load(px + offset, width);
+        entry->y = broadphase_load(py + offset, width);
+        entry->z = broadphase_load(pz + offset, width);
+        entry->entity = (uint32_t)i;
+        entry->reserved = 0;
+    }
+    
+    grid->count = count;
+    grid->built = true;
+    grid->stats.rebuilds++;
+    return 0;
+}
+
+/**
+ * Grid lifetime
+ */
+int broadphase_init(broadphase_t* grid, unsigned int cell_shift) {
+    if (!grid || cell_shift > 62) {
+        return -1;
+    }
+    
+    memory_set(grid, 0, sizeof(*grid));
+    grid->cell_shift = cell_shift;
+    return broadphase_reserve(grid, 0);
+}
+
+void broadphase_destroy(broadphase_t* grid) {
+    if (!grid) return;
+    
+    broadphase_free_buckets(grid);
+    broadphase_free_entities(grid);
+    memory_set(grid, 0, sizeof(*grid));
+}
+
+/**
+ * Updates from separate coordinate arrays, SoA containers and AoS records
+ */
+int broadphase_update_16(broadphase_t* grid, const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count) {
+    return broadphase_update(grid, (const char*)x, (const char*)y, (const char*)z, sizeof(uint16_t), 16, count);
+}
+
+int broadphase_update_32(broadphase_t* grid, const uint32_t* x, const uint32_t* y, const uint32_t* z, size_t count) {
+    return broadphase_update(grid, (const char*)x, (const char*)y, (const char*)z, sizeof(uint32_t), 32, count);
+}
+
+int broadphase_update_64(broadphase_t* grid, const uint64_t* x, const uint64_t* y, const uint64_t* z, size_t count) {
+    return broadphase_update(grid, (const char*)x, (const char*)y, (const char*)z, sizeof(uint64_t), 64, count);
+}
+
+int broadphase_update_soa_16(broadphase_t* grid, const physics_soa_16_t* soa) {
+    if (!soa) return -1;
+    return broadphase_update_16(grid, soa->x, soa->y, soa->z, soa->count);
+}
+
+int broadphase_update_soa_32(broadphase_t* grid, const physics_soa_32_t* soa) {
+    if (!soa) return -1;
+    return broadphase_update_32(grid, soa->x, soa->y, soa->z, soa->count);
+}
+
+int broadphase_update_soa_64(broadphase_t* grid, const physics_soa_64_t* soa) {
+    if (!soa) return -1;
+    return broadphase_update_64(grid, soa->x, soa->y, soa->z, soa->count);
+}
+
+int broadphase_update_aos_16(broadphase_t* grid, const physics_vector_16_t* vectors, size_t count) {
+    if (!vectors) return -1;
+    return broadphase_update(grid, (const char*)&vectors->x, (const char*)&vectors->y, (const char*)&vectors->z,
+                             sizeof(*vectors), 16, count);
+}
+
+int broadphase_update_aos_32(broadphase_t* grid, const physics_vector_32_t* vectors, size_t count) {
+    if (!vectors) return -1;
+    return broadphase_update(grid, (const char*)&vectors->x, (const char*)&vectors->y, (const char*)&vectors->z,
+                             sizeof(*vectors), 32, count);
+}
+
+int broadphase_update_aos_64(broadphase_t* grid, const physics_vector_64_t* vectors, size_t count) {
+    if (!vectors) return -1;
+    return broadphase_update(grid, (const char*)&vectors->x, (const char*)&vectors->y, (const char*)&vectors->z,
+                             sizeof(*vectors), 64, count);
+}
+
+/**
+ * Find all pairs within radius, a bucket at a time
+ */
+size_t broadphase_pairs(broadphase_t* grid, uint64_t radius, broadphase_pair_t* pairs, size_t max_pairs) {
+    if (!grid || !grid->built) {
+        return 0;
+    }
+    if (radius > INT64_MAX) {
+        radius = INT64_MAX;
+    }
+    
+    broadphase_sink_t sink = { pairs, NULL, pairs ? max_pairs : 0, 0 };
+    for (size_t b = 0; b < grid->bucket_count; b++) {
+        const broadphase_entry_t* own = grid->entries + grid->bucket_start[b];
+        const broadphase_entry_t* own_end = grid->entries + grid->bucket_start[b + 1];
+        if (own == own_end) {
+            continue;
+        }
+        
+        // Pairs inside the bucket
+        for (const broadphase_entry_t* entry = own; entry + 1 < own_end; entry++) {
+            broadphase_pairs_between(grid, entry, entry + 1, entry + 1, own_end, radius, &sink);
+        }
+        
+        // Pairs with higher buckets, once per distinct cell in this bucket
+        broadphase_next_mark(grid);
+        for (const broadphase_entry_t* entry = own; entry < own_end; entry++) {
+            int64_t cx = entry->x >> grid->cell_shift;
+            int64_t cy = entry->y >> grid->cell_shift;
+            int64_t cz = entry->z >> grid->cell_shift;
+            
+            const broadphase_entry_t* seen = own;
+            while (seen < entry && ((seen->x >> grid->cell_shift) != cx || (seen->y >> grid->cell_shift) != cy ||
+                                    (seen->z >> grid->cell_shift) != cz)) {
+                seen++;
+            }
+            if (seen == entry) {
+                broadphase_pairs_cell(grid, (uint32_t)b, cx, cy, cz, radius, &sink);
+            }
+        }
+    }
+    
+    grid->stats.matches += sink.found;
+    return sink.found;
+}
+
+/**
+ * Find all entities within radius of a point
+ */
+size_t broadphase_query_radius(broadphase_t* grid, int64_t x, int64_t y, int64_t z, uint64_t radius,
+                               uint32_t* entities, size_t max_entities) {
+    if (!grid || !grid->built) {
+        return 0;
+    }
+    if (radius > INT64_MAX) {
+        radius = INT64_MAX;
+    }
+    
+    broadphase_sink_t sink = { NULL, entities, entities ? max_entities : 0, 0 };
+    broadphase_scan(grid, x, y, z, radius, &sink);
+    
+    grid->stats.matches += sink.found;
+    return sink.found;
+}
+
+/**
+ * Statistics
+ */
+void broadphase_get_stats(const broadphase_t* grid, broadphase_stats_t* stats) {
+    if (!grid || !stats) return;
+    *stats = grid->stats;
+}
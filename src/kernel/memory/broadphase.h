@@ -0,0 +1,114 @@
+/**
+ * CompileOS Physics Broadphase - Header
+ *
+ * Uniform-grid spatial hash over entity positions. Positions are binned
+ * into cubic cells of edge 2^cell_shift. Blocks of 4x4x4 cells are hashed
+ * into a power-of-two bucket table with one bucket per cell of the block,
+ * so nearby cells get nearby buckets. A counting sort lays the entities
+ * out bucket by bucket with their positions alongside, and a query reads
+ * its neighbourhood as a few contiguous runs. Coordinates of any width are
+ * two's-complement fixed-point values, as in the integrator.
+ */
+
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "multibit.h"
+#include "physics.h"
+
+// Cells per block edge (log2); a block's cells share one hash
+#define BROADPHASE_BLOCK_SHIFT 2
+#define BROADPHASE_BLOCK_CELLS (1u << (3 * BROADPHASE_BLOCK_SHIFT))
+
+// Smallest bucket table (grown to twice the entity count, rounded up to a
+// power of two)
+#define BROADPHASE_MIN_BUCKETS BROADPHASE_BLOCK_CELLS
+
+// Most entities one grid can hold (entity and bucket indices are 32-bit)
+#define BROADPHASE_MAX_ENTITIES 0x7FFFFFFFu
+
+// Sorted entry (one per entity, 32 bytes)
+typedef struct {
+    int64_t x;
+    int64_t y;
+    int64_t z;
+    uint32_t entity;
+    uint32_t reserved;
+} broadphase_entry_t;
+
+// Entity pair (a < b)
+typedef struct {
+    uint32_t a;
+    uint32_t b;
+} broadphase_pair_t;
+
+// Statistics
+typedef struct {
+    size_t updates;             // broadphase_update calls
+    size_t rebuilds;            // Updates that re-sorted the cell lists
+    size_t refreshes;           // Updates where no entity changed bucket
+    size_t moved;               // Entities that changed bucket in the last update
+    size_t candidates;          // Entity pairs distance-tested by queries
+    size_t matches;             // Pairs and entities the queries returned
+} broadphase_stats_t;
+
+// Grid (entity i is entries[slot[i]])
+typedef struct {
+    unsigned int cell_shift;
+    unsigned int bucket_bits;
+    size_t bucket_count;
+    size_t count;
+    size_t capacity;
+    
+    // Per bucket: entity count, first slot (bucket_count + 1 entries) and
+    // the query that last visited it
+    uint32_t* bucket_size;
+    uint32_t* bucket_start;
+    uint32_t* bucket_mark;
+    uint32_t mark;
+    
+    // Per entity
+    uint32_t* bucket;
+    uint32_t* slot;
+    
+    // Sorted by bucket, then entity index
+    broadphase_entry_t* entries;
+    
+    bool built;
+    broadphase_stats_t stats;
+} broadphase_t;
+
+// Lifetime (cell edge is 2^cell_shift coordinate units; a cell at least as
+// large as the usual query radius keeps queries to the 27 surrounding cells)
+int broadphase_init(broadphase_t* grid, unsigned int cell_shift);
+void broadphase_destroy(broadphase_t* grid);
+
+// Rebin count entities. Only entities that changed bucket touch the
+// bucket counts; when none did, the sorted order is kept and just the
+// positions are refreshed.
+int broadphase_update_16(broadphase_t* grid, const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count);
+int broadphase_update_32(broadphase_t* grid, const uint32_t* x, const uint32_t* y, const uint32_t* z, size_t count);
+int broadphase_update_64(broadphase_t* grid, const uint64_t* x, const uint64_t* y, const uint64_t* z, size_t count);
+int broadphase_update_soa_16(broadphase_t* grid, const physics_soa_16_t* soa);
+int broadphase_update_soa_32(broadphase_t* grid, const physics_soa_32_t* soa);
+int broadphase_update_soa_64(broadphase_t* grid, const physics_soa_64_t* soa);
+int broadphase_update_aos_16(broadphase_t* grid, const physics_vector_16_t* vectors, size_t count);
+int broadphase_update_aos_32(broadphase_t* grid, const physics_vector_32_t* vectors, size_t count);
+int broadphase_update_aos_64(broadphase_t* grid, const physics_vector_64_t* vectors, size_t count);
+
+// Every pair no further apart than radius (Euclidean); stores up to
+// max_pairs of them and returns how many there are
+size_t broadphase_pairs(broadphase_t* grid, uint64_t radius, broadphase_pair_t* pairs, size_t max_pairs);
+
+// Every entity within radius of a point (sign-extended coordinates);
+// stores up to max_entities indices and returns how many there are
+size_t broadphase_query_radius(broadphase_t* grid, int64_t x, int64_t y, int64_t z, uint64_t radius,
+                               uint32_t* entities, size_t max_entities);
+
+// Statistics
+void broadphase_get_stats(const broadphase_t* grid, broadphase_stats_t* stats);
+
+#endif // BROADPHASE_H
@@ -0,0 +1,1052 @@
+/**
+ * CompileOS Physics Bounding Volume Hierarchy - Implementation
+ *
+ * Insertion looks for the sibling that adds the least surface area to the
+ * tree. Pairing leaf L with sibling S costs area(S + L), plus the growth
+ * of every ancestor of S. The search walks down from the root, pricing
+ * both children of each node as siblings. It descends into the cheaper
+ * internal child only while that child's lower bound (the inherited
+ * growth plus area(L)) can still beat the best sibling found so far. The
+ * new parent is then refitted up to the root. At each ancestor, a child
+ * may swap with a grandchild on the other side when that shrinks the
+ * other child's box; this is the rotation that keeps the tree balanced.
+ *
+ * Reinsertions scatter nodes across the pool. After enough of them, a
+ * bulk update copies the tree out in depth-first order, so a query's walk
+ * down a subtree stays within one run of memory.
+ *
+ * Surface areas and squared distances are 128-bit unsigned integers.
+ * Clamping coordinates to +-2^62 bounds every extent by 2^63, so three
+ * area products still fit. Ray slab tests compare fractions by cross
+ * multiplication, so queries never divide.
+ */
+
+#include "bvh.h"
+#include "memory.h"
+
+// Smallest node pool and per-entity arrays
+#define BVH_MIN_NODES 64
+#define BVH_MIN_ENTITIES 32
+
+// A bulk update re-lays the pool out once this fraction (1 / n) of the
+// leaves has been inserted since the last time
+#define BVH_RELAYOUT_DIVISOR 4
+
+// Surface area cost and squared distance
+typedef unsigned __int128 bvh_cost_t;
+#define BVH_COST_MAX (~(bvh_cost_t)0)
+
+// k-nearest heap entry
+typedef struct {
+    bvh_cost_t distance;
+    uint32_t entity;
+} bvh_candidate_t;
+
+// Segment with its direction precomputed
+typedef struct {
+    int64_t origin[3];
+    __int128 delta[3];
+} bvh_segment_t;
+
+/**
+ * Sign-extend a coordinate of width bits
+ */
+static inline int64_t bvh_load(const char* p, unsigned int width) {
+    switch (width) {
+        case 16: return (int16_t)*(const uint16_t*)p;
+        case 32: return (int32_t)*(const uint32_t*)p;
+        default: return (int64_t)*(const uint64_t*)p;
+    }
+}
+
+static inline int64_t bvh_clamp(__int128 value) {
+    if (value < -BVH_COORD_LIMIT) return -BVH_COORD_LIMIT;
+    if (value > BVH_COORD_LIMIT) return BVH_COORD_LIMIT;
+    return (int64_t)value;
+}
+
+static inline bvh_cost_t bvh_cost_add(bvh_cost_t a, bvh_cost_t b) {
+    return a > BVH_COST_MAX - b ? BVH_COST_MAX : a + b;
+}
+
+/**
+ * Box helpers
+ */
+static inline void bvh_union(bvh_aabb_t* out, const bvh_aabb_t* a, const bvh_aabb_t* b) {
+    for (int k = 0; k < 3; k++) {
+        out->min[k] = a->min[k] < b->min[k] ? a->min[k] : b->min[k];
+        out->max[k] = a->max[k] > b->max[k] ? a->max[k] : b->max[k];
+    }
+}
+
+static inline bool bvh_encloses(const bvh_aabb_t* outer, const bvh_aabb_t* inner) {
+    return outer->min[0] <= inner->min[0] && outer->min[1] <= inner->min[1] && outer->min[2] <= inner->min[2] &&
+           outer->max[0] >= inner->max[0] && outer->max[1] >= inner->max[1] && outer->max[2] >= inner->max[2];
+}
+
+static inline bool bvh_overlaps(const bvh_aabb_t* a, const bvh_aabb_t* b) {
+    return a->min[0] <= b->max[0] && b->min[0] <= a->max[0] &&
+           a->min[1] <= b->max[1] && b->min[1] <= a->max[1] &&
+           a->min[2] <= b->max[2] && b->min[2] <= a->max[2];
+}
+
+/**
+ * Half the surface area (extents are at most 2^63, so each product fits
+ * in 126 bits and the sum in 128)
+ */
+static inline bvh_cost_t bvh_area(const bvh_aabb_t* box) {
+    bvh_cost_t x = (uint64_t)box->max[0] - (uint64_t)box->min[0];
+    bvh_cost_t y = (uint64_t)box->max[1] - (uint64_t)box->min[1];
+    bvh_cost_t z = (uint64_t)box->max[2] - (uint64_t)box->min[2];
+    return x * y + y * z + z * x;
+}
+
+static inline bvh_cost_t bvh_union_area(const bvh_aabb_t* a, const bvh_aabb_t* b) {
+    bvh_aabb_t box;
+    bvh_union(&box, a, b);
+    return bvh_area(&box);
+}
+
+/**
+ * Squared distance from a point to a box (0 inside it)
+ */
+static inline bvh_cost_t bvh_distance(const bvh_aabb_t* box, const int64_t* point) {
+    bvh_cost_t sum = 0;
+    for (int k = 0; k < 3; k++) {
+        uint64_t d = 0;
+        if (point[k] < box->min[k]) {
+            d = (uint64_t)box->min[k] - (uint64_t)point[k];
+        } else if (point[k] > box->max[k]) {
+            d = (uint64_t)point[k] - (uint64_t)box->max[k];
+        }
+        sum += (bvh_cost_t)d * d;
+    }
+    return sum;
+}
+
+/**
+ * Where the segment enters a box, as num / den, if it does so no later
+ * than limit_num / limit_den
+ */
+static bool bvh_enter(const bvh_segment_t* segment, const bvh_aabb_t* box, __int128 limit_num, __int128 limit_den,
+                      __int128* num, __int128* den) {
+    __int128 enter_num = 0, enter_den = 1;
+    __int128 exit_num = limit_num, exit_den = limit_den;
+    for (int k = 0; k < 3; k++) {
+        __int128 d = segment->delta[k];
+        __int128 o = segment->origin[k];
+        if (d == 0) {
+            if (o < box->min[k] || o > box->max[k]) {
+                return false;
+            }
+            continue;
+        }
+        
+        // Slab fractions over a positive denominator
+        __int128 near = d > 0 ? box->min[k] - o : o - box->max[k];
+        __int128 far = d > 0 ? box->max[k] - o : o - box->min[k];
+        if (d < 0) d = -d;
+        
+        if (near * enter_den > enter_num * d) {
+            enter_num = near;
+            enter_den = d;
+        }
+        if (far * exit_den < exit_num * d) {
+            exit_num = far;
+            exit_den = d;
+        }
+        if (enter_num * exit_den > exit_num * enter_den) {
+            return false;
+        }
+    }
+    
+    *num = enter_num;
+    *den = enter_den;
+    return true;
+}
+
+/**
+ * num / den (0 <= num, 0 < den < 2^64) as a 32.32 fraction, by shift and
+ * subtract so no 128-bit division is needed
+ */
+static uint64_t bvh_fraction(__int128 num, __int128 den) {
+    if (num >= den) {
+        return BVH_FRACTION_ONE;
+    }
+    
+    uint64_t remainder = (uint64_t)num;
+    uint64_t divisor = (uint64_t)den;
+    uint64_t quotient = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        remainder <<= 1;
+        quotient <<= 1;
+        if (remainder >= divisor) {
+            remainder -= divisor;
+            quotient |= 1;
+        }
+    }
+    return quotient;
+}
+
+/**
+ * Grow the node pool so at least needed nodes are free. Indices stay
+ * valid; node pointers do not.
+ */
+static int bvh_reserve_nodes(bvh_t* tree, uint32_t needed) {
+    if (tree->node_capacity - tree->node_count >= needed) {
+        return 0;
+    }
+    
+    size_t capacity = tree->node_capacity ? (size_t)tree->node_capacity * 2 : BVH_MIN_NODES;
+    if (capacity < (size_t)tree->node_count + needed) {
+        capacity = (size_t)tree->node_count + needed;
+    }
+    if (capacity > BVH_NULL) {
+        capacity = BVH_NULL;
+    }
+    if (capacity - tree->node_count < needed) {
+        return -1;
+    }
+    
+    bvh_node_t* nodes = (bvh_node_t*)memory_alloc_aligned(capacity * sizeof(bvh_node_t), MEMORY_CACHE_LINE_SIZE);
+    uint32_t* stack = (uint32_t*)memory_alloc_aligned(capacity * sizeof(uint32_t), MEMORY_CACHE_LINE_SIZE);
+    if (!nodes || !stack) {
+        if (nodes) memory_free_aligned(nodes);
+        if (stack) memory_free_aligned(stack);
+        return -1;
+    }
+    
+    if (tree->nodes) {
+        memory_copy(nodes, tree->nodes, tree->node_capacity * sizeof(bvh_node_t));
+        memory_free_aligned(tree->nodes);
+    }
+    if (tree->stack) {
+        memory_free_aligned(tree->stack);
+    }
+    
+    // Chain the new nodes onto the free list, lowest index first
+    for (size_t i = capacity; i-- > tree->node_capacity;) {
+        nodes[i].parent = tree->free_list;
+        nodes[i].child[0] = BVH_NULL;
+        nodes[i].child[1] = BVH_NULL;
+        nodes[i].entity = BVH_NULL;
+        tree->free_list = (uint32_t)i;
+    }
+    
+    tree->nodes = nodes;
+    tree->stack = stack;
+    tree->node_capacity = (uint32_t)capacity;
+    return 0;
+}
+
+/**
+ * Take a node off the free list (the caller reserved it) or put one back
+ */
+static uint32_t bvh_alloc_node(bvh_t* tree) {
+    uint32_t index = tree->free_list;
+    bvh_node_t* node = &tree->nodes[index];
+    tree->free_list = node->parent;
+    node->parent = BVH_NULL;
+    node->child[0] = BVH_NULL;
+    node->child[1] = BVH_NULL;
+    node->entity = BVH_NULL;
+    tree->node_count++;
+    return index;
+}
+
+static void bvh_free_node(bvh_t* tree, uint32_t index) {
+    bvh_node_t* node = &tree->nodes[index];
+    node->parent = tree->free_list;
+    node->child[0] = BVH_NULL;
+    node->child[1] = BVH_NULL;
+    node->entity = BVH_NULL;
+    tree->free_list = index;
+    tree->node_count--;
+}
+
+/**
+ * Grow the per-entity arrays to hold count entities
+ */
+static int bvh_reserve_entities(bvh_t* tree, size_t count) {
+    if (count <= tree->capacity) {
+        return 0;
+    }
+    
+    size_t capacity = tree->capacity ? tree->capacity * 2 : BVH_MIN_ENTITIES;
+    if (capacity < count) {
+        capacity = count;
+    }
+    
+    uint32_t* leaf = (uint32_t*)memory_alloc_aligned(capacity * sizeof(uint32_t), MEMORY_CACHE_LINE_SIZE);
+    bvh_aabb_t* bounds = (bvh_aabb_t*)memory_alloc_aligned(capacity * sizeof(bvh_aabb_t), MEMORY_CACHE_LINE_SIZE);
+    if (!leaf || !bounds) {
+        if (leaf) memory_free_aligned(leaf);
+        if (bounds) memory_free_aligned(bounds);
+        return -1;
+    }
+    
+    if (tree->leaf) {
+        memory_copy(leaf, tree->leaf, tree->capacity * sizeof(uint32_t));
+        memory_copy(bounds, tree->bounds, tree->capacity * sizeof(bvh_aabb_t));
+        memory_free_aligned(tree->leaf);
+        memory_free_aligned(tree->bounds);
+    }
+    
+    // All-ones bytes make BVH_NULL
+    memory_set(leaf + tree->capacity, 0xFF, (capacity - tree->capacity) * sizeof(uint32_t));
+    
+    tree->leaf = leaf;
+    tree->bounds = bounds;
+    tree->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Swap a child of node a with a grandchild on the other side when that
+ * shrinks the other child's box. The box of a is unchanged.
+ */
+static void bvh_rotate(bvh_t* tree, uint32_t a) {
+    bvh_node_t* nodes = tree->nodes;
+    bvh_cost_t best_gain = 0;
+    int best_side = -1;
+    int best_k = 0;
+    
+    for (int side = 0; side < 2; side++) {
+        uint32_t mover = nodes[a].child[side];
+        uint32_t other = nodes[a].child[1 - side];
+        if (nodes[other].entity != BVH_NULL) {
+            continue;
+        }
+        
+        // mover trades places with child k of other
+        bvh_cost_t other_area = bvh_area(&nodes[other].box);
+        for (int k = 0; k < 2; k++) {
+            uint32_t keep = nodes[other].child[1 - k];
+            bvh_cost_t area = bvh_union_area(&nodes[mover].box, &nodes[keep].box);
+            if (area < other_area && other_area - area > best_gain) {
+                best_gain = other_area - area;
+                best_side = side;
+                best_k = k;
+            }
+        }
+    }
+    if (best_side < 0) {
+        return;
+    }
+    
+    uint32_t mover = nodes[a].child[best_side];
+    uint32_t other = nodes[a].child[1 - best_side];
+    uint32_t grandchild = nodes[other].child[best_k];
+    nodes[a].child[best_side] = grandchild;
+    nodes[grandchild].parent = a;
+    nodes[other].child[best_k] = mover;
+    nodes[mover].parent = other;
+    bvh_union(&nodes[other].box, &nodes[nodes[other].child[0]].box, &nodes[nodes[other].child[1]].box);
+    tree->stats.rotations++;
+}
+
+/**
+ * Recompute the boxes from index towards the root, rotating on the way.
+ * Above the first node the walk stops at the first box that comes out
+ * unchanged, since nothing over it can change either.
+ */
+static void bvh_refit(bvh_t* tree, uint32_t index) {
+    bvh_node_t* nodes = tree->nodes;
+    bool first = true;
+    while (index != BVH_NULL) {
+        bvh_node_t* node = &nodes[index];
+        bvh_aabb_t box;
+        bvh_union(&box, &nodes[node->child[0]].box, &nodes[node->child[1]].box);
+        bool same = bvh_encloses(&node->box, &box) && bvh_encloses(&box, &node->box);
+        node->box = box;
+        bvh_rotate(tree, index);
+        if (same && !first) {
+            return;
+        }
+        first = false;
+        index = node->parent;
+    }
+}
+
+/**
+ * Link a leaf into the tree next to its cheapest sibling (one free node
+ * must be reserved for the new parent)
+ */
+static void bvh_insert_leaf(bvh_t* tree, uint32_t leaf) {
+    tree->stats.inserts++;
+    tree->churn++;
+    bvh_node_t* nodes = tree->nodes;
+    if (tree->root == BVH_NULL) {
+        nodes[leaf].parent = BVH_NULL;
+        tree->root = leaf;
+        return;
+    }
+    
+    const bvh_aabb_t* box = &nodes[leaf].box;
+    bvh_cost_t leaf_area = bvh_area(box);
+    uint32_t best = tree->root;
+    bvh_cost_t best_cost = bvh_union_area(&nodes[best].box, box);
+    bvh_cost_t inherited = 0;
+    
+    // growth is how much the box of index grows if the leaf goes below it
+    uint32_t index = tree->root;
+    bvh_cost_t growth = best_cost - bvh_area(&nodes[index].box);
+    while (nodes[index].entity == BVH_NULL) {
+        inherited = bvh_cost_add(inherited, growth);
+        
+        uint32_t next = BVH_NULL;
+        bvh_cost_t next_bound = BVH_COST_MAX;
+        bvh_cost_t next_growth = 0;
+        for (int k = 0; k < 2; k++) {
+            uint32_t child = nodes[index].child[k];
+            bvh_cost_t direct = bvh_union_area(&nodes[child].box, box);
+            bvh_cost_t cost = bvh_cost_add(direct, inherited);
+            if (cost < best_cost) {
+                best = child;
+                best_cost = cost;
+            }
+            
+            // Any sibling below child costs at least this much
+            if (nodes[child].entity == BVH_NULL) {
+                bvh_cost_t child_growth = direct - bvh_area(&nodes[child].box);
+                bvh_cost_t bound = bvh_cost_add(bvh_cost_add(inherited, child_growth), leaf_area);
+                if (bound < next_bound) {
+                    next = child;
+                    next_bound = bound;
+                    next_growth = child_growth;
+                }
+            }
+        }
+        if (next == BVH_NULL || next_bound >= best_cost) {
+            break;
+        }
+        index = next;
+        growth = next_growth;
+    }
+    
+    // New parent in the sibling's place
+    uint32_t old_parent = nodes[best].parent;
+    uint32_t parent = bvh_alloc_node(tree);
+    nodes[parent].parent = old_parent;
+    nodes[parent].child[0] = best;
+    nodes[parent].child[1] = leaf;
+    nodes[best].parent = parent;
+    nodes[leaf].parent = parent;
+    if (old_parent == BVH_NULL) {
+        tree->root = parent;
+    } else if (nodes[old_parent].child[0] == best) {
+        nodes[old_parent].child[0] = parent;
+    } else {
+        nodes[old_parent].child[1] = parent;
+    }
+    
+    bvh_refit(tree, parent);
+}
+
+/**
+ * Unlink a leaf (the node itself stays allocated); its sibling takes the
+ * parent's place
+ */
+static void bvh_remove_leaf(bvh_t* tree, uint32_t leaf) {
+    tree->stats.removes++;
+    bvh_node_t* nodes = tree->nodes;
+    if (leaf == tree->root) {
+        tree->root = BVH_NULL;
+        return;
+    }
+    
+    uint32_t parent = nodes[leaf].parent;
+    uint32_t grandparent = nodes[parent].parent;
+    uint32_t sibling = nodes[parent].child[0] == leaf ? nodes[parent].child[1] : nodes[parent].child[0];
+    
+    nodes[sibling].parent = grandparent;
+    if (grandparent == BVH_NULL) {
+        tree->root = sibling;
+    } else if (nodes[grandparent].child[0] == parent) {
+        nodes[grandparent].child[0] = sibling;
+    } else {
+        nodes[grandparent].child[1] = sibling;
+    }
+    bvh_free_node(tree, parent);
+    
+    bvh_refit(tree, grandparent);
+}
+
+/**
+ * Give an entity its exact box. The leaf goes back through the tree only
+ * when box leaves its fattened box; it is then refattened by the margin
+ * and, with a displacement, stretched along it. Returns 1 when the entity
+ * was inserted or reinserted, 0 when its leaf still held it, -1 when out
+ * of memory.
+ */
+static int bvh_place(bvh_t* tree, uint32_t entity, const bvh_aabb_t* box, const int64_t* displacement) {
+    tree->bounds[entity] = *box;
+    
+    uint32_t leaf = tree->leaf[entity];
+    if (leaf != BVH_NULL) {
+        if (bvh_encloses(&tree->nodes[leaf].box, box)) {
+            return 0;
+        }
+        bvh_remove_leaf(tree, leaf);
+    } else {
+        // The leaf and its future parent
+        if (bvh_reserve_nodes(tree, 2) != 0) {
+            return -1;
+        }
+        leaf = bvh_alloc_node(tree);
+        tree->nodes[leaf].entity = entity;
+        tree->leaf[entity] = leaf;
+        tree->stats.leaves++;
+    }
+    
+    bvh_aabb_t* fat = &tree->nodes[leaf].box;
+    for (int k = 0; k < 3; k++) {
+        __int128 low = (__int128)box->min[k] - tree->margin;
+        __int128 high = (__int128)box->max[k] + tree->margin;
+        if (displacement) {
+            __int128 step = (__int128)displacement[k] * BVH_LOOKAHEAD_STEPS;
+            if (step < 0) {
+                low += step;
+            } else {
+                high += step;
+            }
+        }
+        fat->min[k] = bvh_clamp(low);
+        fat->max[k] = bvh_clamp(high);
+    }
+    
+    bvh_insert_leaf(tree, leaf);
+    return 1;
+}
+
+/**
+ * Take an entity out and return its leaf to the pool
+ */
+static void bvh_drop(bvh_t* tree, uint32_t entity) {
+    uint32_t leaf = tree->leaf[entity];
+    bvh_remove_leaf(tree, leaf);
+    bvh_free_node(tree, leaf);
+    tree->leaf[entity] = BVH_NULL;
+    tree->stats.leaves--;
+}
+
+/**
+ * Copy the tree into a fresh pool in depth-first order, so each node's
+ * first child sits right after it and every subtree is one contiguous
+ * run. While the copy runs, the parent field of each copied old node
+ * holds its new index.
+ */
+static int bvh_relayout(bvh_t* tree) {
+    bvh_node_t* old = tree->nodes;
+    bvh_node_t* nodes = (bvh_node_t*)memory_alloc_aligned((size_t)tree->node_capacity * sizeof(bvh_node_t),
+                                                          MEMORY_CACHE_LINE_SIZE);
+    if (!nodes) {
+        return -1;
+    }
+    
+    uint32_t* stack = tree->stack;
+    size_t top = 0;
+    uint32_t next = 0;
+    if (tree->root != BVH_NULL) {
+        stack[top++] = tree->root;
+    }
+    while (top > 0) {
+        uint32_t index = stack[--top];
+        uint32_t parent = old[index].parent;
+        uint32_t placed = next++;
+        nodes[placed] = old[index];
+        if (parent == BVH_NULL) {
+            nodes[placed].parent = BVH_NULL;
+        } else {
+            // The parent was copied first; its old parent field has its new index
+            uint32_t new_parent = old[parent].parent;
+            nodes[placed].parent = new_parent;
+            nodes[new_parent].child[old[parent].child[0] == index ? 0 : 1] = placed;
+        }
+        old[index].parent = placed;
+        
+        if (old[index].entity != BVH_NULL) {
+            tree->leaf[old[index].entity] = placed;
+        } else {
+            stack[top++] = old[index].child[1];
+            stack[top++] = old[index].child[0];
+        }
+    }
+    
+    // Everything past the live nodes is free
+    tree->free_list = BVH_NULL;
+    for (size_t i = tree->node_capacity; i-- > next;) {
+        nodes[i].parent = tree->free_list;
+        nodes[i].child[0] = BVH_NULL;
+        nodes[i].child[1] = BVH_NULL;
+        nodes[i].entity = BVH_NULL;
+        tree->free_list = (uint32_t)i;
+    }
+    
+    memory_free_aligned(old);
+    tree->nodes = nodes;
+    tree->root = next > 0 ? 0 : BVH_NULL;
+    tree->churn = 0;
+    tree->stats.relayouts++;
+    return 0;
+}
+
+/**
+ * Update entities 0 .. count - 1 from coordinates width bits wide and
+ * stride bytes apart (velocities optional)
+ */
+static int bvh_update(bvh_t* tree, const char* px, const char* py, const char* pz,
+                      const char* vx, const char* vy, const char* vz,
+                      size_t stride, unsigned int width, size_t count) {
+    if (!tree || (count > 0 && (!px || !py || !pz)) || count > BVH_MAX_ENTITIES) {
+        return -1;
+    }
+    if (bvh_reserve_entities(tree, count) != 0) {
+        return -1;
+    }
+    
+    // Entities past the new count leave the tree
+    for (size_t i = count; i < tree->count; i++) {
+        if (tree->leaf[i] != BVH_NULL) {
+            bvh_drop(tree, (uint32_t)i);
+        }
+    }
+    if (tree->count > count) {
+        tree->count = count;
+    }
+    
+    size_t reinserted = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t offset = i * stride;
+        const char* position[3] = { px + offset, py + offset, pz + offset };
+        bvh_aabb_t box;
+        for (int k = 0; k < 3; k++) {
+            int64_t p = bvh_load(position[k], width);
+            box.min[k] = bvh_clamp((__int128)p - tree->extent);
+            box.max[k] = bvh_clamp((__int128)p + tree->extent);
+        }
+        
+        int64_t displacement[3];
+        if (vx) {
+            displacement[0] = bvh_load(vx + offset, width);
+            displacement[1] = bvh_load(vy + offset, width);
+            displacement[2] = bvh_load(vz + offset, width);
+        }
+        
+        int placed = bvh_place(tree, (uint32_t)i, &box, vx ? displacement : NULL);
+        if (placed < 0) {
+            if (tree->count < i) {
+                tree->count = i;
+            }
+            return -1;
+        }
+        reinserted += (size_t)placed;
+    }
+    
+    tree->count = count;
+    tree->stats.updates++;
+    tree->stats.reinserted = reinserted;
+    if (tree->churn > 0 && tree->churn >= tree->stats.leaves / BVH_RELAYOUT_DIVISOR) {
+        // Best effort: without the memory the old layout stays
+        bvh_relayout(tree);
+    }
+    return 0;
+}
+
+/**
+ * Tree lifetime
+ */
+int bvh_init(bvh_t* tree, uint64_t extent, uint64_t margin) {
+    if (!tree) {
+        return -1;
+    }
+    
+    memory_set(tree, 0, sizeof(*tree));
+    tree->extent = extent;
+    tree->margin = margin;
+    tree->root = BVH_NULL;
+    tree->free_list = BVH_NULL;
+    return bvh_reserve_nodes(tree, BVH_MIN_NODES);
+}
+
+void bvh_destroy(bvh_t* tree) {
+    if (!tree) return;
+    
+    if (tree->nodes) memory_free_aligned(tree->nodes);
+    if (tree->stack) memory_free_aligned(tree->stack);
+    if (tree->leaf) memory_free_aligned(tree->leaf);
+    if (tree->bounds) memory_free_aligned(tree->bounds);
+    if (tree->nearest) memory_free_aligned(tree->nearest);
+    memory_set(tree, 0, sizeof(*tree));
+    tree->root = BVH_NULL;
+    tree->free_list = BVH_NULL;
+}
+
+/**
+ * Single-entity insert, move and remove
+ */
+int bvh_set(bvh_t* tree, uint32_t entity, const bvh_aabb_t* box) {
+    if (!tree || !box || entity >= BVH_MAX_ENTITIES) {
+        return -1;
+    }
+    for (int k = 0; k < 3; k++) {
+        if (box->min[k] > box->max[k]) {
+            return -1;
+        }
+    }
+    if (bvh_reserve_entities(tree, (size_t)entity + 1) != 0) {
+        return -1;
+    }
+    
+    bvh_aabb_t clamped;
+    for (int k = 0; k < 3; k++) {
+        clamped.min[k] = bvh_clamp(box->min[k]);
+        clamped.max[k] = bvh_clamp(box->max[k]);
+    }
+    if (bvh_place(tree, entity, &clamped, NULL) < 0) {
+        return -1;
+    }
+    
+    if (tree->count <= entity) {
+        tree->count = (size_t)entity + 1;
+    }
+    return 0;
+}
+
+int bvh_remove(bvh_t* tree, uint32_t entity) {
+    if (!bvh_contains(tree, entity)) {
+        return -1;
+    }
+    
+    bvh_drop(tree, entity);
+    while (tree->count > 0 && tree->leaf[tree->count - 1] == BVH_NULL) {
+        tree->count--;
+    }
+    return 0;
+}
+
+bool bvh_contains(const bvh_t* tree, uint32_t entity) {
+    return tree && entity < tree->count && tree->leaf[entity] != BVH_NULL;
+}
+
+/**
+ * Bulk updates from separate coordinate arrays, SoA containers and AoS
+ * records
+ */
+int bvh_update_16(bvh_t* tree, const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count) {
+    return bvh_update(tree, (const char*)x, (const char*)y, (const char*)z, NULL, NULL, NULL,
+                      sizeof(uint16_t), 16, count);
+}
+
+int bvh_update_32(bvh_t* tree, const uint32_t* x, const uint32_t* y, const uint32_t* z, size_t count) {
+    return bvh_update(tree, (const char*)x, (const char*)y, (const char*)z, NULL, NULL, NULL,
+                      sizeof(uint32_t), 32, count);
+}
+
+int bvh_update_64(bvh_t* tree, const uint64_t* x, const uint64_t* y, const uint64_t* z, size_t count) {
+    return bvh_update(tree, (const char*)x, (const char*)y, (const char*)z, NULL, NULL, NULL,
+                      sizeof(uint64_t), 64, count);
+}
+
+int bvh_update_soa_16(bvh_t* tree, const physics_soa_16_t* soa) {
+    if (!soa) return -1;
+    return bvh_update(tree, (const char*)soa->x, (const char*)soa->y, (const char*)soa->z,
+                      (const char*)soa->vx, (const char*)soa->vy, (const char*)soa->vz,
+                      sizeof(uint16_t), 16, soa->count);
+}
+
+int bvh_update_soa_32(bvh_t* tree, const physics_soa_32_t* soa) {
+    if (!soa) return -1;
+    return bvh_update(tree, (const char*)soa->x, (const char*)soa->y, (const char*)soa->z,
+                      (const char*)soa->vx, (const char*)soa->vy, (const char*)soa->vz,
+                      sizeof(uint32_t), 32, soa->count);
+}
+
+int bvh_update_soa_64(bvh_t* tree, const physics_soa_64_t* soa) {
+    if (!soa) return -1;
+    return bvh_update(tree, (const char*)soa->x, (const char*)soa->y, (const char*)soa->z,
+                      (const char*)soa->vx, (const char*)soa->vy, (const char*)soa->vz,
+                      sizeof(uint64_t), 64, soa->count);
+}
+
+int bvh_update_aos_16(bvh_t* tree, const physics_vector_16_t* vectors, size_t count) {
+    if (!vectors) return -1;
+    return bvh_update(tree, (const char*)&vectors->x, (const char*)&vectors->y, (const char*)&vectors->z,
+                      (const char*)&vectors->vx, (const char*)&vectors->vy, (const char*)&vectors->vz,
+                      sizeof(*vectors), 16, count);
+}
+
+int bvh_update_aos_32(bvh_t* tree, const physics_vector_32_t* vectors, size_t count) {
+    if (!vectors) return -1;
+    return bvh_update(tree, (const char*)&vectors->x, (const char*)&vectors->y, (const char*)&vectors->z,
+                      (const char*)&vectors->vx, (const char*)&vectors->vy, (const char*)&vectors->vz,
+                      sizeof(*vectors), 32, count);
+}
+
+int bvh_update_aos_64(bvh_t* tree, const physics_vector_64_t* vectors, size_t count) {
+    if (!vectors) return -1;
+    return bvh_update(tree, (const char*)&vectors->x, (const char*)&vectors->y, (const char*)&vectors->z,
+                      (const char*)&vectors->vx, (const char*)&vectors->vy, (const char*)&vectors->vz,
+                      sizeof(*vectors), 64, count);
+}
+
+/**
+ * Overlap query: descend through fattened boxes, match on exact ones
+ */
+size_t bvh_query_aabb(bvh_t* tree, const bvh_aabb_t* box, uint32_t* entities, size_t max_entities) {
+    if (!tree || !box || tree->root == BVH_NULL) {
+        return 0;
+    }
+    if (!entities) {
+        max_entities = 0;
+    }
+    
+    bvh_aabb_t query;
+    for (int k = 0; k < 3; k++) {
+        query.min[k] = bvh_clamp(box->min[k]);
+        query.max[k] = bvh_clamp(box->max[k]);
+    }
+    
+    const bvh_node_t* nodes = tree->nodes;
+    uint32_t* stack = tree->stack;
+    size_t top = 0;
+    size_t found = 0;
+    size_t visited = 0;
+    stack[top++] = tree->root;
+    while (top > 0) {
+        const bvh_node_t* node = &nodes[stack[--top]];
+        visited++;
+        if (!bvh_overlaps(&node->box, &query)) {
+            continue;
+        }
+        if (node->entity == BVH_NULL) {
+            stack[top++] = node->child[1];
+            stack[top++] = node->child[0];
+        } else if (bvh_overlaps(&tree->bounds[node->entity], &query)) {
+            if (found < max_entities) {
+                entities[found] = node->entity;
+            }
+            found++;
+        }
+    }
+    
+    tree->stats.visited += visited;
+    tree->stats.matches += found;
+    return found;
+}
+
+/**
+ * Closest hit: depth first, nearer child first, with the best hit so far
+ * bounding every slab test
+ */
+bool bvh_raycast(bvh_t* tree, const bvh_ray_t* ray, bvh_hit_t* hit) {
+    if (!tree || !ray || tree->root == BVH_NULL) {
+        return false;
+    }
+    
+    bvh_segment_t segment;
+    for (int k = 0; k < 3; k++) {
+        segment.origin[k] = bvh_clamp(ray->origin[k]);
+        segment.delta[k] = (__int128)bvh_clamp(ray->end[k]) - segment.origin[k];
+    }
+    
+    const bvh_node_t* nodes = tree->nodes;
+    uint32_t* stack = tree->stack;
+    size_t top = 0;
+    size_t visited = 0;
+    __int128 best_num = 1, best_den = 1;
+    uint32_t best = BVH_NULL;
+    stack[top++] = tree->root;
+    while (top > 0) {
+        const bvh_node_t* node = &nodes[stack[--top]];
+        __int128 num, den;
+        visited++;
+        if (!bvh_enter(&segment, &node->box, best_num, best_den, &num, &den)) {
+            continue;
+        }
+        
+        if (node->entity != BVH_NULL) {
+            if (!bvh_enter(&segment, &tree->bounds[node->entity], best_num, best_den, &num, &den)) {
+                continue;
+            }
+            
+            // Strictly nearer, or as near with a lower index
+            __int128 lhs = num * best_den;
+            __int128 rhs = best_num * den;
+            if (best == BVH_NULL || lhs < rhs || (lhs == rhs && node->entity < best)) {
+                best = node->entity;
+                best_num = num;
+                best_den = den;
+            }
+            continue;
+        }
+        
+        // Push the farther child first so the nearer one is searched first
+        uint32_t first = node->child[0];
+        uint32_t second = node->child[1];
+        __int128 first_num, first_den, second_num, second_den;
+        bool first_hit = bvh_enter(&segment, &nodes[first].box, best_num, best_den, &first_num, &first_den);
+        bool second_hit = bvh_enter(&segment, &nodes[second].box, best_num, best_den, &second_num, &second_den);
+        if (first_hit && second_hit && second_num * first_den < first_num * second_den) {
+            stack[top++] = first;
+            stack[top++] = second;
+        } else {
+            if (second_hit) stack[top++] = second;
+            if (first_hit) stack[top++] = first;
+        }
+    }
+    
+    tree->stats.visited += visited;
+    if (best == BVH_NULL) {
+        return false;
+    }
+    
+    tree->stats.matches++;
+    if (hit) {
+        hit->entity = best;
+        hit->fraction = bvh_fraction(best_num, best_den);
+    }
+    return true;
+}
+
+/**
+ * Max-heap order: farther first, then higher entity index
+ */
+static inline bool bvh_worse(const bvh_candidate_t* a, const bvh_candidate_t* b) {
+    return a->distance > b->distance || (a->distance == b->distance && a->entity > b->entity);
+}
+
+static void bvh_sift_down(bvh_candidate_t* heap, size_t size, size_t index) {
+    for (;;) {
+        size_t largest = index;
+        size_t left = 2 * index + 1;
+        size_t right = left + 1;
+        if (left < size && bvh_worse(&heap[left], &heap[largest])) largest = left;
+        if (right < size && bvh_worse(&heap[right], &heap[largest])) largest = right;
+        if (largest == index) {
+            return;
+        }
+        bvh_candidate_t swap = heap[index];
+        heap[index] = heap[largest];
+        heap[largest] = swap;
+        index = largest;
+    }
+}
+
+static void bvh_sift_up(bvh_candidate_t* heap, size_t index) {
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!bvh_worse(&heap[index], &heap[parent])) {
+            return;
+        }
+        bvh_candidate_t swap = heap[index];
+        heap[index] = heap[parent];
+        heap[parent] = swap;
+        index = parent;
+    }
+}
+
+/**
+ * k-nearest: depth first, nearer child first, keeping the best k in a
+ * max-heap whose top bounds the search once it is full
+ */
+size_t bvh_query_nearest(bvh_t* tree, int64_t x, int64_t y, int64_t z, uint32_t* entities, size_t k) {
+    if (!tree || !entities || k == 0 || tree->root == BVH_NULL) {
+        return 0;
+    }
+    if (k > tree->stats.leaves) {
+        k = tree->stats.leaves;
+    }
+    
+    if (k > tree->nearest_capacity) {
+        bvh_candidate_t* heap = (bvh_candidate_t*)memory_alloc_aligned(k * sizeof(bvh_candidate_t),
+                                                                      MEMORY_CACHE_LINE_SIZE);
+        if (!heap) {
+            return 0;
+        }
+        if (tree->nearest) memory_free_aligned(tree->nearest);
+        tree->nearest = heap;
+        tree->nearest_capacity = k;
+    }
+    
+    const int64_t point[3] = { bvh_clamp(x), bvh_clamp(y), bvh_clamp(z) };
+    const bvh_node_t* nodes = tree->nodes;
+    bvh_candidate_t* heap = (bvh_candidate_t*)tree->nearest;
+    uint32_t* stack = tree->stack;
+    size_t size = 0;
+    size_t top = 0;
+    size_t visited = 0;
+    stack[top++] = tree->root;
+    while (top > 0) {
+        const bvh_node_t* node = &nodes[stack[--top]];
+        visited++;
+        if (size == k && bvh_distance(&node->box, point) > heap[0].distance) {
+            continue;
+        }
+        
+        if (node->entity != BVH_NULL) {
+            bvh_candidate_t candidate = { bvh_distance(&tree->bounds[node->entity], point), node->entity };
+            if (size < k) {
+                heap[size] = candidate;
+                bvh_sift_up(heap, size++);
+            } else if (bvh_worse(&heap[0], &candidate)) {
+                heap[0] = candidate;
+                bvh_sift_down(heap, size, 0);
+            }
+            continue;
+        }
+        
+        uint32_t first = node->child[0];
+        uint32_t second = node->child[1];
+        if (bvh_distance(&nodes[second].box, point) < bvh_distance(&nodes[first].box, point)) {
+            stack[top++] = first;
+            stack[top++] = second;
+        } else {
+            stack[top++] = second;
+            stack[top++] = first;
+        }
+    }
+    
+    // Drain the heap back to front, leaving the nearest first
+    for (size_t i = size; i-- > 0;) {
+        entities[i] = heap[0].entity;
+        heap[0] = heap[i];
+        bvh_sift_down(heap, i, 0);
+    }
+    
+    tree->stats.visited += visited;
+    tree->stats.matches += size;
+    return size;
+}
+
+/**
+ * Statistics
+ */
+void bvh_get_stats(const bvh_t* tree, bvh_stats_t* stats) {
+    if (!tree || !stats) return;
+    
+    *stats = tree->stats;
+    stats->nodes = tree->node_count;
+}
+
+size_t bvh_height(const bvh_t* tree) {
+    if (!tree) return 0;
+    
+    size_t height = 0;
+    for (size_t i = 0; i < tree->count; i++) {
+        uint32_t index = tree->leaf[i];
+        if (index == BVH_NULL) {
+            continue;
+        }
+        
+        size_t depth = 0;
+        while (tree->nodes[index].parent != BVH_NULL) {
+            index = tree->nodes[index].parent;
+            depth++;
+        }
+        if (depth > height) {
+            height = depth;
+        }
+    }
+    return height;
+}
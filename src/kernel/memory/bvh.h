@@ -0,0 +1,157 @@
+/**
+ * CompileOS Physics Bounding Volume Hierarchy - Header
+ *
+ * Dynamic AABB tree over entities, keyed by their index into the physics
+ * vector arrays. Memory follows the entity count rather than the extent
+ * of the world, so it suits sparse, very large worlds the uniform grid
+ * would cover with mostly empty buckets. Each leaf holds a fattened copy
+ * of its entity's box, so an entity only goes back through the tree when
+ * it leaves that box. Insertion picks the sibling with the least
+ * surface-area cost, and tree rotations on the way back up keep the
+ * hierarchy shallow. Nodes are 64 bytes and live in one contiguous,
+ * cache-line aligned pool, addressed by 32-bit index.
+ *
+ * All arithmetic is integer: coordinates are two's-complement fixed-point
+ * values as in the integrator, and ray hits come back as 32.32 fractions.
+ */
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "multibit.h"
+#include "physics.h"
+
+// No node / no entity
+#define BVH_NULL 0xFFFFFFFFu
+
+// Most entities one tree can hold (2n - 1 nodes must stay below BVH_NULL)
+#define BVH_MAX_ENTITIES 0x7FFFFFFFu
+
+// Coordinates are clamped to +-BVH_COORD_LIMIT, which keeps extents, surface
+// areas and ray slab products inside 128-bit integers
+#define BVH_COORD_LIMIT ((int64_t)1 << 62)
+
+// Steps of velocity added to a fattened box in the direction of motion
+#define BVH_LOOKAHEAD_STEPS 2
+
+// Ray fraction of the segment end (hit fractions are 32.32 fixed point)
+#define BVH_FRACTION_ONE ((uint64_t)1 << 32)
+
+// Axis-aligned box (bounds inclusive)
+typedef struct {
+    int64_t min[3];
+    int64_t max[3];
+} bvh_aabb_t;
+
+// Pool node (64 bytes)
+typedef struct {
+    bvh_aabb_t box;             // Fattened box for leaves, union of the children otherwise
+    uint32_t parent;            // BVH_NULL at the root; next free node while free
+    uint32_t child[2];          // BVH_NULL for leaves
+    uint32_t entity;            // BVH_NULL for internal nodes
+} bvh_node_t;
+
+// Segment from origin to end
+typedef struct {
+    int64_t origin[3];
+    int64_t end[3];
+} bvh_ray_t;
+
+// Closest ray hit
+typedef struct {
+    uint32_t entity;
+    uint64_t fraction;          // Entry point as a fraction of the segment (0 .. BVH_FRACTION_ONE)
+} bvh_hit_t;
+
+// Statistics
+typedef struct {
+    size_t updates;             // Bulk update calls
+    size_t inserts;             // Leaves inserted, including reinsertions
+    size_t removes;             // Leaves removed, including reinsertions
+    size_t reinserted;          // Entities inserted or moved out of their fattened box by the last update
+    size_t rotations;           // Tree rotations applied
+    size_t visited;             // Nodes tested by queries
+    size_t matches;             // Entities the queries returned
+    size_t leaves;              // Entities in the tree
+    size_t nodes;               // Pool nodes in use
+    size_t relayouts;           // Pool copies into depth-first order
+} bvh_stats_t;
+
+// Tree
+typedef struct {
+    uint64_t extent;            // Half the edge of an entity's box in the bulk updates
+    uint64_t margin;            // Fattening on every side
+    
+    // Node pool (free nodes are chained through parent)
+    bvh_node_t* nodes;
+    uint32_t node_capacity;
+    uint32_t node_count;
+    uint32_t free_list;
+    uint32_t root;
+    
+    // Per entity: leaf node (BVH_NULL when absent) and exact box
+    uint32_t* leaf;
+    bvh_aabb_t* bounds;
+    size_t count;               // One past the highest entity index in use
+    size_t capacity;
+    
+    // Query scratch: traversal stack (node_capacity entries) and the
+    // k-nearest heap
+    uint32_t* stack;
+    void* nearest;
+    size_t nearest_capacity;
+    
+    // Inserts since the pool was last laid out depth first
+    size_t churn;
+    
+    bvh_stats_t stats;
+} bvh_t;
+
+// Lifetime (the bulk updates give each entity a cube of half-edge extent
+// around its position; every leaf is fattened by margin)
+int bvh_init(bvh_t* tree, uint64_t extent, uint64_t margin);
+void bvh_destroy(bvh_t* tree);
+
+// Single entities: set inserts the entity or moves it to box (reinserting
+// only when box leaves the fattened leaf), remove takes it out
+int bvh_set(bvh_t* tree, uint32_t entity, const bvh_aabb_t* box);
+int bvh_remove(bvh_t* tree, uint32_t entity);
+bool bvh_contains(const bvh_t* tree, uint32_t entity);
+
+// Bulk updates: entities 0 .. count - 1 take the boxes around the given
+// positions and any entity at or past count is removed. The SoA and AoS
+// forms also stretch each reinserted leaf along its velocity. Once enough
+// leaves have been reinserted, the update also re-lays the pool out depth
+// first so queries walk memory in order.
+int bvh_update_16(bvh_t* tree, const uint16_t* x, const uint16_t* y, const uint16_t* z, size_t count);
+int bvh_update_32(bvh_t* tree, const uint32_t* x, const uint32_t* y, const uint32_t* z, size_t count);
+int bvh_update_64(bvh_t* tree, const uint64_t* x, const uint64_t* y, const uint64_t* z, size_t count);
+int bvh_update_soa_16(bvh_t* tree, const physics_soa_16_t* soa);
+int bvh_update_soa_32(bvh_t* tree, const physics_soa_32_t* soa);
+int bvh_update_soa_64(bvh_t* tree, const physics_soa_64_t* soa);
+int bvh_update_aos_16(bvh_t* tree, const physics_vector_16_t* vectors, size_t count);
+int bvh_update_aos_32(bvh_t* tree, const physics_vector_32_t* vectors, size_t count);
+int bvh_update_aos_64(bvh_t* tree, const physics_vector_64_t* vectors, size_t count);
+
+// Every entity whose box overlaps box; stores up to max_entities indices
+// and returns how many there are
+size_t bvh_query_aabb(bvh_t* tree, const bvh_aabb_t* box, uint32_t* entities, size_t max_entities);
+
+// Closest entity box the segment enters (ties go to the lower entity
+// index); false when it hits nothing
+bool bvh_raycast(bvh_t* tree, const bvh_ray_t* ray, bvh_hit_t* hit);
+
+// The k entities whose boxes are closest to a point, nearest first (ties
+// go to the lower entity index); returns how many were stored
+size_t bvh_query_nearest(bvh_t* tree, int64_t x, int64_t y, int64_t z, uint32_t* entities, size_t k);
+
+// Statistics
+void bvh_get_stats(const bvh_t* tree, bvh_stats_t* stats);
+
+// Longest root-to-leaf path in edges (walks every leaf to the root)
+size_t bvh_height(const bvh_t* tree);
+
+#endif // BVH_H
@@ -0,0 +1,416 @@
+/**
+ * CompileOS Width Conversion Routines - Implementation
+ *
+ * Widening uses the zero-extending moves (pmovzx), narrowing clears or
+ * clamps the high bits and then packs (packusdw) or shuffles the low
+ * halves together. Saturation is unsigned: 64-bit lanes whose high half
+ * is non-zero become all ones before their low half is taken, which needs
+ * no 64-bit compare. Every routine finishes the elements that do not fill
+ * a vector with the scalar loop.
+ */
+
+#include "convert.h"
+#include "../../hal/arch/x86_64/cpu.h"
+#include <immintrin.h>
+
+// Dispatch table
+typedef struct {
+    void (*widen_16_32)(uint32_t* dest, const uint16_t* src, size_t count);
+    void (*widen_16_64)(uint64_t* dest, const uint16_t* src, size_t count);
+    void (*widen_32_64)(uint64_t* dest, const uint32_t* src, size_t count);
+    void (*narrow_32_16)(uint16_t* dest, const uint32_t* src, size_t count, bool saturate);
+    void (*narrow_64_16)(uint16_t* dest, const uint64_t* src, size_t count, bool saturate);
+    void (*narrow_64_32)(uint32_t* dest, const uint64_t* src, size_t count, bool saturate);
+} convert_table_t;
+
+// Generic (one element at a time)
+
+static void convert_16_to_32_generic(uint32_t* dest, const uint16_t* src, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = src[i];
+    }
+}
+
+static void convert_16_to_64_generic(uint64_t* dest, const uint16_t* src, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = src[i];
+    }
+}
+
+static void convert_32_to_64_generic(uint64_t* dest, const uint32_t* src, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dest[i] = src[i];
+    }
+}
+
+static void convert_32_to_16_generic(uint16_t* dest, const uint32_t* src, size_t count, bool saturate) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = src[i];
+        dest[i] = (uint16_t)(saturate && value > UINT16_MAX ? UINT16_MAX : value);
+    }
+}
+
+static void convert_64_to_16_generic(uint16_t* dest, const uint64_t* src, size_t count, bool saturate) {
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = src[i];
+        dest[i] = (uint16_t)(saturate && value > UINT16_MAX ? UINT16_MAX : value);
+    }
+}
+
+static void convert_64_to_32_generic(uint32_t* dest, const uint64_t* src, size_t count, bool saturate) {
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = src[i];
+        dest[i] = (uint32_t)(saturate && value > UINT32_MAX ? UINT32_MAX : value);
+    }
+}
+
+// SSE4.1 (16-byte vectors)
+
+__attribute__((target("sse4.1")))
+static void convert_16_to_32_sse41(uint32_t* dest, const uint16_t* src, size_t count) {
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_cvtepu16_epi32(v));
+        _mm_storeu_si128((__m128i*)(dest + i + 4), _mm_cvtepu16_epi32(_mm_srli_si128(v, 8)));
+    }
+    convert_16_to_32_generic(dest + i, src + i, count - i);
+}
+
+__attribute__((target("sse4.1")))
+static void convert_16_to_64_sse41(uint64_t* dest, const uint16_t* src, size_t count) {
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_cvtepu16_epi64(v));
+        _mm_storeu_si128((__m128i*)(dest + i + 2), _mm_cvtepu16_epi64(_mm_srli_si128(v, 4)));
+        _mm_storeu_si128((__m128i*)(dest + i + 4), _mm_cvtepu16_epi64(_mm_srli_si128(v, 8)));
+        _mm_storeu_si128((__m128i*)(dest + i + 6), _mm_cvtepu16_epi64(_mm_srli_si128(v, 12)));
+    }
+    convert_16_to_64_generic(dest + i, src + i, count - i);
+}
+
+__attribute__((target("sse4.1")))
+static void convert_32_to_64_sse41(uint64_t* dest, const uint32_t* src, size_t count) {
+    size_t i = 0;
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_cvtepu32_epi64(v));
+        _mm_storeu_si128((__m128i*)(dest + i + 2), _mm_cvtepu32_epi64(_mm_srli_si128(v, 8)));
+    }
+    convert_32_to_64_generic(dest + i, src + i, count - i);
+}
+
+/**
+ * Four 64-bit lanes to their low 32 bits, all ones where the high half is
+ * set when saturating
+ */
+__attribute__((target("sse4.1")))
+static inline __m128i convert_narrow_64_32_sse41(__m128i a, __m128i b, bool saturate) {
+    if (saturate) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i ones = _mm_set1_epi32(-1);
+        a = _mm_or_si128(a, _mm_andnot_si128(_mm_cmpeq_epi32(_mm_srli_epi64(a, 32), zero), ones));
+        b = _mm_or_si128(b, _mm_andnot_si128(_mm_cmpeq_epi32(_mm_srli_epi64(b, 32), zero), ones));
+    }
+    return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+/**
+ * Eight 32-bit lanes to 16 bits (packusdw needs values already in range)
+ */
+__attribute__((target("sse4.1")))
+static inline __m128i convert_narrow_32_16_sse41(__m128i a, __m128i b, bool saturate) {
+    __m128i limit = _mm_set1_epi32(UINT16_MAX);
+    
+    if (saturate) {
+        a = _mm_min_epu32(a, limit);
+        b = _mm_min_epu32(b, limit);
+    } else {
+        a = _mm_and_si128(a, limit);
+        b = _mm_and_si128(b, limit);
+    }
+    return _mm_packus_epi32(a, b);
+}
+
+__attribute__((target("sse4.1")))
+static void convert_32_to_16_sse41(uint16_t* dest, const uint32_t* src, size_t count, bool saturate) {
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 4));
+        _mm_storeu_si128((__m128i*)(dest + i), convert_narrow_32_16_sse41(a, b, saturate));
+    }
+    convert_32_to_16_generic(dest + i, src + i, count - i, saturate);
+}
+
+__attribute__((target("sse4.1")))
+static void convert_64_to_16_sse41(uint16_t* dest, const uint64_t* src, size_t count, bool saturate) {
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m128i low = convert_narrow_64_32_sse41(_mm_loadu_si128((const __m128i*)(src + i)),
+                                                 _mm_loadu_si128((const __m128i*)(src + i + 2)), saturate);
+        __m128i high = convert_narrow_64_32_sse41(_mm_loadu_si128((const __m128i*)(src + i + 4)),
+                                                  _mm_loadu_si128((const __m128i*)(src + i + 6)), saturate);
+        _mm_storeu_si128((__m128i*)(dest + i), convert_narrow_32_16_sse41(low, high, saturate));
+    }
+    convert_64_to_16_generic(dest + i, src + i, count - i, saturate);
+}
+
+__attribute__((target("sse4.1")))
+static void convert_64_to_32_sse41(uint32_t* dest, const uint64_t* src, size_t count, bool saturate) {
+    size_t i = 0;
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 2));
+        _mm_storeu_si128((__m128i*)(dest + i), convert_narrow_64_32_sse41(a, b, saturate));
+    }
+    convert_64_to_32_generic(dest + i, src + i, count - i, saturate);
+}
+
+// AVX2 (32-byte vectors; the packs and shuffles work per 128-bit lane, so
+// results are put back in order with a cross-lane permute)
+
+__attribute__((target("avx2")))
+static void convert_16_to_32_avx2(uint32_t* dest, const uint16_t* src, size_t count) {
+    size_t i = 0;
+    
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 8));
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_cvtepu16_epi32(a));
+        _mm256_storeu_si256((__m256i*)(dest + i + 8), _mm256_cvtepu16_epi32(b));
+    }
+    convert_16_to_32_generic(dest + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void convert_16_to_64_avx2(uint64_t* dest, const uint16_t* src, size_t count) {
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_cvtepu16_epi64(v));
+        _mm256_storeu_si256((__m256i*)(dest + i + 4), _mm256_cvtepu16_epi64(_mm_srli_si128(v, 8)));
+    }
+    convert_16_to_64_generic(dest + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void convert_32_to_64_avx2(uint64_t* dest, const uint32_t* src, size_t count) {
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 4));
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_cvtepu32_epi64(a));
+        _mm256_storeu_si256((__m256i*)(dest + i + 4), _mm256_cvtepu32_epi64(b));
+    }
+    convert_32_to_64_generic(dest + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i convert_narrow_64_32_avx2(__m256i a, __m256i b, bool saturate) {
+    if (saturate) {
+        __m256i zero = _mm256_setzero_si256();
+        __m256i ones = _mm256_set1_epi32(-1);
+        a = _mm256_or_si256(a, _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_srli_epi64(a, 32), zero), ones));
+        b = _mm256_or_si256(b, _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_srli_epi64(b, 32), zero), ones));
+    }
+    __m256 low = _mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm256_permute4x64_epi64(_mm256_castps_si256(low), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i convert_narrow_32_16_avx2(__m256i a, __m256i b, bool saturate) {
+    __m256i limit = _mm256_set1_epi32(UINT16_MAX);
+    
+    if (saturate) {
+        a = _mm256_min_epu32(a, limit);
+        b = _mm256_min_epu32(b, limit);
+    } else {
+        a = _mm256_and_si256(a, limit);
+        b = _mm256_and_si256(b, limit);
+    }
+    return _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+__attribute__((target("avx2")))
+static void convert_32_to_16_avx2(uint16_t* dest, const uint32_t* src, size_t count, bool saturate) {
+    size_t i = 0;
+    
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+        _mm256_storeu_si256((__m256i*)(dest + i), convert_narrow_32_16_avx2(a, b, saturate));
+    }
+    convert_32_to_16_generic(dest + i, src + i, count - i, saturate);
+}
+
+__attribute__((target("avx2")))
+static void convert_64_to_16_avx2(uint16_t* dest, const uint64_t* src, size_t count, bool saturate) {
+    size_t i = 0;
+    
+    for (; i + 16 <= count; i += 16) {
+        __m256i low = convert_narrow_64_32_avx2(_mm256_loadu_si256((const __m256i*)(src + i)),
+                                                _mm256_loadu_si256((const __m256i*)(src + i + 4)), saturate);
+        __m256i high = convert_narrow_64_32_avx2(_mm256_loadu_si256((const __m256i*)(src + i + 8)),
+                                                 _mm256_loadu_si256((const __m256i*)(src + i + 12)), saturate);
+        _mm256_storeu_si256((__m256i*)(dest + i), convert_narrow_32_16_avx2(low, high, saturate));
+    }
+    convert_64_to_16_generic(dest + i, src + i, count - i, saturate);
+}
+
+__attribute__((target("avx2")))
+static void convert_64_to_32_avx2(uint32_t* dest, const uint64_t* src, size_t count, bool saturate) {
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 4));
+        _mm256_storeu_si256((__m256i*)(dest + i), convert_narrow_64_32_avx2(a, b, saturate));
+    }
+    convert_64_to_32_generic(dest + i, src + i, count - i, saturate);
+}
+
+// Variant tables
+static const convert_table_t g_convert_tables[CONVERT_VARIANT_COUNT] = {
+    [CONVERT_VARIANT_GENERIC] = {
+        convert_16_to_32_generic, convert_16_to_64_generic, convert_32_to_64_generic,
+        convert_32_to_16_generic, convert_64_to_16_generic, convert_64_to_32_generic
+    },
+    [CONVERT_VARIANT_SSE41] = {
+        convert_16_to_32_sse41, convert_16_to_64_sse41, convert_32_to_64_sse41,
+        convert_32_to_16_sse41, convert_64_to_16_sse41, convert_64_to_32_sse41
+    },
+    [CONVERT_VARIANT_AVX2] = {
+        convert_16_to_32_avx2, convert_16_to_64_avx2, convert_32_to_64_avx2,
+        convert_32_to_16_avx2, convert_64_to_16_avx2, convert_64_to_32_avx2
+    }
+};
+
+static const char* const g_convert_variant_names[CONVERT_VARIANT_COUNT] = {
+    [CONVERT_VARIANT_GENERIC] = "generic",
+    [CONVERT_VARIANT_SSE41] = "sse4.1",
+    [CONVERT_VARIANT_AVX2] = "avx2"
+};
+
+// Routines state (generic until convert_init has looked at the CPU)
+static struct {
+    bool initialized;
+    convert_variant_t variant;
+    bool supported[CONVERT_VARIANT_COUNT];
+    convert_table_t table;
+} g_convert_state = {
+    false, CONVERT_VARIANT_GENERIC, { true },
+    {
+        convert_16_to_32_generic, convert_16_to_64_generic, convert_32_to_64_generic,
+        convert_32_to_16_generic, convert_64_to_16_generic, convert_64_to_32_generic
+    }
+};
+
+/**
+ * Detect the supported variants and select the best one
+ */
+void convert_init(void) {
+    if (g_convert_state.initialized) {
+        return;
+    }
+    
+    cpu_info_t cpu_info = {0};
+    cpu_detect(&cpu_info);
+    
+    g_convert_state.supported[CONVERT_VARIANT_GENERIC] = true;
+    g_convert_state.supported[CONVERT_VARIANT_SSE41] = cpu_info.features.sse4_1;
+    g_convert_state.supported[CONVERT_VARIANT_AVX2] = cpu_info.features.avx2 && cpu_avx_usable(&cpu_info);
+    
+    for (int variant = CONVERT_VARIANT_COUNT - 1; variant >= 0; variant--) {
+        if (convert_set_variant((convert_variant_t)variant) == 0) {
+            break;
+        }
+    }
+    
+    g_convert_state.initialized = true;
+}
+
+/**
+ * Check whether this CPU can run a variant
+ */
+bool convert_variant_supported(convert_variant_t variant) {
+    return variant < CONVERT_VARIANT_COUNT && g_convert_state.supported[variant];
+}
+
+/**
+ * Switch all routines to a variant
+ */
+int convert_set_variant(convert_variant_t variant) {
+    if (!convert_variant_supported(variant)) {
+        return -1;
+    }
+    
+    g_convert_state.variant = variant;
+    g_convert_state.table = g_convert_tables[variant];
+    return 0;
+}
+
+/**
+ * Get the selected variant
+ */
+convert_variant_t convert_get_variant(void) {
+    return g_convert_state.variant;
+}
+
+/**
+ * Get a variant's name
+ */
+const char* convert_variant_name(convert_variant_t variant) {
+    return variant < CONVERT_VARIANT_COUNT ? g_convert_variant_names[variant] : "unknown";
+}
+
+/**
+ * Zero-extend 16-bit values to 32 bits
+ */
+void convert_16_to_32(uint32_t* dest, const uint16_t* src, size_t count) {
+    g_convert_state.table.widen_16_32(dest, src, count);
+}
+
+/**
+ * Zero-extend 16-bit values to 64 bits
+ */
+void convert_16_to_64(uint64_t* dest, const uint16_t* src, size_t count) {
+    g_convert_state.table.widen_16_64(dest, src, count);
+}
+
+/**
+ * Zero-extend 32-bit values to 64 bits
+ */
+void convert_32_to_64(uint64_t* dest, const uint32_t* src, size_t count) {
+    g_convert_state.table.widen_32_64(dest, src, count);
+}
+
+/**
+ * Narrow 32-bit values to 16 bits
+ */
+void convert_32_to_16(uint16_t* dest, const uint32_t* src, size_t count, convert_mode_t mode) {
+    g_convert_state.table.narrow_32_16(dest, src, count, mode == CONVERT_SATURATE);
+}
+
+/**
+ * Narrow 64-bit values to 16 bits
+ */
+void convert_64_to_16(uint16_t* dest, const uint64_t* src, size_t count, convert_mode_t mode) {
+    g_convert_state.table.narrow_64_16(dest, src, count, mode == CONVERT_SATURATE);
+}
+
+/**
+ * Narrow 64-bit values to 32 bits
+ */
+void convert_64_to_32(uint32_t* dest, const uint64_t* src, size_t count, convert_mode_t mode) {
+    g_convert_state.table.narrow_64_32(dest, src, count, mode == CONVERT_SATURATE);
+}
@@ -0,0 +1,47 @@
+/**
+ * CompileOS Width Conversion Routines - Header
+ *
+ * Widening and narrowing copies between 16-, 32- and 64-bit unsigned
+ * arrays with SSE4.1 and AVX2 variants, one of which is selected at boot
+ * from the CPU feature bits
+ */
+
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Routine variants
+typedef enum {
+    CONVERT_VARIANT_GENERIC,
+    CONVERT_VARIANT_SSE41,
+    CONVERT_VARIANT_AVX2,
+    CONVERT_VARIANT_COUNT
+} convert_variant_t;
+
+// Narrowing behaviour for values that do not fit the destination
+typedef enum {
+    CONVERT_TRUNCATE,       // Keep the low bits
+    CONVERT_SATURATE        // Clamp to the destination's maximum
+} convert_mode_t;
+
+// Variant selection (init picks the best variant the CPU supports)
+void convert_init(void);
+bool convert_variant_supported(convert_variant_t variant);
+int convert_set_variant(convert_variant_t variant);
+convert_variant_t convert_get_variant(void);
+const char* convert_variant_name(convert_variant_t variant);
+
+// Widening (zero-extending; dest and src must not overlap)
+void convert_16_to_32(uint32_t* dest, const uint16_t* src, size_t count);
+void convert_16_to_64(uint64_t* dest, const uint16_t* src, size_t count);
+void convert_32_to_64(uint64_t* dest, const uint32_t* src, size_t count);
+
+// Narrowing (dest and src must not overlap)
+void convert_32_to_16(uint16_t* dest, const uint32_t* src, size_t count, convert_mode_t mode);
+void convert_64_to_16(uint16_t* dest, const uint64_t* src, size_t count, convert_mode_t mode);
+void convert_64_to_32(uint32_t* dest, const uint64_t* src, size_t count, convert_mode_t mode);
+
+#endif // CONVERT_H
@@ -0,0 +1,555 @@
+/**
+ * CompileOS Gather/Scatter Routines - Implementation
+ *
+ * The generic variant moves one element at a time. The SSE2 variant does
+ * the same but prefetches the element GATHER_PREFETCH_DISTANCE places
+ * ahead whenever the hardware prefetcher cannot see it coming: always for
+ * index lists, and for strides of GATHER_PREFETCH_MIN_STRIDE bytes or
+ * more. The AVX2 variant gathers eight 32-bit or four 64-bit elements per
+ * instruction and leaves out the prefetches, which cost more than they
+ * hide once each instruction has several loads in flight. 16-bit elements
+ * are gathered as the aligned 32-bit word holding them, which never
+ * crosses a page, and shifted down. AVX2 has no scatter instruction, so
+ * both SIMD variants scatter with the prefetching scalar loop.
+ */
+
+#include "gather.h"
+#include "../../hal/arch/x86_64/cpu.h"
+#include <immintrin.h>
+
+// Unaligned, aliasing element access for the scalar paths
+typedef uint16_t gather_u16_t __attribute__((may_alias, aligned(1)));
+typedef uint32_t gather_u32_t __attribute__((may_alias, aligned(1)));
+typedef uint64_t gather_u64_t __attribute__((may_alias, aligned(1)));
+
+// Routines
+typedef void (*gather_strided_t)(char* dest, const char* base, ptrdiff_t stride, size_t count);
+typedef void (*gather_indexed_t)(char* dest, const char* base, const uint32_t* indices, size_t count);
+typedef void (*scatter_strided_t)(char* base, ptrdiff_t stride, const char* src, size_t count);
+typedef void (*scatter_indexed_t)(char* base, const uint32_t* indices, const char* src, size_t count);
+
+// Dispatch table (each indexed by width: 16, 32, 64 bits)
+typedef struct {
+    gather_strided_t gather_strided[3];
+    gather_indexed_t gather_indexed[3];
+    scatter_strided_t scatter_strided[3];
+    scatter_indexed_t scatter_indexed[3];
+} gather_table_t;
+
+static inline uint64_t gather_load(const char* p, size_t width) {
+    switch (width) {
+        case 2: return *(const gather_u16_t*)p;
+        case 4: return *(const gather_u32_t*)p;
+        default: return *(const gather_u64_t*)p;
+    }
+}
+
+static inline void gather_store(char* p, size_t width, uint64_t value) {
+    switch (width) {
+        case 2: *(gather_u16_t*)p = (uint16_t)value; break;
+        case 4: *(gather_u32_t*)p = (uint32_t)value; break;
+        default: *(gather_u64_t*)p = value; break;
+    }
+}
+
+/**
+ * Whether a strided walk should prefetch
+ */
+static inline bool gather_stride_prefetch(ptrdiff_t stride) {
+    return stride >= GATHER_PREFETCH_MIN_STRIDE || stride <= -GATHER_PREFETCH_MIN_STRIDE;
+}
+
+/**
+ * Strided gather, one element at a time (width and prefetch are constants
+ * at every call, so each caller gets its own specialized loop)
+ */
+static inline __attribute__((always_inline))
+void gather_strided_scalar(char* dest, const char* base, ptrdiff_t stride, size_t count, size_t width,
+                           bool prefetch) {
+    prefetch = prefetch && gather_stride_prefetch(stride);
+    
+    for (size_t i = 0; i < count; i++) {
+        const char* p = base + (ptrdiff_t)i * stride;
+        if (prefetch && i + GATHER_PREFETCH_DISTANCE < count) {
+            _mm_prefetch(p + GATHER_PREFETCH_DISTANCE * stride, _MM_HINT_T0);
+        }
+        gather_store(dest + i * width, width, gather_load(p, width));
+    }
+}
+
+/**
+ * Indexed gather, one element at a time
+ */
+static inline __attribute__((always_inline))
+void gather_indexed_scalar(char* dest, const char* base, const uint32_t* indices, size_t count, size_t width,
+                           bool prefetch) {
+    for (size_t i = 0; i < count; i++) {
+        if (prefetch && i + GATHER_PREFETCH_DISTANCE < count) {
+            _mm_prefetch(base + (size_t)indices[i + GATHER_PREFETCH_DISTANCE] * width, _MM_HINT_T0);
+        }
+        gather_store(dest + i * width, width, gather_load(base + (size_t)indices[i] * width, width));
+    }
+}
+
+/**
+ * Strided scatter, one element at a time
+ */
+static inline __attribute__((always_inline))
+void scatter_strided_scalar(char* base, ptrdiff_t stride, const char* src, size_t count, size_t width,
+                            bool prefetch) {
+    prefetch = prefetch && gather_stride_prefetch(stride);
+    
+    for (size_t i = 0; i < count; i++) {
+        char* p = base + (ptrdiff_t)i * stride;
+        if (prefetch && i + GATHER_PREFETCH_DISTANCE < count) {
+            _mm_prefetch(p + GATHER_PREFETCH_DISTANCE * stride, _MM_HINT_T0);
+        }
+        gather_store(p, width, gather_load(src + i * width, width));
+    }
+}
+
+/**
+ * Indexed scatter, one element at a time
+ */
+static inline __attribute__((always_inline))
+void scatter_indexed_scalar(char* base, const uint32_t* indices, const char* src, size_t count, size_t width,
+                            bool prefetch) {
+    for (size_t i = 0; i < count; i++) {
+        if (prefetch && i + GATHER_PREFETCH_DISTANCE < count) {
+            _mm_prefetch(base + (size_t)indices[i + GATHER_PREFETCH_DISTANCE] * width, _MM_HINT_T0);
+        }
+        gather_store(base + (size_t)indices[i] * width, width, gather_load(src + i * width, width));
+    }
+}
+
+// Generic
+
+static void gather_strided_16_generic(char* dest, const char* base, ptrdiff_t stride, size_t count) {
+    gather_strided_scalar(dest, base, stride, count, 2, false);
+}
+
+static void gather_strided_32_generic(char* dest, const char* base, ptrdiff_t stride, size_t count) {
+    gather_strided_scalar(dest, base, stride, count, 4, false);
+}
+
+static void gather_strided_64_generic(char* dest, const char* base, ptrdiff_t stride, size_t count) {
+    gather_strided_scalar(dest, base, stride, count, 8, false);
+}
+
+static void gather_indexed_16_generic(char* dest, const char* base, const uint32_t* indices, size_t count) {
+    gather_indexed_scalar(dest, base, indices, count, 2, false);
+}
+
+static void gather_indexed_32_generic(char* dest, const char* base, const uint32_t* indices, size_t count) {
+    gather_indexed_scalar(dest, base, indices, count, 4, false);
+}
+
+static void gather_indexed_64_generic(char* dest, const char* base, const uint32_t* indices, size_t count) {
+    gather_indexed_scalar(dest, base, indices, count, 8, false);
+}
+
+static void scatter_strided_16_generic(char* base, ptrdiff_t stride, const char* src, size_t count) {
+    scatter_strided_scalar(base, stride, src, count, 2, false);
+}
+
+static void scatter_strided_32_generic(char* base, ptrdiff_t stride, const char* src, size_t count) {
+    scatter_strided_scalar(base, stride, src, count, 4, false);
+}
+
+static void scatter_strided_64_generic(char* base, ptrdiff_t stride, const char* src, size_t count) {
+    scatter_strided_scalar(base, stride, src, count, 8, false);
+}
+
+static void scatter_indexed_16_generic(char* base, const uint32_t* indices, const char* src, size_t count) {
+    scatter_indexed_scalar(base, indices, src, count, 2, false);
+}
+
+static void scatter_indexed_32_generic(char* base, const uint32_t* indices, const char* src, size_t count) {
+    scatter_indexed_scalar(base, indices, src, count, 4, false);
+}
+
+static void scatter_indexed_64_generic(char* base, const uint32_t* indices, const char* src, size_t count) {
+    scatter_indexed_scalar(base, indices, src, count, 8, false);
+}
+
+// SSE2 (scalar moves with software prefetch)
+
+static void gather_strided_16_sse2(char* dest, const char* base, ptrdiff_t stride, size_t count) {
+    gather_strided_scalar(dest, base, stride, count, 2, true);
+}
+
+static void gather_strided_32_sse2(char* dest, const char* base, ptrdiff_t stride, size_t count) {
+    gather_strided_scalar(dest, base, stride, count, 4, true);
+}
+
+static void gather_strided_64_sse2(char* dest, const char* base, ptrdiff_t stride, size_t count) {
+    gather_strided_scalar(dest, base, stride, count, 8, true);
+}
+
+static void gather_indexed_16_sse2(char* dest, const char* base, const uint32_t* indices, size_t count) {
+    gather_indexed_scalar(dest, base, indices, count, 2, true);
+}
+
+static void gather_indexed_32_sse2(char* dest, const char* base, const uint32_t* indices, size_t count) {
+    gather_indexed_scalar(dest, base, indices, count, 4, true);
+}
+
+static void gather_indexed_64_sse2(char* dest, const char* base, const uint32_t* indices, size_t count) {
+    gather_indexed_scalar(dest, base, indices, count, 8, true);
+}
+
+static void scatter_strided_16_sse2(char* base, ptrdiff_t stride, const char* src, size_t count) {
+    scatter_strided_scalar(base, stride, src, count, 2, true);
+}
+
+static void scatter_strided_32_sse2(char* base, ptrdiff_t stride, const char* src, size_t count) {
+    scatter_strided_scalar(base, stride, src, count, 4, true);
+}
+
+static void scatter_strided_64_sse2(char* base, ptrdiff_t stride, const char* src, size_t count) {
+    scatter_strided_scalar(base, stride, src, count, 8, true);
+}
+
+static void scatter_indexed_16_sse2(char* base, const uint32_t* indices, const char* src, size_t count) {
+    scatter_indexed_scalar(base, indices, src, count, 2, true);
+}
+
+static void scatter_indexed_32_sse2(char* base, const uint32_t* indices, const char* src, size_t count) {
+    scatter_indexed_scalar(base, indices, src, count, 4, true);
+}
+
+static void scatter_indexed_64_sse2(char* base, const uint32_t* indices, const char* src, size_t count) {
+    scatter_indexed_scalar(base, indices, src, count, 8, true);
+}
+
+// AVX2 (hardware gathers with 32-bit offsets; anything they cannot address
+// falls back to the prefetching loop)
+
+/**
+ * Whether eight consecutive strides fit the gathers' signed 32-bit offsets
+ */
+static inline bool gather_stride_fits(ptrdiff_t stride) {
+    return stride <= INT32_MAX / 8 && stride >= -(INT32_MAX / 8);
+}
+
+/**
+ * Whether any of eight indices has its top bit set (the gathers would
+ * sign-extend it)
+ */
+__attribute__((target("avx2")))
+static inline bool gather_indices_negative(__m256i indices) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(indices)) != 0;
+}
+
+/**
+ * Narrow sixteen gathered 32-bit words to the 16-bit halves selected by
+ * the shifts, in element order
+ */
+__attribute__((target("avx2")))
+static inline __m256i gather_narrow_16_avx2(__m256i a, __m256i a_shift, __m256i b, __m256i b_shift) {
+    __m256i low = _mm256_set1_epi32(0xFFFF);
+    a = _mm256_and_si256(_mm256_srlv_epi32(a, a_shift), low);
+    b = _mm256_and_si256(_mm256_srlv_epi32(b, b_shift), low);
+    return _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+__attribute__((target("avx2")))
+static void gather_strided_16_avx2(char* dest, const char* base, ptrdiff_t stride, size_t count) {
+    // Elements must be 2-byte aligned for their 32-bit word to hold them
+    if (!gather_stride_fits(stride) || (((uintptr_t)base | (uintptr_t)stride) & 1)) {
+        gather_strided_scalar(dest, base, stride, count, 2, true);
+        return;
+    }
+    
+    // 8 * stride is a multiple of 16, so every block of eight has the same
+    // offsets from its first word
+    uintptr_t skew = (uintptr_t)base & 3;
+    __m256i offsets = _mm256_add_epi32(_mm256_set1_epi32((int)skew),
+                                       _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                          _mm256_set1_epi32((int)stride)));
+    __m256i shifts = _mm256_slli_epi32(_mm256_and_si256(offsets, _mm256_set1_epi32(3)), 3);
+    offsets = _mm256_andnot_si256(_mm256_set1_epi32(3), offsets);
+    
+    const char* words = base - skew;
+    size_t i = 0;
+    for (; count - i >= 16; i += 16) {
+        const char* p = words + (ptrdiff_t)i * stride;
+        __m256i a = _mm256_i32gather_epi32((const int*)p, offsets, 1);
+        __m256i b = _mm256_i32gather_epi32((const int*)(p + 8 * stride), offsets, 1);
+        _mm256_storeu_si256((__m256i*)(dest + i * 2), gather_narrow_16_avx2(a, shifts, b, shifts));
+    }
+    
+    gather_strided_scalar(dest + i * 2, base + (ptrdiff_t)i * stride, stride, count - i, 2, true);
+}
+
+__attribute__((target("avx2")))
+static void gather_strided_32_avx2(char* dest, const char* base, ptrdiff_t stride, size_t count) {
+    if (!gather_stride_fits(stride)) {
+        gather_strided_scalar(dest, base, stride, count, 4, true);
+        return;
+    }
+    
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+    
+    size_t i = 0;
+    for (; count - i >= 8; i += 8) {
+        const char* p = base + (ptrdiff_t)i * stride;
+        _mm256_storeu_si256((__m256i*)(dest + i * 4), _mm256_i32gather_epi32((const int*)p, offsets, 1));
+    }
+    
+    gather_strided_scalar(dest + i * 4, base + (ptrdiff_t)i * stride, stride, count - i, 4, true);
+}
+
+__attribute__((target("avx2")))
+static void gather_strided_64_avx2(char* dest, const char* base, ptrdiff_t stride, size_t count) {
+    if (!gather_stride_fits(stride)) {
+        gather_strided_scalar(dest, base, stride, count, 8, true);
+        return;
+    }
+    
+    __m128i offsets = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32((int)stride));
+    
+    size_t i = 0;
+    for (; count - i >= 8; i += 8) {
+        const char* p = base + (ptrdiff_t)i * stride;
+        __m256i a = _mm256_i32gather_epi64((const long long*)p, offsets, 1);
+        __m256i b = _mm256_i32gather_epi64((const long long*)(p + 4 * stride), offsets, 1);
+        _mm256_storeu_si256((__m256i*)(dest + i * 8), a);
+        _mm256_storeu_si256((__m256i*)(dest + i * 8 + 32), b);
+    }
+    
+    gather_strided_scalar(dest + i * 8, base + (ptrdiff_t)i * stride, stride, count - i, 8, true);
+}
+
+__attribute__((target("avx2")))
+static void gather_indexed_16_avx2(char* dest, const char* base, const uint32_t* indices, size_t count) {
+    if ((uintptr_t)base & 1) {
+        gather_indexed_scalar(dest, base, indices, count, 2, true);
+        return;
+    }
+    
+    // Element index + skew / 2 counts 16-bit halves from the first word:
+    // half it for the word, its low bit picks the half
+    __m256i skew = _mm256_set1_epi32((int)(((uintptr_t)base & 3) / 2));
+    __m256i one = _mm256_set1_epi32(1);
+    const char* words = base - ((uintptr_t)base & 3);
+    
+    size_t i = 0;
+    for (; count - i >= 16; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(indices + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(indices + i + 8));
+        if (gather_indices_negative(_mm256_or_si256(a, b))) {
+            gather_indexed_scalar(dest + i * 2, base, indices + i, 16, 2, false);
+            continue;
+        }
+        
+        a = _mm256_add_epi32(a, skew);
+        b = _mm256_add_epi32(b, skew);
+        __m256i a_shift = _mm256_slli_epi32(_mm256_and_si256(a, one), 4);
+        __m256i b_shift = _mm256_slli_epi32(_mm256_and_si256(b, one), 4);
+        a = _mm256_i32gather_epi32((const int*)words, _mm256_srli_epi32(a, 1), 4);
+        b = _mm256_i32gather_epi32((const int*)words, _mm256_srli_epi32(b, 1), 4);
+        _mm256_storeu_si256((__m256i*)(dest + i * 2), gather_narrow_16_avx2(a, a_shift, b, b_shift));
+    }
+    
+    gather_indexed_scalar(dest + i * 2, base, indices + i, count - i, 2, false);
+}
+
+__attribute__((target("avx2")))
+static void gather_indexed_32_avx2(char* dest, const char* base, const uint32_t* indices, size_t count) {
+    size_t i = 0;
+    for (; count - i >= 8; i += 8) {
+        __m256i index = _mm256_loadu_si256((const __m256i*)(indices + i));
+        if (gather_indices_negative(index)) {
+            gather_indexed_scalar(dest + i * 4, base, indices + i, 8, 4, false);
+            continue;
+        }
+        _mm256_storeu_si256((__m256i*)(dest + i * 4), _mm256_i32gather_epi32((const int*)base, index, 4));
+    }
+    
+    gather_indexed_scalar(dest + i * 4, base, indices + i, count - i, 4, false);
+}
+
+__attribute__((target("avx2")))
+static void gather_indexed_64_avx2(char* dest, const char* base, const uint32_t* indices, size_t count) {
+    size_t i = 0;
+    for (; count - i >= 8; i += 8) {
+        __m256i index = _mm256_loadu_si256((const __m256i*)(indices + i));
+        if (gather_indices_negative(index)) {
+            gather_indexed_scalar(dest + i * 8, base, indices + i, 8, 8, false);
+            continue;
+        }
+        __m256i a = _mm256_i32gather_epi64((const long long*)base, _mm256_castsi256_si128(index), 8);
+        __m256i b = _mm256_i32gather_epi64((const long long*)base, _mm256_extracti128_si256(index, 1), 8);
+        _mm256_storeu_si256((__m256i*)(dest + i * 8), a);
+        _mm256_storeu_si256((__m256i*)(dest + i * 8 + 32), b);
+    }
+    
+    gather_indexed_scalar(dest + i * 8, base, indices + i, count - i, 8, false);
+}
+
+// Variant tables
+static const gather_table_t g_gather_tables[GATHER_VARIANT_COUNT] = {
+    [GATHER_VARIANT_GENERIC] = {
+        { gather_strided_16_generic, gather_strided_32_generic, gather_strided_64_generic },
+        { gather_indexed_16_generic, gather_indexed_32_generic, gather_indexed_64_generic },
+        { scatter_strided_16_generic, scatter_strided_32_generic, scatter_strided_64_generic },
+        { scatter_indexed_16_generic, scatter_indexed_32_generic, scatter_indexed_64_generic }
+    },
+    [GATHER_VARIANT_SSE2] = {
+        { gather_strided_16_sse2, gather_strided_32_sse2, gather_strided_64_sse2 },
+        { gather_indexed_16_sse2, gather_indexed_32_sse2, gather_indexed_64_sse2 },
+        { scatter_strided_16_sse2, scatter_strided_32_sse2, scatter_strided_64_sse2 },
+        { scatter_indexed_16_sse2, scatter_indexed_32_sse2, scatter_indexed_64_sse2 }
+    },
+    [GATHER_VARIANT_AVX2] = {
+        { gather_strided_16_avx2, gather_strided_32_avx2, gather_strided_64_avx2 },
+        { gather_indexed_16_avx2, gather_indexed_32_avx2, gather_indexed_64_avx2 },
+        { scatter_strided_16_sse2, scatter_strided_32_sse2, scatter_strided_64_sse2 },
+        { scatter_indexed_16_sse2, scatter_indexed_32_sse2, scatter_indexed_64_sse2 }
+    }
+};
+
+static const char* const g_gather_variant_names[GATHER_VARIANT_COUNT] = {
+    [GATHER_VARIANT_GENERIC] = "generic",
+    [GATHER_VARIANT_SSE2] = "sse2",
+    [GATHER_VARIANT_AVX2] = "avx2"
+};
+
+// Routines state (generic until gather_init has looked at the CPU)
+static struct {
+    bool initialized;
+    gather_variant_t variant;
+    bool supported[GATHER_VARIANT_COUNT];
+    gather_table_t table;
+} g_gather_state = {
+    false, GATHER_VARIANT_GENERIC, { true },
+    {
+        { gather_strided_16_generic, gather_strided_32_generic, gather_strided_64_generic },
+        { gather_indexed_16_generic, gather_indexed_32_generic, gather_indexed_64_generic },
+        { scatter_strided_16_generic, scatter_strided_32_generic, scatter_strided_64_generic },
+        { scatter_indexed_16_generic, scatter_indexed_32_generic, scatter_indexed_64_generic }
+    }
+};
+
+/**
+ * Table slot for an element width; -1 for anything but 2, 4 or 8 bytes
+ */
+static int gather_width_slot(size_t width) {
+    switch (width) {
+        case 2: return 0;
+        case 4: return 1;
+        case 8: return 2;
+        default: return -1;
+    }
+}
+
+/**
+ * Detect the supported variants and select the best one
+ */
+void gather_init(void) {
+    if (g_gather_state.initialized) {
+        return;
+    }
+    
+    cpu_info_t cpu_info = {0};
+    cpu_detect(&cpu_info);
+    
+    g_gather_state.supported[GATHER_VARIANT_GENERIC] = true;
+    g_gather_state.supported[GATHER_VARIANT_SSE2] = cpu_info.features.sse2;
+    g_gather_state.supported[GATHER_VARIANT_AVX2] = cpu_info.features.avx2 && cpu_avx_usable(&cpu_info);
+    
+    for (int variant = GATHER_VARIANT_COUNT - 1; variant >= 0; variant--) {
+        if (gather_set_variant((gather_variant_t)variant) == 0) {
+            break;
+        }
+    }
+    
+    g_gather_state.initialized = true;
+}
+
+/**
+ * Check whether this CPU can run a variant
+ */
+bool gather_variant_supported(gather_variant_t variant) {
+    return variant < GATHER_VARIANT_COUNT && g_gather_state.supported[variant];
+}
+
+/**
+ * Switch all routines to a variant
+ */
+int gather_set_variant(gather_variant_t variant) {
+    if (!gather_variant_supported(variant)) {
+        return -1;
+    }
+    
+    g_gather_state.variant = variant;
+    g_gather_state.table = g_gather_tables[variant];
+    return 0;
+}
+
+/**
+ * Get the selected variant
+ */
+gather_variant_t gather_get_variant(void) {
+    return g_gather_state.variant;
+}
+
+/**
+ * Get a variant's name
+ */
+const char* gather_variant_name(gather_variant_t variant) {
+    return variant < GATHER_VARIANT_COUNT ? g_gather_variant_names[variant] : "unknown";
+}
+
+/**
+ * Copy every stride-th element into a dense buffer
+ */
+int gather_strided(void* dest, const void* base, ptrdiff_t stride, size_t count, size_t width) {
+    int slot = gather_width_slot(width);
+    if (!dest || !base || slot < 0) {
+        return -1;
+    }
+    
+    g_gather_state.table.gather_strided[slot]((char*)dest, (const char*)base, stride, count);
+    return 0;
+}
+
+/**
+ * Copy a dense buffer out to every stride-th element
+ */
+int scatter_strided(void* base, ptrdiff_t stride, const void* src, size_t count, size_t width) {
+    int slot = gather_width_slot(width);
+    if (!base || !src || slot < 0) {
+        return -1;
+    }
+    
+    g_gather_state.table.scatter_strided[slot]((char*)base, stride, (const char*)src, count);
+    return 0;
+}
+
+/**
+ * Copy the listed elements into a dense buffer
+ */
+int gather_indexed(void* dest, const void* base, const uint32_t* indices, size_t count, size_t width) {
+    int slot = gather_width_slot(width);
+    if (!dest || !base || !indices || slot < 0) {
+        return -1;
+    }
+    
+    g_gather_state.table.gather_indexed[slot]((char*)dest, (const char*)base, indices, count);
+    return 0;
+}
+
+/**
+ * Copy a dense buffer out to the listed elements
+ */
+int scatter_indexed(void* base, const uint32_t* indices, const void* src, size_t count, size_t width) {
+    int slot = gather_width_slot(width);
+    if (!base || !indices || !src || slot < 0) {
+        return -1;
+    }
+    
+    g_gather_state.table.scatter_indexed[slot]((char*)base, indices, (const char*)src, count);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * CompileOS Gather/Scatter Routines - Header
+ *
+ * Bulk reads and writes of 16-, 32- or 64-bit elements between scattered
+ * locations and a dense buffer, with prefetching and AVX2 variants, one of
+ * which is selected at boot from the CPU feature bits. Elements are
+ * addressed either by a byte stride (one field across an array of
+ * records) or by a list of element indices.
+ */
+
+#ifndef GATHER_H
+#define GATHER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Elements ahead of the current one whose cache lines are prefetched
+#define GATHER_PREFETCH_DISTANCE 16
+
+// Strides shorter than this are left to the hardware prefetcher
+#define GATHER_PREFETCH_MIN_STRIDE 256
+
+// Routine variants
+typedef enum {
+    GATHER_VARIANT_GENERIC,
+    GATHER_VARIANT_SSE2,
+    GATHER_VARIANT_AVX2,
+    GATHER_VARIANT_COUNT
+} gather_variant_t;
+
+// Variant selection (init picks the best variant the CPU supports)
+void gather_init(void);
+bool gather_variant_supported(gather_variant_t variant);
+int gather_set_variant(gather_variant_t variant);
+gather_variant_t gather_get_variant(void);
+const char* gather_variant_name(gather_variant_t variant);
+
+// Strided: element i of width bytes (2, 4 or 8) lives at base + i * stride.
+// Neither the elements nor the stride need any alignment, and the stride
+// may be zero or negative.
+int gather_strided(void* dest, const void* base, ptrdiff_t stride, size_t count, size_t width);
+int scatter_strided(void* base, ptrdiff_t stride, const void* src, size_t count, size_t width);
+
+// Indexed: element i lives at base + indices[i] * width. A scatter writes
+// in order, so the last of several equal indices wins.
+int gather_indexed(void* dest, const void* base, const uint32_t* indices, size_t count, size_t width);
+int scatter_indexed(void* base, const uint32_t* indices, const void* src, size_t count, size_t width);
+
+#endif // GATHER_H
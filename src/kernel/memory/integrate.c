@@ -0,0 +1,635 @@
+/**
+ * CompileOS Physics Integration Routines - Implementation
+ *
+ * SoA containers are stepped one axis at a time: position, velocity and
+ * acceleration of an axis are three dense arrays, so each vector is one
+ * load from each and two stores. Array-of-structs records are treated as a
+ * flat element array instead: element j gains element j + 3 when j falls
+ * on a position or velocity field (j mod 9 < 6), which is a shifted load
+ * ANDed with a mask whose phase advances by the vector width. Elements are
+ * only ever read before they are written, so the step works in place.
+ */
+
+#include "integrate.h"
+#include "../../hal/arch/x86_64/cpu.h"
+#include <immintrin.h>
+
+// Fields per physics record, and the offset from position to velocity and
+// from velocity to acceleration
+#define INTEGRATE_RECORD_FIELDS 9
+#define INTEGRATE_FIELD_STRIDE 3
+
+// AoS mask length (one record phase plus the widest vector)
+#define INTEGRATE_MASK_LENGTH (INTEGRATE_RECORD_FIELDS + 16)
+
+// One axis of a SoA container
+typedef void (*integrate_axis_t)(void* position, void* velocity, const void* acceleration,
+                                 size_t count, bool saturate);
+
+// A run of AoS records
+typedef void (*integrate_records_t)(void* records, size_t count, bool saturate);
+
+// Dispatch table (indexed by width: 16, 32, 64 bits)
+typedef struct {
+    integrate_axis_t axis[3];
+    integrate_records_t records[3];
+} integrate_table_t;
+
+// AoS masks: all ones on position and velocity fields, repeating per record
+static uint16_t g_integrate_mask_16[INTEGRATE_MASK_LENGTH];
+static uint32_t g_integrate_mask_32[INTEGRATE_MASK_LENGTH];
+static uint64_t g_integrate_mask_64[INTEGRATE_MASK_LENGTH];
+
+/**
+ * Scalar adds (saturating to the signed range when asked)
+ */
+static inline uint16_t integrate_add_16(uint16_t a, uint16_t b, bool saturate) {
+    uint16_t sum = (uint16_t)(a + b);
+    if (saturate && (~(a ^ b) & (a ^ sum) & 0x8000)) {
+        sum = (a & 0x8000) ? 0x8000 : 0x7FFF;
+    }
+    return sum;
+}
+
+static inline uint32_t integrate_add_32(uint32_t a, uint32_t b, bool saturate) {
+    uint32_t sum = a + b;
+    if (saturate && (~(a ^ b) & (a ^ sum) & 0x80000000u)) {
+        sum = (a & 0x80000000u) ? 0x80000000u : 0x7FFFFFFFu;
+    }
+    return sum;
+}
+
+static inline uint64_t integrate_add_64(uint64_t a, uint64_t b, bool saturate) {
+    uint64_t sum = a + b;
+    if (saturate && (~(a ^ b) & (a ^ sum) & 0x8000000000000000ULL)) {
+        sum = (a & 0x8000000000000000ULL) ? 0x8000000000000000ULL : 0x7FFFFFFFFFFFFFFFULL;
+    }
+    return sum;
+}
+
+/**
+ * Scalar AoS step over flat elements first .. count - 1 (count is a whole
+ * number of records, so element j + 3 always exists when it is read)
+ */
+static void integrate_flat_16(uint16_t* e, size_t first, size_t count, bool saturate) {
+    for (size_t j = first; j < count; j++) {
+        if (j % INTEGRATE_RECORD_FIELDS < 2 * INTEGRATE_FIELD_STRIDE) {
+            e[j] = integrate_add_16(e[j], e[j + INTEGRATE_FIELD_STRIDE], saturate);
+        }
+    }
+}
+
+static void integrate_flat_32(uint32_t* e, size_t first, size_t count, bool saturate) {
+    for (size_t j = first; j < count; j++) {
+        if (j % INTEGRATE_RECORD_FIELDS < 2 * INTEGRATE_FIELD_STRIDE) {
+            e[j] = integrate_add_32(e[j], e[j + INTEGRATE_FIELD_STRIDE], saturate);
+        }
+    }
+}
+
+static void integrate_flat_64(uint64_t* e, size_t first, size_t count, bool saturate) {
+    for (size_t j = first; j < count; j++) {
+        if (j % INTEGRATE_RECORD_FIELDS < 2 * INTEGRATE_FIELD_STRIDE) {
+            e[j] = integrate_add_64(e[j], e[j + INTEGRATE_FIELD_STRIDE], saturate);
+        }
+    }
+}
+
+// Generic
+
+static void integrate_axis_16_generic(void* position, void* velocity, const void* acceleration,
+                                      size_t count, bool saturate) {
+    uint16_t* p = (uint16_t*)position;
+    uint16_t* v = (uint16_t*)velocity;
+    const uint16_t* a = (const uint16_t*)acceleration;
+    
+    for (size_t i = 0; i < count; i++) {
+        p[i] = integrate_add_16(p[i], v[i], saturate);
+        v[i] = integrate_add_16(v[i], a[i], saturate);
+    }
+}
+
+static void integrate_axis_32_generic(void* position, void* velocity, const void* acceleration,
+                                      size_t count, bool saturate) {
+    uint32_t* p = (uint32_t*)position;
+    uint32_t* v = (uint32_t*)velocity;
+    const uint32_t* a = (const uint32_t*)acceleration;
+    
+    for (size_t i = 0; i < count; i++) {
+        p[i] = integrate_add_32(p[i], v[i], saturate);
+        v[i] = integrate_add_32(v[i], a[i], saturate);
+    }
+}
+
+static void integrate_axis_64_generic(void* position, void* velocity, const void* acceleration,
+                                      size_t count, bool saturate) {
+    uint64_t* p = (uint64_t*)position;
+    uint64_t* v = (uint64_t*)velocity;
+    const uint64_t* a = (const uint64_t*)acceleration;
+    
+    for (size_t i = 0; i < count; i++) {
+        p[i] = integrate_add_64(p[i], v[i], saturate);
+        v[i] = integrate_add_64(v[i], a[i], saturate);
+    }
+}
+
+static void integrate_records_16_generic(void* records, size_t count, bool saturate) {
+    integrate_flat_16((uint16_t*)records, 0, count * INTEGRATE_RECORD_FIELDS, saturate);
+}
+
+static void integrate_records_32_generic(void* records, size_t count, bool saturate) {
+    integrate_flat_32((uint32_t*)records, 0, count * INTEGRATE_RECORD_FIELDS, saturate);
+}
+
+static void integrate_records_64_generic(void* records, size_t count, bool saturate) {
+    integrate_flat_64((uint64_t*)records, 0, count * INTEGRATE_RECORD_FIELDS, saturate);
+}
+
+// SSE2 (16-byte vectors; 16-bit saturation is native, 32 and 64 bits pick
+// the limit by the sign of a wherever a and b agree in sign and the sum
+// does not)
+
+static inline __m128i integrate_adds_epi32_sse2(__m128i a, __m128i b) {
+    __m128i sum = _mm_add_epi32(a, b);
+    __m128i overflow = _mm_srai_epi32(_mm_andnot_si128(_mm_xor_si128(a, b), _mm_xor_si128(a, sum)), 31);
+    __m128i limit = _mm_xor_si128(_mm_srai_epi32(a, 31), _mm_set1_epi32(0x7FFFFFFF));
+    return _mm_or_si128(_mm_andnot_si128(overflow, sum), _mm_and_si128(overflow, limit));
+}
+
+static inline __m128i integrate_sign_epi64_sse2(__m128i x) {
+    return _mm_shuffle_epi32(_mm_srai_epi32(x, 31), _MM_SHUFFLE(3, 3, 1, 1));
+}
+
+static inline __m128i integrate_adds_epi64_sse2(__m128i a, __m128i b) {
+    __m128i sum = _mm_add_epi64(a, b);
+    __m128i overflow = integrate_sign_epi64_sse2(_mm_andnot_si128(_mm_xor_si128(a, b), _mm_xor_si128(a, sum)));
+    __m128i limit = _mm_xor_si128(integrate_sign_epi64_sse2(a), _mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    return _mm_or_si128(_mm_andnot_si128(overflow, sum), _mm_and_si128(overflow, limit));
+}
+
+static void integrate_axis_16_sse2(void* position, void* velocity, const void* acceleration,
+                                   size_t count, bool saturate) {
+    uint16_t* p = (uint16_t*)position;
+    uint16_t* v = (uint16_t*)velocity;
+    const uint16_t* a = (const uint16_t*)acceleration;
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m128i pv = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i vv = _mm_loadu_si128((const __m128i*)(v + i));
+        __m128i av = _mm_loadu_si128((const __m128i*)(a + i));
+        if (saturate) {
+            pv = _mm_adds_epi16(pv, vv);
+            vv = _mm_adds_epi16(vv, av);
+        } else {
+            pv = _mm_add_epi16(pv, vv);
+            vv = _mm_add_epi16(vv, av);
+        }
+        _mm_storeu_si128((__m128i*)(p + i), pv);
+        _mm_storeu_si128((__m128i*)(v + i), vv);
+    }
+    
+    integrate_axis_16_generic(p + i, v + i, a + i, count - i, saturate);
+}
+
+static void integrate_axis_32_sse2(void* position, void* velocity, const void* acceleration,
+                                   size_t count, bool saturate) {
+    uint32_t* p = (uint32_t*)position;
+    uint32_t* v = (uint32_t*)velocity;
+    const uint32_t* a = (const uint32_t*)acceleration;
+    size_t i = 0;
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128i pv = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i vv = _mm_loadu_si128((const __m128i*)(v + i));
+        __m128i av = _mm_loadu_si128((const __m128i*)(a + i));
+        if (saturate) {
+            pv = integrate_adds_epi32_sse2(pv, vv);
+            vv = integrate_adds_epi32_sse2(vv, av);
+        } else {
+            pv = _mm_add_epi32(pv, vv);
+            vv = _mm_add_epi32(vv, av);
+        }
+        _mm_storeu_si128((__m128i*)(p + i), pv);
+        _mm_storeu_si128((__m128i*)(v + i), vv);
+    }
+    
+    integrate_axis_32_generic(p + i, v + i, a + i, count - i, saturate);
+}
+
+static void integrate_axis_64_sse2(void* position, void* velocity, const void* acceleration,
+                                   size_t count, bool saturate) {
+    uint64_t* p = (uint64_t*)position;
+    uint64_t* v = (uint64_t*)velocity;
+    const uint64_t* a = (const uint64_t*)acceleration;
+    size_t i = 0;
+    
+    for (; i + 2 <= count; i += 2) {
+        __m128i pv = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i vv = _mm_loadu_si128((const __m128i*)(v + i));
+        __m128i av = _mm_loadu_si128((const __m128i*)(a + i));
+        if (saturate) {
+            pv = integrate_adds_epi64_sse2(pv, vv);
+            vv = integrate_adds_epi64_sse2(vv, av);
+        } else {
+            pv = _mm_add_epi64(pv, vv);
+            vv = _mm_add_epi64(vv, av);
+        }
+        _mm_storeu_si128((__m128i*)(p + i), pv);
+        _mm_storeu_si128((__m128i*)(v + i), vv);
+    }
+    
+    integrate_axis_64_generic(p + i, v + i, a + i, count - i, saturate);
+}
+
+static void integrate_records_16_sse2(void* records, size_t count, bool saturate) {
+    uint16_t* e = (uint16_t*)records;
+    size_t total = count * INTEGRATE_RECORD_FIELDS;
+    size_t j = 0;
+    unsigned int phase = 0;
+    
+    // The shifted load reads three elements past the vector
+    for (; j + 8 + INTEGRATE_FIELD_STRIDE <= total; j += 8) {
+        __m128i mask = _mm_loadu_si128((const __m128i*)(g_integrate_mask_16 + phase));
+        __m128i value = _mm_loadu_si128((const __m128i*)(e + j));
+        __m128i addend = _mm_and_si128(_mm_loadu_si128((const __m128i*)(e + j + INTEGRATE_FIELD_STRIDE)), mask);
+        value = saturate ? _mm_adds_epi16(value, addend) : _mm_add_epi16(value, addend);
+        _mm_storeu_si128((__m128i*)(e + j), value);
+        phase = (phase + 8) % INTEGRATE_RECORD_FIELDS;
+    }
+    
+    integrate_flat_16(e, j, total, saturate);
+}
+
+static void integrate_records_32_sse2(void* records, size_t count, bool saturate) {
+    uint32_t* e = (uint32_t*)records;
+    size_t total = count * INTEGRATE_RECORD_FIELDS;
+    size_t j = 0;
+    unsigned int phase = 0;
+    
+    for (; j + 4 + INTEGRATE_FIELD_STRIDE <= total; j += 4) {
+        __m128i mask = _mm_loadu_si128((const __m128i*)(g_integrate_mask_32 + phase));
+        __m128i value = _mm_loadu_si128((const __m128i*)(e + j));
+        __m128i addend = _mm_and_si128(_mm_loadu_si128((const __m128i*)(e + j + INTEGRATE_FIELD_STRIDE)), mask);
+        value = saturate ? integrate_adds_epi32_sse2(value, addend) : _mm_add_epi32(value, addend);
+        _mm_storeu_si128((__m128i*)(e + j), value);
+        phase = (phase + 4) % INTEGRATE_RECORD_FIELDS;
+    }
+    
+    integrate_flat_32(e, j, total, saturate);
+}
+
+static void integrate_records_64_sse2(void* records, size_t count, bool saturate) {
+    uint64_t* e = (uint64_t*)records;
+    size_t total = count * INTEGRATE_RECORD_FIELDS;
+    size_t j = 0;
+    unsigned int phase = 0;
+    
+    for (; j + 2 + INTEGRATE_FIELD_STRIDE <= total; j += 2) {
+        __m128i mask = _mm_loadu_si128((const __m128i*)(g_integrate_mask_64 + phase));
+        __m128i value = _mm_loadu_si128((const __m128i*)(e + j));
+        __m128i addend = _mm_and_si128(_mm_loadu_si128((const __m128i*)(e + j + INTEGRATE_FIELD_STRIDE)), mask);
+        value = saturate ? integrate_adds_epi64_sse2(value, addend) : _mm_add_epi64(value, addend);
+        _mm_storeu_si128((__m128i*)(e + j), value);
+        phase = (phase + 2) % INTEGRATE_RECORD_FIELDS;
+    }
+    
+    integrate_flat_64(e, j, total, saturate);
+}
+
+// AVX2 (32-byte vectors; the same saturation scheme)
+
+__attribute__((target("avx2")))
+static inline __m256i integrate_adds_epi32_avx2(__m256i a, __m256i b) {
+    __m256i sum = _mm256_add_epi32(a, b);
+    __m256i overflow = _mm256_srai_epi32(_mm256_andnot_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(a, sum)), 31);
+    __m256i limit = _mm256_xor_si256(_mm256_srai_epi32(a, 31), _mm256_set1_epi32(0x7FFFFFFF));
+    return _mm256_blendv_epi8(sum, limit, overflow);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i integrate_adds_epi64_avx2(__m256i a, __m256i b) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i sum = _mm256_add_epi64(a, b);
+    __m256i overflow = _mm256_cmpgt_epi64(zero, _mm256_andnot_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(a, sum)));
+    __m256i limit = _mm256_xor_si256(_mm256_cmpgt_epi64(zero, a), _mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    return _mm256_blendv_epi8(sum, limit, overflow);
+}
+
+__attribute__((target("avx2")))
+static void integrate_axis_16_avx2(void* position, void* velocity, const void* acceleration,
+                                   size_t count, bool saturate) {
+    uint16_t* p = (uint16_t*)position;
+    uint16_t* v = (uint16_t*)velocity;
+    const uint16_t* a = (const uint16_t*)acceleration;
+    size_t i = 0;
+    
+    for (; i + 16 <= count; i += 16) {
+        __m256i pv = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i vv = _mm256_loadu_si256((const __m256i*)(v + i));
+        __m256i av = _mm256_loadu_si256((const __m256i*)(a + i));
+        if (saturate) {
+            pv = _mm256_adds_epi16(pv, vv);
+            vv = _mm256_adds_epi16(vv, av);
+        } else {
+            pv = _mm256_add_epi16(pv, vv);
+            vv = _mm256_add_epi16(vv, av);
+        }
+        _mm256_storeu_si256((__m256i*)(p + i), pv);
+        _mm256_storeu_si256((__m256i*)(v + i), vv);
+    }
+    
+    integrate_axis_16_generic(p + i, v + i, a + i, count - i, saturate);
+}
+
+__attribute__((target("avx2")))
+static void integrate_axis_32_avx2(void* position, void* velocity, const void* acceleration,
+                                   size_t count, bool saturate) {
+    uint32_t* p = (uint32_t*)position;
+    uint32_t* v = (uint32_t*)velocity;
+    const uint32_t* a = (const uint32_t*)acceleration;
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m256i pv = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i vv = _mm256_loadu_si256((const __m256i*)(v + i));
+        __m256i av = _mm256_loadu_si256((const __m256i*)(a + i));
+        if (saturate) {
+            pv = integrate_adds_epi32_avx2(pv, vv);
+            vv = integrate_adds_epi32_avx2(vv, av);
+        } else {
+            pv = _mm256_add_epi32(pv, vv);
+            vv = _mm256_add_epi32(vv, av);
+        }
+        _mm256_storeu_si256((__m256i*)(p + i), pv);
+        _mm256_storeu_si256((__m256i*)(v + i), vv);
+    }
+    
+    integrate_axis_32_generic(p + i, v + i, a + i, count - i, saturate);
+}
+
+__attribute__((target("avx2")))
+static void integrate_axis_64_avx2(void* position, void* velocity, const void* acceleration,
+                                   size_t count, bool saturate) {
+    uint64_t* p = (uint64_t*)position;
+    uint64_t* v = (uint64_t*)velocity;
+    const uint64_t* a = (const uint64_t*)acceleration;
+    size_t i = 0;
+    
+    for (; i + 4 <= count; i += 4) {
+        __m256i pv = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i vv = _mm256_loadu_si256((const __m256i*)(v + i));
+        __m256i av = _mm256_loadu_si256((const __m256i*)(a + i));
+        if (saturate) {
+            pv = integrate_adds_epi64_avx2(pv, vv);
+            vv = integrate_adds_epi64_avx2(vv, av);
+        } else {
+            pv = _mm256_add_epi64(pv, vv);
+            vv = _mm256_add_epi64(vv, av);
+        }
+        _mm256_storeu_si256((__m256i*)(p + i), pv);
+        _mm256_storeu_si256((__m256i*)(v + i), vv);
+    }
+    
+    integrate_axis_64_generic(p + i, v + i, a + i, count - i, saturate);
+}
+
+__attribute__((target("avx2")))
+static void integrate_records_16_avx2(void* records, size_t count, bool saturate) {
+    uint16_t* e = (uint16_t*)records;
+    size_t total = count * INTEGRATE_RECORD_FIELDS;
+    size_t j = 0;
+    unsigned int phase = 0;
+    
+    for (; j + 16 + INTEGRATE_FIELD_STRIDE <= total; j += 16) {
+        __m256i mask = _mm256_loadu_si256((const __m256i*)(g_integrate_mask_16 + phase));
+        __m256i value = _mm256_loadu_si256((const __m256i*)(e + j));
+        __m256i addend = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(e + j + INTEGRATE_FIELD_STRIDE)), mask);
+        value = saturate ? _mm256_adds_epi16(value, addend) : _mm256_add_epi16(value, addend);
+        _mm256_storeu_si256((__m256i*)(e + j), value);
+        phase = (phase + 16) % INTEGRATE_RECORD_FIELDS;
+    }
+    
+    integrate_flat_16(e, j, total, saturate);
+}
+
+__attribute__((target("avx2")))
+static void integrate_records_32_avx2(void* records, size_t count, bool saturate) {
+    uint32_t* e = (uint32_t*)records;
+    size_t total = count * INTEGRATE_RECORD_FIELDS;
+    size_t j = 0;
+    unsigned int phase = 0;
+    
+    for (; j + 8 + INTEGRATE_FIELD_STRIDE <= total; j += 8) {
+        __m256i mask = _mm256_loadu_si256((const __m256i*)(g_integrate_mask_32 + phase));
+        __m256i value = _mm256_loadu_si256((const __m256i*)(e + j));
+        __m256i addend = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(e + j + INTEGRATE_FIELD_STRIDE)), mask);
+        value = saturate ? integrate_adds_epi32_avx2(value, addend) : _mm256_add_epi32(value, addend);
+        _mm256_storeu_si256((__m256i*)(e + j), value);
+        phase = (phase + 8) % INTEGRATE_RECORD_FIELDS;
+    }
+    
+    integrate_flat_32(e, j, total, saturate);
+}
+
+__attribute__((target("avx2")))
+static void integrate_records_64_avx2(void* records, size_t count, bool saturate) {
+    uint64_t* e = (uint64_t*)records;
+    size_t total = count * INTEGRATE_RECORD_FIELDS;
+    size_t j = 0;
+    unsigned int phase = 0;
+    
+    for (; j + 4 + INTEGRATE_FIELD_STRIDE <= total; j += 4) {
+        __m256i mask = _mm256_loadu_si256((const __m256i*)(g_integrate_mask_64 + phase));
+        __m256i value = _mm256_loadu_si256((const __m256i*)(e + j));
+        __m256i addend = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(e + j + INTEGRATE_FIELD_STRIDE)), mask);
+        value = saturate ? integrate_adds_epi64_avx2(value, addend) : _mm256_add_epi64(value, addend);
+        _mm256_storeu_si256((__m256i*)(e + j), value);
+        phase = (phase + 4) % INTEGRATE_RECORD_FIELDS;
+    }
+    
+    integrate_flat_64(e, j, total, saturate);
+}
+
+// Variant tables
+static const integrate_table_t g_integrate_tables[INTEGRATE_VARIANT_COUNT] = {
+    [INTEGRATE_VARIANT_GENERIC] = {
+        { integrate_axis_16_generic, integrate_axis_32_generic, integrate_axis_64_generic },
+        { integrate_records_16_generic, integrate_records_32_generic, integrate_records_64_generic }
+    },
+    [INTEGRATE_VARIANT_SSE2] = {
+        { integrate_axis_16_sse2, integrate_axis_32_sse2, integrate_axis_64_sse2 },
+        { integrate_records_16_sse2, integrate_records_32_sse2, integrate_records_64_sse2 }
+    },
+    [INTEGRATE_VARIANT_AVX2] = {
+        { integrate_axis_16_avx2, integrate_axis_32_avx2, integrate_axis_64_avx2 },
+        { integrate_records_16_avx2, integrate_records_32_avx2, integrate_records_64_avx2 }
+    }
+};
+
+static const char* const g_integrate_variant_names[INTEGRATE_VARIANT_COUNT] = {
+    [INTEGRATE_VARIANT_GENERIC] = "generic",
+    [INTEGRATE_VARIANT_SSE2] = "sse2",
+    [INTEGRATE_VARIANT_AVX2] = "avx2"
+};
+
+// Routines state (generic until integrate_init has looked at the CPU)
+static struct {
+    bool initialized;
+    integrate_variant_t variant;
+    bool supported[INTEGRATE_VARIANT_COUNT];
+    integrate_table_t table;
+} g_integrate_state = {
+    false, INTEGRATE_VARIANT_GENERIC, { true },
+    {
+        { integrate_axis_16_generic, integrate_axis_32_generic, integrate_axis_64_generic },
+        { integrate_records_16_generic, integrate_records_32_generic, integrate_records_64_generic }
+    }
+};
+
+/**
+ * Detect the supported variants and select the best one
+ */
+void integrate_init(void) {
+    if (g_integrate_state.initialized) {
+        return;
+    }
+    
+    for (unsigned int i = 0; i < INTEGRATE_MASK_LENGTH; i++) {
+        bool added = i % INTEGRATE_RECORD_FIELDS < 2 * INTEGRATE_FIELD_STRIDE;
+        g_integrate_mask_16[i] = added ? 0xFFFF : 0;
+        g_integrate_mask_32[i] = added ? 0xFFFFFFFFu : 0;
+        g_integrate_mask_64[i] = added ? 0xFFFFFFFFFFFFFFFFULL : 0;
+    }
+    
+    cpu_info_t cpu_info = {0};
+    cpu_detect(&cpu_info);
+    
+    g_integrate_state.supported[INTEGRATE_VARIANT_GENERIC] = true;
+    g_integrate_state.supported[INTEGRATE_VARIANT_SSE2] = cpu_info.features.sse2;
+    g_integrate_state.supported[INTEGRATE_VARIANT_AVX2] = cpu_info.features.avx2 && cpu_avx_usable(&cpu_info);
+    
+    for (int variant = INTEGRATE_VARIANT_COUNT - 1; variant >= 0; variant--) {
+        if (integrate_set_variant((integrate_variant_t)variant) == 0) {
+            break;
+        }
+    }
+    
+    g_integrate_state.initialized = true;
+}
+
+/**
+ * Check whether this CPU can run a variant
+ */
+bool integrate_variant_supported(integrate_variant_t variant) {
+    return variant < INTEGRATE_VARIANT_COUNT && g_integrate_state.supported[variant];
+}
+
+/**
+ * Switch all routines to a variant
+ */
+int integrate_set_variant(integrate_variant_t variant) {
+    if (!integrate_variant_supported(variant)) {
+        return -1;
+    }
+    
+    g_integrate_state.variant = variant;
+    g_integrate_state.table = g_integrate_tables[variant];
+    return 0;
+}
+
+/**
+ * Get the selected variant
+ */
+integrate_variant_t integrate_get_variant(void) {
+    return g_integrate_state.variant;
+}
+
+/**
+ * Get a variant's name
+ */
+const char* integrate_variant_name(integrate_variant_t variant) {
+    return variant < INTEGRATE_VARIANT_COUNT ? g_integrate_variant_names[variant] : "unknown";
+}
+
+/**
+ * Array-of-structs steps
+ */
+void integrate_aos_16(physics_vector_16_t* vectors, size_t count, integrate_mode_t mode) {
+    if (!vectors || count == 0) return;
+    g_integrate_state.table.records[0](vectors, count, mode == INTEGRATE_SATURATE);
+}
+
+void integrate_aos_32(physics_vector_32_t* vectors, size_t count, integrate_mode_t mode) {
+    if (!vectors || count == 0) return;
+    g_integrate_state.table.records[1](vectors, count, mode == INTEGRATE_SATURATE);
+}
+
+void integrate_aos_64(physics_vector_64_t* vectors, size_t count, integrate_mode_t mode) {
+    if (!vectors || count == 0) return;
+    g_integrate_state.table.records[2](vectors, count, mode == INTEGRATE_SATURATE);
+}
+
+/**
+ * SoA steps (one pass per axis)
+ */
+int integrate_soa_16(physics_soa_16_t* soa, size_t first, size_t count, integrate_mode_t mode) {
+    if (!soa || first > soa->count || count > soa->count - first) return -1;
+    if (count == 0) return 0;
+    
+    integrate_axis_t axis = g_integrate_state.table.axis[0];
+    bool saturate = mode == INTEGRATE_SATURATE;
+    axis(soa->x + first, soa->vx + first, soa->ax + first, count, saturate);
+    axis(soa->y + first, soa->vy + first, soa->ay + first, count, saturate);
+    axis(soa->z + first, soa->vz + first, soa->az + first, count, saturate);
+    return 0;
+}
+
+int integrate_soa_32(physics_soa_32_t* soa, size_t first, size_t count, integrate_mode_t mode) {
+    if (!soa || first > soa->count || count > soa->count - first) return -1;
+    if (count == 0) return 0;
+    
+    integrate_axis_t axis = g_integrate_state.table.axis[1];
+    bool saturate = mode == INTEGRATE_SATURATE;
+    axis(soa->x + first, soa->vx + first, soa->ax + first, count, saturate);
+    axis(soa->y + first, soa->vy + first, soa->ay + first, count, saturate);
+    axis(soa->z + first, soa->vz + first, soa->az + first, count, saturate);
+    return 0;
+}
+
+int integrate_soa_64(physics_soa_64_t* soa, size_t first, size_t count, integrate_mode_t mode) {
+    if (!soa || first > soa->count || count > soa->count - first) return -1;
+    if (count == 0) return 0;
+    
+    integrate_axis_t axis = g_integrate_state.table.axis[2];
+    bool saturate = mode == INTEGRATE_SATURATE;
+    axis(soa->x + first, soa->vx + first, soa->ax + first, count, saturate);
+    axis(soa->y + first, soa->vy + first, soa->ay + first, count, saturate);
+    axis(soa->z + first, soa->vz + first, soa->az + first, count, saturate);
+    return 0;
+}
+
+/**
+ * Partition a range into granule-aligned parts, spreading the leftover
+ * granules over the first parts
+ */
+void integrate_partition(size_t count, uint32_t part, uint32_t parts, size_t* first, size_t* range_count) {
+    if (!first || !range_count) return;
+    
+    if (parts == 0 || part >= parts) {
+        *first = count;
+        *range_count = 0;
+        return;
+    }
+    
+    size_t granules = count / INTEGRATE_PARTITION_GRANULE + (count % INTEGRATE_PARTITION_GRANULE != 0);
+    size_t share = granules / parts;
+    size_t extra = granules % parts;
+    size_t start = part * share + (part < extra ? part : extra);
+    size_t end = start + share + (part < extra ? 1 : 0);
+    
+    start *= INTEGRATE_PARTITION_GRANULE;
+    end *= INTEGRATE_PARTITION_GRANULE;
+    *first = start < count ? start : count;
+    *range_count = (end < count ? end : count) - *first;
+}
@@ -0,0 +1,62 @@
+/**
+ * CompileOS Physics Integration Routines - Header
+ *
+ * One explicit Euler step (position += velocity, then velocity +=
+ * acceleration) over batches of 16-, 32- or 64-bit physics vectors, in
+ * either the array-of-structs physics_vector layout or the SoA containers.
+ * Components are two's-complement fixed-point values held in the unsigned
+ * fields, so the arithmetic either wraps or saturates to the signed range.
+ * SSE2 and AVX2 variants are selected at boot from the CPU feature bits.
+ */
+
+#ifndef INTEGRATE_H
+#define INTEGRATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "multibit.h"
+#include "physics.h"
+
+// Range granule in entities for integrate_partition (a multiple of
+// PHYSICS_SOA_GRANULE, and 64 records of any width fill whole cache lines)
+#define INTEGRATE_PARTITION_GRANULE 64
+
+// Routine variants
+typedef enum {
+    INTEGRATE_VARIANT_GENERIC,
+    INTEGRATE_VARIANT_SSE2,
+    INTEGRATE_VARIANT_AVX2,
+    INTEGRATE_VARIANT_COUNT
+} integrate_variant_t;
+
+// Overflow behaviour
+typedef enum {
+    INTEGRATE_WRAP,         // Modular arithmetic
+    INTEGRATE_SATURATE      // Clamp to the signed range of the width
+} integrate_mode_t;
+
+// Variant selection (init picks the best variant the CPU supports)
+void integrate_init(void);
+bool integrate_variant_supported(integrate_variant_t variant);
+int integrate_set_variant(integrate_variant_t variant);
+integrate_variant_t integrate_get_variant(void);
+const char* integrate_variant_name(integrate_variant_t variant);
+
+// Array-of-structs step over count vectors
+void integrate_aos_16(physics_vector_16_t* vectors, size_t count, integrate_mode_t mode);
+void integrate_aos_32(physics_vector_32_t* vectors, size_t count, integrate_mode_t mode);
+void integrate_aos_64(physics_vector_64_t* vectors, size_t count, integrate_mode_t mode);
+
+// SoA step over entities first .. first + count - 1 (returns -1 when the
+// range is outside the container)
+int integrate_soa_16(physics_soa_16_t* soa, size_t first, size_t count, integrate_mode_t mode);
+int integrate_soa_32(physics_soa_32_t* soa, size_t first, size_t count, integrate_mode_t mode);
+int integrate_soa_64(physics_soa_64_t* soa, size_t first, size_t count, integrate_mode_t mode);
+
+// Partitioning helper: range part of parts of count entities. Ranges start
+// on granule boundaries and share no cache line. Nothing here schedules
+// them; every step above runs on the calling CPU over the range it is given.
+void integrate_partition(size_t count, uint32_t part, uint32_t parts, size_t* first, size_t* range_count);
+
+#endif // INTEGRATE_H
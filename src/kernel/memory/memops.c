@@ -0,0 +1,599 @@
+/**
+ * CompileOS Memory Routines - Implementation
+ *
+ * The kernel is built freestanding, so there is no tuned libc behind
+ * memcpy and friends. These routines cover the common x86_64 cases: plain
+ * 64-bit words, SSE2 and AVX2 vector loops, and ERMS rep movsb/stosb for
+ * medium and large copies. Large copies and fills switch to non-temporal
+ * stores so they do not flush the working set out of the cache.
+ */
+
+#include "memops.h"
+#include "../../hal/arch/x86_64/cpu.h"
+#include <immintrin.h>
+
+// Unaligned, aliasing word access for the scalar paths
+typedef uint64_t memops_u64_t __attribute__((may_alias, aligned(1)));
+typedef uint32_t memops_u32_t __attribute__((may_alias, aligned(1)));
+
+// Dispatch table
+typedef struct {
+    void* (*copy)(void* dest, const void* src, size_t n);
+    void* (*set)(void* s, int c, size_t n);
+    int (*compare)(const void* s1, const void* s2, size_t n);
+} memops_table_t;
+
+static void* memops_copy_generic(void* dest, const void* src, size_t n);
+static void* memops_set_generic(void* s, int c, size_t n);
+static int memops_compare_generic(const void* s1, const void* s2, size_t n);
+
+// Routines state (generic until memops_init has looked at the CPU)
+static struct {
+    bool initialized;
+    memops_variant_t variant;
+    bool supported[MEMOPS_VARIANT_COUNT];
+    size_t nt_threshold;
+    memops_table_t table;
+    memops_table_t vector;  // Widest vector routines, used by ERMS for small sizes
+    void* (*stream_set)(void* s, int c, size_t n);
+} g_memops_state = {
+    false, MEMOPS_VARIANT_GENERIC, { true }, MEMOPS_DEFAULT_NT_THRESHOLD,
+    { memops_copy_generic, memops_set_generic, memops_compare_generic },
+    { memops_copy_generic, memops_set_generic, memops_compare_generic },
+    memops_set_generic
+};
+
+/**
+ * Copy fewer than 16 bytes with overlapping word moves
+ */
+static inline void memops_copy_small(char* d, const char* s, size_t n) {
+    if (n >= 8) {
+        uint64_t head = *(const memops_u64_t*)s;
+        uint64_t tail = *(const memops_u64_t*)(s + n - 8);
+        *(memops_u64_t*)d = head;
+        *(memops_u64_t*)(d + n - 8) = tail;
+    } else if (n >= 4) {
+        uint32_t head = *(const memops_u32_t*)s;
+        uint32_t tail = *(const memops_u32_t*)(s + n - 4);
+        *(memops_u32_t*)d = head;
+        *(memops_u32_t*)(d + n - 4) = tail;
+    } else if (n) {
+        char first = s[0], middle = s[n / 2], last = s[n - 1];
+        d[0] = first;
+        d[n / 2] = middle;
+        d[n - 1] = last;
+    }
+}
+
+/**
+ * Fill fewer than 16 bytes with overlapping word stores
+ */
+static inline void memops_set_small(char* d, uint64_t pattern, size_t n) {
+    if (n >= 8) {
+        *(memops_u64_t*)d = pattern;
+        *(memops_u64_t*)(d + n - 8) = pattern;
+    } else if (n >= 4) {
+        *(memops_u32_t*)d = (uint32_t)pattern;
+        *(memops_u32_t*)(d + n - 4) = (uint32_t)pattern;
+    } else if (n) {
+        d[0] = (char)pattern;
+        d[n / 2] = (char)pattern;
+        d[n - 1] = (char)pattern;
+    }
+}
+
+/**
+ * Compare bytes one at a time
+ */
+static inline int memops_compare_bytes(const unsigned char* a, const unsigned char* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) {
+            return a[i] - b[i];
+        }
+    }
+    return 0;
+}
+
+// Generic (64-bit words)
+
+static void* memops_copy_generic(void* dest, const void* src, size_t n) {
+    char* d = dest;
+    const char* s = src;
+    
+    for (; n >= 16; n -= 16, d += 16, s += 16) {
+        uint64_t a = *(const memops_u64_t*)s;
+        uint64_t b = *(const memops_u64_t*)(s + 8);
+        *(memops_u64_t*)d = a;
+        *(memops_u64_t*)(d + 8) = b;
+    }
+    memops_copy_small(d, s, n);
+    
+    return dest;
+}
+
+static void* memops_set_generic(void* s, int c, size_t n) {
+    char* d = s;
+    uint64_t pattern = 0x0101010101010101ULL * (unsigned char)c;
+    
+    for (; n >= 16; n -= 16, d += 16) {
+        *(memops_u64_t*)d = pattern;
+        *(memops_u64_t*)(d + 8) = pattern;
+    }
+    memops_set_small(d, pattern, n);
+    
+    return s;
+}
+
+static int memops_compare_generic(const void* s1, const void* s2, size_t n) {
+    const unsigned char* a = s1;
+    const unsigned char* b = s2;
+    
+    // Skip equal words, then find the differing byte
+    for (; n >= 8; n -= 8, a += 8, b += 8) {
+        if (*(const memops_u64_t*)a != *(const memops_u64_t*)b) {
+            return memops_compare_bytes(a, b, 8);
+        }
+    }
+    return memops_compare_bytes(a, b, n);
+}
+
+// SSE2 (16-byte vectors)
+
+/**
+ * Copy with streaming stores: one unaligned head store, aligned
+ * non-temporal stores for the body, then a fence and an unaligned tail
+ */
+static void memops_copy_nt_sse2(char* d, const char* s, size_t n) {
+    __m128i head = _mm_loadu_si128((const __m128i*)s);
+    _mm_storeu_si128((__m128i*)d, head);
+    
+    size_t i = 16 - ((uintptr_t)d & 15);
+    for (; i + 64 <= n; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(s + i + 32));
+        __m128i e = _mm_loadu_si128((const __m128i*)(s + i + 48));
+        _mm_stream_si128((__m128i*)(d + i), a);
+        _mm_stream_si128((__m128i*)(d + i + 16), b);
+        _mm_stream_si128((__m128i*)(d + i + 32), c);
+        _mm_stream_si128((__m128i*)(d + i + 48), e);
+    }
+    for (; i + 16 <= n; i += 16) {
+        _mm_stream_si128((__m128i*)(d + i), _mm_loadu_si128((const __m128i*)(s + i)));
+    }
+    _mm_sfence();
+    
+    _mm_storeu_si128((__m128i*)(d + n - 16), _mm_loadu_si128((const __m128i*)(s + n - 16)));
+}
+
+static void* memops_copy_sse2(void* dest, const void* src, size_t n) {
+    char* d = dest;
+    const char* s = src;
+    
+    if (n < 16) {
+        memops_copy_small(d, s, n);
+        return dest;
+    }
+    if (n >= g_memops_state.nt_threshold) {
+        memops_copy_nt_sse2(d, s, n);
+        return dest;
+    }
+    
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(s + i + 32));
+        __m128i e = _mm_loadu_si128((const __m128i*)(s + i + 48));
+        _mm_storeu_si128((__m128i*)(d + i), a);
+        _mm_storeu_si128((__m128i*)(d + i + 16), b);
+        _mm_storeu_si128((__m128i*)(d + i + 32), c);
+        _mm_storeu_si128((__m128i*)(d + i + 48), e);
+    }
+    for (; i + 16 <= n; i += 16) {
+        _mm_storeu_si128((__m128i*)(d + i), _mm_loadu_si128((const __m128i*)(s + i)));
+    }
+    
+    // The last vector overlaps bytes already copied instead of a byte loop
+    _mm_storeu_si128((__m128i*)(d + n - 16), _mm_loadu_si128((const __m128i*)(s + n - 16)));
+    return dest;
+}
+
+static void memops_set_nt_sse2(char* d, __m128i v, size_t n) {
+    _mm_storeu_si128((__m128i*)d, v);
+    
+    size_t i = 16 - ((uintptr_t)d & 15);
+    for (; i + 64 <= n; i += 64) {
+        _mm_stream_si128((__m128i*)(d + i), v);
+        _mm_stream_si128((__m128i*)(d + i + 16), v);
+        _mm_stream_si128((__m128i*)(d + i + 32), v);
+        _mm_stream_si128((__m128i*)(d + i + 48), v);
+    }
+    for (; i + 16 <= n; i += 16) {
+        _mm_stream_si128((__m128i*)(d + i), v);
+    }
+    _mm_sfence();
+    
+    _mm_storeu_si128((__m128i*)(d + n - 16), v);
+}
+
+static void* memops_set_sse2(void* s, int c, size_t n) {
+    char* d = s;
+    
+    if (n < 16) {
+        memops_set_small(d, 0x0101010101010101ULL * (unsigned char)c, n);
+        return s;
+    }
+    
+    __m128i v = _mm_set1_epi8((char)c);
+    if (n >= g_memops_state.nt_threshold) {
+        memops_set_nt_sse2(d, v, n);
+        return s;
+    }
+    
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        _mm_storeu_si128((__m128i*)(d + i), v);
+        _mm_storeu_si128((__m128i*)(d + i + 16), v);
+        _mm_storeu_si128((__m128i*)(d + i + 32), v);
+        _mm_storeu_si128((__m128i*)(d + i + 48), v);
+    }
+    for (; i + 16 <= n; i += 16) {
+        _mm_storeu_si128((__m128i*)(d + i), v);
+    }
+    _mm_storeu_si128((__m128i*)(d + n - 16), v);
+    
+    return s;
+}
+
+static void* memops_stream_set_sse2(void* s, int c, size_t n) {
+    memops_set_nt_sse2(s, _mm_set1_epi8((char)c), n);
+    return s;
+}
+
+static int memops_compare_sse2(const void* s1, const void* s2, size_t n) {
+    const unsigned char* a = s1;
+    const unsigned char* b = s2;
+    
+    if (n < 16) {
+        return memops_compare_generic(a, b, n);
+    }
+    
+    size_t i = 0;
+    for (;;) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)),
+                                    _mm_loadu_si128((const __m128i*)(b + i)));
+        unsigned int diff = ~(unsigned int)_mm_movemask_epi8(eq) & 0xFFFF;
+        if (diff) {
+            size_t at = i + (size_t)__builtin_ctz(diff);
+            return a[at] - b[at];
+        }
+        
+        if (i + 16 == n) {
+            return 0;
+        }
+        
+        // Finish with a vector that ends exactly at n (its overlap is known equal)
+        i = i + 32 <= n ? i + 16 : n - 16;
+    }
+}
+
+// AVX2 (32-byte vectors)
+
+__attribute__((target("avx2")))
+static void memops_copy_nt_avx2(char* d, const char* s, size_t n) {
+    _mm256_storeu_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+    
+    size_t i = 32 - ((uintptr_t)d & 31);
+    for (; i + 128 <= n; i += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(s + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(s + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(s + i + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i*)(s + i + 96));
+        _mm256_stream_si256((__m256i*)(d + i), a);
+        _mm256_stream_si256((__m256i*)(d + i + 32), b);
+        _mm256_stream_si256((__m256i*)(d + i + 64), c);
+        _mm256_stream_si256((__m256i*)(d + i + 96), e);
+    }
+    for (; i + 32 <= n; i += 32) {
+        _mm256_stream_si256((__m256i*)(d + i), _mm256_loadu_si256((const __m256i*)(s + i)));
+    }
+    _mm_sfence();
+    
+    _mm256_storeu_si256((__m256i*)(d + n - 32), _mm256_loadu_si256((const __m256i*)(s + n - 32)));
+}
+
+__attribute__((target("avx2")))
+static void* memops_copy_avx2(void* dest, const void* src, size_t n) {
+    char* d = dest;
+    const char* s = src;
+    
+    if (n < 32) {
+        if (n >= 16) {
+            __m128i head = _mm_loadu_si128((const __m128i*)s);
+            __m128i tail = _mm_loadu_si128((const __m128i*)(s + n - 16));
+            _mm_storeu_si128((__m128i*)d, head);
+            _mm_storeu_si128((__m128i*)(d + n - 16), tail);
+        } else {
+            memops_copy_small(d, s, n);
+        }
+        return dest;
+    }
+    
+    if (n >= g_memops_state.nt_threshold) {
+        memops_copy_nt_avx2(d, s, n);
+    } else {
+        size_t i = 0;
+        for (; i + 128 <= n; i += 128) {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(s + i));
+            __m256i b = _mm256_loadu_si256((const __m256i*)(s + i + 32));
+            __m256i c = _mm256_loadu_si256((const __m256i*)(s + i + 64));
+            __m256i e = _mm256_loadu_si256((const __m256i*)(s + i + 96));
+            _mm256_storeu_si256((__m256i*)(d + i), a);
+            _mm256_storeu_si256((__m256i*)(d + i + 32), b);
+            _mm256_storeu_si256((__m256i*)(d + i + 64), c);
+            _mm256_storeu_si256((__m256i*)(d + i + 96), e);
+        }
+        for (; i + 32 <= n; i += 32) {
+            _mm256_storeu_si256((__m256i*)(d + i), _mm256_loadu_si256((const __m256i*)(s + i)));
+        }
+        _mm256_storeu_si256((__m256i*)(d + n - 32), _mm256_loadu_si256((const __m256i*)(s + n - 32)));
+    }
+    
+    // Avoid the SSE/AVX transition penalty in the caller
+    _mm256_zeroupper();
+    return dest;
+}
+
+__attribute__((target("avx2")))
+static void memops_set_nt_avx2(char* d, __m256i v, size_t n) {
+    _mm256_storeu_si256((__m256i*)d, v);
+    
+    size_t i = 32 - ((uintptr_t)d & 31);
+    for (; i + 128 <= n; i += 128) {
+        _mm256_stream_si256((__m256i*)(d + i), v);
+        _mm256_stream_si256((__m256i*)(d + i + 32), v);
+        _mm256_stream_si256((__m256i*)(d + i + 64), v);
+        _mm256_stream_si256((__m256i*)(d + i + 96), v);
+    }
+    for (; i + 32 <= n; i += 32) {
+        _mm256_stream_si256((__m256i*)(d + i), v);
+    }
+    _mm_sfence();
+    
+    _mm256_storeu_si256((__m256i*)(d + n - 32), v);
+}
+
+__attribute__((target("avx2")))
+static void* memops_set_avx2(void* s, int c, size_t n) {
+    char* d = s;
+    
+    if (n < 32) {
+        if (n >= 16) {
+            __m128i v = _mm_set1_epi8((char)c);
+            _mm_storeu_si128((__m128i*)d, v);
+            _mm_storeu_si128((__m128i*)(d + n - 16), v);
+        } else {
+            memops_set_small(d, 0x0101010101010101ULL * (unsigned char)c, n);
+        }
+        return s;
+    }
+    
+    __m256i v = _mm256_set1_epi8((char)c);
+    if (n >= g_memops_state.nt_threshold) {
+        memops_set_nt_avx2(d, v, n);
+    } else {
+        size_t i = 0;
+        for (; i + 128 <= n; i += 128) {
+            _mm256_storeu_si256((__m256i*)(d + i), v);
+            _mm256_storeu_si256((__m256i*)(d + i + 32), v);
+            _mm256_storeu_si256((__m256i*)(d + i + 64), v);
+            _mm256_storeu_si256((__m256i*)(d + i + 96), v);
+        }
+        for (; i + 32 <= n; i += 32) {
+            _mm256_storeu_si256((__m256i*)(d + i), v);
+        }
+        _mm256_storeu_si256((__m256i*)(d + n - 32), v);
+    }
+    
+    _mm256_zeroupper();
+    return s;
+}
+
+__attribute__((target("avx2")))
+static void* memops_stream_set_avx2(void* s, int c, size_t n) {
+    memops_set_nt_avx2(s, _mm256_set1_epi8((char)c), n);
+    _mm256_zeroupper();
+    return s;
+}
+
+__attribute__((target("avx2")))
+static int memops_compare_avx2(const void* s1, const void* s2, size_t n) {
+    const unsigned char* a = s1;
+    const unsigned char* b = s2;
+    
+    if (n < 32) {
+        return memops_compare_sse2(a, b, n);
+    }
+    
+    int result = 0;
+    size_t i = 0;
+    for (;;) {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                       _mm256_loadu_si256((const __m256i*)(b + i)));
+        unsigned int diff = ~(unsigned int)_mm256_movemask_epi8(eq);
+        if (diff) {
+            size_t at = i + (size_t)__builtin_ctz(diff);
+            result = a[at] - b[at];
+            break;
+        }
+        
+        if (i + 32 == n) {
+            break;
+        }
+        i = i + 64 <= n ? i + 32 : n - 32;
+    }
+    
+    _mm256_zeroupper();
+    return result;
+}
+
+// ERMS (rep movsb / rep stosb, vector routines for small and streaming sizes)
+
+static void* memops_copy_erms(void* dest, const void* src, size_t n) {
+    if (n < MEMOPS_ERMS_THRESHOLD || n >= g_memops_state.nt_threshold) {
+        return g_memops_state.vector.copy(dest, src, n);
+    }
+    
+    void* d = dest;
+    __asm__ volatile ("rep movsb" : "+D" (d), "+S" (src), "+c" (n) : : "memory");
+    return dest;
+}
+
+static void* memops_set_erms(void* s, int c, size_t n) {
+    if (n < MEMOPS_ERMS_THRESHOLD || n >= g_memops_state.nt_threshold) {
+        return g_memops_state.vector.set(s, c, n);
+    }
+    
+    void* d = s;
+    __asm__ volatile ("rep stosb" : "+D" (d), "+c" (n) : "a" (c) : "memory");
+    return s;
+}
+
+static int memops_compare_erms(const void* s1, const void* s2, size_t n) {
+    // repe cmpsb is not fast-pathed by ERMS; compare with vectors
+    return g_memops_state.vector.compare(s1, s2, n);
+}
+
+// Variant tables
+static const memops_table_t g_memops_tables[MEMOPS_VARIANT_COUNT] = {
+    [MEMOPS_VARIANT_GENERIC] = { memops_copy_generic, memops_set_generic, memops_compare_generic },
+    [MEMOPS_VARIANT_SSE2] = { memops_copy_sse2, memops_set_sse2, memops_compare_sse2 },
+    [MEMOPS_VARIANT_AVX2] = { memops_copy_avx2, memops_set_avx2, memops_compare_avx2 },
+    [MEMOPS_VARIANT_ERMS] = { memops_copy_erms, memops_set_erms, memops_compare_erms }
+};
+
+static const char* const g_memops_variant_names[MEMOPS_VARIANT_COUNT] = {
+    [MEMOPS_VARIANT_GENERIC] = "generic",
+    [MEMOPS_VARIANT_SSE2] = "sse2",
+    [MEMOPS_VARIANT_AVX2] = "avx2",
+    [MEMOPS_VARIANT_ERMS] = "erms"
+};
+
+/**
+ * Detect the supported variants and select the best one
+ */
+void memops_init(void) {
+    if (g_memops_state.initialized) {
+        return;
+    }
+    
+    cpu_info_t cpu_info = {0};
+    cpu_detect(&cpu_info);
+    
+    g_memops_state.supported[MEMOPS_VARIANT_GENERIC] = true;
+    g_memops_state.supported[MEMOPS_VARIANT_SSE2] = cpu_info.features.sse2;
+    g_memops_state.supported[MEMOPS_VARIANT_AVX2] = cpu_info.features.avx2 && cpu_avx_usable(&cpu_info);
+    g_memops_state.supported[MEMOPS_VARIANT_ERMS] = cpu_info.features.erms;
+    
+    // ERMS hands small and streaming sizes to the widest vector routines
+    if (g_memops_state.supported[MEMOPS_VARIANT_AVX2]) {
+        g_memops_state.vector = g_memops_tables[MEMOPS_VARIANT_AVX2];
+        g_memops_state.stream_set = memops_stream_set_avx2;
+    } else if (g_memops_state.supported[MEMOPS_VARIANT_SSE2]) {
+        g_memops_state.vector = g_memops_tables[MEMOPS_VARIANT_SSE2];
+        g_memops_state.stream_set = memops_stream_set_sse2;
+    }
+    
+    static const memops_variant_t preference[] = {
+        MEMOPS_VARIANT_ERMS, MEMOPS_VARIANT_AVX2, MEMOPS_VARIANT_SSE2, MEMOPS_VARIANT_GENERIC
+    };
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+        if (memops_set_variant(preference[i]) == 0) {
+            break;
+        }
+    }
+    
+    g_memops_state.initialized = true;
+}
+
+/**
+ * Check whether this CPU can run a variant
+ */
+bool memops_variant_supported(memops_variant_t variant) {
+    return variant < MEMOPS_VARIANT_COUNT && g_memops_state.supported[variant];
+}
+
+/**
+ * Switch all routines to a variant
+ */
+int memops_set_variant(memops_variant_t variant) {
+    if (!memops_variant_supported(variant)) {
+        return -1;
+    }
+    
+    g_memops_state.variant = variant;
+    g_memops_state.table = g_memops_tables[variant];
+    return 0;
+}
+
+/**
+ * Get the selected variant
+ */
+memops_variant_t memops_get_variant(void) {
+    return g_memops_state.variant;
+}
+
+/**
+ * Get a variant's name
+ */
+const char* memops_variant_name(memops_variant_t variant) {
+    return variant < MEMOPS_VARIANT_COUNT ? g_memops_variant_names[variant] : "unknown";
+}
+
+/**
+ * Set the size from which copies and fills bypass the cache
+ */
+void memops_set_nt_threshold(size_t bytes) {
+    // The streaming paths need room for an unaligned head and tail vector
+    g_memops_state.nt_threshold = bytes < 256 ? 256 : bytes;
+}
+
+/**
+ * Get the non-temporal store threshold
+ */
+size_t memops_get_nt_threshold(void) {
+    return g_memops_state.nt_threshold;
+}
+
+/**
+ * Copy n bytes
+ */
+void* memops_copy(void* dest, const void* src, size_t n) {
+    return g_memops_state.table.copy(dest, src, n);
+}
+
+/**
+ * Fill n bytes
+ */
+void* memops_set(void* s, int c, size_t n) {
+    return g_memops_state.table.set(s, c, n);
+}
+
+/**
+ * Compare n bytes
+ */
+int memops_compare(const void* s1, const void* s2, size_t n) {
+    return g_memops_state.table.compare(s1, s2, n);
+}
+
+/**
+ * Fill n bytes with non-temporal stores
+ */
+void* memops_set_nt(void* s, int c, size_t n) {
+    // The streaming paths need room for an unaligned head and tail vector
+    if (n < 256) {
+        return memops_set(s, c, n);
+    }
+    return g_memops_state.stream_set(s, c, n);
+}
@@ -0,0 +1,49 @@
+/**
+ * CompileOS Memory Routines - Header
+ *
+ * Copy, fill and compare routines with SSE2, AVX2 and ERMS (rep movsb)
+ * variants, one of which is selected at boot from the CPU feature bits
+ */
+
+#ifndef MEMOPS_H
+#define MEMOPS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Copies and fills at least this large use non-temporal stores by default
+#define MEMOPS_DEFAULT_NT_THRESHOLD (4 * 1024 * 1024)
+
+// Below this size the ERMS variant uses vector moves (rep movsb has a startup cost)
+#define MEMOPS_ERMS_THRESHOLD 2048
+
+// Routine variants
+typedef enum {
+    MEMOPS_VARIANT_GENERIC,
+    MEMOPS_VARIANT_SSE2,
+    MEMOPS_VARIANT_AVX2,
+    MEMOPS_VARIANT_ERMS,
+    MEMOPS_VARIANT_COUNT
+} memops_variant_t;
+
+// Variant selection (init picks the best variant the CPU supports)
+void memops_init(void);
+bool memops_variant_supported(memops_variant_t variant);
+int memops_set_variant(memops_variant_t variant);
+memops_variant_t memops_get_variant(void);
+const char* memops_variant_name(memops_variant_t variant);
+
+// Non-temporal store threshold in bytes (SIZE_MAX disables streaming)
+void memops_set_nt_threshold(size_t bytes);
+size_t memops_get_nt_threshold(void);
+
+// Routines (dest and src must not overlap)
+void* memops_copy(void* dest, const void* src, size_t n);
+void* memops_set(void* s, int c, size_t n);
+int memops_compare(const void* s1, const void* s2, size_t n);
+
+// Fill with non-temporal stores whatever the size (for memory not needed soon)
+void* memops_set_nt(void* s, int c, size_t n);
+
+#endif // MEMOPS_H
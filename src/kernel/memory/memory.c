@@ -5,7 +5,10 @@
  */
 
 #include "memory.h"
+#include "page.h"
+#include "memops.h"
 #include "../kernel.h"
+#include "../spinlock.h"
 #include "../../hal/hal.h"
 #include <string.h>
 
@@ -19,69 +22,853 @@ static struct {
     uint64_t heap_start;
     uint64_t heap_end;
     uint64_t heap_current;
+    uint64_t blocks_visited;
+    uint64_t max_blocks_visited;
+    uint64_t insert_blocks_visited;
+    uint64_t heap_grows;
+    uint64_t coalesce_next;
+    uint64_t coalesce_prev;
+    uint64_t free_blocks;
+    uint64_t free_bytes;
+    uint64_t large_alloc_calls;
+    uint64_t large_allocations;
+    uint64_t large_bytes;
 } g_memory_state = {0};
 
 // Memory block header
 typedef struct memory_block {
     size_t size;
     bool is_free;
+    bool cached;            // Parked in a per-CPU magazine or remote free list
+    uint16_t owner;         // CPU whose magazine a small block returns to
     struct memory_block* next;
     struct memory_block* prev;
 } memory_block_t;
 
+// Free-list links, stored in the payload of free blocks so the header stays small
+typedef struct {
+    memory_block_t* next;
+    memory_block_t* prev;
+} memory_free_links_t;
+
+#define MEMORY_FREE_LINKS(block) ((memory_free_links_t*)((char*)(block) + sizeof(memory_block_t)))
+
+// Size classes: exact 8-byte classes below MEMORY_SMALL_LIMIT, one class per
+// power of two above it (kept sorted by size so the first fit is the best fit)
+#define MEMORY_ALIGNMENT 8
+#define MEMORY_MIN_BLOCK_SIZE sizeof(memory_free_links_t)
+#define MEMORY_SMALL_LIMIT 512
+#define MEMORY_SMALL_BIN_COUNT (MEMORY_SMALL_LIMIT / MEMORY_ALIGNMENT)
+#define MEMORY_SMALL_LIMIT_SHIFT 9
+#define MEMORY_LARGE_BIN_COUNT (64 - MEMORY_SMALL_LIMIT_SHIFT)
+#define MEMORY_BIN_COUNT (MEMORY_SMALL_BIN_COUNT + MEMORY_LARGE_BIN_COUNT)
+#define MEMORY_BITMAP_WORDS ((MEMORY_BIN_COUNT + 63) / 64)
+
+// Blocks checked in the requested size classes before falling back to a
+// class where any block is guaranteed to hold an aligned payload
+#define MEMORY_ALIGNED_SCAN_LIMIT 32
+
+// The heap grows in chunks of at least 2 MB taken from the page allocator
+#define MEMORY_HEAP_CHUNK_ORDER PAGE_ORDER_2MB
+
+// Requests of at least this size bypass the heap and take whole pages
+#define MEMORY_LARGE_THRESHOLD (128 * 1024)
+
+// Large allocation table entry (open addressing, address 0 marks an empty slot)
+typedef struct {
+    uintptr_t address;
+    size_t pages;
+} memory_large_entry_t;
+
+#define MEMORY_LARGE_TABLE_MIN_ORDER 0
+
+// Per-CPU magazines: blocks below MEMORY_SMALL_LIMIT are cached per CPU and
+// per size class, and move to and from the heap in batches
+#define MEMORY_MAGAZINE_BATCH 16
+#define MEMORY_MAGAZINE_LIMIT 32
+
+// Magazine (singly linked through the free-list links)
+typedef struct {
+    memory_block_t* head;
+    uint32_t count;
+} memory_magazine_t;
+
+// Per-CPU allocator cache; only its own CPU touches it, with interrupts off,
+// except for the remote free list which other CPUs push onto lock-free
+typedef struct {
+    memory_magazine_t magazines[MEMORY_SMALL_BIN_COUNT];
+    uint64_t cached_bytes;
+    uint64_t alloc_calls;
+    uint64_t free_calls;
+    uint64_t realloc_calls;
+    uint64_t realloc_grown_in_place;
+    uint64_t realloc_shrunk_in_place;
+    uint64_t realloc_copies;
+    uint64_t magazine_hits;
+    uint64_t magazine_refills;
+    uint64_t magazine_drains;
+    uint64_t remote_frees;
+    uint64_t alloc_size_histogram[MEMORY_STATS_SIZE_CLASSES];
+    
+    struct {
+        memory_block_t* head;
+        uint64_t bytes;
+    } remote __attribute__((aligned(64)));
+} __attribute__((aligned(64))) memory_cpu_cache_t;
+
+static memory_cpu_cache_t g_cpu_caches[HAL_MAX_CPUS];
+
+// Protects the heap, its size classes, the large allocation table and the
+// global counters; always taken with interrupts off
+static spinlock_t g_heap_lock = SPINLOCK_INIT;
+
 // Heap management
 static memory_block_t* g_heap_head = NULL;
 static memory_block_t* g_heap_tail = NULL;
+static memory_block_t* g_heap_bins[MEMORY_BIN_COUNT];
+static uint64_t g_heap_bin_bitmap[MEMORY_BITMAP_WORDS];
+static uint64_t g_heap_bin_counts[MEMORY_BIN_COUNT];
+
+// Large allocations
+static memory_large_entry_t* g_large_table = NULL;
+static size_t g_large_table_capacity = 0;
+static unsigned int g_large_table_order = 0;
+static unsigned int g_large_table_shift = 0;
 
 /**
- * Initialize memory management
+ * Map a size to its statistics histogram bucket
  */
-int memory_init(void) {
-    if (g_memory_state.initialized) {
+static size_t memory_stats_bucket(size_t size) {
+    if (size < 32) {
         return 0;
     }
     
-    // Get memory map from HAL
-    memory_region_t regions[32];
-    size_t actual_count;
+    size_t bucket = (size_t)(63 - __builtin_clzll((unsigned long long)size)) - 4;
+    return bucket < MEMORY_STATS_SIZE_CLASSES ? bucket : MEMORY_STATS_SIZE_CLASSES - 1;
+}
+
+/**
+ * Account for one allocation search
+ */
+static void memory_stats_record_search(size_t visited) {
+    g_memory_state.blocks_visited += visited;
+    if (visited > g_memory_state.max_blocks_visited) {
+        g_memory_state.max_blocks_visited = visited;
+    }
+}
+
+/**
+ * Map a block size to its size class
+ */
+static size_t memory_bin_index(size_t size) {
+    if (size < MEMORY_SMALL_LIMIT) {
+        return size / MEMORY_ALIGNMENT;
+    }
     
-    if (hal_memory_map(regions, 32, &actual_count) != HAL_SUCCESS) {
-        return -1;
+    size_t log2 = 63 - (size_t)__builtin_clzll((unsigned long long)size);
+    return MEMORY_SMALL_BIN_COUNT + (log2 - MEMORY_SMALL_LIMIT_SHIFT);
+}
+
+/**
+ * Find the first non-empty size class at or above index
+ */
+static size_t memory_bin_next_nonempty(size_t index) {
+    size_t word = index / 64;
+    if (word >= MEMORY_BITMAP_WORDS) {
+        return MEMORY_BIN_COUNT;
+    }
+    
+    uint64_t bits = g_heap_bin_bitmap[word] & (~0ULL << (index % 64));
+    while (!bits) {
+        if (++word >= MEMORY_BITMAP_WORDS) {
+            return MEMORY_BIN_COUNT;
+        }
+        bits = g_heap_bin_bitmap[word];
+    }
+    
+    return word * 64 + (size_t)__builtin_ctzll(bits);
+}
+
+/**
+ * Insert a free block into its size class
+ */
+static void memory_bin_insert(memory_block_t* block) {
+    size_t index = memory_bin_index(block->size);
+    memory_free_links_t* links = MEMORY_FREE_LINKS(block);
+    memory_block_t* prev = NULL;
+    memory_block_t* next = g_heap_bins[index];
+    
+    // Large classes are kept sorted so allocation can stop at the first fit
+    if (index >= MEMORY_SMALL_BIN_COUNT) {
+        while (next && next->size < block->size) {
+            prev = next;
+            next = MEMORY_FREE_LINKS(next)->next;
+            g_memory_state.insert_blocks_visited++;
+        }
+    }
+    
+    links->prev = prev;
+    links->next = next;
+    if (next) {
+        MEMORY_FREE_LINKS(next)->prev = block;
+    }
+    if (prev) {
+        MEMORY_FREE_LINKS(prev)->next = block;
+    } else {
+        g_heap_bins[index] = block;
+    }
+    
+    g_heap_bin_bitmap[index / 64] |= 1ULL << (index % 64);
+    g_heap_bin_counts[index]++;
+    g_memory_state.free_blocks++;
+    g_memory_state.free_bytes += block->size;
+}
+
+/**
+ * Remove a free block from its size class
+ */
+static void memory_bin_remove(memory_block_t* block) {
+    size_t index = memory_bin_index(block->size);
+    memory_free_links_t* links = MEMORY_FREE_LINKS(block);
+    
+    if (links->prev) {
+        MEMORY_FREE_LINKS(links->prev)->next = links->next;
+    } else {
+        g_heap_bins[index] = links->next;
+    }
+    if (links->next) {
+        MEMORY_FREE_LINKS(links->next)->prev = links->prev;
+    }
+    
+    if (!g_heap_bins[index]) {
+        g_heap_bin_bitmap[index / 64] &= ~(1ULL << (index % 64));
+    }
+    g_heap_bin_counts[index]--;
+    g_memory_state.free_blocks--;
+    g_memory_state.free_bytes -= block->size;
+}
+
+/**
+ * Find a free block of at least size bytes, counting the blocks examined
+ */
+static memory_block_t* memory_find_block(size_t size, size_t* visited) {
+    size_t index = memory_bin_index(size);
+    
+    if (index < MEMORY_SMALL_BIN_COUNT) {
+        // Exact class: any block will do
+        if (g_heap_bins[index]) {
+            (*visited)++;
+            return g_heap_bins[index];
+        }
+    } else {
+        // Own class holds sizes on both sides of the request; take the first fit
+        memory_block_t* block = g_heap_bins[index];
+        while (block) {
+            (*visited)++;
+            if (block->size >= size) {
+                return block;
+            }
+            block = MEMORY_FREE_LINKS(block)->next;
+        }
+    }
+    
+    // Every block in a higher class fits; the head is the smallest one
+    index = memory_bin_next_nonempty(index + 1);
+    if (index >= MEMORY_BIN_COUNT) {
+        return NULL;
+    }
+    
+    (*visited)++;
+    return g_heap_bins[index];
+}
+
+/**
+ * Check whether b starts where a ends (heap chunks need not be contiguous)
+ */
+static bool memory_blocks_adjacent(const memory_block_t* a, const memory_block_t* b) {
+    return (const char*)a + sizeof(memory_block_t) + a->size == (const char*)b;
+}
+
+/**
+ * Absorb the physically following block into block
+ */
+static void memory_merge_next(memory_block_t* block) {
+    memory_block_t* next = block->next;
+    
+    block->size += sizeof(memory_block_t) + next->size;
+    block->next = next->next;
+    if (block->next) {
+        block->next->prev = block;
+    } else {
+        g_heap_tail = block;
+    }
+}
+
+/**
+ * Split the tail of a block off into a new free block if it is large enough,
+ * merging it with a free successor
+ */
+static void memory_split_block(memory_block_t* block, size_t size) {
+    if (block->size < size + sizeof(memory_block_t) + MEMORY_MIN_BLOCK_SIZE) {
+        return;
+    }
+    
+    memory_block_t* new_block = (memory_block_t*)((char*)block + sizeof(memory_block_t) + size);
+    new_block->size = block->size - size - sizeof(memory_block_t);
+    new_block->is_free = true;
+    new_block->next = block->next;
+    new_block->prev = block;
+    
+    if (block->next) {
+        block->next->prev = new_block;
+    } else {
+        g_heap_tail = new_block;
+    }
+    
+    block->size = size;
+    block->next = new_block;
+    
+    if (new_block->next && new_block->next->is_free && memory_blocks_adjacent(new_block, new_block->next)) {
+        memory_bin_remove(new_block->next);
+        memory_merge_next(new_block);
+        g_memory_state.coalesce_next++;
+    }
+    
+    memory_bin_insert(new_block);
+}
+
+/**
+ * Add a chunk of at least size bytes from the page allocator to the heap
+ */
+static memory_block_t* memory_heap_grow(size_t size) {
+    unsigned int min_order = page_order_for_size(size + sizeof(memory_block_t));
+    unsigned int order = min_order < MEMORY_HEAP_CHUNK_ORDER ? MEMORY_HEAP_CHUNK_ORDER : min_order;
+    
+    void* chunk = page_alloc(order);
+    if (!chunk && order != min_order) {
+        // Fall back to the smallest chunk that fits when memory is tight
+        order = min_order;
+        chunk = page_alloc(order);
+    }
+    if (!chunk) {
+        return NULL;
+    }
+    
+    size_t chunk_size = (size_t)PAGE_SIZE << order;
+    memory_block_t* block = (memory_block_t*)chunk;
+    block->size = chunk_size - sizeof(memory_block_t);
+    block->is_free = true;
+    block->next = NULL;
+    block->prev = g_heap_tail;
+    
+    if (g_heap_tail) {
+        g_heap_tail->next = block;
+    } else {
+        g_heap_head = block;
+    }
+    g_heap_tail = block;
+    
+    // Track heap bounds
+    uint64_t chunk_start = (uint64_t)(uintptr_t)chunk;
+    if (!g_memory_state.heap_start || chunk_start < g_memory_state.heap_start) {
+        g_memory_state.heap_start = chunk_start;
+    }
+    if (chunk_start + chunk_size > g_memory_state.heap_end) {
+        g_memory_state.heap_end = chunk_start + chunk_size;
+    }
+    g_memory_state.heap_current = chunk_start + chunk_size;
+    g_memory_state.heap_grows++;
+    
+    // Merge with the previous chunk if the page allocator handed out adjacent frames
+    if (block->prev && block->prev->is_free && memory_blocks_adjacent(block->prev, block)) {
+        block = block->prev;
+        memory_bin_remove(block);
+        memory_merge_next(block);
+        g_memory_state.coalesce_prev++;
+    }
+    
+    memory_bin_insert(block);
+    return block;
+}
+
+/**
+ * Hash a page-aligned address into the large allocation table
+ */
+static size_t memory_large_slot(uintptr_t address) {
+    return (size_t)(((uint64_t)(address >> PAGE_SHIFT) * 0x9E3779B97F4A7C15ULL) >> g_large_table_shift);
+}
+
+/**
+ * Find the table entry for a large allocation
+ */
+static memory_large_entry_t* memory_large_find(uintptr_t address) {
+    if (!g_large_table) {
+        return NULL;
+    }
+    
+    size_t mask = g_large_table_capacity - 1;
+    for (size_t slot = memory_large_slot(address);; slot = (slot + 1) & mask) {
+        if (g_large_table[slot].address == address) {
+            return &g_large_table[slot];
+        }
+        if (!g_large_table[slot].address) {
+            return NULL;
+        }
+    }
+}
+
+static void memory_large_place(uintptr_t address, size_t pages) {
+    size_t mask = g_large_table_capacity - 1;
+    size_t slot = memory_large_slot(address);
+    
+    while (g_large_table[slot].address) {
+        slot = (slot + 1) & mask;
+    }
+    
+    g_large_table[slot].address = address;
+    g_large_table[slot].pages = pages;
+}
+
+/**
+ * Move the large allocation table to a block of 2^order pages
+ */
+static bool memory_large_table_resize(unsigned int order) {
+    memory_large_entry_t* table = (memory_large_entry_t*)page_alloc(order);
+    if (!table) {
+        return false;
+    }
+    
+    size_t capacity = ((size_t)PAGE_SIZE << order) / sizeof(memory_large_entry_t);
+    memops_set(table, 0, (size_t)PAGE_SIZE << order);
+    
+    memory_large_entry_t* old_table = g_large_table;
+    size_t old_capacity = g_large_table_capacity;
+    unsigned int old_order = g_large_table_order;
+    
+    g_large_table = table;
+    g_large_table_capacity = capacity;
+    g_large_table_order = order;
+    g_large_table_shift = 64 - (unsigned int)__builtin_ctzll((unsigned long long)capacity);
+    
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_table[i].address) {
+            memory_large_place(old_table[i].address, old_table[i].pages);
+        }
+    }
+    
+    if (old_table) {
+        page_free(old_table, old_order);
+    }
+    return true;
+}
+
+/**
+ * Remove an entry, shifting later entries of the probe run back into the gap
+ */
+static void memory_large_remove(memory_large_entry_t* entry) {
+    size_t mask = g_large_table_capacity - 1;
+    size_t hole = (size_t)(entry - g_large_table);
+    size_t slot = hole;
+    
+    for (;;) {
+        slot = (slot + 1) & mask;
+        if (!g_large_table[slot].address) {
+            break;
+        }
+        
+        // Move the entry back unless its home slot lies cyclically in (hole, slot]
+        size_t home = memory_large_slot(g_large_table[slot].address);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            g_large_table[hole] = g_large_table[slot];
+            hole = slot;
+        }
+    }
+    
+    g_large_table[hole].address = 0;
+    g_large_table[hole].pages = 0;
+}
+
+/**
+ * Make room in the large allocation table for one more entry
+ */
+static bool memory_large_reserve(void) {
+    // Keep the table at most half full
+    if ((g_memory_state.large_allocations + 1) * 2 > g_large_table_capacity) {
+        unsigned int order = g_large_table ? g_large_table_order + 1 : MEMORY_LARGE_TABLE_MIN_ORDER;
+        return memory_large_table_resize(order);
+    }
+    return true;
+}
+
+/**
+ * Record a page run as a large allocation (table reserved)
+ */
+static void memory_large_track(void* ptr, size_t pages) {
+    memory_large_place((uintptr_t)ptr, pages);
+    
+    g_memory_state.large_alloc_calls++;
+    g_memory_state.large_allocations++;
+    g_memory_state.large_bytes += (uint64_t)pages * PAGE_SIZE;
+    g_memory_state.used_memory += (uint64_t)pages * PAGE_SIZE;
+}
+
+/**
+ * Allocate directly from the page allocator
+ */
+static void* memory_large_alloc(size_t size, size_t alignment) {
+    size_t pages = (size_t)(((uint64_t)size + PAGE_SIZE - 1) >> PAGE_SHIFT);
+    
+    if (!memory_large_reserve()) {
+        return NULL;
+    }
+    
+    void* ptr = page_alloc_pages(pages, alignment);
+    if (ptr) {
+        memory_large_track(ptr, pages);
+    }
+    
+    return ptr;
+}
+
+/**
+ * Return a large allocation's pages to the page allocator
+ */
+static void memory_large_free(memory_large_entry_t* entry) {
+    void* ptr = (void*)entry->address;
+    size_t pages = entry->pages;
+    
+    memory_large_remove(entry);
+    page_free_pages(ptr, pages);
+    
+    g_memory_state.large_allocations--;
+    g_memory_state.large_bytes -= (uint64_t)pages * PAGE_SIZE;
+    g_memory_state.used_memory -= (uint64_t)pages * PAGE_SIZE;
+}
+
+/**
+ * Look up a pointer in the large allocation table (only page-aligned
+ * pointers can be large allocations)
+ */
+static memory_large_entry_t* memory_large_lookup(const void* ptr) {
+    if ((uintptr_t)ptr & (PAGE_SIZE - 1)) {
+        return NULL;
+    }
+    return memory_large_find((uintptr_t)ptr);
+}
+
+/**
+ * Take a block of at least size bytes from the heap (heap lock held)
+ */
+static memory_block_t* memory_heap_alloc(size_t size, uint16_t owner) {
+    // Find a suitable free block, growing the heap if none fits
+    size_t visited = 0;
+    memory_block_t* block = memory_find_block(size, &visited);
+    if (!block && memory_heap_grow(size)) {
+        block = memory_find_block(size, &visited);
+    }
+    memory_stats_record_search(visited);
+    if (!block) {
+        return NULL; // Out of memory
+    }
+    
+    memory_bin_remove(block);
+    memory_split_block(block, size);
+    
+    block->is_free = false;
+    block->cached = false;
+    block->owner = owner;
+    g_memory_state.used_memory += block->size;
+    
+    return block;
+}
+
+/**
+ * Return a block to the heap, merging it with free neighbours (heap lock held)
+ */
+static void memory_heap_free(memory_block_t* block) {
+    block->is_free = true;
+    block->cached = false;
+    g_memory_state.used_memory -= block->size;
+    
+    // Merge with adjacent free blocks
+    if (block->next && block->next->is_free && memory_blocks_adjacent(block, block->next)) {
+        memory_bin_remove(block->next);
+        memory_merge_next(block);
+        g_memory_state.coalesce_next++;
+    }
+    
+    if (block->prev && block->prev->is_free && memory_blocks_adjacent(block->prev, block)) {
+        block = block->prev;
+        memory_bin_remove(block);
+        memory_merge_next(block);
+        g_memory_state.coalesce_prev++;
+    }
+    
+    memory_bin_insert(block);
+}
+
+/**
+ * Find an aligned payload inside a free block, leaving either no gap in front
+ * of it or one large enough to remain a free block; returns 0 if none fits
+ */
+static uintptr_t memory_aligned_payload(const memory_block_t* block, size_t size, size_t alignment) {
+    uintptr_t start = (uintptr_t)block + sizeof(memory_block_t);
+    uintptr_t payload = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    
+    while (payload != start && payload - start < sizeof(memory_block_t) + MEMORY_MIN_BLOCK_SIZE) {
+        payload += alignment;
+    }
+    
+    if (payload + size > start + block->size) {
+        return 0;
     }
     
-    // Find the largest RAM region for heap
-    memory_region_t* heap_region = NULL;
-    uint64_t largest_size = 0;
+    return payload;
+}
+
+/**
+ * Find a free block that can hold an aligned payload
+ */
+static memory_block_t* memory_find_aligned_block(size_t size, size_t alignment, uintptr_t* payload, size_t* visited) {
+    size_t scanned = 0;
     
-    for (size_t i = 0; i < actual_count; i++) {
-        if (regions[i].type == MEMORY_TYPE_RAM && regions[i].is_available) {
-            g_memory_state.total_memory += regions[i].size;
-            
-            if (regions[i].size > largest_size) {
-                largest_size = regions[i].size;
-                heap_region = &regions[i];
+    // Look for a block that happens to fit without extra room first
+    size_t index = memory_bin_next_nonempty(memory_bin_index(size));
+    while (index < MEMORY_BIN_COUNT && scanned < MEMORY_ALIGNED_SCAN_LIMIT) {
+        for (memory_block_t* block = g_heap_bins[index]; block && scanned < MEMORY_ALIGNED_SCAN_LIMIT;
+             block = MEMORY_FREE_LINKS(block)->next) {
+            scanned++;
+            (*visited)++;
+            *payload = memory_aligned_payload(block, size, alignment);
+            if (*payload) {
+                return block;
             }
         }
+        index = memory_bin_next_nonempty(index + 1);
     }
     
-    if (!heap_region) {
+    // Any block this large holds an aligned payload wherever it starts
+    memory_block_t* block = memory_find_block(size + alignment + sizeof(memory_block_t) + MEMORY_MIN_BLOCK_SIZE, visited);
+    if (block) {
+        *payload = memory_aligned_payload(block, size, alignment);
+    }
+    
+    return block;
+}
+
+/**
+ * Take an aligned block from the heap (heap lock held)
+ */
+static void* memory_heap_alloc_aligned(size_t size, size_t alignment, uint16_t owner) {
+    uintptr_t payload = 0;
+    size_t visited = 0;
+    memory_block_t* block = memory_find_aligned_block(size, alignment, &payload, &visited);
+    if (!block && memory_heap_grow(size + alignment + sizeof(memory_block_t) + MEMORY_MIN_BLOCK_SIZE)) {
+        block = memory_find_aligned_block(size, alignment, &payload, &visited);
+    }
+    memory_stats_record_search(visited);
+    if (!block) {
+        return NULL;
+    }
+    
+    memory_bin_remove(block);
+    
+    // Leave the gap in front of the payload as a free block of its own
+    memory_block_t* aligned = (memory_block_t*)(payload - sizeof(memory_block_t));
+    if (aligned != block) {
+        size_t front = (size_t)((char*)aligned - (char*)block) - sizeof(memory_block_t);
+        
+        aligned->size = block->size - front - sizeof(memory_block_t);
+        aligned->next = block->next;
+        aligned->prev = block;
+        if (block->next) {
+            block->next->prev = aligned;
+        } else {
+            g_heap_tail = aligned;
+        }
+        
+        block->size = front;
+        block->next = aligned;
+        memory_bin_insert(block);
+    }
+    
+    memory_split_block(aligned, size);
+    
+    aligned->is_free = false;
+    aligned->cached = false;
+    aligned->owner = owner;
+    g_memory_state.used_memory += aligned->size;
+    
+    return (void*)payload;
+}
+
+/**
+ * Resize a heap block without moving it (heap lock held)
+ */
+static bool memory_heap_resize(memory_block_t* block, size_t size) {
+    // Shrinking: keep the block and return the tail to the free pool
+    if (size <= block->size) {
+        g_memory_state.used_memory -= block->size;
+        memory_split_block(block, size);
+        g_memory_state.used_memory += block->size;
+        return true;
+    }
+    
+    // Growing: extend into a free successor if it is large enough
+    memory_block_t* next = block->next;
+    if (next && next->is_free && memory_blocks_adjacent(block, next) &&
+        block->size + sizeof(memory_block_t) + next->size >= size) {
+        g_memory_state.used_memory -= block->size;
+        memory_bin_remove(next);
+        memory_merge_next(block);
+        memory_split_block(block, size);
+        g_memory_state.used_memory += block->size;
+        return true;
+    }
+    
+    return false;
+}
+
+/**
+ * Resize a large allocation without moving it: only trimming pages off a
+ * buffer that stays above the threshold works in place (heap lock held)
+ */
+static bool memory_large_resize(memory_large_entry_t* entry, size_t new_size) {
+    size_t pages = (size_t)(((uint64_t)new_size + PAGE_SIZE - 1) >> PAGE_SHIFT);
+    
+    if (new_size < MEMORY_LARGE_THRESHOLD || pages > entry->pages) {
+        return false;
+    }
+    
+    size_t released = entry->pages - pages;
+    if (released) {
+        page_free_pages((char*)entry->address + ((size_t)pages << PAGE_SHIFT), released);
+        entry->pages = pages;
+        g_memory_state.large_bytes -= (uint64_t)released * PAGE_SIZE;
+        g_memory_state.used_memory -= (uint64_t)released * PAGE_SIZE;
+    }
+    return true;
+}
+
+/**
+ * The executing CPU's cache (interrupts must be off)
+ */
+static memory_cpu_cache_t* memory_cpu_cache(void) {
+    return &g_cpu_caches[hal_get_cpu_id()];
+}
+
+/**
+ * Hand the oldest half of an over-full magazine back to the heap
+ */
+static void memory_magazine_drain(memory_cpu_cache_t* cache, memory_magazine_t* magazine) {
+    spin_lock(&g_heap_lock);
+    for (size_t i = 0; i < MEMORY_MAGAZINE_BATCH && magazine->head; i++) {
+        memory_block_t* block = magazine->head;
+        magazine->head = MEMORY_FREE_LINKS(block)->next;
+        magazine->count--;
+        cache->cached_bytes -= block->size;
+        memory_heap_free(block);
+    }
+    spin_unlock(&g_heap_lock);
+    
+    cache->magazine_drains++;
+}
+
+/**
+ * Put a block owned by this CPU into its magazine
+ */
+static void memory_magazine_push(memory_cpu_cache_t* cache, memory_block_t* block) {
+    memory_magazine_t* magazine = &cache->magazines[block->size / MEMORY_ALIGNMENT];
+    
+    block->cached = true;
+    MEMORY_FREE_LINKS(block)->next = magazine->head;
+    magazine->head = block;
+    magazine->count++;
+    cache->cached_bytes += block->size;
+    
+    if (magazine->count > MEMORY_MAGAZINE_LIMIT) {
+        memory_magazine_drain(cache, magazine);
+    }
+}
+
+/**
+ * Move blocks other CPUs freed on our behalf into the magazines
+ */
+static void memory_magazine_collect(memory_cpu_cache_t* cache) {
+    memory_block_t* block = __atomic_exchange_n(&cache->remote.head, NULL, __ATOMIC_ACQUIRE);
+    
+    while (block) {
+        memory_block_t* next = MEMORY_FREE_LINKS(block)->next;
+        __atomic_fetch_sub(&cache->remote.bytes, block->size, __ATOMIC_RELAXED);
+        memory_magazine_push(cache, block);
+        block = next;
+    }
+}
+
+/**
+ * Fill an empty magazine with a batch of blocks from the heap
+ */
+static bool memory_magazine_refill(memory_cpu_cache_t* cache, memory_magazine_t* magazine, size_t size, uint16_t owner) {
+    spin_lock(&g_heap_lock);
+    for (size_t i = 0; i < MEMORY_MAGAZINE_BATCH; i++) {
+        memory_block_t* block = memory_heap_alloc(size, owner);
+        if (!block) {
+            break;
+        }
+        
+        block->cached = true;
+        MEMORY_FREE_LINKS(block)->next = magazine->head;
+        magazine->head = block;
+        magazine->count++;
+        cache->cached_bytes += block->size;
+    }
+    spin_unlock(&g_heap_lock);
+    
+    cache->magazine_refills++;
+    return magazine->head != NULL;
+}
+
+/**
+ * Return a block to the CPU that owns it without taking any lock
+ */
+static void memory_remote_free(memory_cpu_cache_t* owner, memory_block_t* block) {
+    block->cached = true;
+    __atomic_fetch_add(&owner->remote.bytes, block->size, __ATOMIC_RELAXED);
+    
+    memory_block_t* head = __atomic_load_n(&owner->remote.head, __ATOMIC_RELAXED);
+    do {
+        MEMORY_FREE_LINKS(block)->next = head;
+    } while (!__atomic_compare_exchange_n(&owner->remote.head, &head, block, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**
+ * Initialize memory management
+ */
+int memory_init(void) {
+    if (g_memory_state.initialized) {
+        return 0;
+    }
+    
+    // Pick the copy/fill/compare routines for this CPU
+    memops_init();
+    
+    // Bring up the physical page allocator the heap is built on
+    if (page_init() != 0) {
         return -1;
     }
     
-    // Initialize heap
-    g_memory_state.heap_start = heap_region->base_address;
-    g_memory_state.heap_end = heap_region->base_address + heap_region->size;
-    g_memory_state.heap_current = g_memory_state.heap_start;
+    page_stats_t page_stats;
+    page_get_stats(&page_stats);
+    g_memory_state.total_memory = page_stats.total_pages * PAGE_SIZE;
     
-    // Create initial heap block
-    memory_block_t* initial_block = (memory_block_t*)g_memory_state.heap_start;
-    initial_block->size = heap_region->size - sizeof(memory_block_t);
-    initial_block->is_free = true;
-    initial_block->next = NULL;
-    initial_block->prev = NULL;
+    g_heap_head = NULL;
+    g_heap_tail = NULL;
     
-    g_heap_head = initial_block;
-    g_heap_tail = initial_block;
+    // Create the initial heap chunk
+    if (!memory_heap_grow(0)) {
+        return -1;
+    }
     
     g_memory_state.initialized = true;
     return 0;
@@ -91,46 +878,57 @@ int memory_init(void) {
  * Allocate memory
  */
 void* memory_alloc(size_t size) {
-    if (!g_memory_state.initialized || size == 0) {
+    if (!g_memory_state.initialized || size == 0 || size > SIZE_MAX - MEMORY_ALIGNMENT) {
         return NULL;
     }
     
-    // Align size to 8-byte boundary
-    size = (size + 7) & ~7;
+    // Align size to 8-byte boundary and leave room for the free-list links
+    size = (size + MEMORY_ALIGNMENT - 1) & ~(size_t)(MEMORY_ALIGNMENT - 1);
+    if (size < MEMORY_MIN_BLOCK_SIZE) {
+        size = MEMORY_MIN_BLOCK_SIZE;
+    }
     
-    // Find a suitable free block
-    memory_block_t* block = g_heap_head;
-    while (block) {
-        if (block->is_free && block->size >= size) {
-            // Check if we need to split the block
-            if (block->size > size + sizeof(memory_block_t)) {
-                // Split the block
-                memory_block_t* new_block = (memory_block_t*)((char*)block + sizeof(memory_block_t) + size);
-                new_block->size = block->size - size - sizeof(memory_block_t);
-                new_block->is_free = true;
-                new_block->next = block->next;
-                new_block->prev = block;
-                
-                if (block->next) {
-                    block->next->prev = new_block;
-                } else {
-                    g_heap_tail = new_block;
-                }
-                
-                block->size = size;
-                block->next = new_block;
-            }
-            
-            block->is_free = false;
-            g_memory_state.used_memory += block->size;
-            
-            return (void*)((char*)block + sizeof(memory_block_t));
+    uint64_t irq_state = hal_interrupt_save();
+    uint16_t cpu = (uint16_t)hal_get_cpu_id();
+    memory_cpu_cache_t* cache = &g_cpu_caches[cpu];
+    memory_block_t* block = NULL;
+    void* ptr = NULL;
+    
+    cache->alloc_calls++;
+    cache->alloc_size_histogram[memory_stats_bucket(size)]++;
+    
+    if (size < MEMORY_SMALL_LIMIT) {
+        // Small objects come from this CPU's magazine; the heap is only
+        // touched to refill it
+        memory_magazine_t* magazine = &cache->magazines[size / MEMORY_ALIGNMENT];
+        if (!magazine->head) {
+            memory_magazine_collect(cache);
         }
-        
-        block = block->next;
+        if (magazine->head || memory_magazine_refill(cache, magazine, size, cpu)) {
+            block = magazine->head;
+            magazine->head = MEMORY_FREE_LINKS(block)->next;
+            magazine->count--;
+            cache->cached_bytes -= block->size;
+            cache->magazine_hits++;
+            block->cached = false;
+        }
+    } else {
+        spin_lock(&g_heap_lock);
+        if (size >= MEMORY_LARGE_THRESHOLD) {
+            // Big buffers take their own pages so they never split the heap
+            ptr = memory_large_alloc(size, PAGE_SIZE);
+        } else {
+            block = memory_heap_alloc(size, cpu);
+        }
+        spin_unlock(&g_heap_lock);
     }
     
-    return NULL; // No suitable block found
+    hal_interrupt_restore(irq_state);
+    
+    if (block) {
+        ptr = (void*)((char*)block + sizeof(memory_block_t));
+    }
+    return ptr;
 }
 
 /**
@@ -141,36 +939,151 @@ void memory_free(void* ptr) {
         return;
     }
     
+    uint64_t irq_state = hal_interrupt_save();
+    uint16_t cpu = (uint16_t)hal_get_cpu_id();
+    memory_cpu_cache_t* cache = &g_cpu_caches[cpu];
+    
+    // Only page-aligned pointers can be large allocations
+    if (!((uintptr_t)ptr & (PAGE_SIZE - 1))) {
+        spin_lock(&g_heap_lock);
+        memory_large_entry_t* entry = memory_large_find((uintptr_t)ptr);
+        if (entry) {
+            memory_large_free(entry);
+        }
+        spin_unlock(&g_heap_lock);
+        
+        if (entry) {
+            cache->free_calls++;
+            hal_interrupt_restore(irq_state);
+            return;
+        }
+    }
+    
     // Get the block header
     memory_block_t* block = (memory_block_t*)((char*)ptr - sizeof(memory_block_t));
     
-    if (block->is_free) {
+    if (block->is_free || block->cached) {
+        hal_interrupt_restore(irq_state);
         return; // Already free
     }
     
-    block->is_free = true;
-    g_memory_state.used_memory -= block->size;
+    cache->free_calls++;
     
-    // Merge with adjacent free blocks
-    if (block->next && block->next->is_free) {
-        block->size += sizeof(memory_block_t) + block->next->size;
-        block->next = block->next->next;
-        if (block->next) {
-            block->next->prev = block;
+    if (block->size < MEMORY_SMALL_LIMIT) {
+        // Small objects go back to the magazine of the CPU that handed them out
+        if (block->owner == cpu) {
+            memory_magazine_push(cache, block);
         } else {
-            g_heap_tail = block;
+            memory_remote_free(&g_cpu_caches[block->owner], block);
+            cache->remote_frees++;
         }
+    } else {
+        spin_lock(&g_heap_lock);
+        memory_heap_free(block);
+        spin_unlock(&g_heap_lock);
     }
     
-    if (block->prev && block->prev->is_free) {
-        block->prev->size += sizeof(memory_block_t) + block->size;
-        block->prev->next = block->next;
-        if (block->next) {
-            block->next->prev = block->prev;
-        } else {
-            g_heap_tail = block->prev;
+    hal_interrupt_restore(irq_state);
+}
+
+/**
+ * Allocate memory aligned to a power-of-two boundary
+ */
+void* memory_alloc_aligned(size_t size, size_t alignment) {
+    if (alignment <= MEMORY_ALIGNMENT) {
+        return memory_alloc(size);
+    }
+    
+    if (!g_memory_state.initialized || size == 0 || (alignment & (alignment - 1)) ||
+        size > SIZE_MAX / 2 || alignment > SIZE_MAX / 4) {
+        return NULL;
+    }
+    
+    size = (size + MEMORY_ALIGNMENT - 1) & ~(size_t)(MEMORY_ALIGNMENT - 1);
+    if (size < MEMORY_MIN_BLOCK_SIZE) {
+        size = MEMORY_MIN_BLOCK_SIZE;
+    }
+    
+    uint64_t irq_state = hal_interrupt_save();
+    uint16_t cpu = (uint16_t)hal_get_cpu_id();
+    memory_cpu_cache_t* cache = &g_cpu_caches[cpu];
+    
+    cache->alloc_calls++;
+    cache->alloc_size_histogram[memory_stats_bucket(size)]++;
+    
+    spin_lock(&g_heap_lock);
+    void* ptr = size >= MEMORY_LARGE_THRESHOLD
+        ? memory_large_alloc(size, alignment)
+        : memory_heap_alloc_aligned(size, alignment, cpu);
+    spin_unlock(&g_heap_lock);
+    
+    hal_interrupt_restore(irq_state);
+    return ptr;
+}
+
+/**
+ * Allocate zero-filled memory aligned to a power-of-two boundary
+ */
+void* memory_alloc_aligned_zeroed(size_t size, size_t alignment) {
+    if (!g_memory_state.initialized || size == 0 || (alignment & (alignment - 1)) ||
+        size > SIZE_MAX / 2 || alignment > SIZE_MAX / 4) {
+        return NULL;
+    }
+    
+    // Big or whole-page requests take pages directly, which come from the
+    // pre-zeroed pool when it has stock; anything else is cleared in place
+    bool page_run = size >= MEMORY_LARGE_THRESHOLD ||
+                    (alignment >= PAGE_SIZE && !(size & (PAGE_SIZE - 1)));
+    if (!page_run) {
+        void* ptr = memory_alloc_aligned(size, alignment);
+        if (ptr) {
+            memops_set(ptr, 0, size);
         }
+        return ptr;
     }
+    
+    size_t pages = (size_t)(((uint64_t)size + PAGE_SIZE - 1) >> PAGE_SHIFT);
+    
+    // Take the pages before the heap lock so a pool miss is cleared unlocked
+    void* ptr = page_alloc_pages_flags(pages, alignment < PAGE_SIZE ? PAGE_SIZE : alignment, PAGE_ALLOC_ZERO);
+    if (!ptr) {
+        return NULL;
+    }
+    
+    uint64_t irq_state = hal_interrupt_save();
+    memory_cpu_cache_t* cache = memory_cpu_cache();
+    cache->alloc_calls++;
+    cache->alloc_size_histogram[memory_stats_bucket(size)]++;
+    
+    spin_lock(&g_heap_lock);
+    bool tracked = memory_large_reserve();
+    if (tracked) {
+        memory_large_track(ptr, pages);
+    }
+    spin_unlock(&g_heap_lock);
+    
+    hal_interrupt_restore(irq_state);
+    
+    if (!tracked) {
+        page_free_pages(ptr, pages);
+        return NULL;
+    }
+    return ptr;
+}
+
+/**
+ * Allocate zero-filled memory
+ */
+void* memory_alloc_zeroed(size_t size) {
+    return memory_alloc_aligned_zeroed(size, MEMORY_ALIGNMENT);
+}
+
+/**
+ * Free memory from memory_alloc_aligned
+ */
+void memory_free_aligned(void* ptr) {
+    // Aligned allocations are ordinary heap blocks
+    memory_free(ptr);
 }
 
 /**
@@ -186,14 +1099,47 @@ void* memory_realloc(void* ptr, size_t new_size) {
         return NULL;
     }
     
-    // Get the block header
-    memory_block_t* block = (memory_block_t*)((char*)ptr - sizeof(memory_block_t));
+    if (!g_memory_state.initialized || new_size > SIZE_MAX - MEMORY_ALIGNMENT) {
+        return NULL;
+    }
+    
+    size_t size = (new_size + MEMORY_ALIGNMENT - 1) & ~(size_t)(MEMORY_ALIGNMENT - 1);
+    if (size < MEMORY_MIN_BLOCK_SIZE) {
+        size = MEMORY_MIN_BLOCK_SIZE;
+    }
+    
+    uint64_t irq_state = hal_interrupt_save();
+    memory_cpu_cache_t* cache = memory_cpu_cache();
+    cache->realloc_calls++;
+    
+    // Try to resize in place first
+    size_t old_size;
+    bool resized;
     
-    // If the new size is smaller, we can just return the same pointer
-    if (new_size <= block->size) {
+    spin_lock(&g_heap_lock);
+    memory_large_entry_t* entry = memory_large_lookup(ptr);
+    if (entry) {
+        old_size = entry->pages << PAGE_SHIFT;
+        resized = memory_large_resize(entry, new_size);
+    } else {
+        memory_block_t* block = (memory_block_t*)((char*)ptr - sizeof(memory_block_t));
+        old_size = block->size;
+        resized = memory_heap_resize(block, size);
+    }
+    spin_unlock(&g_heap_lock);
+    
+    if (resized) {
+        if (size <= old_size) {
+            cache->realloc_shrunk_in_place++;
+        } else {
+            cache->realloc_grown_in_place++;
+        }
+        hal_interrupt_restore(irq_state);
         return ptr;
     }
     
+    hal_interrupt_restore(irq_state);
+    
     // Try to allocate new memory
     void* new_ptr = memory_alloc(new_size);
     if (!new_ptr) {
@@ -201,11 +1147,15 @@ void* memory_realloc(void* ptr, size_t new_size) {
     }
     
     // Copy the data
-    memcpy(new_ptr, ptr, block->size);
+    memops_copy(new_ptr, ptr, new_size < old_size ? new_size : old_size);
     
     // Free the old memory
     memory_free(ptr);
     
+    irq_state = hal_interrupt_save();
+    memory_cpu_cache()->realloc_copies++;
+    hal_interrupt_restore(irq_state);
+    
     return new_ptr;
 }
 
@@ -217,30 +1167,114 @@ void memory_get_stats(memory_stats_t* stats) {
         return;
     }
     
+    uint64_t irq_state = spin_lock_irqsave(&g_heap_lock);
+    
     stats->total_memory = g_memory_state.total_memory;
-    stats->used_memory = g_memory_state.used_memory;
-    stats->free_memory = g_memory_state.total_memory - g_memory_state.used_memory;
     stats->heap_start = g_memory_state.heap_start;
     stats->heap_end = g_memory_state.heap_end;
+    
+    stats->blocks_visited = g_memory_state.blocks_visited;
+    stats->max_blocks_visited = g_memory_state.max_blocks_visited;
+    stats->insert_blocks_visited = g_memory_state.insert_blocks_visited;
+    stats->heap_grows = g_memory_state.heap_grows;
+    stats->coalesce_next = g_memory_state.coalesce_next;
+    stats->coalesce_prev = g_memory_state.coalesce_prev;
+    stats->free_blocks = g_memory_state.free_blocks;
+    stats->free_bytes = g_memory_state.free_bytes;
+    stats->large_alloc_calls = g_memory_state.large_alloc_calls;
+    stats->large_allocations = g_memory_state.large_allocations;
+    stats->large_bytes = g_memory_state.large_bytes;
+    
+    // Histograms: free blocks come from the per-class counts, which map
+    // onto whole buckets because large classes are powers of two
+    for (size_t i = 0; i < MEMORY_STATS_SIZE_CLASSES; i++) {
+        stats->alloc_size_histogram[i] = 0;
+        stats->free_block_histogram[i] = 0;
+    }
+    for (size_t index = 0; index < MEMORY_BIN_COUNT; index++) {
+        if (g_heap_bin_counts[index]) {
+            size_t size = index < MEMORY_SMALL_BIN_COUNT
+                ? index * MEMORY_ALIGNMENT
+                : (size_t)1 << (index - MEMORY_SMALL_BIN_COUNT + MEMORY_SMALL_LIMIT_SHIFT);
+            stats->free_block_histogram[memory_stats_bucket(size)] += g_heap_bin_counts[index];
+        }
+    }
+    
+    // Largest free block: the last entry of the highest non-empty class
+    stats->largest_free_block = 0;
+    for (size_t index = MEMORY_BIN_COUNT; index-- > 0;) {
+        if (g_heap_bins[index]) {
+            memory_block_t* block = g_heap_bins[index];
+            while (MEMORY_FREE_LINKS(block)->next) {
+                block = MEMORY_FREE_LINKS(block)->next;
+            }
+            stats->largest_free_block = block->size;
+            break;
+        }
+    }
+    
+    stats->fragmentation_index = g_memory_state.free_bytes
+        ? (uint32_t)(1000 - stats->largest_free_block * 1000 / g_memory_state.free_bytes)
+        : 0;
+    
+    uint64_t heap_used = g_memory_state.used_memory;
+    spin_unlock_irqrestore(&g_heap_lock, irq_state);
+    
+    // Per-CPU counters; blocks parked in magazines count as free
+    uint64_t cached = 0;
+    stats->alloc_calls = 0;
+    stats->free_calls = 0;
+    stats->realloc_calls = 0;
+    stats->realloc_grown_in_place = 0;
+    stats->realloc_shrunk_in_place = 0;
+    stats->realloc_copies = 0;
+    stats->magazine_hits = 0;
+    stats->magazine_refills = 0;
+    stats->magazine_drains = 0;
+    stats->remote_frees = 0;
+    
+    for (size_t cpu = 0; cpu < HAL_MAX_CPUS; cpu++) {
+        const memory_cpu_cache_t* cache = &g_cpu_caches[cpu];
+        
+        stats->alloc_calls += cache->alloc_calls;
+        stats->free_calls += cache->free_calls;
+        stats->realloc_calls += cache->realloc_calls;
+        stats->realloc_grown_in_place += cache->realloc_grown_in_place;
+        stats->realloc_shrunk_in_place += cache->realloc_shrunk_in_place;
+        stats->realloc_copies += cache->realloc_copies;
+        stats->magazine_hits += cache->magazine_hits;
+        stats->magazine_refills += cache->magazine_refills;
+        stats->magazine_drains += cache->magazine_drains;
+        stats->remote_frees += cache->remote_frees;
+        for (size_t i = 0; i < MEMORY_STATS_SIZE_CLASSES; i++) {
+            stats->alloc_size_histogram[i] += cache->alloc_size_histogram[i];
+        }
+        
+        cached += cache->cached_bytes + __atomic_load_n(&cache->remote.bytes, __ATOMIC_RELAXED);
+    }
+    
+    stats->cached_bytes = cached;
+    stats->used_memory = heap_used > cached ? heap_used - cached : 0;
+    stats->free_memory = g_memory_state.total_memory - stats->used_memory;
 }
 
 /**
  * Memory copy
  */
 void* memory_copy(void* dest, const void* src, size_t n) {
-    return memcpy(dest, src, n);
+    return memops_copy(dest, src, n);
 }
 
 /**
  * Memory set
  */
 void* memory_set(void* s, int c, size_t n) {
-    return memset(s, c, n);
+    return memops_set(s, c, n);
 }
 
 /**
  * Memory compare
  */
 int memory_compare(const void* s1, const void* s2, size_t n) {
-    return memcmp(s1, s2, n);
+    return memops_compare(s1, s2, n);
 }
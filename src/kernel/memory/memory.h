@@ -11,6 +11,15 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+// Common alignments for memory_alloc_aligned
+#define MEMORY_CACHE_LINE_SIZE 64
+#define MEMORY_PAGE_ALIGNMENT 0x1000
+#define MEMORY_HUGE_PAGE_ALIGNMENT 0x200000
+
+// Size histogram buckets: bucket i counts sizes in [16 << i, 32 << i); the
+// first bucket also takes smaller sizes and the last one everything larger
+#define MEMORY_STATS_SIZE_CLASSES 20
+
 // Memory statistics structure
 typedef struct {
     uint64_t total_memory;
@@ -18,6 +27,46 @@ typedef struct {
     uint64_t free_memory;
     uint64_t heap_start;
     uint64_t heap_end;
+    
+    // Reallocation (copies avoided = grown + shrunk in place)
+    uint64_t realloc_calls;
+    uint64_t realloc_grown_in_place;
+    uint64_t realloc_shrunk_in_place;
+    uint64_t realloc_copies;
+    
+    // Allocation search (average scan length = blocks_visited / alloc_calls)
+    uint64_t alloc_calls;
+    uint64_t free_calls;
+    uint64_t blocks_visited;
+    uint64_t max_blocks_visited;
+    uint64_t insert_blocks_visited;
+    uint64_t heap_grows;
+    
+    // Per-CPU magazines (cached bytes are free but not yet back in the heap)
+    uint64_t magazine_hits;
+    uint64_t magazine_refills;
+    uint64_t magazine_drains;
+    uint64_t remote_frees;
+    uint64_t cached_bytes;
+    
+    // Large allocations (page-backed, outside the heap; included in used_memory)
+    uint64_t large_alloc_calls;
+    uint64_t large_allocations;
+    uint64_t large_bytes;
+    
+    // Coalescing with the following / preceding block
+    uint64_t coalesce_next;
+    uint64_t coalesce_prev;
+    
+    // Free space (fragmentation index in permille: 1 - largest / free bytes)
+    uint64_t free_blocks;
+    uint64_t free_bytes;
+    uint64_t largest_free_block;
+    uint32_t fragmentation_index;
+    
+    // Size histograms
+    uint64_t alloc_size_histogram[MEMORY_STATS_SIZE_CLASSES];
+    uint64_t free_block_histogram[MEMORY_STATS_SIZE_CLASSES];
 } memory_stats_t;
 
 // Memory allocation functions
@@ -26,6 +75,15 @@ void* memory_alloc(size_t size);
 void memory_free(void* ptr);
 void* memory_realloc(void* ptr, size_t new_size);
 
+// Aligned allocation (alignment must be a power of two; realloc keeps only 8-byte alignment)
+void* memory_alloc_aligned(size_t size, size_t alignment);
+void memory_free_aligned(void* ptr);
+
+// Zero-filled allocation (free with memory_free; whole-page and large
+// requests are served from the page allocator's pre-zeroed pool)
+void* memory_alloc_zeroed(size_t size);
+void* memory_alloc_aligned_zeroed(size_t size, size_t alignment);
+
 // Memory statistics
 void memory_get_stats(memory_stats_t* stats);
 
@@ -34,11 +92,11 @@ void* memory_copy(void* dest, const void* src, size_t n);
 void* memory_set(void* s, int c, size_t n);
 int memory_compare(const void* s1, const void* s2, size_t n);
 
-// Memory protection (to be implemented)
+// Memory protection on kernel pages (implemented in paging.c)
 int memory_protect(void* address, size_t size, bool read, bool write, bool execute);
 int memory_unprotect(void* address, size_t size);
 
-// Virtual memory (to be implemented)
+// Virtual memory in the kernel address space (implemented in paging.c)
 int memory_map_virtual(void* virtual_addr, void* physical_addr, size_t size);
 int memory_unmap_virtual(void* virtual_addr, size_t size);
 
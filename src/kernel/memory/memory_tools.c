@@ -0,0 +1,332 @@
+/**
+ * CompileOS Memory Tools - Implementation
+ *
+ * Terminal commands for inspecting the kernel allocators. memory_tools.h
+ * declares its own memory_compare, which clashes with the one in memory.h,
+ * so the command handlers are defined here against memory.h directly.
+ */
+
+#include "memory.h"
+#include "page.h"
+#include "paging.h"
+#include "tlb.h"
+#include "vm.h"
+#include "../terminal/terminal.h"
+#include "../../hal/arch/x86_64/cpu.h"
+
+// faultcheck: pages faulted per kind and vector registers held across them
+#define MEMORY_TOOLS_FAULTCHECK_PAGES 16
+#define MEMORY_TOOLS_FAULTCHECK_REGISTERS 16
+#define MEMORY_TOOLS_FAULTCHECK_WIDTH 32
+
+/**
+ * Print a size histogram, skipping empty buckets
+ */
+static void memory_tools_print_histogram(const char* title, const uint64_t* buckets) {
+    terminal_printf("%s\n", title);
+    
+    for (size_t i = 0; i < MEMORY_STATS_SIZE_CLASSES; i++) {
+        if (!buckets[i]) {
+            continue;
+        }
+        
+        unsigned long long low = i == 0 ? 0ULL : 16ULL << i;
+        if (i == MEMORY_STATS_SIZE_CLASSES - 1) {
+            terminal_printf("  %10llu+          %12llu\n", low, (unsigned long long)buckets[i]);
+        } else {
+            terminal_printf("  %10llu - %-8llu %12llu\n", low, (32ULL << i) - 1, (unsigned long long)buckets[i]);
+        }
+    }
+}
+
+/**
+ * Load ymm0-15 from in, store ymm0 to the start of each page (every store
+ * faults), then write all sixteen registers back to out
+ */
+static void memory_tools_store_loop_avx(uint8_t* const* pages, size_t count, const uint8_t* in, uint8_t* out) {
+    __asm__ volatile (
+        "vmovdqu 0(%[in]), %%ymm0\n\t"
+        "vmovdqu 32(%[in]), %%ymm1\n\t"
+        "vmovdqu 64(%[in]), %%ymm2\n\t"
+        "vmovdqu 96(%[in]), %%ymm3\n\t"
+        "vmovdqu 128(%[in]), %%ymm4\n\t"
+        "vmovdqu 160(%[in]), %%ymm5\n\t"
+        "vmovdqu 192(%[in]), %%ymm6\n\t"
+        "vmovdqu 224(%[in]), %%ymm7\n\t"
+        "vmovdqu 256(%[in]), %%ymm8\n\t"
+        "vmovdqu 288(%[in]), %%ymm9\n\t"
+        "vmovdqu 320(%[in]), %%ymm10\n\t"
+        "vmovdqu 352(%[in]), %%ymm11\n\t"
+        "vmovdqu 384(%[in]), %%ymm12\n\t"
+        "vmovdqu 416(%[in]), %%ymm13\n\t"
+        "vmovdqu 448(%[in]), %%ymm14\n\t"
+        "vmovdqu 480(%[in]), %%ymm15\n\t"
+        "1:\n\t"
+        "mov (%[pages]), %%rax\n\t"
+        "vmovdqu %%ymm0, (%%rax)\n\t"
+        "add $8, %[pages]\n\t"
+        "dec %[count]\n\t"
+        "jnz 1b\n\t"
+        "vmovdqu %%ymm0, 0(%[out])\n\t"
+        "vmovdqu %%ymm1, 32(%[out])\n\t"
+        "vmovdqu %%ymm2, 64(%[out])\n\t"
+        "vmovdqu %%ymm3, 96(%[out])\n\t"
+        "vmovdqu %%ymm4, 128(%[out])\n\t"
+        "vmovdqu %%ymm5, 160(%[out])\n\t"
+        "vmovdqu %%ymm6, 192(%[out])\n\t"
+        "vmovdqu %%ymm7, 224(%[out])\n\t"
+        "vmovdqu %%ymm8, 256(%[out])\n\t"
+        "vmovdqu %%ymm9, 288(%[out])\n\t"
+        "vmovdqu %%ymm10, 320(%[out])\n\t"
+        "vmovdqu %%ymm11, 352(%[out])\n\t"
+        "vmovdqu %%ymm12, 384(%[out])\n\t"
+        "vmovdqu %%ymm13, 416(%[out])\n\t"
+        "vmovdqu %%ymm14, 448(%[out])\n\t"
+        "vmovdqu %%ymm15, 480(%[out])\n\t"
+        "vzeroupper\n\t"
+        : [pages] "+r" (pages), [count] "+r" (count)
+        : [in] "r" (in), [out] "r" (out)
+        : "rax", "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15");
+}
+
+/**
+ * SSE form of memory_tools_store_loop_avx over xmm0-15
+ */
+static void memory_tools_store_loop_sse(uint8_t* const* pages, size_t count, const uint8_t* in, uint8_t* out) {
+    __asm__ volatile (
+        "movdqu 0(%[in]), %%xmm0\n\t"
+        "movdqu 16(%[in]), %%xmm1\n\t"
+        "movdqu 32(%[in]), %%xmm2\n\t"
+        "movdqu 48(%[in]), %%xmm3\n\t"
+        "movdqu 64(%[in]), %%xmm4\n\t"
+        "movdqu 80(%[in]), %%xmm5\n\t"
+        "movdqu 96(%[in]), %%xmm6\n\t"
+        "movdqu 112(%[in]), %%xmm7\n\t"
+        "movdqu 128(%[in]), %%xmm8\n\t"
+        "movdqu 144(%[in]), %%xmm9\n\t"
+        "movdqu 160(%[in]), %%xmm10\n\t"
+        "movdqu 176(%[in]), %%xmm11\n\t"
+        "movdqu 192(%[in]), %%xmm12\n\t"
+        "movdqu 208(%[in]), %%xmm13\n\t"
+        "movdqu 224(%[in]), %%xmm14\n\t"
+        "movdqu 240(%[in]), %%xmm15\n\t"
+        "1:\n\t"
+        "mov (%[pages]), %%rax\n\t"
+        "movdqu %%xmm0, (%%rax)\n\t"
+        "add $8, %[pages]\n\t"
+        "dec %[count]\n\t"
+        "jnz 1b\n\t"
+        "movdqu %%xmm0, 0(%[out])\n\t"
+        "movdqu %%xmm1, 16(%[out])\n\t"
+        "movdqu %%xmm2, 32(%[out])\n\t"
+        "movdqu %%xmm3, 48(%[out])\n\t"
+        "movdqu %%xmm4, 64(%[out])\n\t"
+        "movdqu %%xmm5, 80(%[out])\n\t"
+        "movdqu %%xmm6, 96(%[out])\n\t"
+        "movdqu %%xmm7, 112(%[out])\n\t"
+        "movdqu %%xmm8, 128(%[out])\n\t"
+        "movdqu %%xmm9, 144(%[out])\n\t"
+        "movdqu %%xmm10, 160(%[out])\n\t"
+        "movdqu %%xmm11, 176(%[out])\n\t"
+        "movdqu %%xmm12, 192(%[out])\n\t"
+        "movdqu %%xmm13, 208(%[out])\n\t"
+        "movdqu %%xmm14, 224(%[out])\n\t"
+        "movdqu %%xmm15, 240(%[out])\n\t"
+        : [pages] "+r" (pages), [count] "+r" (count)
+        : [in] "r" (in), [out] "r" (out)
+        : "rax", "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15");
+}
+
+/**
+ * stats [-h]: heap and page allocator statistics
+ */
+int memory_cmd_stats(int argc, char** argv) {
+    bool histograms = argc > 1 && argv[1][0] == '-' && argv[1][1] == 'h';
+    
+    memory_stats_t stats;
+    page_stats_t pages;
+    memory_get_stats(&stats);
+    page_get_stats(&pages);
+    
+    terminal_printf("Heap\n");
+    terminal_printf("  %-20s %llu KB\n", "total memory", (unsigned long long)(stats.total_memory / 1024));
+    terminal_printf("  %-20s %llu KB\n", "used", (unsigned long long)(stats.used_memory / 1024));
+    terminal_printf("  %-20s %llu KB in %llu blocks\n", "free in heap",
+                    (unsigned long long)(stats.free_bytes / 1024), (unsigned long long)stats.free_blocks);
+    terminal_printf("  %-20s %llu KB\n", "largest free block", (unsigned long long)(stats.largest_free_block / 1024));
+    terminal_printf("  %-20s %u.%u%%\n", "fragmentation",
+                    stats.fragmentation_index / 10, stats.fragmentation_index % 10);
+    
+    terminal_printf("Allocation\n");
+    terminal_printf("  %-20s %llu / %llu\n", "allocs / frees",
+                    (unsigned long long)stats.alloc_calls, (unsigned long long)stats.free_calls);
+    terminal_printf("  %-20s %llu.%02llu avg, %llu max\n", "blocks visited",
+                    (unsigned long long)(stats.alloc_calls ? stats.blocks_visited / stats.alloc_calls : 0),
+                    (unsigned long long)(stats.alloc_calls ? (stats.blocks_visited * 100 / stats.alloc_calls) % 100 : 0),
+                    (unsigned long long)stats.max_blocks_visited);
+    terminal_printf("  %-20s %llu\n", "insert scan steps", (unsigned long long)stats.insert_blocks_visited);
+    terminal_printf("  %-20s %llu next, %llu prev\n", "coalesced",
+                    (unsigned long long)stats.coalesce_next, (unsigned long long)stats.coalesce_prev);
+    terminal_printf("  %-20s %llu\n", "heap grows", (unsigned long long)stats.heap_grows);
+    terminal_printf("  %-20s %llu live, %llu KB, %llu total\n", "page-backed",
+                    (unsigned long long)stats.large_allocations, (unsigned long long)(stats.large_bytes / 1024),
+                    (unsigned long long)stats.large_alloc_calls);
+    terminal_printf("  %-20s %llu calls, %llu grown, %llu shrunk, %llu copied\n", "realloc",
+                    (unsigned long long)stats.realloc_calls, (unsigned long long)stats.realloc_grown_in_place,
+                    (unsigned long long)stats.realloc_shrunk_in_place, (unsigned long long)stats.realloc_copies);
+    terminal_printf("  %-20s %llu hits, %llu refills, %llu drains\n", "per-CPU magazines",
+                    (unsigned long long)stats.magazine_hits, (unsigned long long)stats.magazine_refills,
+                    (unsigned long long)stats.magazine_drains);
+    terminal_printf("  %-20s %llu remote frees, %llu KB cached\n", "",
+                    (unsigned long long)stats.remote_frees, (unsigned long long)(stats.cached_bytes / 1024));
+    
+    terminal_printf("Pages\n");
+    terminal_printf("  %-20s %llu of %llu free\n", "4 KB pages",
+                    (unsigned long long)pages.free_pages, (unsigned long long)pages.total_pages);
+    terminal_printf("  %-20s %llu pages, %llu hits, %llu misses, %llu zeroed idle\n", "pre-zeroed pool",
+                    (unsigned long long)pages.zero_pool_pages, (unsigned long long)pages.zero_pool_hits,
+                    (unsigned long long)pages.zero_pool_misses, (unsigned long long)pages.pages_zeroed_idle);
+    terminal_printf("  %-20s %llu local, %llu remote\n", "NUMA allocations",
+                    (unsigned long long)pages.local_allocations, (unsigned long long)pages.remote_allocations);
+    for (uint32_t node = 0; node < pages.node_count && pages.node_count > 1; node++) {
+        terminal_printf("  node %-15u %llu of %llu free\n", node,
+                        (unsigned long long)pages.node_free_pages[node], (unsigned long long)pages.node_total_pages[node]);
+    }
+    
+    paging_stats_t paging;
+    paging_get_stats(&paging);
+    
+    terminal_printf("Paging\n");
+    terminal_printf("  %-20s %llu x 4 KB, %llu x 2 MB, %llu x 1 GB\n", "mapped pages",
+                    (unsigned long long)paging.mapped_pages[0], (unsigned long long)paging.mapped_pages[1],
+                    (unsigned long long)paging.mapped_pages[2]);
+    terminal_printf("  %-20s %llu tables, %llu splits\n", "page tables",
+                    (unsigned long long)paging.tables, (unsigned long long)paging.splits);
+    terminal_printf("  %-20s 1 GB pages %s, NX %s\n", "features",
+                    paging.huge_1gb ? "yes" : "no", paging.no_execute ? "yes" : "no");
+    
+    tlb_stats_t tlb;
+    tlb_get_stats(&tlb);
+    
+    terminal_printf("TLB\n");
+    terminal_printf("  %-20s %s, INVPCID %s, %llu in use\n", "PCID",
+                    tlb.pcid_enabled ? "on" : "off", tlb.invpcid ? "yes" : "no", (unsigned long long)tlb.pcids_in_use);
+    terminal_printf("  %-20s %llu pages, %llu full\n", "flushes",
+                    (unsigned long long)tlb.page_flushes, (unsigned long long)tlb.full_flushes);
+    terminal_printf("  %-20s %llu, %llu kept the TLB\n", "space switches",
+                    (unsigned long long)tlb.switches, (unsigned long long)tlb.switches_kept);
+    terminal_printf("  %-20s %llu, %llu IPIs, %llu avoided\n", "shootdowns",
+                    (unsigned long long)tlb.shootdowns, (unsigned long long)tlb.ipis_sent,
+                    (unsigned long long)tlb.ipis_avoided);
+    
+    vm_stats_t vm;
+    vm_get_stats(&vm);
+    
+    terminal_printf("Virtual memory\n");
+    terminal_printf("  %-20s %llu areas, %llu KB reserved, %llu KB resident\n", "lazy areas",
+                    (unsigned long long)vm.areas, (unsigned long long)(vm.reserved_bytes / 1024),
+                    (unsigned long long)(vm.resident_pages * 4));
+    terminal_printf("  %-20s %llu total, %llu demand-zero, %llu unresolved\n", "page faults",
+                    (unsigned long long)vm.faults, (unsigned long long)vm.demand_zero_faults,
+                    (unsigned long long)vm.unresolved_faults);
+    terminal_printf("  %-20s %llu copies, %llu reuses, %llu shared frames\n", "copy-on-write",
+                    (unsigned long long)vm.cow_copies, (unsigned long long)vm.cow_reuses,
+                    (unsigned long long)vm.shared_frames);
+    terminal_printf("  %-20s %llu avg, %llu max\n", "fault cycles",
+                    (unsigned long long)(vm.faults ? vm.fault_cycles_total / vm.faults : 0),
+                    (unsigned long long)vm.fault_cycles_max);
+    
+    if (histograms) {
+        memory_tools_print_histogram("Allocations by size", stats.alloc_size_histogram);
+        memory_tools_print_histogram("Free blocks by size", stats.free_block_histogram);
+    }
+    
+    return 0;
+}
+
+/**
+ * faultcheck: take demand-zero and copy-on-write faults from inside a
+ * vector store loop and check that its registers survive the handler,
+ * which copies and zeroes pages with the SIMD routines
+ */
+int memory_cmd_faultcheck(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    
+    cpu_info_t cpu_info = {0};
+    cpu_detect(&cpu_info);
+    bool avx = cpu_avx_usable(&cpu_info);
+    size_t width = avx ? 32 : 16;
+    
+    // A fresh area faults in zeroed pages; a resident one shared with
+    // itself copies each page on the first write
+    vm_space_t* space = vm_kernel_space();
+    size_t size = MEMORY_TOOLS_FAULTCHECK_PAGES * PAGE_SIZE;
+    uint8_t* fresh = vm_reserve(space, size, VM_READ | VM_WRITE);
+    uint8_t* original = vm_reserve(space, size, VM_READ | VM_WRITE);
+    uint8_t* shared = NULL;
+    if (fresh && original) {
+        for (size_t i = 0; i < MEMORY_TOOLS_FAULTCHECK_PAGES; i++) {
+            original[i * PAGE_SIZE] = 1;
+        }
+        shared = vm_share(space, original, space);
+    }
+    
+    if (!fresh || !original || !shared) {
+        terminal_printf("faultcheck: cannot reserve the test areas\n");
+        if (fresh) vm_release(space, fresh);
+        if (original) vm_release(space, original);
+        return -1;
+    }
+    
+    uint8_t* pages[2 * MEMORY_TOOLS_FAULTCHECK_PAGES];
+    for (size_t i = 0; i < MEMORY_TOOLS_FAULTCHECK_PAGES; i++) {
+        pages[i] = fresh + i * PAGE_SIZE;
+        pages[MEMORY_TOOLS_FAULTCHECK_PAGES + i] = original + i * PAGE_SIZE;
+    }
+    
+    uint8_t in[MEMORY_TOOLS_FAULTCHECK_REGISTERS * MEMORY_TOOLS_FAULTCHECK_WIDTH];
+    uint8_t out[MEMORY_TOOLS_FAULTCHECK_REGISTERS * MEMORY_TOOLS_FAULTCHECK_WIDTH];
+    for (size_t i = 0; i < sizeof(in); i++) {
+        in[i] = (uint8_t)(i * 7 + 1);
+    }
+    memory_set(out, 0, sizeof(out));
+    
+    vm_stats_t before;
+    vm_stats_t after;
+    vm_get_stats(&before);
+    if (avx) {
+        memory_tools_store_loop_avx(pages, 2 * MEMORY_TOOLS_FAULTCHECK_PAGES, in, out);
+    } else {
+        memory_tools_store_loop_sse(pages, 2 * MEMORY_TOOLS_FAULTCHECK_PAGES, in, out);
+    }
+    vm_get_stats(&after);
+    
+    // Every register must come back as loaded and every page hold register 0
+    size_t bad_bytes = 0;
+    for (size_t i = 0; i < MEMORY_TOOLS_FAULTCHECK_REGISTERS * width; i++) {
+        bad_bytes += out[i] != in[i];
+    }
+    
+    size_t bad_pages = 0;
+    for (size_t i = 0; i < 2 * MEMORY_TOOLS_FAULTCHECK_PAGES; i++) {
+        for (size_t j = 0; j < width; j++) {
+            if (pages[i][j] != in[j]) {
+                bad_pages++;
+                break;
+            }
+        }
+    }
+    
+    terminal_printf("faultcheck: %s loop, %llu demand-zero and %llu copy-on-write faults\n",
+                    avx ? "AVX" : "SSE",
+                    (unsigned long long)(after.demand_zero_faults - before.demand_zero_faults),
+                    (unsigned long long)(after.cow_copies + after.cow_reuses - before.cow_copies - before.cow_reuses));
+    terminal_printf("  %llu register bytes changed, %llu pages wrong\n",
+                    (unsigned long long)bad_bytes, (unsigned long long)bad_pages);
+    
+    vm_release(space, shared);
+    vm_release(space, original);
+    vm_release(space, fresh);
+    return bad_bytes || bad_pages ? -1 : 0;
+}
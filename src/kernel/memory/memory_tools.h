@@ -150,6 +150,7 @@ int memory_cmd_protect(int argc, char** argv);
 int memory_cmd_regions(int argc, char** argv);
 int memory_cmd_stats(int argc, char** argv);
 int memory_cmd_validate(int argc, char** argv);
+int memory_cmd_faultcheck(int argc, char** argv);
 
 // Memory tools configuration
 typedef struct {
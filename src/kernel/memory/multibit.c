@@ -7,16 +7,245 @@
 
 #include "multibit.h"
 #include "memory.h"
+#include "vm.h"
+#include "page.h"
+#include "convert.h"
+#include "search.h"
+#include "gather.h"
+#include "integrate.h"
 #include <string.h>
 
+// Smallest region pool (nodes) and hash table (slots)
+#define MULTIBIT_REGION_MIN_NODES 64
+#define MULTIBIT_REGION_MIN_SLOTS 128
+
+// Multiplier for the base address hash and treap priority
+#define MULTIBIT_REGION_HASH 0x9E3779B97F4A7C15ULL
+
+// Region index node. Node 0 is a sentinel, so a zero link means none and
+// the zeroed state is an empty index.
+typedef struct {
+    multibit_memory_region_t region;
+    uint32_t left;              // Lower addresses; next free node while free
+    uint32_t right;             // Higher addresses
+    uint32_t priority;          // Treap heap order (from the base address)
+} multibit_region_node_t;
+
 // Global state for multi-bit memory management
 static struct {
     bool initialized;
-    multibit_memory_region_t regions[64];
+    
+    // Regions: a pool of nodes forming a treap ordered by base address,
+    // and an open-addressing hash of node indices keyed by base address
+    multibit_region_node_t* region_nodes;
+    uint32_t region_capacity;
+    uint32_t region_free;
+    uint32_t region_root;
     size_t region_count;
+    uint32_t* region_slots;
+    size_t region_slot_count;   // Power of two, more than twice region_count
+    
     multibit_memory_stats_t stats;
+    multibit_packed_stats_t packed_stats;
 } g_multibit_state = {0};
 
+/**
+ * Hash slot of a base address
+ */
+static inline size_t multibit_region_home(uint64_t base) {
+    return (size_t)((base * MULTIBIT_REGION_HASH) >> 32) & (g_multibit_state.region_slot_count - 1);
+}
+
+/**
+ * Slot holding base, or the empty slot where it would go
+ */
+static size_t multibit_region_slot(uint64_t base) {
+    size_t mask = g_multibit_state.region_slot_count - 1;
+    size_t slot = multibit_region_home(base);
+    while (g_multibit_state.region_slots[slot] != 0 &&
+           g_multibit_state.region_nodes[g_multibit_state.region_slots[slot]].region.base_address != base) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Node of the region at base (0 when there is none)
+ */
+static uint32_t multibit_region_lookup(uint64_t base) {
+    if (g_multibit_state.region_slot_count == 0) {
+        return 0;
+    }
+    return g_multibit_state.region_slots[multibit_region_slot(base)];
+}
+
+/**
+ * Empty a slot, shifting back later entries of its probe run so lookups
+ * never stop early
+ */
+static void multibit_region_unslot(size_t slot) {
+    size_t mask = g_multibit_state.region_slot_count - 1;
+    uint32_t* slots = g_multibit_state.region_slots;
+    size_t next = slot;
+    slots[slot] = 0;
+    for (;;) {
+        next = (next + 1) & mask;
+        if (slots[next] == 0) {
+            return;
+        }
+        
+        // An entry may fill the hole unless its home lies cyclically in (slot, next]
+        size_t home = multibit_region_home(g_multibit_state.region_nodes[slots[next]].region.base_address);
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            slots[slot] = slots[next];
+            slots[next] = 0;
+            slot = next;
+        }
+    }
+}
+
+/**
+ * Make room for one more region: a free node and a hash table that stays
+ * under half full. Node indices survive growth.
+ */
+static int multibit_region_reserve(void) {
+    if (g_multibit_state.region_free == 0) {
+        size_t old_capacity = g_multibit_state.region_capacity;
+        size_t capacity = old_capacity ? old_capacity * 2 : MULTIBIT_REGION_MIN_NODES;
+        if (capacity > UINT32_MAX) {
+            return -1;
+        }
+        
+        multibit_region_node_t* nodes = (multibit_region_node_t*)memory_alloc(capacity * sizeof(multibit_region_node_t));
+        if (!nodes) {
+            return -1;
+        }
+        if (g_multibit_state.region_nodes) {
+            memcpy(nodes, g_multibit_state.region_nodes, old_capacity * sizeof(multibit_region_node_t));
+            memory_free(g_multibit_state.region_nodes);
+        } else {
+            memset(&nodes[0], 0, sizeof(nodes[0]));
+            old_capacity = 1;
+        }
+        
+        // Chain the new nodes, lowest index first
+        for (size_t i = capacity; i-- > old_capacity;) {
+            nodes[i].left = g_multibit_state.region_free;
+            g_multibit_state.region_free = (uint32_t)i;
+        }
+        g_multibit_state.region_nodes = nodes;
+        g_multibit_state.region_capacity = (uint32_t)capacity;
+    }
+    
+    if (2 * (g_multibit_state.region_count + 1) >= g_multibit_state.region_slot_count) {
+        size_t old_count = g_multibit_state.region_slot_count;
+        uint32_t* old_slots = g_multibit_state.region_slots;
+        size_t count = old_count ? old_count * 2 : MULTIBIT_REGION_MIN_SLOTS;
+        uint32_t* slots = (uint32_t*)memory_alloc(count * sizeof(uint32_t));
+        if (!slots) {
+            return -1;
+        }
+        
+        memset(slots, 0, count * sizeof(uint32_t));
+        g_multibit_state.region_slots = slots;
+        g_multibit_state.region_slot_count = count;
+        for (size_t i = 0; i < old_count; i++) {
+            if (old_slots[i] != 0) {
+                uint64_t base = g_multibit_state.region_nodes[old_slots[i]].region.base_address;
+                slots[multibit_region_slot(base)] = old_slots[i];
+            }
+        }
+        if (old_slots) {
+            memory_free(old_slots);
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Treap rotations and updates (recursion depth is the treap depth,
+ * O(log n) expected since priorities are hashed addresses)
+ */
+static uint32_t multibit_treap_rotate_right(uint32_t node) {
+    multibit_region_node_t* nodes = g_multibit_state.region_nodes;
+    uint32_t left = nodes[node].left;
+    nodes[node].left = nodes[left].right;
+    nodes[left].right = node;
+    return left;
+}
+
+static uint32_t multibit_treap_rotate_left(uint32_t node) {
+    multibit_region_node_t* nodes = g_multibit_state.region_nodes;
+    uint32_t right = nodes[node].right;
+    nodes[node].right = nodes[right].left;
+    nodes[right].left = node;
+    return right;
+}
+
+static uint32_t multibit_treap_insert(uint32_t root, uint32_t node) {
+    multibit_region_node_t* nodes = g_multibit_state.region_nodes;
+    if (root == 0) {
+        return node;
+    }
+    
+    if (nodes[node].region.base_address < nodes[root].region.base_address) {
+        nodes[root].left = multibit_treap_insert(nodes[root].left, node);
+        if (nodes[nodes[root].left].priority > nodes[root].priority) {
+            root = multibit_treap_rotate_right(root);
+        }
+    } else {
+        nodes[root].right = multibit_treap_insert(nodes[root].right, node);
+        if (nodes[nodes[root].right].priority > nodes[root].priority) {
+            root = multibit_treap_rotate_left(root);
+        }
+    }
+    return root;
+}
+
+static uint32_t multibit_treap_merge(uint32_t left, uint32_t right) {
+    multibit_region_node_t* nodes = g_multibit_state.region_nodes;
+    if (left == 0) return right;
+    if (right == 0) return left;
+    
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = multibit_treap_merge(nodes[left].right, right);
+        return left;
+    }
+    nodes[right].left = multibit_treap_merge(left, nodes[right].left);
+    return right;
+}
+
+static uint32_t multibit_treap_remove(uint32_t root, uint64_t base) {
+    multibit_region_node_t* nodes = g_multibit_state.region_nodes;
+    if (root == 0) {
+        return 0;
+    }
+    
+    if (base < nodes[root].region.base_address) {
+        nodes[root].left = multibit_treap_remove(nodes[root].left, base);
+    } else if (base > nodes[root].region.base_address) {
+        nodes[root].right = multibit_treap_remove(nodes[root].right, base);
+    } else {
+        return multibit_treap_merge(nodes[root].left, nodes[root].right);
+    }
+    return root;
+}
+
+/**
+ * Copy regions out in address order, up to max_count
+ */
+static void multibit_treap_collect(uint32_t node, multibit_memory_region_t* regions, size_t max_count, size_t* count) {
+    while (node != 0 && *count < max_count) {
+        multibit_region_node_t* entry = &g_multibit_state.region_nodes[node];
+        multibit_treap_collect(entry->left, regions, max_count, count);
+        if (*count < max_count) {
+            regions[(*count)++] = entry->region;
+        }
+        node = entry->right;
+    }
+}
+
 /**
  * Initialize multi-bit memory system
  */
@@ -25,8 +254,16 @@ int multibit_memory_init(void) {
         return 0;
     }
     
-    g_multibit_state.region_count = 0;
     memset(&g_multibit_state.stats, 0, sizeof(g_multibit_state.stats));
+    memset(&g_multibit_state.packed_stats, 0, sizeof(g_multibit_state.packed_stats));
+    
+    // Pick the widening/narrowing, search, gather, packing and integration
+    // routines for this CPU
+    convert_init();
+    search_init();
+    gather_init();
+    packed_init();
+    integrate_init();
     
     g_multibit_state.initialized = true;
     return 0;
@@ -47,11 +284,11 @@ void memory_write16(void* address, uint16_t value) {
 
 uint16_t* memory_alloc16(size_t count) {
     if (count == 0) return NULL;
-    return (uint16_t*)memory_alloc(count * sizeof(uint16_t));
+    return (uint16_t*)memory_alloc_aligned(count * sizeof(uint16_t), MEMORY_CACHE_LINE_SIZE);
 }
 
 void memory_free16(uint16_t* ptr) {
-    if (ptr) memory_free(ptr);
+    if (ptr) memory_free_aligned(ptr);
 }
 
 /**
@@ -69,11 +306,11 @@ void memory_write32(void* address, uint32_t value) {
 
 uint32_t* memory_alloc32(size_t count) {
     if (count == 0) return NULL;
-    return (uint32_t*)memory_alloc(count * sizeof(uint32_t));
+    return (uint32_t*)memory_alloc_aligned(count * sizeof(uint32_t), MEMORY_CACHE_LINE_SIZE);
 }
 
 void memory_free32(uint32_t* ptr) {
-    if (ptr) memory_free(ptr);
+    if (ptr) memory_free_aligned(ptr);
 }
 
 /**
@@ -91,37 +328,31 @@ void memory_write64(void* address, uint64_t value) {
 
 uint64_t* memory_alloc64(size_t count) {
     if (count == 0) return NULL;
-    return (uint64_t*)memory_alloc(count * sizeof(uint64_t));
+    return (uint64_t*)memory_alloc_aligned(count * sizeof(uint64_t), MEMORY_CACHE_LINE_SIZE);
 }
 
 void memory_free64(uint64_t* ptr) {
-    if (ptr) memory_free(ptr);
+    if (ptr) memory_free_aligned(ptr);
 }
 
 /**
  * Generic memory access
  */
-void* memory_read_generic(void* address, memory_mode_t mode) {
-    if (!address) return NULL;
+int memory_read_generic(void* address, void* value, memory_mode_t mode) {
+    if (!address || !value) return -1;
     
     switch (mode) {
-        case MEMORY_MODE_16BIT: {
-            static uint16_t value;
-            value = memory_read16(address);
-            return &value;
-        }
-        case MEMORY_MODE_32BIT: {
-            static uint32_t value;
-            value = memory_read32(address);
-            return &value;
-        }
-        case MEMORY_MODE_64BIT: {
-            static uint64_t value;
-            value = memory_read64(address);
-            return &value;
-        }
+        case MEMORY_MODE_16BIT:
+            *(uint16_t*)value = memory_read16(address);
+            return 0;
+        case MEMORY_MODE_32BIT:
+            *(uint32_t*)value = memory_read32(address);
+            return 0;
+        case MEMORY_MODE_64BIT:
+            *(uint64_t*)value = memory_read64(address);
+            return 0;
         default:
-            return NULL;
+            return -1;
     }
 }
 
@@ -145,12 +376,33 @@ void memory_write_generic(void* address, void* value, memory_mode_t mode) {
  * Memory region management
  */
 int multibit_memory_alloc_region(memory_mode_t mode, size_t size, multibit_memory_region_t* region) {
-    if (!region || size == 0 || g_multibit_state.region_count >= 64) {
+    return multibit_memory_alloc_region_node(mode, size, MULTIBIT_NODE_LOCAL, region);
+}
+
+/**
+ * Allocate a region whose pages come from a NUMA node; the hint is dropped
+ * for small regions served by the heap before demand paging is up
+ */
+int multibit_memory_alloc_region_node(memory_mode_t mode, size_t size, uint32_t node, multibit_memory_region_t* region) {
+    if (!region || size == 0 || (node != MULTIBIT_NODE_LOCAL && node >= page_node_count())) {
+        return -1;
+    }
+    if (multibit_region_reserve() != 0) {
         return -1;
     }
     
-    // Allocate memory
-    void* ptr = memory_alloc(size);
+    // Large regions (simulation worlds) and regions pinned to a node are
+    // reserved lazily, so each page lands on its node when first touched;
+    // small ones, and everything before demand paging is up, come from the heap
+    void* ptr = NULL;
+    bool lazy = false;
+    if (size >= MULTIBIT_LAZY_THRESHOLD || node != MULTIBIT_NODE_LOCAL) {
+        ptr = vm_reserve_node(vm_kernel_space(), size, VM_READ | VM_WRITE, node);
+        lazy = ptr != NULL;
+    }
+    if (!ptr) {
+        ptr = memory_alloc(size);
+    }
     if (!ptr) {
         return -1;
     }
@@ -163,9 +415,19 @@ int multibit_memory_alloc_region(memory_mode_t mode, size_t size, multibit_memor
     region->is_executable = false;
     region->is_writable = true;
     region->is_readable = true;
-    
-    // Add to region list
-    g_multibit_state.regions[g_multibit_state.region_count] = *region;
+    region->is_lazy = lazy;
+    region->node = lazy ? node : MULTIBIT_NODE_LOCAL;
+    
+    // Index by base address, in the hash and in address order
+    uint32_t index = g_multibit_state.region_free;
+    multibit_region_node_t* entry = &g_multibit_state.region_nodes[index];
+    g_multibit_state.region_free = entry->left;
+    entry->region = *region;
+    entry->left = 0;
+    entry->right = 0;
+    entry->priority = (uint32_t)((region->base_address * MULTIBIT_REGION_HASH) >> 32);
+    g_multibit_state.region_slots[multibit_region_slot(region->base_address)] = index;
+    g_multibit_state.region_root = multibit_treap_insert(g_multibit_state.region_root, index);
     g_multibit_state.region_count++;
     
     // Update statistics
@@ -190,46 +452,77 @@ int multibit_memory_alloc_region(memory_mode_t mode, size_t size, multibit_memor
 int multibit_memory_free_region(multibit_memory_region_t* region) {
     if (!region) return -1;
     
-    // Find and remove region
-    for (size_t i = 0; i < g_multibit_state.region_count; i++) {
-        if (g_multibit_state.regions[i].base_address == region->base_address) {
-            // Free memory
-            memory_free((void*)region->base_address);
-            
-            // Remove from list
-            for (size_t j = i; j < g_multibit_state.region_count - 1; j++) {
-                g_multibit_state.regions[j] = g_multibit_state.regions[j + 1];
-            }
-            g_multibit_state.region_count--;
-            
-            // Update statistics
-            switch (region->bit_mode) {
-                case MEMORY_MODE_16BIT:
-                    g_multibit_state.stats.total_16bit_allocations--;
-                    g_multibit_state.stats.total_16bit_memory -= region->size;
-                    break;
-                case MEMORY_MODE_32BIT:
-                    g_multibit_state.stats.total_32bit_allocations--;
-                    g_multibit_state.stats.total_32bit_memory -= region->size;
-                    break;
-                case MEMORY_MODE_64BIT:
-                    g_multibit_state.stats.total_64bit_allocations--;
-                    g_multibit_state.stats.total_64bit_memory -= region->size;
-                    break;
-            }
-            
-            return 0;
+    uint32_t index = multibit_region_lookup(region->base_address);
+    if (index == 0) {
+        return -1;
+    }
+    
+    // The index's copy is authoritative for how to free and what to count
+    multibit_region_node_t* entry = &g_multibit_state.region_nodes[index];
+    multibit_memory_region_t freed = entry->region;
+    if (freed.is_lazy) {
+        vm_release(vm_kernel_space(), (void*)freed.base_address);
+    } else {
+        memory_free((void*)freed.base_address);
+    }
+    
+    // Drop from the hash and the treap, and return the node to the pool
+    multibit_region_unslot(multibit_region_slot(freed.base_address));
+    g_multibit_state.region_root = multibit_treap_remove(g_multibit_state.region_root, freed.base_address);
+    entry->left = g_multibit_state.region_free;
+    g_multibit_state.region_free = index;
+    g_multibit_state.region_count--;
+    
+    // Update statistics
+    switch (freed.bit_mode) {
+        case MEMORY_MODE_16BIT:
+            g_multibit_state.stats.total_16bit_allocations--;
+            g_multibit_state.stats.total_16bit_memory -= freed.size;
+            break;
+        case MEMORY_MODE_32BIT:
+            g_multibit_state.stats.total_32bit_allocations--;
+            g_multibit_state.stats.total_32bit_memory -= freed.size;
+            break;
+        case MEMORY_MODE_64BIT:
+            g_multibit_state.stats.total_64bit_allocations--;
+            g_multibit_state.stats.total_64bit_memory -= freed.size;
+            break;
+    }
+    
+    return 0;
+}
+
+/**
+ * Find the region containing an address: the last region starting at or
+ * below it, if the address falls inside
+ */
+int multibit_memory_find_region(uint64_t address, multibit_memory_region_t* region) {
+    multibit_region_node_t* nodes = g_multibit_state.region_nodes;
+    uint32_t node = g_multibit_state.region_root;
+    uint32_t below = 0;
+    while (node != 0) {
+        if (nodes[node].region.base_address <= address) {
+            below = node;
+            node = nodes[node].right;
+        } else {
+            node = nodes[node].left;
         }
     }
     
-    return -1;
+    if (below == 0 || address - nodes[below].region.base_address >= nodes[below].region.size) {
+        return -1;
+    }
+    if (region) {
+        *region = nodes[below].region;
+    }
+    return 0;
 }
 
 int multibit_memory_get_regions(multibit_memory_region_t* regions, size_t max_count, size_t* actual_count) {
     if (!regions || !actual_count) return -1;
     
-    size_t count = (g_multibit_state.region_count < max_count) ? g_multibit_state.region_count : max_count;
-    memcpy(regions, g_multibit_state.regions, count * sizeof(multibit_memory_region_t));
+    size_t count = 0;
+    multibit_treap_collect(g_multibit_state.region_root, regions, max_count, &count);
     *actual_count = count;
     
     return 0;
@@ -330,68 +623,51 @@ void memory_copy_64_to_64(void* dest, const void* src, size_t count) {
 
 void memory_copy_16_to_32(void* dest, const void* src, size_t count) {
     if (!dest || !src) return;
-    
-    uint16_t* src16 = (uint16_t*)src;
-    uint32_t* dest32 = (uint32_t*)dest;
-    
-    for (size_t i = 0; i < count; i++) {
-        dest32[i] = (uint32_t)src16[i];
-    }
+    convert_16_to_32((uint32_t*)dest, (const uint16_t*)src, count);
 }
 
 void memory_copy_32_to_16(void* dest, const void* src, size_t count) {
     if (!dest || !src) return;
-    
-    uint32_t* src32 = (uint32_t*)src;
-    uint16_t* dest16 = (uint16_t*)dest;
-    
-    for (size_t i = 0; i < count; i++) {
-        dest16[i] = (uint16_t)(src32[i] & 0xFFFF);
-    }
+    convert_32_to_16((uint16_t*)dest, (const uint32_t*)src, count, CONVERT_TRUNCATE);
 }
 
 void memory_copy_16_to_64(void* dest, const void* src, size_t count) {
     if (!dest || !src) return;
-    
-    uint16_t* src16 = (uint16_t*)src;
-    uint64_t* dest64 = (uint64_t*)dest;
-    
-    for (size_t i = 0; i < count; i++) {
-        dest64[i] = (uint64_t)src16[i];
-    }
+    convert_16_to_64((uint64_t*)dest, (const uint16_t*)src, count);
 }
 
 void memory_copy_64_to_16(void* dest, const void* src, size_t count) {
     if (!dest || !src) return;
-    
-    uint64_t* src64 = (uint64_t*)src;
-    uint16_t* dest16 = (uint16_t*)dest;
-    
-    for (size_t i = 0; i < count; i++) {
-        dest16[i] = (uint16_t)(src64[i] & 0xFFFF);
-    }
+    convert_64_to_16((uint16_t*)dest, (const uint64_t*)src, count, CONVERT_TRUNCATE);
 }
 
 void memory_copy_32_to_64(void* dest, const void* src, size_t count) {
     if (!dest || !src) return;
-    
-    uint32_t* src32 = (uint32_t*)src;
-    uint64_t* dest64 = (uint64_t*)dest;
-    
-    for (size_t i = 0; i < count; i++) {
-        dest64[i] = (uint64_t)src32[i];
-    }
+    convert_32_to_64((uint64_t*)dest, (const uint32_t*)src, count);
 }
 
 void memory_copy_64_to_32(void* dest, const void* src, size_t count) {
     if (!dest || !src) return;
-    
-    uint64_t* src64 = (uint64_t*)src;
-    uint32_t* dest32 = (uint32_t*)dest;
-    
-    for (size_t i = 0; i < count; i++) {
-        dest32[i] = (uint32_t)(src64[i] & 0xFFFFFFFF);
-    }
+    convert_64_to_32((uint32_t*)dest, (const uint64_t*)src, count, CONVERT_TRUNCATE);
+}
+
+/**
+ * Narrowing copies that clamp out-of-range values to the destination's
+ * maximum instead of keeping the low bits
+ */
+void memory_copy_32_to_16_saturate(void* dest, const void* src, size_t count) {
+    if (!dest || !src) return;
+    convert_32_to_16((uint16_t*)dest, (const uint32_t*)src, count, CONVERT_SATURATE);
+}
+
+void memory_copy_64_to_16_saturate(void* dest, const void* src, size_t count) {
+    if (!dest || !src) return;
+    convert_64_to_16((uint16_t*)dest, (const uint64_t*)src, count, CONVERT_SATURATE);
+}
+
+void memory_copy_64_to_32_saturate(void* dest, const void* src, size_t count) {
+    if (!dest || !src) return;
+    convert_64_to_32((uint32_t*)dest, (const uint64_t*)src, count, CONVERT_SATURATE);
 }
 
 /**
@@ -417,47 +693,107 @@ int memory_compare_64(const void* ptr1, const void* ptr2, size_t count) {
  */
 void* memory_search_16(const void* haystack, size_t haystack_size, uint16_t needle) {
     if (!haystack) return NULL;
-    
-    uint16_t* haystack16 = (uint16_t*)haystack;
-    size_t count = haystack_size / sizeof(uint16_t);
-    
-    for (size_t i = 0; i < count; i++) {
-        if (haystack16[i] == needle) {
-            return &haystack16[i];
-        }
-    }
-    
-    return NULL;
+    return (void*)search_first(haystack, haystack_size / sizeof(uint16_t), sizeof(uint16_t), needle);
+}
+
+size_t memory_search_all_16(const void* haystack, size_t haystack_size, uint16_t needle,
+                            size_t* offsets, size_t max_offsets) {
+    return search_all(haystack, haystack_size / sizeof(uint16_t), sizeof(uint16_t), needle, offsets, max_offsets);
+}
+
+size_t memory_search_count_16(const void* haystack, size_t haystack_size, uint16_t needle) {
+    return search_count(haystack, haystack_size / sizeof(uint16_t), sizeof(uint16_t), needle);
+}
+
+size_t memory_search_bitmap_16(const void* haystack, size_t haystack_size, uint16_t needle, uint64_t* bitmap) {
+    return search_bitmap(haystack, haystack_size / sizeof(uint16_t), sizeof(uint16_t), needle, bitmap);
 }
 
 void* memory_search_32(const void* haystack, size_t haystack_size, uint32_t needle) {
     if (!haystack) return NULL;
-    
-    uint32_t* haystack32 = (uint32_t*)haystack;
-    size_t count = haystack_size / sizeof(uint32_t);
-    
-    for (size_t i = 0; i < count; i++) {
-        if (haystack32[i] == needle) {
-            return &haystack32[i];
-        }
-    }
-    
-    return NULL;
+    return (void*)search_first(haystack, haystack_size / sizeof(uint32_t), sizeof(uint32_t), needle);
+}
+
+size_t memory_search_all_32(const void* haystack, size_t haystack_size, uint32_t needle,
+                            size_t* offsets, size_t max_offsets) {
+    return search_all(haystack, haystack_size / sizeof(uint32_t), sizeof(uint32_t), needle, offsets, max_offsets);
+}
+
+size_t memory_search_count_32(const void* haystack, size_t haystack_size, uint32_t needle) {
+    return search_count(haystack, haystack_size / sizeof(uint32_t), sizeof(uint32_t), needle);
+}
+
+size_t memory_search_bitmap_32(const void* haystack, size_t haystack_size, uint32_t needle, uint64_t* bitmap) {
+    return search_bitmap(haystack, haystack_size / sizeof(uint32_t), sizeof(uint32_t), needle, bitmap);
 }
 
 void* memory_search_64(const void* haystack, size_t haystack_size, uint64_t needle) {
     if (!haystack) return NULL;
-    
-    uint64_t* haystack64 = (uint64_t*)haystack;
-    size_t count = haystack_size / sizeof(uint64_t);
-    
-    for (size_t i = 0; i < count; i++) {
-        if (haystack64[i] == needle) {
-            return &haystack64[i];
-        }
-    }
-    
-    return NULL;
+    return (void*)search_first(haystack, haystack_size / sizeof(uint64_t), sizeof(uint64_t), needle);
+}
+
+size_t memory_search_all_64(const void* haystack, size_t haystack_size, uint64_t needle,
+                            size_t* offsets, size_t max_offsets) {
+    return search_all(haystack, haystack_size / sizeof(uint64_t), sizeof(uint64_t), needle, offsets, max_offsets);
+}
+
+size_t memory_search_count_64(const void* haystack, size_t haystack_size, uint64_t needle) {
+    return search_count(haystack, haystack_size / sizeof(uint64_t), sizeof(uint64_t), needle);
+}
+
+size_t memory_search_bitmap_64(const void* haystack, size_t haystack_size, uint64_t needle, uint64_t* bitmap) {
+    return search_bitmap(haystack, haystack_size / sizeof(uint64_t), sizeof(uint64_t), needle, bitmap);
+}
+
+/**
+ * Gather/scatter functions
+ */
+int memory_gather_16(void* dest, const void* base, ptrdiff_t stride, size_t count) {
+    return gather_strided(dest, base, stride, count, sizeof(uint16_t));
+}
+
+int memory_scatter_16(void* base, ptrdiff_t stride, const void* src, size_t count) {
+    return scatter_strided(base, stride, src, count, sizeof(uint16_t));
+}
+
+int memory_gather_indexed_16(void* dest, const void* base, const uint32_t* indices, size_t count) {
+    return gather_indexed(dest, base, indices, count, sizeof(uint16_t));
+}
+
+int memory_scatter_indexed_16(void* base, const uint32_t* indices, const void* src, size_t count) {
+    return scatter_indexed(base, indices, src, count, sizeof(uint16_t));
+}
+
+int memory_gather_32(void* dest, const void* base, ptrdiff_t stride, size_t count) {
+    return gather_strided(dest, base, stride, count, sizeof(uint32_t));
+}
+
+int memory_scatter_32(void* base, ptrdiff_t stride, const void* src, size_t count) {
+    return scatter_strided(base, stride, src, count, sizeof(uint32_t));
+}
+
+int memory_gather_indexed_32(void* dest, const void* base, const uint32_t* indices, size_t count) {
+    return gather_indexed(dest, base, indices, count, sizeof(uint32_t));
+}
+
+int memory_scatter_indexed_32(void* base, const uint32_t* indices, const void* src, size_t count) {
+    return scatter_indexed(base, indices, src, count, sizeof(uint32_t));
+}
+
+int memory_gather_64(void* dest, const void* base, ptrdiff_t stride, size_t count) {
+    return gather_strided(dest, base, stride, count, sizeof(uint64_t));
+}
+
+int memory_scatter_64(void* base, ptrdiff_t stride, const void* src, size_t count) {
+    return scatter_strided(base, stride, src, count, sizeof(uint64_t));
+}
+
+int memory_gather_indexed_64(void* dest, const void* base, const uint32_t* indices, size_t count) {
+    return gather_indexed(dest, base, indices, count, sizeof(uint64_t));
+}
+
+int memory_scatter_indexed_64(void* base, const uint32_t* indices, const void* src, size_t count) {
+    return scatter_indexed(base, indices, src, count, sizeof(uint64_t));
 }
 
 /**
@@ -468,32 +804,76 @@ void multibit_memory_get_stats(multibit_memory_stats_t* stats) {
     *stats = g_multibit_state.stats;
 }
 
+void multibit_packed_get_stats(multibit_packed_stats_t* stats) {
+    if (!stats) return;
+    *stats = g_multibit_state.packed_stats;
+}
+
+/**
+ * Packed integer arrays
+ */
+static size_t multibit_packed_slot_bytes(const packed_array_t* array) {
+    size_t slot = array->bits <= 16 ? sizeof(uint16_t) : array->bits <= 32 ? sizeof(uint32_t) : sizeof(uint64_t);
+    return array->count * slot;
+}
+
+int memory_alloc_packed(packed_array_t* array, unsigned int bits, size_t count) {
+    if (!array || count == 0) return -1;
+    
+    size_t words = packed_words(bits, count);
+    if (words == 0) return -1;
+    
+    uint64_t* storage = (uint64_t*)memory_alloc_aligned_zeroed(words * sizeof(uint64_t), MEMORY_CACHE_LINE_SIZE);
+    if (!storage) return -1;
+    
+    packed_attach(array, storage, bits, count);
+    
+    g_multibit_state.packed_stats.arrays++;
+    g_multibit_state.packed_stats.elements += count;
+    g_multibit_state.packed_stats.packed_bytes += words * sizeof(uint64_t);
+    g_multibit_state.packed_stats.slot_bytes += multibit_packed_slot_bytes(array);
+    return 0;
+}
+
+void memory_free_packed(packed_array_t* array) {
+    if (!array || !array->words) return;
+    
+    g_multibit_state.packed_stats.arrays--;
+    g_multibit_state.packed_stats.elements -= array->count;
+    g_multibit_state.packed_stats.packed_bytes -= packed_words(array->bits, array->count) * sizeof(uint64_t);
+    g_multibit_state.packed_stats.slot_bytes -= multibit_packed_slot_bytes(array);
+    
+    memory_free_aligned(array->words);
+    array->words = NULL;
+    array->count = 0;
+}
+
 /**
  * Physics engine specific functions
  */
 physics_vector_16_t* physics_alloc_vectors_16(size_t count) {
     if (count == 0) return NULL;
-    return (physics_vector_16_t*)memory_alloc(count * sizeof(physics_vector_16_t));
+    return (physics_vector_16_t*)memory_alloc_aligned_zeroed(count * sizeof(physics_vector_16_t), MEMORY_CACHE_LINE_SIZE);
 }
 
 physics_vector_32_t* physics_alloc_vectors_32(size_t count) {
     if (count == 0) return NULL;
-    return (physics_vector_32_t*)memory_alloc(count * sizeof(physics_vector_32_t));
+    return (physics_vector_32_t*)memory_alloc_aligned_zeroed(count * sizeof(physics_vector_32_t), MEMORY_CACHE_LINE_SIZE);
 }
 
 physics_vector_64_t* physics_alloc_vectors_64(size_t count) {
     if (count == 0) return NULL;
-    return (physics_vector_64_t*)memory_alloc(count * sizeof(physics_vector_64_t));
+    return (physics_vector_64_t*)memory_alloc_aligned_zeroed(count * sizeof(physics_vector_64_t), MEMORY_CACHE_LINE_SIZE);
 }
 
 void physics_free_vectors_16(physics_vector_16_t* vectors) {
-    if (vectors) memory_free(vectors);
+    if (vectors) memory_free_aligned(vectors);
 }
 
 void physics_free_vectors_32(physics_vector_32_t* vectors) {
-    if (vectors) memory_free(vectors);
+    if (vectors) memory_free_aligned(vectors);
 }
 
 void physics_free_vectors_64(physics_vector_64_t* vectors) {
-    if (vectors) memory_free(vectors);
+    if (vectors) memory_free_aligned(vectors);
 }
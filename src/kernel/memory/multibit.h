@@ -12,6 +12,7 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include "access.h"
+#include "packed.h"
 
 // Memory addressing modes
 //typedef enum {
@@ -36,8 +37,18 @@ typedef struct {
     bool is_executable;
     bool is_writable;
     bool is_readable;
+    bool is_lazy;       // Backed on first touch (regions of MULTIBIT_LAZY_THRESHOLD or more)
+    uint32_t node;      // NUMA node hint (MULTIBIT_NODE_LOCAL: the touching CPU's node)
 } multibit_memory_region_t;
 
+// Regions at least this large are reserved lazily and cost no memory until
+// their pages are touched
+#define MULTIBIT_LAZY_THRESHOLD (2 * 1024 * 1024)
+
+// Node hint for regions that follow the CPU touching them (same value as
+// PAGE_NODE_LOCAL)
+#define MULTIBIT_NODE_LOCAL 0xFFFFFFFFu
+
 // Memory access functions for different bit modes
 // 16-bit memory access
 uint16_t memory_read16(void* address);
@@ -57,14 +68,21 @@ void memory_write64(void* address, uint64_t value);
 uint64_t* memory_alloc64(size_t count);
 void memory_free64(uint64_t* ptr);
 
-// Generic memory access (auto-detects bit mode)
-void* memory_read_generic(void* address, memory_mode_t mode);
+// Generic memory access: the caller passes the element width as mode, and
+// value points to an element of that width (uint16_t, uint32_t or
+// uint64_t). read stores the element at address into *value and returns 0,
+// or -1 for a bad mode or NULL pointer; write stores *value at address.
+int memory_read_generic(void* address, void* value, memory_mode_t mode);
 void memory_write_generic(void* address, void* value, memory_mode_t mode);
 
-// Memory region management
+// Memory region management (regions are indexed by base address: free is
+// a hash lookup, find_region an ordered search for the region containing
+// an address, and get_regions lists them in address order)
 int multibit_memory_init(void);
 int multibit_memory_alloc_region(memory_mode_t mode, size_t size, multibit_memory_region_t* region);
+int multibit_memory_alloc_region_node(memory_mode_t mode, size_t size, uint32_t node, multibit_memory_region_t* region);
 int multibit_memory_free_region(multibit_memory_region_t* region);
+int multibit_memory_find_region(uint64_t address, multibit_memory_region_t* region);
 int multibit_memory_get_regions(multibit_memory_region_t* regions, size_t max_count, size_t* actual_count);
 
 // Memory mode conversion
@@ -80,7 +98,8 @@ bool memory_is_aligned(void* address, memory_mode_t mode);
 void* memory_align(void* address, memory_mode_t mode);
 size_t memory_align_size(size_t size, memory_mode_t mode);
 
-// Memory copying with different bit modes
+// Memory copying with different bit modes (vectorized; narrowing keeps the
+// low bits, the _saturate variants clamp to the destination's maximum)
 void memory_copy_16_to_16(void* dest, const void* src, size_t count);
 void memory_copy_32_to_32(void* dest, const void* src, size_t count);
 void memory_copy_64_to_64(void* dest, const void* src, size_t count);
@@ -90,17 +109,56 @@ void memory_copy_16_to_64(void* dest, const void* src, size_t count);
 void memory_copy_64_to_16(void* dest, const void* src, size_t count);
 void memory_copy_32_to_64(void* dest, const void* src, size_t count);
 void memory_copy_64_to_32(void* dest, const void* src, size_t count);
+void memory_copy_32_to_16_saturate(void* dest, const void* src, size_t count);
+void memory_copy_64_to_16_saturate(void* dest, const void* src, size_t count);
+void memory_copy_64_to_32_saturate(void* dest, const void* src, size_t count);
 
 // Memory comparison with different bit modes
 int memory_compare_16(const void* ptr1, const void* ptr2, size_t count);
 int memory_compare_32(const void* ptr1, const void* ptr2, size_t count);
 int memory_compare_64(const void* ptr1, const void* ptr2, size_t count);
 
-// Memory search functions
+// Memory search functions (vectorized; sizes in bytes, offsets in elements)
 void* memory_search_16(const void* haystack, size_t haystack_size, uint16_t needle);
 void* memory_search_32(const void* haystack, size_t haystack_size, uint32_t needle);
 void* memory_search_64(const void* haystack, size_t haystack_size, uint64_t needle);
 
+// Every match: up to max_offsets offsets in ascending order, returns how many were stored
+size_t memory_search_all_16(const void* haystack, size_t haystack_size, uint16_t needle,
+                            size_t* offsets, size_t max_offsets);
+size_t memory_search_all_32(const void* haystack, size_t haystack_size, uint32_t needle,
+                            size_t* offsets, size_t max_offsets);
+size_t memory_search_all_64(const void* haystack, size_t haystack_size, uint64_t needle,
+                            size_t* offsets, size_t max_offsets);
+
+// Number of matches
+size_t memory_search_count_16(const void* haystack, size_t haystack_size, uint16_t needle);
+size_t memory_search_count_32(const void* haystack, size_t haystack_size, uint32_t needle);
+size_t memory_search_count_64(const void* haystack, size_t haystack_size, uint64_t needle);
+
+// Match bitmap (bit i set when element i matches; one uint64_t per 64
+// elements, rounded up), returns the number of matches
+size_t memory_search_bitmap_16(const void* haystack, size_t haystack_size, uint16_t needle, uint64_t* bitmap);
+size_t memory_search_bitmap_32(const void* haystack, size_t haystack_size, uint32_t needle, uint64_t* bitmap);
+size_t memory_search_bitmap_64(const void* haystack, size_t haystack_size, uint64_t needle, uint64_t* bitmap);
+
+// Gather/scatter between scattered elements and a dense buffer of count
+// elements (vectorized; strides in bytes, indices in elements)
+int memory_gather_16(void* dest, const void* base, ptrdiff_t stride, size_t count);
+int memory_gather_32(void* dest, const void* base, ptrdiff_t stride, size_t count);
+int memory_gather_64(void* dest, const void* base, ptrdiff_t stride, size_t count);
+int memory_scatter_16(void* base, ptrdiff_t stride, const void* src, size_t count);
+int memory_scatter_32(void* base, ptrdiff_t stride, const void* src, size_t count);
+int memory_scatter_64(void* base, ptrdiff_t stride, const void* src, size_t count);
+
+// Indexed forms (the last of several equal scatter indices wins)
+int memory_gather_indexed_16(void* dest, const void* base, const uint32_t* indices, size_t count);
+int memory_gather_indexed_32(void* dest, const void* base, const uint32_t* indices, size_t count);
+int memory_gather_indexed_64(void* dest, const void* base, const uint32_t* indices, size_t count);
+int memory_scatter_indexed_16(void* base, const uint32_t* indices, const void* src, size_t count);
+int memory_scatter_indexed_32(void* base, const uint32_t* indices, const void* src, size_t count);
+int memory_scatter_indexed_64(void* base, const uint32_t* indices, const void* src, size_t count);
+
 // Memory statistics for different bit modes
 typedef struct {
     size_t total_16bit_allocations;
@@ -116,6 +174,21 @@ typedef struct {
 
 void multibit_memory_get_stats(multibit_memory_stats_t* stats);
 
+// Packed array statistics (live arrays from memory_alloc_packed)
+typedef struct {
+    size_t arrays;
+    size_t elements;
+    size_t packed_bytes;        // Memory the arrays take
+    size_t slot_bytes;          // Memory the same elements would take in 16/32/64-bit slots
+} multibit_packed_stats_t;
+
+void multibit_packed_get_stats(multibit_packed_stats_t* stats);
+
+// Packed integer arrays of 1-63-bit elements, zeroed (see packed.h for
+// element access, bulk pack/unpack and copies between widths)
+int memory_alloc_packed(packed_array_t* array, unsigned int bits, size_t count);
+void memory_free_packed(packed_array_t* array);
+
 // Physics engine specific functions (16-bit optimized)
 typedef struct {
     uint16_t x, y, z;  // Position (16-bit for physics precision)
@@ -135,7 +208,7 @@ typedef struct {
     uint64_t ax, ay, az; // Acceleration
 } physics_vector_64_t;
 
-// Physics memory allocation
+// Physics memory allocation (vectors come back zeroed)
 physics_vector_16_t* physics_alloc_vectors_16(size_t count);
 physics_vector_32_t* physics_alloc_vectors_32(size_t count);
 physics_vector_64_t* physics_alloc_vectors_64(size_t count);
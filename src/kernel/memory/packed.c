@@ -0,0 +1,696 @@
+/**
+ * CompileOS Packed Integer Arrays - Implementation
+ *
+ * Every element read goes through packed_read, which funnels the 64 bits
+ * starting at any bit position out of two neighbouring words; the padding
+ * word at the end of each array keeps the second load in bounds. Bulk
+ * packs stream their output through a one-word accumulator, so each word
+ * is stored once and only the first and last words of a run are merged
+ * with their neighbours' bits.
+ *
+ * The BMI2 variant moves one 64-bit lane word at a time: pdep spreads
+ * four 16-bit or two 32-bit lanes' worth of packed bits into place, and
+ * pext gathers them back. The AVX2 variant unpacks eight elements per
+ * step. Eight elements span exactly bits bytes, so the bit phase repeats
+ * from block to block: a pshufb with constants built once per call moves
+ * each element's bytes into its lane, and a per-lane shift and mask finish
+ * it. It packs with pext, since there is no lane-crossing bit shift to
+ * pack with.
+ */
+
+#include "packed.h"
+#include "../../hal/arch/x86_64/cpu.h"
+#include <immintrin.h>
+
+// Unaligned, aliasing lane access
+typedef uint16_t packed_u16_t __attribute__((may_alias, aligned(1)));
+typedef uint32_t packed_u32_t __attribute__((may_alias, aligned(1)));
+typedef uint64_t packed_u64_t __attribute__((may_alias, aligned(1)));
+
+// Elements per packed_copy step (staged through a lane buffer on the stack)
+#define PACKED_COPY_CHUNK 128
+
+// Widest elements one 32- or 64-bit window holds at any bit phase
+#define PACKED_WINDOW_BITS_32 25
+#define PACKED_WINDOW_BITS_64 57
+
+// Routines (bit is the first element's bit position)
+typedef void (*packed_unpack_t)(const packed_array_t* array, uint64_t bit, size_t count, char* dest);
+typedef void (*packed_pack_t)(packed_array_t* array, uint64_t bit, size_t count, const char* src, bool saturate);
+
+// Dispatch table (each indexed by lane width: 16, 32, 64 bits)
+typedef struct {
+    packed_unpack_t unpack[3];
+    packed_pack_t pack[3];
+} packed_table_t;
+
+// Output bit stream
+typedef struct {
+    uint64_t* word;             // Word being filled
+    uint64_t acc;               // Its bits so far
+    unsigned int fill;          // How many
+} packed_writer_t;
+
+/**
+ * Mask of the low bits bits (1 .. 64)
+ */
+static inline uint64_t packed_mask(unsigned int bits) {
+    return ~0ULL >> (64 - bits);
+}
+
+/**
+ * The 64 bits starting at a bit position
+ */
+static inline uint64_t packed_read(const uint64_t* words, uint64_t bit) {
+    size_t word = (size_t)(bit >> 6);
+    unsigned int shift = (unsigned int)(bit & 63);
+    
+    // Split shift: a shift of 64 when shift is 0 would be undefined
+    return (words[word] >> shift) | ((words[word + 1] << 1) << (63 - shift));
+}
+
+static inline uint64_t packed_load(const char* p, size_t width) {
+    switch (width) {
+        case 2: return *(const packed_u16_t*)p;
+        case 4: return *(const packed_u32_t*)p;
+        default: return *(const packed_u64_t*)p;
+    }
+}
+
+static inline void packed_store(char* p, size_t width, uint64_t value) {
+    switch (width) {
+        case 2: *(packed_u16_t*)p = (uint16_t)value; break;
+        case 4: *(packed_u32_t*)p = (uint32_t)value; break;
+        default: *(packed_u64_t*)p = value; break;
+    }
+}
+
+/**
+ * Start writing at a bit position, keeping the bits below it
+ */
+static inline void packed_writer_start(packed_writer_t* writer, uint64_t* words, uint64_t bit) {
+    writer->word = words + (bit >> 6);
+    writer->fill = (unsigned int)(bit & 63);
+    writer->acc = *writer->word & ((1ULL << writer->fill) - 1);
+}
+
+/**
+ * Append the low n bits of value (1 .. 64; value has no bits above them)
+ */
+static inline void packed_writer_put(packed_writer_t* writer, uint64_t value, unsigned int n) {
+    writer->acc |= value << writer->fill;
+    writer->fill += n;
+    
+    if (writer->fill >= 64) {
+        *writer->word++ = writer->acc;
+        writer->fill -= 64;
+        writer->acc = writer->fill ? value >> (n - writer->fill) : 0;
+    }
+}
+
+/**
+ * Merge the last partial word, keeping the bits above the stream
+ */
+static inline void packed_writer_finish(packed_writer_t* writer) {
+    if (writer->fill) {
+        uint64_t low = (1ULL << writer->fill) - 1;
+        *writer->word = (*writer->word & ~low) | writer->acc;
+    }
+}
+
+/**
+ * Unpack one element at a time (width is a constant at every call, so
+ * each caller gets its own specialized loop)
+ */
+static inline __attribute__((always_inline))
+void packed_unpack_scalar(const packed_array_t* array, uint64_t bit, size_t count, char* dest, size_t width) {
+    const uint64_t* words = array->words;
+    unsigned int bits = array->bits;
+    uint64_t mask = packed_mask(bits);
+    
+    for (size_t i = 0; i < count; i++, bit += bits) {
+        packed_store(dest + i * width, width, packed_read(words, bit) & mask);
+    }
+}
+
+/**
+ * Pack one element at a time
+ */
+static inline __attribute__((always_inline))
+void packed_pack_scalar(packed_array_t* array, uint64_t bit, size_t count, const char* src, size_t width,
+                        bool saturate) {
+    unsigned int bits = array->bits;
+    uint64_t mask = packed_mask(bits);
+    packed_writer_t writer;
+    
+    packed_writer_start(&writer, array->words, bit);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = packed_load(src + i * width, width);
+        if (value > mask) {
+            value = saturate ? mask : value & mask;
+        }
+        packed_writer_put(&writer, value, bits);
+    }
+    packed_writer_finish(&writer);
+}
+
+/**
+ * Element mask repeated in each lane of a 64-bit word
+ */
+static inline uint64_t packed_lane_mask(unsigned int bits, size_t width) {
+    uint64_t lanes = 0;
+    for (size_t lane = 0; lane < 8 / width; lane++) {
+        lanes |= packed_mask(bits) << (lane * width * 8);
+    }
+    return lanes;
+}
+
+/**
+ * Unpack a 64-bit word of lanes at a time with pdep (elements no wider
+ * than the lanes; 64-bit lanes take the scalar loop)
+ */
+__attribute__((target("bmi2")))
+static inline __attribute__((always_inline))
+void packed_unpack_pdep(const packed_array_t* array, uint64_t bit, size_t count, char* dest, size_t width) {
+    const uint64_t* words = array->words;
+    unsigned int bits = array->bits;
+    size_t lanes = 8 / width;
+    uint64_t deposit = packed_lane_mask(bits, width);
+    
+    size_t i = 0;
+    for (; count - i >= lanes; i += lanes, bit += lanes * bits) {
+        *(packed_u64_t*)(dest + i * width) = _pdep_u64(packed_read(words, bit), deposit);
+    }
+    
+    packed_unpack_scalar(array, bit, count - i, dest + i * width, width);
+}
+
+/**
+ * Pack a 64-bit word of lanes at a time with pext (elements no narrower
+ * than the lanes take the scalar loop)
+ */
+__attribute__((target("bmi2")))
+static inline __attribute__((always_inline))
+void packed_pack_pext(packed_array_t* array, uint64_t bit, size_t count, const char* src, size_t width,
+                      bool saturate) {
+    unsigned int bits = array->bits;
+    if (bits >= width * 8) {
+        packed_pack_scalar(array, bit, count, src, width, saturate);
+        return;
+    }
+    
+    size_t lanes = 8 / width;
+    uint64_t mask = packed_mask(bits);
+    uint64_t extract = packed_lane_mask(bits, width);
+    packed_writer_t writer;
+    
+    packed_writer_start(&writer, array->words, bit);
+    size_t i = 0;
+    for (; count - i >= lanes; i += lanes) {
+        uint64_t value = *(const packed_u64_t*)(src + i * width);
+        uint64_t packed;
+        if (saturate && (value & ~extract)) {
+            // Some lane is too wide: clamp them one by one
+            packed = 0;
+            for (size_t lane = 0; lane < lanes; lane++) {
+                uint64_t element = packed_load(src + (i + lane) * width, width);
+                packed |= (element > mask ? mask : element) << (lane * bits);
+            }
+        } else {
+            packed = _pext_u64(value, extract);
+        }
+        packed_writer_put(&writer, packed, (unsigned int)(lanes * bits));
+    }
+    packed_writer_finish(&writer);
+    
+    packed_pack_scalar(array, bit + (uint64_t)i * bits, count - i, src + i * width, width, saturate);
+}
+
+// Generic
+
+static void packed_unpack_16_generic(const packed_array_t* array, uint64_t bit, size_t count, char* dest) {
+    packed_unpack_scalar(array, bit, count, dest, 2);
+}
+
+static void packed_unpack_32_generic(const packed_array_t* array, uint64_t bit, size_t count, char* dest) {
+    packed_unpack_scalar(array, bit, count, dest, 4);
+}
+
+static void packed_unpack_64_generic(const packed_array_t* array, uint64_t bit, size_t count, char* dest) {
+    packed_unpack_scalar(array, bit, count, dest, 8);
+}
+
+static void packed_pack_16_generic(packed_array_t* array, uint64_t bit, size_t count, const char* src, bool saturate) {
+    packed_pack_scalar(array, bit, count, src, 2, saturate);
+}
+
+static void packed_pack_32_generic(packed_array_t* array, uint64_t bit, size_t count, const char* src, bool saturate) {
+    packed_pack_scalar(array, bit, count, src, 4, saturate);
+}
+
+static void packed_pack_64_generic(packed_array_t* array, uint64_t bit, size_t count, const char* src, bool saturate) {
+    packed_pack_scalar(array, bit, count, src, 8, saturate);
+}
+
+// BMI2 (pdep/pext on 64-bit words of lanes)
+
+__attribute__((target("bmi2")))
+static void packed_unpack_16_bmi2(const packed_array_t* array, uint64_t bit, size_t count, char* dest) {
+    packed_unpack_pdep(array, bit, count, dest, 2);
+}
+
+__attribute__((target("bmi2")))
+static void packed_unpack_32_bmi2(const packed_array_t* array, uint64_t bit, size_t count, char* dest) {
+    packed_unpack_pdep(array, bit, count, dest, 4);
+}
+
+__attribute__((target("bmi2")))
+static void packed_pack_16_bmi2(packed_array_t* array, uint64_t bit, size_t count, const char* src, bool saturate) {
+    packed_pack_pext(array, bit, count, src, 2, saturate);
+}
+
+__attribute__((target("bmi2")))
+static void packed_pack_32_bmi2(packed_array_t* array, uint64_t bit, size_t count, const char* src, bool saturate) {
+    packed_pack_pext(array, bit, count, src, 4, saturate);
+}
+
+// AVX2 (in-lane byte shuffles; loads read up to 16 bytes past the element
+// they start at, so blocks stop short of the end of the array's words)
+
+/**
+ * Constants for eight 32-bit windows from a block of eight elements at bit
+ * phase phase: lanes 0-3 read the block's first 16 bytes, lanes 4-7 the 16
+ * bytes from *high on
+ */
+__attribute__((target("avx2")))
+static void packed_windows_32(unsigned int bits, unsigned int phase, __m256i* shuffle, __m256i* shift,
+                              unsigned int* high) {
+    uint8_t bytes[32];
+    uint32_t shifts[8];
+    
+    *high = (phase + 4 * bits) >> 3;
+    for (unsigned int j = 0; j < 8; j++) {
+        unsigned int position = phase + j * bits;
+        unsigned int offset = (position >> 3) - (j < 4 ? 0 : *high);
+        for (unsigned int b = 0; b < 4; b++) {
+            bytes[j * 4 + b] = (uint8_t)(offset + b);
+        }
+        shifts[j] = position & 7;
+    }
+    
+    *shuffle = _mm256_loadu_si256((const __m256i*)bytes);
+    *shift = _mm256_loadu_si256((const __m256i*)shifts);
+}
+
+/**
+ * Eight elements of a block starting at byte p
+ */
+__attribute__((target("avx2")))
+static inline __m256i packed_block_32_avx2(const uint8_t* p, unsigned int high, __m256i shuffle, __m256i shift,
+                                           __m256i mask) {
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+                                        _mm_loadu_si128((const __m128i*)(p + high)), 1);
+    return _mm256_and_si256(_mm256_srlv_epi32(_mm256_shuffle_epi8(v, shuffle), shift), mask);
+}
+
+__attribute__((target("avx2,bmi2")))
+static void packed_unpack_16_avx2(const packed_array_t* array, uint64_t bit, size_t count, char* dest) {
+    unsigned int bits = array->bits;
+    const uint8_t* bytes = (const uint8_t*)array->words;
+    uint64_t limit = (uint64_t)packed_words(array->bits, array->count) * 8;
+    
+    __m256i shuffle, shift;
+    unsigned int high;
+    packed_windows_32(bits, (unsigned int)(bit & 7), &shuffle, &shift, &high);
+    __m256i mask = _mm256_set1_epi32((int)packed_mask(bits));
+    
+    // Two blocks per step, narrowed together; the permute restores the
+    // order the per-lane pack leaves interleaved
+    uint64_t byte = bit >> 3;
+    size_t i = 0;
+    for (; count - i >= 16 && byte + bits + high + 16 <= limit; i += 16, byte += 2 * bits) {
+        __m256i a = packed_block_32_avx2(bytes + byte, high, shuffle, shift, mask);
+        __m256i b = packed_block_32_avx2(bytes + byte + bits, high, shuffle, shift, mask);
+        __m256i v = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(dest + i * 2), v);
+    }
+    
+    packed_unpack_pdep(array, bit + (uint64_t)i * bits, count - i, dest + i * 2, 2);
+}
+
+__attribute__((target("avx2,bmi2")))
+static void packed_unpack_32_avx2(const packed_array_t* array, uint64_t bit, size_t count, char* dest) {
+    unsigned int bits = array->bits;
+    if (bits > PACKED_WINDOW_BITS_32) {
+        packed_unpack_pdep(array, bit, count, dest, 4);
+        return;
+    }
+    
+    const uint8_t* bytes = (const uint8_t*)array->words;
+    uint64_t limit = (uint64_t)packed_words(array->bits, array->count) * 8;
+    
+    __m256i shuffle, shift;
+    unsigned int high;
+    packed_windows_32(bits, (unsigned int)(bit & 7), &shuffle, &shift, &high);
+    __m256i mask = _mm256_set1_epi32((int)packed_mask(bits));
+    
+    uint64_t byte = bit >> 3;
+    size_t i = 0;
+    for (; count - i >= 8 && byte + high + 16 <= limit; i += 8, byte += bits) {
+        _mm256_storeu_si256((__m256i*)(dest + i * 4), packed_block_32_avx2(bytes + byte, high, shuffle, shift, mask));
+    }
+    
+    packed_unpack_pdep(array, bit + (uint64_t)i * bits, count - i, dest + i * 4, 4);
+}
+
+__attribute__((target("avx2,bmi2")))
+static void packed_unpack_64_avx2(const packed_array_t* array, uint64_t bit, size_t count, char* dest) {
+    unsigned int bits = array->bits;
+    if (bits > PACKED_WINDOW_BITS_64) {
+        packed_unpack_scalar(array, bit, count, dest, 8);
+        return;
+    }
+    
+    const uint8_t* bytes = (const uint8_t*)array->words;
+    uint64_t limit = (uint64_t)packed_words(array->bits, array->count) * 8;
+    unsigned int phase = (unsigned int)(bit & 7);
+    
+    // Block of eight as four 16-byte loads of two 64-bit windows each
+    uint8_t shuffle_bytes[64];
+    uint64_t shifts[8];
+    unsigned int start[4];
+    for (unsigned int h = 0; h < 4; h++) {
+        start[h] = (phase + 2 * h * bits) >> 3;
+    }
+    for (unsigned int j = 0; j < 8; j++) {
+        unsigned int position = phase + j * bits;
+        unsigned int offset = (position >> 3) - start[j / 2];
+        for (unsigned int b = 0; b < 8; b++) {
+            shuffle_bytes[j * 8 + b] = (uint8_t)(offset + b);
+        }
+        shifts[j] = position & 7;
+    }
+    __m256i shuffle_low = _mm256_loadu_si256((const __m256i*)shuffle_bytes);
+    __m256i shuffle_high = _mm256_loadu_si256((const __m256i*)(shuffle_bytes + 32));
+    __m256i shift_low = _mm256_loadu_si256((const __m256i*)shifts);
+    __m256i shift_high = _mm256_loadu_si256((const __m256i*)(shifts + 4));
+    __m256i mask = _mm256_set1_epi64x((long long)packed_mask(bits));
+    
+    uint64_t byte = bit >> 3;
+    size_t i = 0;
+    for (; count - i >= 8 && byte + start[3] + 16 <= limit; i += 8, byte += bits) {
+        const uint8_t* p = bytes + byte;
+        __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p + start[0]))),
+                                            _mm_loadu_si128((const __m128i*)(p + start[1])), 1);
+        __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p + start[2]))),
+                                            _mm_loadu_si128((const __m128i*)(p + start[3])), 1);
+        a = _mm256_and_si256(_mm256_srlv_epi64(_mm256_shuffle_epi8(a, shuffle_low), shift_low), mask);
+        b = _mm256_and_si256(_mm256_srlv_epi64(_mm256_shuffle_epi8(b, shuffle_high), shift_high), mask);
+        _mm256_storeu_si256((__m256i*)(dest + i * 8), a);
+        _mm256_storeu_si256((__m256i*)(dest + i * 8 + 32), b);
+    }
+    
+    packed_unpack_scalar(array, bit + (uint64_t)i * bits, count - i, dest + i * 8, 8);
+}
+
+// Variant tables
+static const packed_table_t g_packed_tables[PACKED_VARIANT_COUNT] = {
+    [PACKED_VARIANT_GENERIC] = {
+        { packed_unpack_16_generic, packed_unpack_32_generic, packed_unpack_64_generic },
+        { packed_pack_16_generic, packed_pack_32_generic, packed_pack_64_generic }
+    },
+    [PACKED_VARIANT_BMI2] = {
+        { packed_unpack_16_bmi2, packed_unpack_32_bmi2, packed_unpack_64_generic },
+        { packed_pack_16_bmi2, packed_pack_32_bmi2, packed_pack_64_generic }
+    },
+    [PACKED_VARIANT_AVX2] = {
+        { packed_unpack_16_avx2, packed_unpack_32_avx2, packed_unpack_64_avx2 },
+        { packed_pack_16_bmi2, packed_pack_32_bmi2, packed_pack_64_generic }
+    }
+};
+
+static const char* const g_packed_variant_names[PACKED_VARIANT_COUNT] = {
+    [PACKED_VARIANT_GENERIC] = "generic",
+    [PACKED_VARIANT_BMI2] = "bmi2",
+    [PACKED_VARIANT_AVX2] = "avx2"
+};
+
+// Routines state (generic until packed_init has looked at the CPU)
+static struct {
+    bool initialized;
+    packed_variant_t variant;
+    bool supported[PACKED_VARIANT_COUNT];
+    packed_table_t table;
+} g_packed_state = {
+    false, PACKED_VARIANT_GENERIC, { true },
+    {
+        { packed_unpack_16_generic, packed_unpack_32_generic, packed_unpack_64_generic },
+        { packed_pack_16_generic, packed_pack_32_generic, packed_pack_64_generic }
+    }
+};
+
+/**
+ * Whether pdep/pext run as slow microcode (AMD before family 19h)
+ */
+static bool packed_pdep_microcoded(const cpu_info_t* info) {
+    bool amd = info->vendor_id[0] == 0x68747541 && info->vendor_id[1] == 0x69746E65 &&
+               info->vendor_id[2] == 0x444D4163;
+    unsigned int family = info->family == 0xF ? info->family + info->ext_family : info->family;
+    return amd && family < 0x19;
+}
+
+/**
+ * Whether first .. first + count - 1 are elements of the array
+ */
+static bool packed_range_valid(const packed_array_t* array, size_t first, size_t count) {
+    return array && array->words && first <= array->count && count <= array->count - first;
+}
+
+/**
+ * Detect the supported variants and select the best one
+ */
+void packed_init(void) {
+    if (g_packed_state.initialized) {
+        return;
+    }
+    
+    cpu_info_t cpu_info = {0};
+    cpu_detect(&cpu_info);
+    
+    g_packed_state.supported[PACKED_VARIANT_GENERIC] = true;
+    g_packed_state.supported[PACKED_VARIANT_BMI2] = cpu_info.features.bmi2;
+    g_packed_state.supported[PACKED_VARIANT_AVX2] =
+        cpu_info.features.avx2 && cpu_info.features.bmi2 && cpu_avx_usable(&cpu_info);
+    
+    // Both SIMD variants pack with pext
+    if (!packed_pdep_microcoded(&cpu_info)) {
+        for (int variant = PACKED_VARIANT_COUNT - 1; variant >= 0; variant--) {
+            if (packed_set_variant((packed_variant_t)variant) == 0) {
+                break;
+            }
+        }
+    }
+    
+    g_packed_state.initialized = true;
+}
+
+/**
+ * Check whether this CPU can run a variant
+ */
+bool packed_variant_supported(packed_variant_t variant) {
+    return variant < PACKED_VARIANT_COUNT && g_packed_state.supported[variant];
+}
+
+/**
+ * Switch all routines to a variant
+ */
+int packed_set_variant(packed_variant_t variant) {
+    if (!packed_variant_supported(variant)) {
+        return -1;
+    }
+    
+    g_packed_state.variant = variant;
+    g_packed_state.table = g_packed_tables[variant];
+    return 0;
+}
+
+/**
+ * Get the selected variant
+ */
+packed_variant_t packed_get_variant(void) {
+    return g_packed_state.variant;
+}
+
+/**
+ * Get a variant's name
+ */
+const char* packed_variant_name(packed_variant_t variant) {
+    return variant < PACKED_VARIANT_COUNT ? g_packed_variant_names[variant] : "unknown";
+}
+
+/**
+ * Words needed for count elements of bits each
+ */
+size_t packed_words(unsigned int bits, size_t count) {
+    if (bits < PACKED_MIN_BITS || bits > PACKED_MAX_BITS || count > (SIZE_MAX - 63) / bits) {
+        return 0;
+    }
+    
+    return (count * bits + 63) / 64 + 1;
+}
+
+/**
+ * Point an array at caller storage
+ */
+int packed_attach(packed_array_t* array, uint64_t* words, unsigned int bits, size_t count) {
+    if (!array || !words || packed_words(bits, count) == 0) {
+        return -1;
+    }
+    
+    array->words = words;
+    array->count = count;
+    array->bits = bits;
+    return 0;
+}
+
+/**
+ * Read one element
+ */
+uint64_t packed_get(const packed_array_t* array, size_t index) {
+    if (!packed_range_valid(array, index, 1)) {
+        return 0;
+    }
+    
+    return packed_read(array->words, (uint64_t)index * array->bits) & packed_mask(array->bits);
+}
+
+/**
+ * Write one element
+ */
+int packed_set(packed_array_t* array, size_t index, uint64_t value) {
+    if (!packed_range_valid(array, index, 1)) {
+        return -1;
+    }
+    
+    unsigned int bits = array->bits;
+    uint64_t mask = packed_mask(bits);
+    uint64_t bit = (uint64_t)index * bits;
+    uint64_t* word = array->words + (bit >> 6);
+    unsigned int shift = (unsigned int)(bit & 63);
+    
+    value &= mask;
+    word[0] = (word[0] & ~(mask << shift)) | (value << shift);
+    
+    // The element runs on into the next word
+    if (shift + bits > 64) {
+        unsigned int spill = shift + bits - 64;
+        word[1] = (word[1] & ~packed_mask(spill)) | (value >> (bits - spill));
+    }
+    
+    return 0;
+}
+
+/**
+ * Unpack a run into 16-bit lanes
+ */
+int packed_unpack_16(const packed_array_t* array, size_t first, size_t count, uint16_t* dest) {
+    if (!packed_range_valid(array, first, count) || !dest || array->bits > 16) {
+        return -1;
+    }
+    
+    g_packed_state.table.unpack[0](array, (uint64_t)first * array->bits, count, (char*)dest);
+    return 0;
+}
+
+/**
+ * Unpack a run into 32-bit lanes
+ */
+int packed_unpack_32(const packed_array_t* array, size_t first, size_t count, uint32_t* dest) {
+    if (!packed_range_valid(array, first, count) || !dest || array->bits > 32) {
+        return -1;
+    }
+    
+    g_packed_state.table.unpack[1](array, (uint64_t)first * array->bits, count, (char*)dest);
+    return 0;
+}
+
+/**
+ * Unpack a run into 64-bit lanes
+ */
+int packed_unpack_64(const packed_array_t* array, size_t first, size_t count, uint64_t* dest) {
+    if (!packed_range_valid(array, first, count) || !dest) {
+        return -1;
+    }
+    
+    g_packed_state.table.unpack[2](array, (uint64_t)first * array->bits, count, (char*)dest);
+    return 0;
+}
+
+/**
+ * Pack a run from 16-bit lanes
+ */
+int packed_pack_16(packed_array_t* array, size_t first, size_t count, const uint16_t* src, convert_mode_t mode) {
+    if (!packed_range_valid(array, first, count) || !src) {
+        return -1;
+    }
+    
+    if (count) {
+        g_packed_state.table.pack[0](array, (uint64_t)first * array->bits, count, (const char*)src,
+                                     mode == CONVERT_SATURATE);
+    }
+    return 0;
+}
+
+/**
+ * Pack a run from 32-bit lanes
+ */
+int packed_pack_32(packed_array_t* array, size_t first, size_t count, const uint32_t* src, convert_mode_t mode) {
+    if (!packed_range_valid(array, first, count) || !src) {
+        return -1;
+    }
+    
+    if (count) {
+        g_packed_state.table.pack[1](array, (uint64_t)first * array->bits, count, (const char*)src,
+                                     mode == CONVERT_SATURATE);
+    }
+    return 0;
+}
+
+/**
+ * Pack a run from 64-bit lanes
+ */
+int packed_pack_64(packed_array_t* array, size_t first, size_t count, const uint64_t* src, convert_mode_t mode) {
+    if (!packed_range_valid(array, first, count) || !src) {
+        return -1;
+    }
+    
+    if (count) {
+        g_packed_state.table.pack[2](array, (uint64_t)first * array->bits, count, (const char*)src,
+                                     mode == CONVERT_SATURATE);
+    }
+    return 0;
+}
+
+/**
+ * Copy a run between arrays, staging chunks in the narrowest lanes that
+ * hold the source elements
+ */
+int packed_copy(packed_array_t* dest, size_t dest_first, const packed_array_t* src, size_t src_first,
+                size_t count, convert_mode_t mode) {
+    if (!packed_range_valid(dest, dest_first, count) || !packed_range_valid(src, src_first, count)) {
+        return -1;
+    }
+    
+    int slot = src->bits <= 16 ? 0 : src->bits <= 32 ? 1 : 2;
+    uint64_t lanes[PACKED_COPY_CHUNK];
+    
+    for (size_t done = 0; done < count;) {
+        size_t chunk = count - done < PACKED_COPY_CHUNK ? count - done : PACKED_COPY_CHUNK;
+        g_packed_state.table.unpack[slot](src, (uint64_t)(src_first + done) * src->bits, chunk, (char*)lanes);
+        g_packed_state.table.pack[slot](dest, (uint64_t)(dest_first + done) * dest->bits, chunk, (const char*)lanes,
+                                        mode == CONVERT_SATURATE);
+        done += chunk;
+    }
+    
+    return 0;
+}
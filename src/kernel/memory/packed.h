@@ -0,0 +1,78 @@
+/**
+ * CompileOS Packed Integer Arrays - Header
+ *
+ * Arrays of unsigned integers of any width from 1 to 63 bits, stored back
+ * to back in 64-bit words: element i starts at bit i * bits, low bits
+ * first. A 10- or 12-bit field takes 10 or 12 bits instead of a 16-bit
+ * slot. Single elements are read and written in place. The bulk routines
+ * unpack runs into 16-, 32- or 64-bit lanes and pack them back, with BMI2
+ * (pdep/pext) and AVX2 variants, one of which is selected at boot from
+ * the CPU feature bits.
+ */
+
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "convert.h"
+
+// Element widths
+#define PACKED_MIN_BITS 1
+#define PACKED_MAX_BITS 63
+
+// Routine variants
+typedef enum {
+    PACKED_VARIANT_GENERIC,
+    PACKED_VARIANT_BMI2,
+    PACKED_VARIANT_AVX2,
+    PACKED_VARIANT_COUNT
+} packed_variant_t;
+
+// Array (words holds packed_words(bits, count) words)
+typedef struct {
+    uint64_t* words;
+    size_t count;
+    unsigned int bits;
+} packed_array_t;
+
+// Variant selection (init picks the best variant the CPU supports, passing
+// over pdep/pext where they are microcoded)
+void packed_init(void);
+bool packed_variant_supported(packed_variant_t variant);
+int packed_set_variant(packed_variant_t variant);
+packed_variant_t packed_get_variant(void);
+const char* packed_variant_name(packed_variant_t variant);
+
+// Words behind count elements of bits each, counting the padding word the
+// routines may read past the last element; 0 for a width out of range or
+// a size that does not fit
+size_t packed_words(unsigned int bits, size_t count);
+
+// Point an array at caller storage of packed_words(bits, count) words
+int packed_attach(packed_array_t* array, uint64_t* words, unsigned int bits, size_t count);
+
+// Single elements: get returns 0 past the end, set keeps the low bits of
+// value
+uint64_t packed_get(const packed_array_t* array, size_t index);
+int packed_set(packed_array_t* array, size_t index, uint64_t value);
+
+// Unpack elements first .. first + count - 1, zero-extended, into lanes at
+// least as wide as the array's elements
+int packed_unpack_16(const packed_array_t* array, size_t first, size_t count, uint16_t* dest);
+int packed_unpack_32(const packed_array_t* array, size_t first, size_t count, uint32_t* dest);
+int packed_unpack_64(const packed_array_t* array, size_t first, size_t count, uint64_t* dest);
+
+// Pack lanes into elements first .. first + count - 1; mode decides what
+// happens to values too wide for the array
+int packed_pack_16(packed_array_t* array, size_t first, size_t count, const uint16_t* src, convert_mode_t mode);
+int packed_pack_32(packed_array_t* array, size_t first, size_t count, const uint32_t* src, convert_mode_t mode);
+int packed_pack_64(packed_array_t* array, size_t first, size_t count, const uint64_t* src, convert_mode_t mode);
+
+// Copy count elements between arrays of any two widths (zero-extending,
+// truncating or saturating by mode); the ranges must not overlap
+int packed_copy(packed_array_t* dest, size_t dest_first, const packed_array_t* src, size_t src_first,
+                size_t count, convert_mode_t mode);
+
+#endif // PACKED_H
@@ -0,0 +1,782 @@
+/**
+ * CompileOS Page Frame Allocator - Implementation
+ *
+ * Binary buddy allocator over the RAM regions reported by the HAL. Free
+ * blocks are kept on per-order lists whose links live in the free pages
+ * themselves; one byte of metadata per page records whether a page heads a
+ * free block and at which order, which is all coalescing needs.
+ *
+ * Memory is split by NUMA node: each node owns the frames the HAL assigns
+ * to it and keeps its own free lists, pool and lock, and blocks never
+ * merge across a node boundary. Allocations go to the calling CPU's node
+ * by default and fall back to the other nodes in order of distance.
+ *
+ * A pool of pre-zeroed blocks, filled at idle time with non-temporal
+ * stores, lets zero-filled allocations skip the clearing on the critical
+ * path. The pool is handed back to the free lists before an allocation
+ * would fail.
+ */
+
+#include "page.h"
+#include "memops.h"
+#include "../spinlock.h"
+#include "../../hal/hal.h"
+#include <string.h>
+
+// Per-page metadata
+#define PAGE_INFO_FREE 0x80
+#define PAGE_INFO_ORDER_MASK 0x1F
+
+// Maximum number of memory map entries read from the HAL
+#define PAGE_MAX_REGIONS 64
+
+// Maximum number of NUMA memory ranges read from the HAL
+#define PAGE_MAX_NODE_RANGES 32
+
+// Free block list node (stored in the free block itself)
+typedef struct page_free_node {
+    struct page_free_node* next;
+    struct page_free_node* prev;
+} page_free_node_t;
+
+// Per-node allocator; the lock protects the node's lists, counters and the
+// metadata of its pages (taken with interrupts off)
+typedef struct {
+    spinlock_t lock;
+    page_free_node_t* free_lists[PAGE_ORDER_COUNT];
+    uint64_t free_blocks[PAGE_ORDER_COUNT];
+    uint64_t total_pages;
+    uint64_t free_pages;
+    
+    // Pre-zeroed pool (singly linked through the first word of each block,
+    // which is cleared again when the block is handed out)
+    page_free_node_t* zero_lists[PAGE_ZERO_MAX_ORDER + 1];
+    uint64_t zero_blocks[PAGE_ZERO_MAX_ORDER + 1];
+    uint64_t zero_pool_pages;
+    uint64_t zero_pool_hits;
+    uint64_t zero_pool_misses;
+    uint64_t pages_zeroed_idle;
+    
+    uint64_t local_allocations;
+    uint64_t remote_allocations;
+    
+    // Nodes to try for an allocation aimed at this one, nearest first
+    uint32_t fallback[PAGE_MAX_NODES];
+} page_node_state_t;
+
+// Physical range owned by a node
+typedef struct {
+    uint64_t start_pfn;
+    uint64_t end_pfn;
+    uint32_t node;
+} page_node_range_t;
+
+// Page allocator state
+static struct {
+    bool initialized;
+    uint64_t base_pfn;
+    uint64_t span_pages;
+    uint8_t* page_info;
+    
+    // Frames outside every range belong to node 0
+    uint32_t node_count;
+    page_node_range_t ranges[PAGE_MAX_NODE_RANGES];
+    size_t range_count;
+    page_node_state_t nodes[PAGE_MAX_NODES];
+} g_page_state = {0};
+
+static page_free_node_t* page_node(uint64_t pfn) {
+    return (page_free_node_t*)(uintptr_t)(pfn << PAGE_SHIFT);
+}
+
+static bool page_pfn_valid(uint64_t pfn) {
+    return pfn >= g_page_state.base_pfn && pfn - g_page_state.base_pfn < g_page_state.span_pages;
+}
+
+static uint8_t* page_info(uint64_t pfn) {
+    return &g_page_state.page_info[pfn - g_page_state.base_pfn];
+}
+
+/**
+ * Node owning a page frame
+ */
+static uint32_t page_pfn_node(uint64_t pfn) {
+    for (size_t i = 0; i < g_page_state.range_count; i++) {
+        if (pfn >= g_page_state.ranges[i].start_pfn && pfn < g_page_state.ranges[i].end_pfn) {
+            return g_page_state.ranges[i].node;
+        }
+    }
+    return 0;
+}
+
+/**
+ * First frame after pfn where the owning node may change
+ */
+static uint64_t page_node_boundary(uint64_t pfn) {
+    uint64_t boundary = UINT64_MAX;
+    
+    for (size_t i = 0; i < g_page_state.range_count; i++) {
+        const page_node_range_t* range = &g_page_state.ranges[i];
+        if (range->start_pfn > pfn && range->start_pfn < boundary) {
+            boundary = range->start_pfn;
+        }
+        if (range->end_pfn > pfn && range->end_pfn < boundary) {
+            boundary = range->end_pfn;
+        }
+    }
+    
+    return boundary;
+}
+
+static void page_list_push(page_node_state_t* node, uint64_t pfn, unsigned int order) {
+    page_free_node_t* entry = page_node(pfn);
+    
+    entry->prev = NULL;
+    entry->next = node->free_lists[order];
+    if (entry->next) {
+        entry->next->prev = entry;
+    }
+    node->free_lists[order] = entry;
+    node->free_blocks[order]++;
+    
+    *page_info(pfn) = (uint8_t)(PAGE_INFO_FREE | order);
+}
+
+static void page_list_remove(page_node_state_t* node, uint64_t pfn, unsigned int order) {
+    page_free_node_t* entry = page_node(pfn);
+    
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        node->free_lists[order] = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    }
+    node->free_blocks[order]--;
+    
+    *page_info(pfn) = 0;
+}
+
+/**
+ * Return a block to its node's free lists, merging with free buddies of
+ * the same node
+ */
+static void page_free_block(page_node_state_t* node, uint64_t pfn, unsigned int order) {
+    uint32_t owner = (uint32_t)(node - g_page_state.nodes);
+    
+    while (order < PAGE_MAX_ORDER) {
+        uint64_t buddy = pfn ^ (1ULL << order);
+        if (!page_pfn_valid(buddy) || *page_info(buddy) != (PAGE_INFO_FREE | order) ||
+            (g_page_state.range_count && page_pfn_node(buddy) != owner)) {
+            break;
+        }
+        
+        page_list_remove(node, buddy, order);
+        if (buddy < pfn) {
+            pfn = buddy;
+        }
+        order++;
+    }
+    
+    page_list_push(node, pfn, order);
+}
+
+/**
+ * Free an arbitrary page range within one node as the largest naturally
+ * aligned blocks
+ */
+static void page_free_range(page_node_state_t* node, uint64_t start_pfn, uint64_t end_pfn) {
+    while (start_pfn < end_pfn) {
+        unsigned int order = PAGE_MAX_ORDER;
+        if (start_pfn) {
+            unsigned int align = (unsigned int)__builtin_ctzll(start_pfn);
+            if (align < order) {
+                order = align;
+            }
+        }
+        while (start_pfn + (1ULL << order) > end_pfn) {
+            order--;
+        }
+        
+        page_free_block(node, start_pfn, order);
+        start_pfn += 1ULL << order;
+    }
+}
+
+/**
+ * Hand a range of usable frames to the nodes that own them (init only)
+ */
+static void page_release_range(uint64_t start_pfn, uint64_t end_pfn) {
+    while (start_pfn < end_pfn) {
+        uint64_t boundary = page_node_boundary(start_pfn);
+        uint64_t end = boundary < end_pfn ? boundary : end_pfn;
+        page_node_state_t* node = &g_page_state.nodes[page_pfn_node(start_pfn)];
+        
+        page_free_range(node, start_pfn, end);
+        node->total_pages += end - start_pfn;
+        node->free_pages += end - start_pfn;
+        start_pfn = end;
+    }
+}
+
+/**
+ * Read the node layout from the HAL and order each node's fallbacks by
+ * distance
+ */
+static void page_init_nodes(void) {
+    uint32_t count = hal_numa_node_count();
+    if (count == 0) {
+        count = 1;
+    }
+    if (count > PAGE_MAX_NODES) {
+        count = PAGE_MAX_NODES;
+    }
+    g_page_state.node_count = count;
+    
+    numa_memory_region_t regions[PAGE_MAX_NODE_RANGES];
+    size_t region_count = 0;
+    
+    g_page_state.range_count = 0;
+    if (count > 1 && hal_numa_memory_map(regions, PAGE_MAX_NODE_RANGES, &region_count) == HAL_SUCCESS) {
+        for (size_t i = 0; i < region_count; i++) {
+            uint64_t start = (regions[i].base_address + PAGE_SIZE - 1) >> PAGE_SHIFT;
+            uint64_t end = (regions[i].base_address + regions[i].size) >> PAGE_SHIFT;
+            if (start >= end || regions[i].node >= count) {
+                continue;
+            }
+            
+            page_node_range_t* range = &g_page_state.ranges[g_page_state.range_count++];
+            range->start_pfn = start;
+            range->end_pfn = end;
+            range->node = regions[i].node;
+        }
+    }
+    
+    // Insertion sort by distance; the node itself (distance 10) comes first
+    for (uint32_t from = 0; from < count; from++) {
+        uint32_t* order = g_page_state.nodes[from].fallback;
+        
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t candidate = (from + i) % count;
+            uint32_t distance = hal_numa_distance(from, candidate);
+            uint32_t j = i;
+            
+            while (j > 0 && hal_numa_distance(from, order[j - 1]) > distance) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = candidate;
+        }
+    }
+}
+
+/**
+ * Initialize the page allocator from the HAL memory map
+ */
+int page_init(void) {
+    if (g_page_state.initialized) {
+        return 0;
+    }
+    
+    memory_region_t regions[PAGE_MAX_REGIONS];
+    size_t count;
+    
+    if (hal_memory_map(regions, PAGE_MAX_REGIONS, &count) != HAL_SUCCESS) {
+        return -1;
+    }
+    
+    // Find the span of usable page frames
+    uint64_t lowest_pfn = UINT64_MAX;
+    uint64_t highest_pfn = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        if (regions[i].type != MEMORY_TYPE_RAM || !regions[i].is_available) {
+            continue;
+        }
+        
+        uint64_t start = (regions[i].base_address + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        uint64_t end = (regions[i].base_address + regions[i].size) >> PAGE_SHIFT;
+        if (start == 0) {
+            start = 1; // Never hand out the page at address zero
+        }
+        if (start >= end) {
+            continue;
+        }
+        
+        if (start < lowest_pfn) lowest_pfn = start;
+        if (end > highest_pfn) highest_pfn = end;
+    }
+    
+    if (lowest_pfn >= highest_pfn) {
+        return -1;
+    }
+    
+    // Carve the per-page metadata out of the first region that can hold it
+    uint64_t span = highest_pfn - lowest_pfn;
+    uint64_t info_pages = (span + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint64_t info_pfn = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        if (regions[i].type != MEMORY_TYPE_RAM || !regions[i].is_available) {
+            continue;
+        }
+        
+        uint64_t start = (regions[i].base_address + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        uint64_t end = (regions[i].base_address + regions[i].size) >> PAGE_SHIFT;
+        if (start < lowest_pfn) {
+            start = lowest_pfn;
+        }
+        if (end > start && end - start >= info_pages) {
+            info_pfn = start;
+            break;
+        }
+    }
+    
+    if (!info_pfn) {
+        return -1;
+    }
+    
+    g_page_state.base_pfn = lowest_pfn;
+    g_page_state.span_pages = span;
+    g_page_state.page_info = (uint8_t*)(uintptr_t)(info_pfn << PAGE_SHIFT);
+    memset(g_page_state.page_info, 0, (size_t)span);
+    
+    page_init_nodes();
+    
+    // Release every usable frame except the metadata itself
+    for (size_t i = 0; i < count; i++) {
+        if (regions[i].type != MEMORY_TYPE_RAM || !regions[i].is_available) {
+            continue;
+        }
+        
+        uint64_t start = (regions[i].base_address + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        uint64_t end = (regions[i].base_address + regions[i].size) >> PAGE_SHIFT;
+        if (start < lowest_pfn) {
+            start = lowest_pfn;
+        }
+        if (start >= end) {
+            continue;
+        }
+        
+        if (info_pfn >= start && info_pfn < end) {
+            page_release_range(start, info_pfn);
+            page_release_range(info_pfn + info_pages, end);
+        } else {
+            page_release_range(start, end);
+        }
+    }
+    
+    g_page_state.initialized = true;
+    return 0;
+}
+
+/**
+ * Take a 2^order block off a node's free lists (node lock held)
+ */
+static void* page_alloc_block(page_node_state_t* node, unsigned int order) {
+    // Find the smallest non-empty order that can satisfy the request
+    unsigned int current = order;
+    while (current <= PAGE_MAX_ORDER && !node->free_lists[current]) {
+        current++;
+    }
+    if (current > PAGE_MAX_ORDER) {
+        return NULL;
+    }
+    
+    uint64_t pfn = (uint64_t)(uintptr_t)node->free_lists[current] >> PAGE_SHIFT;
+    page_list_remove(node, pfn, current);
+    
+    // Split, returning the upper halves to the free lists
+    while (current > order) {
+        current--;
+        page_list_push(node, pfn + (1ULL << current), current);
+    }
+    
+    node->free_pages -= 1ULL << order;
+    return (void*)(uintptr_t)(pfn << PAGE_SHIFT);
+}
+
+/**
+ * Take a pre-zeroed block from a node's pool (node lock held)
+ */
+static void* page_zero_pool_take(page_node_state_t* node, unsigned int order) {
+    if (order > PAGE_ZERO_MAX_ORDER || !node->zero_lists[order]) {
+        return NULL;
+    }
+    
+    page_free_node_t* entry = node->zero_lists[order];
+    node->zero_lists[order] = entry->next;
+    node->zero_blocks[order]--;
+    node->zero_pool_pages -= 1ULL << order;
+    
+    entry->next = NULL;
+    return entry;
+}
+
+/**
+ * Return every pre-zeroed block of a node to its free lists (node lock held)
+ */
+static void page_zero_pool_drain(page_node_state_t* node) {
+    for (unsigned int order = 0; order <= PAGE_ZERO_MAX_ORDER; order++) {
+        void* block;
+        while ((block = page_zero_pool_take(node, order)) != NULL) {
+            node->free_pages += 1ULL << order;
+            page_free_block(node, (uint64_t)(uintptr_t)block >> PAGE_SHIFT, order);
+        }
+    }
+}
+
+/**
+ * Take a block off a node's free lists, reclaiming its pre-zeroed pool if
+ * they cannot satisfy the request (node lock held)
+ */
+static void* page_alloc_block_reclaim(page_node_state_t* node, unsigned int order) {
+    void* block = page_alloc_block(node, order);
+    if (!block && node->zero_pool_pages) {
+        page_zero_pool_drain(node);
+        block = page_alloc_block(node, order);
+    }
+    return block;
+}
+
+/**
+ * Take a block for a zeroed allocation, preferring the node's pool (node
+ * lock held); sets *zeroed when the block needs no clearing
+ */
+static void* page_alloc_block_zeroed(page_node_state_t* node, unsigned int order, bool* zeroed) {
+    void* block = page_zero_pool_take(node, order);
+    
+    *zeroed = block != NULL;
+    if (block) {
+        node->zero_pool_hits++;
+        return block;
+    }
+    
+    node->zero_pool_misses++;
+    return page_alloc_block_reclaim(node, order);
+}
+
+/**
+ * Resolve a node argument (PAGE_NODE_LOCAL or an index) to a node index;
+ * returns false for nodes that do not exist
+ */
+static bool page_resolve_node(uint32_t node, uint32_t* index) {
+    if (node == PAGE_NODE_LOCAL) {
+        *index = page_local_node();
+        return true;
+    }
+    if (node >= g_page_state.node_count) {
+        return false;
+    }
+    
+    *index = node;
+    return true;
+}
+
+/**
+ * Take a 2^order block from the preferred node or, unless PAGE_ALLOC_STRICT
+ * is set, the nearest node that has one. For a count below 2^order the
+ * unused tail goes back to the serving node. Sets *zeroed when the block
+ * came from a pre-zeroed pool.
+ */
+static void* page_alloc_from_nodes(uint32_t preferred, unsigned int order, uint64_t count,
+                                   unsigned int flags, bool* zeroed) {
+    const uint32_t* fallback = g_page_state.nodes[preferred].fallback;
+    uint32_t tries = (flags & PAGE_ALLOC_STRICT) ? 1 : g_page_state.node_count;
+    
+    *zeroed = false;
+    
+    for (uint32_t i = 0; i < tries; i++) {
+        page_node_state_t* node = &g_page_state.nodes[fallback[i]];
+        
+        uint64_t irq_state = spin_lock_irqsave(&node->lock);
+        void* block = (flags & PAGE_ALLOC_ZERO)
+            ? page_alloc_block_zeroed(node, order, zeroed)
+            : page_alloc_block_reclaim(node, order);
+        
+        if (block) {
+            if (count < (1ULL << order)) {
+                uint64_t pfn = (uint64_t)(uintptr_t)block >> PAGE_SHIFT;
+                page_free_range(node, pfn + count, pfn + (1ULL << order));
+                node->free_pages += (1ULL << order) - count;
+            }
+            
+            if (i == 0) {
+                node->local_allocations++;
+            } else {
+                node->remote_allocations++;
+            }
+        }
+        spin_unlock_irqrestore(&node->lock, irq_state);
+        
+        if (block) {
+            return block;
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * Allocate 2^order contiguous pages
+ */
+void* page_alloc(unsigned int order) {
+    return page_alloc_node(order, 0, PAGE_NODE_LOCAL);
+}
+
+/**
+ * Allocate 2^order contiguous pages with PAGE_ALLOC_* flags
+ */
+void* page_alloc_flags(unsigned int order, unsigned int flags) {
+    return page_alloc_node(order, flags, PAGE_NODE_LOCAL);
+}
+
+/**
+ * Allocate 2^order contiguous pages on a node (PAGE_NODE_LOCAL for the
+ * calling CPU's)
+ */
+void* page_alloc_node(unsigned int order, unsigned int flags, uint32_t node) {
+    uint32_t preferred;
+    if (!g_page_state.initialized || order > PAGE_MAX_ORDER || !page_resolve_node(node, &preferred)) {
+        return NULL;
+    }
+    
+    bool zeroed = false;
+    void* page = page_alloc_from_nodes(preferred, order, 1ULL << order, flags, &zeroed);
+    
+    // Pool miss: clear with ordinary stores, the caller is about to use it
+    if (page && (flags & PAGE_ALLOC_ZERO) && !zeroed) {
+        memops_set(page, 0, (size_t)PAGE_SIZE << order);
+    }
+    
+    return page;
+}
+
+/**
+ * Free 2^order contiguous pages
+ */
+void page_free(void* page, unsigned int order) {
+    if (!page || !g_page_state.initialized || order > PAGE_MAX_ORDER) {
+        return;
+    }
+    
+    uint64_t address = (uint64_t)(uintptr_t)page;
+    uint64_t pfn = address >> PAGE_SHIFT;
+    
+    if ((address & (PAGE_SIZE - 1)) || (pfn & ((1ULL << order) - 1)) ||
+        !page_pfn_valid(pfn) || !page_pfn_valid(pfn + (1ULL << order) - 1)) {
+        return; // Not a block this allocator handed out
+    }
+    
+    page_node_state_t* node = &g_page_state.nodes[page_pfn_node(pfn)];
+    
+    uint64_t irq_state = spin_lock_irqsave(&node->lock);
+    if (!(*page_info(pfn) & PAGE_INFO_FREE)) {
+        node->free_pages += 1ULL << order;
+        page_free_block(node, pfn, order);
+    }
+    spin_unlock_irqrestore(&node->lock, irq_state);
+}
+
+/**
+ * Allocate a run of count contiguous pages
+ */
+void* page_alloc_pages(size_t count, size_t alignment) {
+    return page_alloc_pages_node(count, alignment, 0, PAGE_NODE_LOCAL);
+}
+
+/**
+ * Allocate a run of count contiguous pages with PAGE_ALLOC_* flags
+ */
+void* page_alloc_pages_flags(size_t count, size_t alignment, unsigned int flags) {
+    return page_alloc_pages_node(count, alignment, flags, PAGE_NODE_LOCAL);
+}
+
+/**
+ * Allocate a run of count contiguous pages on a node
+ */
+void* page_alloc_pages_node(size_t count, size_t alignment, unsigned int flags, uint32_t node) {
+    uint32_t preferred;
+    if (!g_page_state.initialized || count == 0 || count > (1ULL << PAGE_MAX_ORDER) ||
+        alignment > ((size_t)PAGE_SIZE << PAGE_MAX_ORDER) || !page_resolve_node(node, &preferred)) {
+        return NULL;
+    }
+    
+    // Buddy blocks are naturally aligned, so a large enough order aligns the run
+    unsigned int order = page_order_for_size(alignment);
+    while ((1ULL << order) < count) {
+        order++;
+    }
+    
+    bool zeroed = false;
+    void* pages = page_alloc_from_nodes(preferred, order, count, flags, &zeroed);
+    
+    if (pages && (flags & PAGE_ALLOC_ZERO) && !zeroed) {
+        memops_set(pages, 0, count << PAGE_SHIFT);
+    }
+    
+    return pages;
+}
+
+/**
+ * Free a run of pages from page_alloc_pages
+ */
+void page_free_pages(void* pages, size_t count) {
+    if (!pages || count == 0 || !g_page_state.initialized) {
+        return;
+    }
+    
+    uint64_t address = (uint64_t)(uintptr_t)pages;
+    uint64_t pfn = address >> PAGE_SHIFT;
+    
+    if ((address & (PAGE_SIZE - 1)) || !page_pfn_valid(pfn) || !page_pfn_valid(pfn + count - 1)) {
+        return;
+    }
+    
+    // A run comes from a single block, so it lies within one node
+    page_node_state_t* node = &g_page_state.nodes[page_pfn_node(pfn)];
+    
+    uint64_t irq_state = spin_lock_irqsave(&node->lock);
+    if (!(*page_info(pfn) & PAGE_INFO_FREE)) {
+        node->free_pages += count;
+        page_free_range(node, pfn, pfn + count);
+    }
+    spin_unlock_irqrestore(&node->lock, irq_state);
+}
+
+/**
+ * Number of NUMA nodes the allocator manages
+ */
+uint32_t page_node_count(void) {
+    return g_page_state.node_count ? g_page_state.node_count : 1;
+}
+
+/**
+ * Node of the calling CPU
+ */
+uint32_t page_local_node(void) {
+    uint32_t node = hal_numa_cpu_node(hal_get_cpu_id());
+    return node < g_page_state.node_count ? node : 0;
+}
+
+/**
+ * Node a page belongs to
+ */
+uint32_t page_node_of(const void* page) {
+    return page_pfn_node((uint64_t)(uintptr_t)page >> PAGE_SHIFT);
+}
+
+/**
+ * Top up one node's pre-zeroed pool, smallest orders first
+ */
+static size_t page_zero_pool_refill_node(page_node_state_t* node, size_t max_pages) {
+    size_t zeroed = 0;
+    
+    for (unsigned int order = 0; order <= PAGE_ZERO_MAX_ORDER; order++) {
+        while (zeroed + (1ULL << order) <= max_pages) {
+            uint64_t irq_state = spin_lock_irqsave(&node->lock);
+            
+            // Stop at the order's target or when free memory runs low
+            void* block = NULL;
+            if ((node->zero_blocks[order] << order) < PAGE_ZERO_POOL_PAGES &&
+                node->free_pages >= node->total_pages / PAGE_ZERO_RESERVE_DIVISOR + (1ULL << order)) {
+                block = page_alloc_block(node, order);
+            }
+            
+            spin_unlock_irqrestore(&node->lock, irq_state);
+            if (!block) {
+                break;
+            }
+            
+            // Zero without the lock, bypassing the cache the block is not needed in
+            memops_set_nt(block, 0, (size_t)PAGE_SIZE << order);
+            
+            irq_state = spin_lock_irqsave(&node->lock);
+            page_free_node_t* entry = block;
+            entry->next = node->zero_lists[order];
+            node->zero_lists[order] = entry;
+            node->zero_blocks[order]++;
+            node->zero_pool_pages += 1ULL << order;
+            node->pages_zeroed_idle += 1ULL << order;
+            spin_unlock_irqrestore(&node->lock, irq_state);
+            
+            zeroed += (size_t)1 << order;
+        }
+    }
+    
+    return zeroed;
+}
+
+/**
+ * Top up the pre-zeroed pools, the calling CPU's node first and the
+ * others nearest first with whatever budget is left
+ */
+size_t page_zero_pool_refill(size_t max_pages) {
+    if (!g_page_state.initialized) {
+        return 0;
+    }
+    
+    const uint32_t* fallback = g_page_state.nodes[page_local_node()].fallback;
+    size_t zeroed = 0;
+    
+    for (uint32_t i = 0; i < g_page_state.node_count && zeroed < max_pages; i++) {
+        zeroed += page_zero_pool_refill_node(&g_page_state.nodes[fallback[i]], max_pages - zeroed);
+    }
+    
+    return zeroed;
+}
+
+/**
+ * Smallest order whose block holds size bytes
+ */
+unsigned int page_order_for_size(size_t size) {
+    uint64_t pages = ((uint64_t)size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    unsigned int order = 0;
+    
+    while ((1ULL << order) < pages) {
+        order++;
+    }
+    
+    return order;
+}
+
+/**
+ * Get page allocator statistics (summed over the nodes, each read under
+ * its own lock)
+ */
+void page_get_stats(page_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    
+    memset(stats, 0, sizeof(*stats));
+    
+    for (uint32_t index = 0; index < g_page_state.node_count; index++) {
+        page_node_state_t* node = &g_page_state.nodes[index];
+        uint64_t irq_state = spin_lock_irqsave(&node->lock);
+        
+        stats->total_pages += node->total_pages;
+        stats->free_pages += node->free_pages;
+        for (unsigned int order = 0; order < PAGE_ORDER_COUNT; order++) {
+            stats->free_blocks[order] += node->free_blocks[order];
+        }
+        
+        stats->zero_pool_pages += node->zero_pool_pages;
+        stats->zero_pool_hits += node->zero_pool_hits;
+        stats->zero_pool_misses += node->zero_pool_misses;
+        stats->pages_zeroed_idle += node->pages_zeroed_idle;
+        
+        stats->node_total_pages[index] = node->total_pages;
+        stats->node_free_pages[index] = node->free_pages;
+        stats->local_allocations += node->local_allocations;
+        stats->remote_allocations += node->remote_allocations;
+        
+        spin_unlock_irqrestore(&node->lock, irq_state);
+    }
+    
+    stats->node_count = g_page_state.node_count;
+    stats->reserved_pages = g_page_state.span_pages - stats->total_pages;
+    stats->lowest_address = g_page_state.base_pfn << PAGE_SHIFT;
+    stats->highest_address = (g_page_state.base_pfn + g_page_state.span_pages) << PAGE_SHIFT;
+}
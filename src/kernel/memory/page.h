@@ -0,0 +1,95 @@
+/**
+ * CompileOS Page Frame Allocator - Header
+ *
+ * Physical page allocation with a binary buddy system per NUMA node
+ */
+
+#ifndef PAGE_H
+#define PAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Page geometry
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1UL << PAGE_SHIFT)
+
+// Buddy orders: order 0 is one 4 KB page, order 9 is 2 MB, order 18 is 1 GB
+#define PAGE_ORDER_2MB 9
+#define PAGE_MAX_ORDER 18
+#define PAGE_ORDER_COUNT (PAGE_MAX_ORDER + 1)
+
+// Allocation flags
+#define PAGE_ALLOC_ZERO 0x1     // Zero-filled (free when the pre-zeroed pool has stock)
+#define PAGE_ALLOC_STRICT 0x2   // Fail rather than fall back to another node
+
+// NUMA nodes: each has its own free lists, pool and lock; allocations try
+// the requested node first, then the others nearest first
+#define PAGE_MAX_NODES 8
+#define PAGE_NODE_LOCAL 0xFFFFFFFFu     // The calling CPU's node
+
+// Pre-zeroed pool: blocks up to PAGE_ZERO_MAX_ORDER (1 MB), each order topped
+// up to PAGE_ZERO_POOL_PAGES pages while at least 1/PAGE_ZERO_RESERVE_DIVISOR
+// of memory stays free; the idle loop zeroes PAGE_ZERO_IDLE_BATCH pages a pass
+#define PAGE_ZERO_MAX_ORDER 8
+#define PAGE_ZERO_POOL_PAGES 256
+#define PAGE_ZERO_RESERVE_DIVISOR 16
+#define PAGE_ZERO_IDLE_BATCH 64
+
+// Page allocator statistics
+typedef struct {
+    uint64_t total_pages;
+    uint64_t free_pages;
+    uint64_t reserved_pages;
+    uint64_t lowest_address;
+    uint64_t highest_address;
+    uint64_t free_blocks[PAGE_ORDER_COUNT];
+    
+    // Pre-zeroed pool (pool pages are not counted in free_pages)
+    uint64_t zero_pool_pages;
+    uint64_t zero_pool_hits;
+    uint64_t zero_pool_misses;
+    uint64_t pages_zeroed_idle;
+    
+    // NUMA placement (remote: served by a node other than the one asked for)
+    uint32_t node_count;
+    uint64_t node_total_pages[PAGE_MAX_NODES];
+    uint64_t node_free_pages[PAGE_MAX_NODES];
+    uint64_t local_allocations;
+    uint64_t remote_allocations;
+} page_stats_t;
+
+// Page allocator initialization (reads the HAL memory map)
+int page_init(void);
+
+// Page allocation (returns 2^order contiguous, naturally aligned pages
+// from the calling CPU's node unless a node is given)
+void* page_alloc(unsigned int order);
+void* page_alloc_flags(unsigned int order, unsigned int flags);
+void* page_alloc_node(unsigned int order, unsigned int flags, uint32_t node);
+void page_free(void* page, unsigned int order);
+
+// Page runs (any page count, start aligned to at least alignment bytes; the
+// unused tail of the underlying block goes straight back to the free lists)
+void* page_alloc_pages(size_t count, size_t alignment);
+void* page_alloc_pages_flags(size_t count, size_t alignment, unsigned int flags);
+void* page_alloc_pages_node(size_t count, size_t alignment, unsigned int flags, uint32_t node);
+void page_free_pages(void* pages, size_t count);
+
+// NUMA nodes
+uint32_t page_node_count(void);
+uint32_t page_local_node(void);
+uint32_t page_node_of(const void* page);
+
+// Zero up to max_pages pages into the pre-zeroed pools, the calling CPU's
+// node first (idle time, interrupts may stay on); returns the pages zeroed
+size_t page_zero_pool_refill(size_t max_pages);
+
+// Helpers
+unsigned int page_order_for_size(size_t size);
+
+// Page statistics
+void page_get_stats(page_stats_t* stats);
+
+#endif // PAGE_H
@@ -0,0 +1,793 @@
+/**
+ * CompileOS Paging - Implementation
+ *
+ * Builds and edits x86_64 4-level page tables. Table pages come from a
+ * slab cache whose constructor zeroes them; a table only goes back to the
+ * cache once all of its entries are clear again, so reused tables are
+ * always empty. Mappings use 1 GB and 2 MB pages whenever the virtual and
+ * physical addresses and the remaining size allow, and large pages are
+ * split only when part of one is unmapped or reprotected.
+ *
+ * Page tables are reached through the identity map of physical memory,
+ * which paging_init rebuilds with large pages before switching to it.
+ *
+ * Process address spaces get their own PML4 whose entries outside the user
+ * range point at the kernel space's PDPTs. PDPTs are therefore never freed
+ * while their space lives, which keeps the shared ones valid.
+ */
+
+#include "paging.h"
+#include "memory.h"
+#include "page.h"
+#include "slab.h"
+#include "memops.h"
+#include "tlb.h"
+#include "../spinlock.h"
+#include "../../hal/hal.h"
+#include "../../hal/arch/x86_64/cpu.h"
+
+// Kernel image layout (defined in linker.ld, sections aligned to 2 MB)
+extern char _text_start[];
+extern char _text_end[];
+extern char _rodata_start[];
+extern char _rodata_end[];
+extern char _data_start[];
+extern char _kernel_end[];
+
+// Page table geometry
+#define PAGING_ENTRIES 512
+#define PAGING_INDEX_BITS 9
+
+// PML4 entries of the process-private range
+#define PAGING_USER_FIRST ((size_t)(PAGING_USER_BASE >> 39))
+#define PAGING_USER_LAST ((size_t)((PAGING_USER_END - 1) >> 39))
+
+// Flags of entries that point at a lower table (the leaf decides access)
+#define PAGING_TABLE_FLAGS (PAGING_PRESENT | PAGING_WRITABLE | PAGING_USER)
+
+// The direct map always covers the low 4 GB (local APIC, I/O APIC, ...)
+#define PAGING_DIRECT_MAP_MIN 0x100000000ULL
+
+// Maximum number of memory map entries read from the HAL
+#define PAGING_MAX_REGIONS 64
+
+// Local and I/O APIC registers, mapped uncached in the direct map
+#define PAGING_APIC_BASE 0xFEC00000ULL
+#define PAGING_APIC_SIZE 0x400000ULL
+
+// Paging state
+static struct {
+    bool initialized;
+    bool huge_1gb;
+    bool no_execute;
+    slab_cache_t* table_cache;
+    paging_space_t kernel_space;
+    uint64_t tables;
+    uint64_t mapped_pages[3];
+    uint64_t splits;
+} g_paging_state = {0};
+
+// Protects every address space's tables and the counters
+static spinlock_t g_paging_lock = SPINLOCK_INIT;
+
+static uint64_t paging_level_size(int level) {
+    return PAGING_SIZE_4KB << (PAGING_INDEX_BITS * level);
+}
+
+static size_t paging_index(uint64_t virtual_addr, int level) {
+    return (size_t)(virtual_addr >> (12 + PAGING_INDEX_BITS * level)) & (PAGING_ENTRIES - 1);
+}
+
+static uint64_t* paging_table_at(uint64_t entry) {
+    return (uint64_t*)(uintptr_t)(entry & PAGING_ADDRESS_MASK);
+}
+
+static uint64_t paging_table_address(const uint64_t* table) {
+    return (uint64_t)(uintptr_t)table;
+}
+
+static bool paging_entry_is_leaf(uint64_t entry, int level) {
+    return level == 0 || (entry & PAGING_HUGE);
+}
+
+static uint64_t paging_leaf(uint64_t physical_addr, uint64_t flags, int level) {
+    if (!g_paging_state.no_execute) {
+        flags &= ~PAGING_NO_EXECUTE; // Reserved bit without NX support
+    }
+    return physical_addr | (flags & PAGING_FLAGS_MASK) | PAGING_PRESENT | (level ? PAGING_HUGE : 0);
+}
+
+static uint64_t paging_leaf_address(uint64_t entry, int level) {
+    return entry & PAGING_ADDRESS_MASK & ~(paging_level_size(level) - 1);
+}
+
+/**
+ * Kernel mappings are shared by every address space, so they are global
+ */
+static uint64_t paging_space_flags(const paging_space_t* space, uint64_t flags) {
+    return space == &g_paging_state.kernel_space ? flags | PAGING_GLOBAL : flags;
+}
+
+/**
+ * Check that an address is canonical (bits 63..47 all equal)
+ */
+static bool paging_canonical(uint64_t virtual_addr) {
+    uint64_t high = virtual_addr >> 47;
+    return high == 0 || high == 0x1FFFF;
+}
+
+/**
+ * Slab constructor: page tables start out empty
+ */
+static void paging_table_ctor(void* object) {
+    memops_set(object, 0, PAGE_SIZE);
+}
+
+static uint64_t* paging_table_alloc(void) {
+    uint64_t* table = (uint64_t*)slab_alloc(g_paging_state.table_cache);
+    if (table) {
+        g_paging_state.tables++;
+    }
+    return table;
+}
+
+static void paging_table_free(uint64_t* table) {
+    slab_free(g_paging_state.table_cache, table);
+    g_paging_state.tables--;
+}
+
+static bool paging_table_empty(const uint64_t* table) {
+    for (size_t i = 0; i < PAGING_ENTRIES; i++) {
+        if (table[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Release a table and everything below it, clearing its entries so the
+ * slab gets it back empty (level is that of the table's entries)
+ */
+static void paging_free_table(uint64_t* table, int level) {
+    for (size_t i = 0; i < PAGING_ENTRIES; i++) {
+        uint64_t entry = table[i];
+        if (!(entry & PAGING_PRESENT)) {
+            continue;
+        }
+        
+        if (paging_entry_is_leaf(entry, level)) {
+            g_paging_state.mapped_pages[level]--;
+        } else {
+            paging_free_table(paging_table_at(entry), level - 1);
+        }
+        table[i] = 0;
+    }
+    
+    paging_table_free(table);
+}
+
+/**
+ * Replace a large page with a table of the next smaller pages carrying the
+ * same translation and flags
+ */
+static bool paging_split(uint64_t* entry, int level) {
+    uint64_t* table = paging_table_alloc();
+    if (!table) {
+        return false;
+    }
+    
+    uint64_t base = paging_leaf_address(*entry, level);
+    uint64_t flags = *entry & PAGING_FLAGS_MASK;
+    uint64_t child_size = paging_level_size(level - 1);
+    
+    for (size_t i = 0; i < PAGING_ENTRIES; i++) {
+        table[i] = paging_leaf(base + i * child_size, flags, level - 1);
+    }
+    
+    *entry = paging_table_address(table) | PAGING_TABLE_FLAGS;
+    
+    g_paging_state.mapped_pages[level]--;
+    g_paging_state.mapped_pages[level - 1] += PAGING_ENTRIES;
+    g_paging_state.splits++;
+    return true;
+}
+
+/**
+ * Find the entry for an address at a level, creating lower tables and
+ * splitting large pages on the way
+ */
+static uint64_t* paging_walk_create(uint64_t* pml4, uint64_t virtual_addr, int target_level) {
+    uint64_t* table = pml4;
+    
+    for (int level = PAGING_LEVELS - 1; level > target_level; level--) {
+        uint64_t* entry = &table[paging_index(virtual_addr, level)];
+        
+        if (!(*entry & PAGING_PRESENT)) {
+            uint64_t* next = paging_table_alloc();
+            if (!next) {
+                return NULL;
+            }
+            *entry = paging_table_address(next) | PAGING_TABLE_FLAGS;
+        } else if (paging_entry_is_leaf(*entry, level)) {
+            if (!paging_split(entry, level)) {
+                return NULL;
+            }
+        }
+        
+        table = paging_table_at(*entry);
+    }
+    
+    return &table[paging_index(virtual_addr, target_level)];
+}
+
+/**
+ * Largest page that fits at this point of a mapping
+ */
+static int paging_leaf_level(uint64_t virtual_addr, uint64_t physical_addr, uint64_t size) {
+    uint64_t both = virtual_addr | physical_addr;
+    
+    if (g_paging_state.huge_1gb && !(both & (PAGING_SIZE_1GB - 1)) && size >= PAGING_SIZE_1GB) {
+        return 2;
+    }
+    if (!(both & (PAGING_SIZE_2MB - 1)) && size >= PAGING_SIZE_2MB) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Map a range with the largest pages alignment allows (lock held)
+ */
+static int paging_map_range(paging_space_t* space, uint64_t virtual_addr, uint64_t physical_addr,
+                            uint64_t size, uint64_t flags, tlb_batch_t* batch) {
+    while (size) {
+        int level = paging_leaf_level(virtual_addr, physical_addr, size);
+        uint64_t* entry = paging_walk_create(space->pml4, virtual_addr, level);
+        if (!entry) {
+            return -1;
+        }
+        
+        // Replace whatever was mapped here before
+        if (*entry & PAGING_PRESENT) {
+            if (paging_entry_is_leaf(*entry, level)) {
+                g_paging_state.mapped_pages[level]--;
+                tlb_batch_add(batch, virtual_addr, 1);
+            } else {
+                paging_free_table(paging_table_at(*entry), level - 1);
+                tlb_batch_add_all(batch);
+            }
+        }
+        
+        *entry = paging_leaf(physical_addr, flags, level);
+        g_paging_state.mapped_pages[level]++;
+        
+        uint64_t step = paging_level_size(level);
+        virtual_addr += step;
+        physical_addr += step;
+        size -= step;
+    }
+    
+    return 0;
+}
+
+/**
+ * Unmap or reprotect [virtual_addr, end) below one table, splitting large
+ * pages that are only partly covered and freeing tables left empty (lock
+ * held; level is that of the table's entries)
+ */
+static int paging_update_range(uint64_t* table, int level, uint64_t virtual_addr, uint64_t end,
+                               bool unmap, uint64_t flags, tlb_batch_t* batch) {
+    uint64_t size = paging_level_size(level);
+    
+    while (virtual_addr < end) {
+        uint64_t start = virtual_addr & ~(size - 1);
+        uint64_t last = start + (size - 1);
+        uint64_t stop = last < end - 1 ? last + 1 : end;
+        uint64_t* entry = &table[paging_index(virtual_addr, level)];
+        
+        if (*entry & PAGING_PRESENT) {
+            bool leaf = paging_entry_is_leaf(*entry, level);
+            
+            if (leaf && virtual_addr == start && stop - start == size) {
+                if (unmap) {
+                    *entry = 0;
+                    g_paging_state.mapped_pages[level]--;
+                } else {
+                    *entry = paging_leaf(paging_leaf_address(*entry, level), flags, level);
+                }
+                tlb_batch_add(batch, virtual_addr, 1);
+            } else {
+                if (leaf && !paging_split(entry, level)) {
+                    return -1;
+                }
+                
+                uint64_t* child = paging_table_at(*entry);
+                if (paging_update_range(child, level - 1, virtual_addr, stop, unmap, flags, batch) != 0) {
+                    return -1;
+                }
+                // PDPTs stay (see above); lower tables go once empty
+                if (unmap && level < PAGING_LEVELS - 1 && paging_table_empty(child)) {
+                    *entry = 0;
+                    paging_table_free(child);
+                }
+            }
+        }
+        
+        virtual_addr = stop;
+    }
+    
+    return 0;
+}
+
+/**
+ * Validate a range passed to the public interface
+ */
+static bool paging_range_valid(const paging_space_t* space, uint64_t virtual_addr, uint64_t size) {
+    if (!g_paging_state.initialized || !space || size == 0 ||
+        ((virtual_addr | size) & (PAGING_SIZE_4KB - 1))) {
+        return false;
+    }
+    
+    // The range may not wrap or touch the last page of the address space
+    uint64_t last = virtual_addr + (size - 1);
+    return last > virtual_addr && last != UINT64_MAX && paging_canonical(virtual_addr) && paging_canonical(last) &&
+           (virtual_addr >> 47) == (last >> 47);
+}
+
+/**
+ * End of the physical address range the direct map covers
+ */
+static uint64_t paging_direct_map_end(void) {
+    memory_region_t regions[PAGING_MAX_REGIONS];
+    size_t count = 0;
+    uint64_t end = PAGING_DIRECT_MAP_MIN;
+    
+    if (hal_memory_map(regions, PAGING_MAX_REGIONS, &count) == HAL_SUCCESS) {
+        for (size_t i = 0; i < count; i++) {
+            uint64_t region_end = regions[i].base_address + regions[i].size;
+            if (region_end > end) {
+                end = region_end;
+            }
+        }
+    }
+    
+    return (end + PAGING_SIZE_1GB - 1) & ~(PAGING_SIZE_1GB - 1);
+}
+
+/**
+ * Map one kernel image section, rounded out to whole 2 MB pages
+ */
+static int paging_map_kernel_section(const char* start, const char* end, uint64_t flags, tlb_batch_t* batch) {
+    uint64_t base = (uint64_t)(uintptr_t)start & ~(PAGING_SIZE_2MB - 1);
+    uint64_t limit = ((uint64_t)(uintptr_t)end + PAGING_SIZE_2MB - 1) & ~(PAGING_SIZE_2MB - 1);
+    
+    if (limit <= base) {
+        return 0;
+    }
+    return paging_map_range(&g_paging_state.kernel_space, base, base, limit - base,
+                            paging_space_flags(&g_paging_state.kernel_space, flags), batch);
+}
+
+/**
+ * Build the kernel address space and switch to it
+ */
+int paging_init(void) {
+    if (g_paging_state.initialized) {
+        return 0;
+    }
+    
+    cpu_info_t cpu_info = {0};
+    cpu_detect(&cpu_info);
+    g_paging_state.huge_1gb = cpu_info.features.pdpe1gb;
+    g_paging_state.no_execute = cpu_info.features.nx;
+    
+    g_paging_state.table_cache = slab_cache_create("page_table", PAGE_SIZE, PAGE_SIZE, paging_table_ctor);
+    if (!g_paging_state.table_cache) {
+        return -1;
+    }
+    
+    uint64_t* pml4 = paging_table_alloc();
+    if (!pml4) {
+        return -1;
+    }
+    g_paging_state.kernel_space.pml4 = pml4;
+    g_paging_state.kernel_space.pml4_physical = paging_table_address(pml4);
+    
+    if (g_paging_state.no_execute) {
+        cpu_write_msr(CPU_MSR_EFER, cpu_read_msr(CPU_MSR_EFER) | CPU_EFER_NXE);
+    }
+    
+    // Global pages and PCIDs
+    tlb_init();
+    paging_space_t* space = &g_paging_state.kernel_space;
+    tlb_space_init(space);
+    
+    // Nothing is live in the new tables yet, so the batch is never flushed
+    tlb_batch_t batch;
+    tlb_batch_init(&batch, space);
+    uint64_t data_flags = paging_space_flags(space, PAGING_KERNEL_DATA);
+    
+    // Direct map of physical memory, with page zero left out so null
+    // pointer dereferences fault and the APIC registers uncached
+    if (paging_map_range(space, 0, 0, paging_direct_map_end(), data_flags, &batch) != 0 ||
+        paging_update_range(pml4, PAGING_LEVELS - 1, 0, PAGING_SIZE_4KB, true, 0, &batch) != 0 ||
+        paging_update_range(pml4, PAGING_LEVELS - 1, PAGING_APIC_BASE, PAGING_APIC_BASE + PAGING_APIC_SIZE, false,
+                            data_flags | PAGING_CACHE_DISABLE | PAGING_WRITE_THROUGH, &batch) != 0) {
+        return -1;
+    }
+    
+    // Kernel image with per-section permissions
+    if (paging_map_kernel_section(_text_start, _text_end, PAGING_KERNEL_TEXT, &batch) != 0 ||
+        paging_map_kernel_section(_rodata_start, _rodata_end, PAGING_KERNEL_RODATA, &batch) != 0 ||
+        paging_map_kernel_section(_data_start, _kernel_end, PAGING_KERNEL_DATA, &batch) != 0) {
+        return -1;
+    }
+    
+    // Enforce read-only pages in the kernel as well
+    cpu_write_cr0(cpu_read_cr0() | CPU_CR0_WP);
+    tlb_activate(space);
+    
+    g_paging_state.initialized = true;
+    return 0;
+}
+
+/**
+ * Get the kernel address space
+ */
+paging_space_t* paging_kernel_space(void) {
+    return &g_paging_state.kernel_space;
+}
+
+/**
+ * Create a process address space sharing the kernel's top-level entries
+ */
+paging_space_t* paging_space_create(void) {
+    if (!g_paging_state.initialized) {
+        return NULL;
+    }
+    
+    paging_space_t* space = (paging_space_t*)memory_alloc(sizeof(paging_space_t));
+    if (!space) {
+        return NULL;
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_paging_lock);
+    
+    uint64_t* pml4 = paging_table_alloc();
+    if (pml4) {
+        const uint64_t* kernel = g_paging_state.kernel_space.pml4;
+        for (size_t i = 0; i < PAGING_ENTRIES; i++) {
+            if (i < PAGING_USER_FIRST || i > PAGING_USER_LAST) {
+                pml4[i] = kernel[i];
+            }
+        }
+    }
+    
+    spin_unlock_irqrestore(&g_paging_lock, irq_state);
+    
+    if (!pml4) {
+        memory_free(space);
+        return NULL;
+    }
+    
+    space->pml4 = pml4;
+    space->pml4_physical = paging_table_address(pml4);
+    tlb_space_init(space);
+    return space;
+}
+
+/**
+ * Free a process address space's private tables (the caller releases the
+ * mapped frames first; the space must not be active on any CPU)
+ */
+void paging_space_destroy(paging_space_t* space) {
+    if (!space || space == &g_paging_state.kernel_space) {
+        return;
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_paging_lock);
+    
+    for (size_t i = 0; i < PAGING_ENTRIES; i++) {
+        uint64_t entry = space->pml4[i];
+        if (i >= PAGING_USER_FIRST && i <= PAGING_USER_LAST && (entry & PAGING_PRESENT)) {
+            paging_free_table(paging_table_at(entry), PAGING_LEVELS - 2);
+        }
+        space->pml4[i] = 0;
+    }
+    paging_table_free(space->pml4);
+    
+    spin_unlock_irqrestore(&g_paging_lock, irq_state);
+    
+    tlb_space_release(space);
+    memory_free(space);
+}
+
+/**
+ * Switch the current CPU to an address space
+ */
+void paging_activate(paging_space_t* space) {
+    if (!g_paging_state.initialized || !space) {
+        return;
+    }
+    
+    tlb_activate(space);
+}
+
+/**
+ * Create the PDPTs of a range so address spaces created afterwards share
+ * whatever gets mapped there later
+ */
+int paging_reserve(paging_space_t* space, uint64_t virtual_addr, uint64_t size) {
+    if (!paging_range_valid(space, virtual_addr, size)) {
+        return -1;
+    }
+    
+    int result = 0;
+    uint64_t irq_state = spin_lock_irqsave(&g_paging_lock);
+    
+    size_t first = paging_index(virtual_addr, PAGING_LEVELS - 1);
+    size_t last = paging_index(virtual_addr + size - 1, PAGING_LEVELS - 1);
+    for (size_t i = first; i <= last && result == 0; i++) {
+        uint64_t* entry = &space->pml4[i];
+        if (!(*entry & PAGING_PRESENT)) {
+            uint64_t* table = paging_table_alloc();
+            if (table) {
+                *entry = paging_table_address(table) | PAGING_TABLE_FLAGS;
+            } else {
+                result = -1;
+            }
+        }
+    }
+    
+    spin_unlock_irqrestore(&g_paging_lock, irq_state);
+    return result;
+}
+
+/**
+ * Map a physical range
+ */
+int paging_map(paging_space_t* space, uint64_t virtual_addr, uint64_t physical_addr, uint64_t size,
+               uint64_t flags, tlb_batch_t* batch) {
+    if (!paging_range_valid(space, virtual_addr, size) || (physical_addr & (PAGING_SIZE_4KB - 1)) ||
+        physical_addr + size < physical_addr || ((physical_addr + size - 1) & ~PAGING_ADDRESS_MASK & ~0xFFFULL) ||
+        (batch && batch->space != space)) {
+        return -1;
+    }
+    
+    tlb_batch_t local;
+    if (!batch) {
+        tlb_batch_init(&local, space);
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_paging_lock);
+    int result = paging_map_range(space, virtual_addr, physical_addr, size, paging_space_flags(space, flags),
+                                  batch ? batch : &local);
+    spin_unlock_irqrestore(&g_paging_lock, irq_state);
+    
+    // Flushing may wait for other CPUs, so never with the lock held
+    if (!batch) {
+        tlb_batch_flush(&local);
+    }
+    return result;
+}
+
+/**
+ * Remove the mappings of a range (unmapped parts are skipped)
+ */
+int paging_unmap(paging_space_t* space, uint64_t virtual_addr, uint64_t size, tlb_batch_t* batch) {
+    if (!paging_range_valid(space, virtual_addr, size) || (batch && batch->space != space)) {
+        return -1;
+    }
+    
+    tlb_batch_t local;
+    if (!batch) {
+        tlb_batch_init(&local, space);
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_paging_lock);
+    int result = paging_update_range(space->pml4, PAGING_LEVELS - 1, virtual_addr, virtual_addr + size,
+                                     true, 0, batch ? batch : &local);
+    spin_unlock_irqrestore(&g_paging_lock, irq_state);
+    
+    if (!batch) {
+        tlb_batch_flush(&local);
+    }
+    return result;
+}
+
+/**
+ * Change the flags of the mapped parts of a range
+ */
+int paging_protect(paging_space_t* space, uint64_t virtual_addr, uint64_t size, uint64_t flags,
+                   tlb_batch_t* batch) {
+    if (!paging_range_valid(space, virtual_addr, size) || (batch && batch->space != space)) {
+        return -1;
+    }
+    
+    tlb_batch_t local;
+    if (!batch) {
+        tlb_batch_init(&local, space);
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_paging_lock);
+    int result = paging_update_range(space->pml4, PAGING_LEVELS - 1, virtual_addr, virtual_addr + size,
+                                     false, paging_space_flags(space, flags), batch ? batch : &local);
+    spin_unlock_irqrestore(&g_paging_lock, irq_state);
+    
+    if (!batch) {
+        tlb_batch_flush(&local);
+    }
+    return result;
+}
+
+/**
+ * Translate a virtual address
+ */
+bool paging_translate(paging_space_t* space, uint64_t virtual_addr, uint64_t* physical_addr, uint64_t* flags) {
+    if (!g_paging_state.initialized || !space || !paging_canonical(virtual_addr)) {
+        return false;
+    }
+    
+    bool found = false;
+    uint64_t irq_state = spin_lock_irqsave(&g_paging_lock);
+    
+    const uint64_t* table = space->pml4;
+    for (int level = PAGING_LEVELS - 1; level >= 0; level--) {
+        uint64_t entry = table[paging_index(virtual_addr, level)];
+        if (!(entry & PAGING_PRESENT)) {
+            break;
+        }
+        
+        if (paging_entry_is_leaf(entry, level)) {
+            uint64_t size = paging_level_size(level);
+            if (physical_addr) {
+                *physical_addr = paging_leaf_address(entry, level) | (virtual_addr & (size - 1));
+            }
+            if (flags) {
+                *flags = entry & ~PAGING_ADDRESS_MASK;
+            }
+            found = true;
+            break;
+        }
+        
+        table = paging_table_at(entry);
+    }
+    
+    spin_unlock_irqrestore(&g_paging_lock, irq_state);
+    return found;
+}
+
+/**
+ * Find the first mapped 4 KB page at or after *virtual_addr and below end,
+ * skipping absent tables whole, so the cost follows the populated tables
+ * rather than the size of the range
+ */
+bool paging_next_mapped(paging_space_t* space, uint64_t* virtual_addr, uint64_t end, uint64_t* physical_addr) {
+    if (!g_paging_state.initialized || !space || !virtual_addr) {
+        return false;
+    }
+    
+    bool found = false;
+    uint64_t address = *virtual_addr & ~(PAGING_SIZE_4KB - 1);
+    uint64_t irq_state = spin_lock_irqsave(&g_paging_lock);
+    
+    while (!found && address < end) {
+        const uint64_t* table = space->pml4;
+        uint64_t next = address;
+        
+        for (int level = PAGING_LEVELS - 1; level >= 0; level--) {
+            uint64_t entry = table[paging_index(address, level)];
+            uint64_t size = paging_level_size(level);
+            
+            if (!(entry & PAGING_PRESENT)) {
+                next = (address & ~(size - 1)) + size;
+                break;
+            }
+            if (paging_entry_is_leaf(entry, level)) {
+                if (physical_addr) {
+                    *physical_addr = paging_leaf_address(entry, level) | (address & (size - 1));
+                }
+                found = true;
+                break;
+            }
+            
+            table = paging_table_at(entry);
+        }
+        
+        if (!found) {
+            // Stop at the top of the address space
+            if (next <= address) {
+                break;
+            }
+            address = next;
+        }
+    }
+    
+    spin_unlock_irqrestore(&g_paging_lock, irq_state);
+    
+    if (found) {
+        *virtual_addr = address;
+    }
+    return found;
+}
+
+/**
+ * Get paging statistics
+ */
+void paging_get_stats(paging_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_paging_lock);
+    
+    stats->tables = g_paging_state.tables;
+    for (int level = 0; level < 3; level++) {
+        stats->mapped_pages[level] = g_paging_state.mapped_pages[level];
+    }
+    stats->splits = g_paging_state.splits;
+    stats->huge_1gb = g_paging_state.huge_1gb;
+    stats->no_execute = g_paging_state.no_execute;
+    
+    spin_unlock_irqrestore(&g_paging_lock, irq_state);
+}
+
+/**
+ * Round a byte range out to whole pages, returning the page-aligned start
+ */
+static uint64_t paging_page_range(const void* address, size_t size, uint64_t* length) {
+    uint64_t start = (uint64_t)(uintptr_t)address & ~(PAGING_SIZE_4KB - 1);
+    uint64_t end = ((uint64_t)(uintptr_t)address + size + PAGING_SIZE_4KB - 1) & ~(PAGING_SIZE_4KB - 1);
+    
+    *length = end > start ? end - start : 0;
+    return start;
+}
+
+/**
+ * Map physical memory into the kernel address space (read/write, no execute)
+ */
+int memory_map_virtual(void* virtual_addr, void* physical_addr, size_t size) {
+    uint64_t offset = (uint64_t)(uintptr_t)virtual_addr & (PAGING_SIZE_4KB - 1);
+    if (((uint64_t)(uintptr_t)physical_addr & (PAGING_SIZE_4KB - 1)) != offset) {
+        return -1; // The page offsets must agree
+    }
+    
+    uint64_t length;
+    uint64_t start = paging_page_range(virtual_addr, size, &length);
+    return paging_map(&g_paging_state.kernel_space, start, (uint64_t)(uintptr_t)physical_addr - offset,
+                      length, PAGING_KERNEL_DATA, NULL);
+}
+
+/**
+ * Remove kernel mappings
+ */
+int memory_unmap_virtual(void* virtual_addr, size_t size) {
+    uint64_t length;
+    uint64_t start = paging_page_range(virtual_addr, size, &length);
+    return paging_unmap(&g_paging_state.kernel_space, start, length, NULL);
+}
+
+/**
+ * Change the access rights of kernel pages (x86 cannot express write- or
+ * execute-only pages, and removing all access is not supported)
+ */
+int memory_protect(void* address, size_t size, bool read, bool write, bool execute) {
+    if (!read && !write && !execute) {
+        return -1;
+    }
+    
+    uint64_t flags = (write ? PAGING_WRITABLE : 0) | (execute ? 0 : PAGING_NO_EXECUTE);
+    uint64_t length;
+    uint64_t start = paging_page_range(address, size, &length);
+    return paging_protect(&g_paging_state.kernel_space, start, length, flags, NULL);
+}
+
+/**
+ * Restore the default kernel data access rights (read/write, no execute)
+ */
+int memory_unprotect(void* address, size_t size) {
+    uint64_t length;
+    uint64_t start = paging_page_range(address, size, &length);
+    return paging_protect(&g_paging_state.kernel_space, start, length, PAGING_KERNEL_DATA, NULL);
+}
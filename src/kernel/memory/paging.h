@@ -0,0 +1,99 @@
+/**
+ * CompileOS Paging - Header
+ *
+ * x86_64 4-level page tables (PML4 / PDPT / PD / PT) with 2 MB and 1 GB
+ * pages wherever alignment allows
+ */
+
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Page table entry bits
+#define PAGING_PRESENT (1ULL << 0)
+#define PAGING_WRITABLE (1ULL << 1)
+#define PAGING_USER (1ULL << 2)
+#define PAGING_WRITE_THROUGH (1ULL << 3)
+#define PAGING_CACHE_DISABLE (1ULL << 4)
+#define PAGING_ACCESSED (1ULL << 5)
+#define PAGING_DIRTY (1ULL << 6)
+#define PAGING_HUGE (1ULL << 7)
+#define PAGING_GLOBAL (1ULL << 8)
+#define PAGING_NO_EXECUTE (1ULL << 63)
+#define PAGING_ADDRESS_MASK 0x000FFFFFFFFFF000ULL
+
+// Flags callers may pass to map and protect
+#define PAGING_FLAGS_MASK (PAGING_WRITABLE | PAGING_USER | PAGING_WRITE_THROUGH | \
+                           PAGING_CACHE_DISABLE | PAGING_GLOBAL | PAGING_NO_EXECUTE)
+
+// Common mappings
+#define PAGING_KERNEL_DATA (PAGING_WRITABLE | PAGING_NO_EXECUTE)
+#define PAGING_KERNEL_RODATA (PAGING_NO_EXECUTE)
+#define PAGING_KERNEL_TEXT 0
+
+// Page sizes (leaf levels 0, 1 and 2)
+#define PAGING_SIZE_4KB 0x1000ULL
+#define PAGING_SIZE_2MB 0x200000ULL
+#define PAGING_SIZE_1GB 0x40000000ULL
+#define PAGING_LEVELS 4
+
+// Process-private part of the lower half (PML4 entries 128-255); every other
+// top-level entry is shared with the kernel space
+#define PAGING_USER_BASE 0x0000400000000000ULL
+#define PAGING_USER_END 0x0000800000000000ULL
+
+// Address space (the TLB fields are managed by tlb.c)
+typedef struct paging_space {
+    uint64_t* pml4;
+    uint64_t pml4_physical;
+    uint16_t pcid;
+    uint64_t cpu_mask;      // CPUs that have run the space
+    uint64_t stale_mask;    // CPUs that must flush it on their next switch
+} paging_space_t;
+
+// Invalidation batch (tlb.h)
+struct tlb_batch;
+
+// Paging statistics (mapped_pages[level]: 4 KB, 2 MB and 1 GB leaves)
+typedef struct {
+    uint64_t tables;
+    uint64_t mapped_pages[3];
+    uint64_t splits;
+    bool huge_1gb;
+    bool no_execute;
+} paging_stats_t;
+
+// Initialization (builds the kernel address space and switches to it)
+int paging_init(void);
+paging_space_t* paging_kernel_space(void);
+
+// Address spaces (top-level tables are never freed while the space lives, so
+// kernel ranges must be reserved before spaces that should see them exist)
+paging_space_t* paging_space_create(void);
+void paging_space_destroy(paging_space_t* space);
+void paging_activate(paging_space_t* space);
+int paging_reserve(paging_space_t* space, uint64_t virtual_addr, uint64_t size);
+
+// Mapping (addresses and size 4 KB aligned; existing mappings are replaced).
+// Stale TLB entries are added to batch, or flushed before returning if it
+// is NULL; a batch must belong to the same space
+int paging_map(paging_space_t* space, uint64_t virtual_addr, uint64_t physical_addr, uint64_t size,
+               uint64_t flags, struct tlb_batch* batch);
+int paging_unmap(paging_space_t* space, uint64_t virtual_addr, uint64_t size, struct tlb_batch* batch);
+int paging_protect(paging_space_t* space, uint64_t virtual_addr, uint64_t size, uint64_t flags,
+                   struct tlb_batch* batch);
+
+// Lookup (returns false if the address is not mapped)
+bool paging_translate(paging_space_t* space, uint64_t virtual_addr, uint64_t* physical_addr, uint64_t* flags);
+
+// Scan for the next mapped 4 KB page in [*virtual_addr, end); on success
+// *virtual_addr is that page (returns false once there is none)
+bool paging_next_mapped(paging_space_t* space, uint64_t* virtual_addr, uint64_t end, uint64_t* physical_addr);
+
+// Statistics
+void paging_get_stats(paging_stats_t* stats);
+
+#endif // PAGING_H
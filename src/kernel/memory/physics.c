@@ -0,0 +1,522 @@
+/**
+ * CompileOS Physics Vector Storage - Implementation
+ *
+ * The typed containers share one width-generic core that treats the nine
+ * field pointers as an array: growth reallocates a single cache-line
+ * aligned block and copies the live prefix of each field across, swap
+ * removal moves one element per field, and AoS conversion walks records as
+ * nine elements of the container's width. The typed functions only pass
+ * the element width through.
+ */
+
+#include "physics.h"
+#include "memory.h"
+
+// Width-generic view of a container (the typed structs are nine element
+// pointers followed by count and capacity, so they copy to and from this)
+typedef struct {
+    void* fields[PHYSICS_FIELD_COUNT];
+    size_t count;
+    size_t capacity;
+} physics_soa_view_t;
+
+// Fails to compile if a typed container or vector stops matching the view
+typedef char physics_soa_layout_check[
+    (sizeof(physics_soa_16_t) == sizeof(physics_soa_view_t) &&
+     sizeof(physics_soa_32_t) == sizeof(physics_soa_view_t) &&
+     sizeof(physics_soa_64_t) == sizeof(physics_soa_view_t) &&
+     sizeof(physics_vector_16_t) == PHYSICS_FIELD_COUNT * sizeof(uint16_t) &&
+     sizeof(physics_vector_32_t) == PHYSICS_FIELD_COUNT * sizeof(uint32_t) &&
+     sizeof(physics_vector_64_t) == PHYSICS_FIELD_COUNT * sizeof(uint64_t)) ? 1 : -1];
+
+/**
+ * Copy a typed container into a view
+ */
+static void physics_soa_load(const void* soa, physics_soa_view_t* view) {
+    memory_copy(view, soa, sizeof(*view));
+}
+
+/**
+ * Copy a view back into a typed container
+ */
+static void physics_soa_store(void* soa, const physics_soa_view_t* view) {
+    memory_copy(soa, view, sizeof(*view));
+}
+
+/**
+ * Grow the field arrays to hold at least wanted entities
+ */
+static int physics_soa_grow(void* fields[], size_t count, size_t* capacity, size_t width, size_t wanted) {
+    if (wanted <= *capacity) {
+        return 0;
+    }
+    
+    size_t limit = SIZE_MAX / (width * PHYSICS_FIELD_COUNT) - PHYSICS_SOA_GRANULE;
+    if (wanted > limit) {
+        return -1;
+    }
+    
+    // Double to keep pushes amortized O(1), then round to the granule
+    size_t new_capacity = *capacity <= limit / 2 ? *capacity * 2 : limit;
+    if (new_capacity < wanted) {
+        new_capacity = wanted;
+    }
+    new_capacity = (new_capacity + PHYSICS_SOA_GRANULE - 1) & ~(size_t)(PHYSICS_SOA_GRANULE - 1);
+    
+    size_t stride = new_capacity * width;
+    char* block = (char*)memory_alloc_aligned(stride * PHYSICS_FIELD_COUNT, MEMORY_CACHE_LINE_SIZE);
+    if (!block) {
+        return -1;
+    }
+    
+    // The old block starts at the old first field
+    void* old_block = fields[0];
+    for (unsigned int f = 0; f < PHYSICS_FIELD_COUNT; f++) {
+        char* array = block + f * stride;
+        if (count > 0) {
+            memory_copy(array, fields[f], count * width);
+        }
+        fields[f] = array;
+    }
+    
+    if (old_block) {
+        memory_free_aligned(old_block);
+    }
+    
+    *capacity = new_capacity;
+    return 0;
+}
+
+/**
+ * Zero entities first .. first + count - 1 in every field
+ */
+static void physics_soa_zero(void* const fields[], size_t width, size_t first, size_t count) {
+    for (unsigned int f = 0; f < PHYSICS_FIELD_COUNT; f++) {
+        memory_set((char*)fields[f] + first * width, 0, count * width);
+    }
+}
+
+/**
+ * Copy entity src over entity dest in every field
+ */
+static void physics_soa_move(void* const fields[], size_t width, size_t dest, size_t src) {
+    for (unsigned int f = 0; f < PHYSICS_FIELD_COUNT; f++) {
+        char* array = (char*)fields[f];
+        memory_copy(array + dest * width, array + src * width, width);
+    }
+}
+
+/**
+ * Copy count AoS records into entities first .. first + count - 1. A record
+ * is nine elements of width bytes in field order, the physics_vector layout.
+ * The copy goes field by field over a granule of records at a time, so the
+ * records stay in L1 while each field array is written sequentially.
+ */
+static void physics_soa_scatter(void* const fields[], size_t width, size_t first, const void* records, size_t count) {
+    for (size_t base = 0; base < count; base += PHYSICS_SOA_GRANULE) {
+        size_t run = count - base < PHYSICS_SOA_GRANULE ? count - base : PHYSICS_SOA_GRANULE;
+        for (unsigned int f = 0; f < PHYSICS_FIELD_COUNT; f++) {
+            switch (width) {
+                case sizeof(uint16_t): {
+                    uint16_t* dest = (uint16_t*)fields[f] + first + base;
+                    const uint16_t* src = (const uint16_t*)records + base * PHYSICS_FIELD_COUNT + f;
+                    for (size_t i = 0; i < run; i++) {
+                        dest[i] = src[i * PHYSICS_FIELD_COUNT];
+                    }
+                    break;
+                }
+                case sizeof(uint32_t): {
+                    uint32_t* dest = (uint32_t*)fields[f] + first + base;
+                    const uint32_t* src = (const uint32_t*)records + base * PHYSICS_FIELD_COUNT + f;
+                    for (size_t i = 0; i < run; i++) {
+                        dest[i] = src[i * PHYSICS_FIELD_COUNT];
+                    }
+                    break;
+                }
+                default: {
+                    uint64_t* dest = (uint64_t*)fields[f] + first + base;
+                    const uint64_t* src = (const uint64_t*)records + base * PHYSICS_FIELD_COUNT + f;
+                    for (size_t i = 0; i < run; i++) {
+                        dest[i] = src[i * PHYSICS_FIELD_COUNT];
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Copy entities first .. first + count - 1 out as AoS records. This goes
+ * record by record with the fields unrolled, so each record is written
+ * with sequential stores (strided stores run at about half the rate).
+ */
+static void physics_soa_gather(void* const fields[], size_t width, size_t first, void* records, size_t count) {
+    switch (width) {
+        case sizeof(uint16_t): {
+            const uint16_t* s[PHYSICS_FIELD_COUNT];
+            for (unsigned int f = 0; f < PHYSICS_FIELD_COUNT; f++) {
+                s[f] = (const uint16_t*)fields[f] + first;
+            }
+            
+            uint16_t* d = (uint16_t*)records;
+            for (size_t i = 0; i < count; i++, d += PHYSICS_FIELD_COUNT) {
+                d[0] = s[0][i];
+                d[1] = s[1][i];
+                d[2] = s[2][i];
+                d[3] = s[3][i];
+                d[4] = s[4][i];
+                d[5] = s[5][i];
+                d[6] = s[6][i];
+                d[7] = s[7][i];
+                d[8] = s[8][i];
+            }
+            break;
+        }
+        case sizeof(uint32_t): {
+            const uint32_t* s[PHYSICS_FIELD_COUNT];
+            for (unsigned int f = 0; f < PHYSICS_FIELD_COUNT; f++) {
+                s[f] = (const uint32_t*)fields[f] + first;
+            }
+            
+            uint32_t* d = (uint32_t*)records;
+            for (size_t i = 0; i < count; i++, d += PHYSICS_FIELD_COUNT) {
+                d[0] = s[0][i];
+                d[1] = s[1][i];
+                d[2] = s[2][i];
+                d[3] = s[3][i];
+                d[4] = s[4][i];
+                d[5] = s[5][i];
+                d[6] = s[6][i];
+                d[7] = s[7][i];
+                d[8] = s[8][i];
+            }
+            break;
+        }
+        default: {
+            const uint64_t* s[PHYSICS_FIELD_COUNT];
+            for (unsigned int f = 0; f < PHYSICS_FIELD_COUNT; f++) {
+                s[f] = (const uint64_t*)fields[f] + first;
+            }
+            
+            uint64_t* d = (uint64_t*)records;
+            for (size_t i = 0; i < count; i++, d += PHYSICS_FIELD_COUNT) {
+                d[0] = s[0][i];
+                d[1] = s[1][i];
+                d[2] = s[2][i];
+                d[3] = s[3][i];
+                d[4] = s[4][i];
+                d[5] = s[5][i];
+                d[6] = s[6][i];
+                d[7] = s[7][i];
+                d[8] = s[8][i];
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Width-generic container operations (soa points at a typed container of
+ * width-byte elements, records at physics_vector records of the same width)
+ */
+static int physics_soa_reserve(void* soa, size_t width, size_t capacity) {
+    if (!soa) return -1;
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    if (capacity <= view.capacity) return 0;
+    
+    if (physics_soa_grow(view.fields, view.count, &view.capacity, width, capacity) != 0) {
+        return -1;
+    }
+    physics_soa_store(soa, &view);
+    return 0;
+}
+
+static int physics_soa_init(void* soa, size_t width, size_t capacity) {
+    if (!soa) return -1;
+    memory_set(soa, 0, sizeof(physics_soa_view_t));
+    return physics_soa_reserve(soa, width, capacity);
+}
+
+static void physics_soa_destroy(void* soa) {
+    if (!soa) return;
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    if (view.fields[0]) memory_free_aligned(view.fields[0]);
+    memory_set(soa, 0, sizeof(view));
+}
+
+static int physics_soa_resize(void* soa, size_t width, size_t count) {
+    if (physics_soa_reserve(soa, width, count) != 0) return -1;
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    if (count > view.count) {
+        physics_soa_zero(view.fields, width, view.count, count - view.count);
+    }
+    view.count = count;
+    physics_soa_store(soa, &view);
+    return 0;
+}
+
+static void physics_soa_clear(void* soa) {
+    if (!soa) return;
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    view.count = 0;
+    physics_soa_store(soa, &view);
+}
+
+static int physics_soa_from_aos(void* soa, size_t width, const void* records, size_t count) {
+    if (!soa) return -1;
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    if ((!records && count > 0) || count > SIZE_MAX - view.count) return -1;
+    if (physics_soa_reserve(soa, width, view.count + count) != 0) return -1;
+    
+    physics_soa_load(soa, &view);
+    physics_soa_scatter(view.fields, width, view.count, records, count);
+    view.count += count;
+    physics_soa_store(soa, &view);
+    return 0;
+}
+
+static int physics_soa_to_aos(const void* soa, size_t width, size_t first, size_t count, void* records) {
+    if (!soa) return -1;
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    if ((!records && count > 0) || first > view.count || count > view.count - first) return -1;
+    
+    physics_soa_gather(view.fields, width, first, records, count);
+    return 0;
+}
+
+static int physics_soa_set(void* soa, size_t width, size_t index, const void* record) {
+    if (!soa || !record) return -1;
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    if (index >= view.count) return -1;
+    
+    physics_soa_scatter(view.fields, width, index, record, 1);
+    return 0;
+}
+
+static int physics_soa_push(void* soa, size_t width, const void* record) {
+    if (!soa) return -1;
+    
+    // A NULL record appends a zeroed entity
+    if (record) {
+        return physics_soa_from_aos(soa, width, record, 1);
+    }
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    if (view.count == SIZE_MAX) return -1;
+    return physics_soa_resize(soa, width, view.count + 1);
+}
+
+static int physics_soa_remove(void* soa, size_t width, size_t index) {
+    if (!soa) return -1;
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    if (index >= view.count) return -1;
+    
+    size_t last = --view.count;
+    if (index != last) {
+        physics_soa_move(view.fields, width, index, last);
+    }
+    physics_soa_store(soa, &view);
+    return 0;
+}
+
+static void* physics_soa_field(const void* soa, physics_field_t field) {
+    if (!soa || (unsigned int)field >= PHYSICS_FIELD_COUNT) return NULL;
+    
+    physics_soa_view_t view;
+    physics_soa_load(soa, &view);
+    return view.fields[field];
+}
+
+/**
+ * Batch iteration
+ */
+bool physics_soa_next_batch(size_t count, size_t batch_size, physics_soa_batch_t* batch) {
+    if (!batch) return false;
+    
+    if (batch_size == 0 || batch_size > SIZE_MAX - PHYSICS_SOA_GRANULE) {
+        batch_size = PHYSICS_SOA_GRANULE;
+    }
+    batch_size = (batch_size + PHYSICS_SOA_GRANULE - 1) & ~(size_t)(PHYSICS_SOA_GRANULE - 1);
+    
+    size_t first = batch->first + batch->count;
+    if (first >= count) {
+        batch->first = count;
+        batch->count = 0;
+        return false;
+    }
+    
+    batch->first = first;
+    batch->count = count - first < batch_size ? count - first : batch_size;
+    return true;
+}
+
+/**
+ * 16-bit containers
+ */
+int physics_soa_init_16(physics_soa_16_t* soa, size_t capacity) {
+    return physics_soa_init(soa, sizeof(uint16_t), capacity);
+}
+
+void physics_soa_destroy_16(physics_soa_16_t* soa) {
+    physics_soa_destroy(soa);
+}
+
+int physics_soa_reserve_16(physics_soa_16_t* soa, size_t capacity) {
+    return physics_soa_reserve(soa, sizeof(uint16_t), capacity);
+}
+
+int physics_soa_resize_16(physics_soa_16_t* soa, size_t count) {
+    return physics_soa_resize(soa, sizeof(uint16_t), count);
+}
+
+void physics_soa_clear_16(physics_soa_16_t* soa) {
+    physics_soa_clear(soa);
+}
+
+int physics_soa_push_16(physics_soa_16_t* soa, const physics_vector_16_t* vector) {
+    return physics_soa_push(soa, sizeof(uint16_t), vector);
+}
+
+int physics_soa_remove_16(physics_soa_16_t* soa, size_t index) {
+    return physics_soa_remove(soa, sizeof(uint16_t), index);
+}
+
+int physics_soa_get_16(const physics_soa_16_t* soa, size_t index, physics_vector_16_t* vector) {
+    return physics_soa_to_aos(soa, sizeof(uint16_t), index, 1, vector);
+}
+
+int physics_soa_set_16(physics_soa_16_t* soa, size_t index, const physics_vector_16_t* vector) {
+    return physics_soa_set(soa, sizeof(uint16_t), index, vector);
+}
+
+int physics_soa_from_aos_16(physics_soa_16_t* soa, const physics_vector_16_t* vectors, size_t count) {
+    return physics_soa_from_aos(soa, sizeof(uint16_t), vectors, count);
+}
+
+int physics_soa_to_aos_16(const physics_soa_16_t* soa, size_t first, size_t count, physics_vector_16_t* vectors) {
+    return physics_soa_to_aos(soa, sizeof(uint16_t), first, count, vectors);
+}
+
+uint16_t* physics_soa_field_16(const physics_soa_16_t* soa, physics_field_t field) {
+    return (uint16_t*)physics_soa_field(soa, field);
+}
+
+/**
+ * 32-bit containers
+ */
+int physics_soa_init_32(physics_soa_32_t* soa, size_t capacity) {
+    return physics_soa_init(soa, sizeof(uint32_t), capacity);
+}
+
+void physics_soa_destroy_32(physics_soa_32_t* soa) {
+    physics_soa_destroy(soa);
+}
+
+int physics_soa_reserve_32(physics_soa_32_t* soa, size_t capacity) {
+    return physics_soa_reserve(soa, sizeof(uint32_t), capacity);
+}
+
+int physics_soa_resize_32(physics_soa_32_t* soa, size_t count) {
+    return physics_soa_resize(soa, sizeof(uint32_t), count);
+}
+
+void physics_soa_clear_32(physics_soa_32_t* soa) {
+    physics_soa_clear(soa);
+}
+
+int physics_soa_push_32(physics_soa_32_t* soa, const physics_vector_32_t* vector) {
+    return physics_soa_push(soa, sizeof(uint32_t), vector);
+}
+
+int physics_soa_remove_32(physics_soa_32_t* soa, size_t index) {
+    return physics_soa_remove(soa, sizeof(uint32_t), index);
+}
+
+int physics_soa_get_32(const physics_soa_32_t* soa, size_t index, physics_vector_32_t* vector) {
+    return physics_soa_to_aos(soa, sizeof(uint32_t), index, 1, vector);
+}
+
+int physics_soa_set_32(physics_soa_32_t* soa, size_t index, const physics_vector_32_t* vector) {
+    return physics_soa_set(soa, sizeof(uint32_t), index, vector);
+}
+
+int physics_soa_from_aos_32(physics_soa_32_t* soa, const physics_vector_32_t* vectors, size_t count) {
+    return physics_soa_from_aos(soa, sizeof(uint32_t), vectors, count);
+}
+
+int physics_soa_to_aos_32(const physics_soa_32_t* soa, size_t first, size_t count, physics_vector_32_t* vectors) {
+    return physics_soa_to_aos(soa, sizeof(uint32_t), first, count, vectors);
+}
+
+uint32_t* physics_soa_field_32(const physics_soa_32_t* soa, physics_field_t field) {
+    return (uint32_t*)physics_soa_field(soa, field);
+}
+
+/**
+ * 64-bit containers
+ */
+int physics_soa_init_64(physics_soa_64_t* soa, size_t capacity) {
+    return physics_soa_init(soa, sizeof(uint64_t), capacity);
+}
+
+void physics_soa_destroy_64(physics_soa_64_t* soa) {
+    physics_soa_destroy(soa);
+}
+
+int physics_soa_reserve_64(physics_soa_64_t* soa, size_t capacity) {
+    return physics_soa_reserve(soa, sizeof(uint64_t), capacity);
+}
+
+int physics_soa_resize_64(physics_soa_64_t* soa, size_t count) {
+    return physics_soa_resize(soa, sizeof(uint64_t), count);
+}
+
+void physics_soa_clear_64(physics_soa_64_t* soa) {
+    physics_soa_clear(soa);
+}
+
+int physics_soa_push_64(physics_soa_64_t* soa, const physics_vector_64_t* vector) {
+    return physics_soa_push(soa, sizeof(uint64_t), vector);
+}
+
+int physics_soa_remove_64(physics_soa_64_t* soa, size_t index) {
+    return physics_soa_remove(soa, sizeof(uint64_t), index);
+}
+
+int physics_soa_get_64(const physics_soa_64_t* soa, size_t index, physics_vector_64_t* vector) {
+    return physics_soa_to_aos(soa, sizeof(uint64_t), index, 1, vector);
+}
+
+int physics_soa_set_64(physics_soa_64_t* soa, size_t index, const physics_vector_64_t* vector) {
+    return physics_soa_set(soa, sizeof(uint64_t), index, vector);
+}
+
+int physics_soa_from_aos_64(physics_soa_64_t* soa, const physics_vector_64_t* vectors, size_t count) {
+    return physics_soa_from_aos(soa, sizeof(uint64_t), vectors, count);
+}
+
+int physics_soa_to_aos_64(const physics_soa_64_t* soa, size_t first, size_t count, physics_vector_64_t* vectors) {
+    return physics_soa_to_aos(soa, sizeof(uint64_t), first, count, vectors);
+}
+
+uint64_t* physics_soa_field_64(const physics_soa_64_t* soa, physics_field_t field) {
+    return (uint64_t*)physics_soa_field(soa, field);
+}
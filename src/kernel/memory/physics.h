@@ -0,0 +1,123 @@
+/**
+ * CompileOS Physics Vector Storage - Header
+ *
+ * Structure-of-arrays containers for the 16-, 32- and 64-bit physics
+ * vectors: each of the nine fields lives in its own cache-line aligned
+ * array, so a pass that only needs positions and velocities streams just
+ * those arrays. Containers grow on demand, remove by swapping in the last
+ * entity, and convert to and from the array-of-structs physics_vector types.
+ */
+
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "multibit.h"
+
+// Capacity granule in entities (keeps every field array a whole number of
+// cache lines, so all nine start cache-line aligned)
+#define PHYSICS_SOA_GRANULE 32
+
+// Fields, in storage order
+typedef enum {
+    PHYSICS_FIELD_X,
+    PHYSICS_FIELD_Y,
+    PHYSICS_FIELD_Z,
+    PHYSICS_FIELD_VX,
+    PHYSICS_FIELD_VY,
+    PHYSICS_FIELD_VZ,
+    PHYSICS_FIELD_AX,
+    PHYSICS_FIELD_AY,
+    PHYSICS_FIELD_AZ,
+    PHYSICS_FIELD_COUNT
+} physics_field_t;
+
+// SoA containers (one allocation holds all nine arrays, x first)
+typedef struct {
+    uint16_t *x, *y, *z;        // Position
+    uint16_t *vx, *vy, *vz;     // Velocity
+    uint16_t *ax, *ay, *az;     // Acceleration
+    size_t count;
+    size_t capacity;
+} physics_soa_16_t;
+
+typedef struct {
+    uint32_t *x, *y, *z;
+    uint32_t *vx, *vy, *vz;
+    uint32_t *ax, *ay, *az;
+    size_t count;
+    size_t capacity;
+} physics_soa_32_t;
+
+typedef struct {
+    uint64_t *x, *y, *z;
+    uint64_t *vx, *vy, *vz;
+    uint64_t *ax, *ay, *az;
+    size_t count;
+    size_t capacity;
+} physics_soa_64_t;
+
+// Batch cursor for walking a container in cache-friendly chunks
+typedef struct {
+    size_t first;
+    size_t count;
+} physics_soa_batch_t;
+
+#define PHYSICS_SOA_BATCH_INIT { 0, 0 }
+
+// Lifetime (init with capacity 0 allocates nothing until the first push)
+int physics_soa_init_16(physics_soa_16_t* soa, size_t capacity);
+int physics_soa_init_32(physics_soa_32_t* soa, size_t capacity);
+int physics_soa_init_64(physics_soa_64_t* soa, size_t capacity);
+void physics_soa_destroy_16(physics_soa_16_t* soa);
+void physics_soa_destroy_32(physics_soa_32_t* soa);
+void physics_soa_destroy_64(physics_soa_64_t* soa);
+
+// Capacity and size (resize zero-fills new entities, clear keeps the storage)
+int physics_soa_reserve_16(physics_soa_16_t* soa, size_t capacity);
+int physics_soa_reserve_32(physics_soa_32_t* soa, size_t capacity);
+int physics_soa_reserve_64(physics_soa_64_t* soa, size_t capacity);
+int physics_soa_resize_16(physics_soa_16_t* soa, size_t count);
+int physics_soa_resize_32(physics_soa_32_t* soa, size_t count);
+int physics_soa_resize_64(physics_soa_64_t* soa, size_t count);
+void physics_soa_clear_16(physics_soa_16_t* soa);
+void physics_soa_clear_32(physics_soa_32_t* soa);
+void physics_soa_clear_64(physics_soa_64_t* soa);
+
+// Single entities (push with a NULL vector appends a zeroed entity; remove
+// moves the last entity into index)
+int physics_soa_push_16(physics_soa_16_t* soa, const physics_vector_16_t* vector);
+int physics_soa_push_32(physics_soa_32_t* soa, const physics_vector_32_t* vector);
+int physics_soa_push_64(physics_soa_64_t* soa, const physics_vector_64_t* vector);
+int physics_soa_remove_16(physics_soa_16_t* soa, size_t index);
+int physics_soa_remove_32(physics_soa_32_t* soa, size_t index);
+int physics_soa_remove_64(physics_soa_64_t* soa, size_t index);
+int physics_soa_get_16(const physics_soa_16_t* soa, size_t index, physics_vector_16_t* vector);
+int physics_soa_get_32(const physics_soa_32_t* soa, size_t index, physics_vector_32_t* vector);
+int physics_soa_get_64(const physics_soa_64_t* soa, size_t index, physics_vector_64_t* vector);
+int physics_soa_set_16(physics_soa_16_t* soa, size_t index, const physics_vector_16_t* vector);
+int physics_soa_set_32(physics_soa_32_t* soa, size_t index, const physics_vector_32_t* vector);
+int physics_soa_set_64(physics_soa_64_t* soa, size_t index, const physics_vector_64_t* vector);
+
+// AoS conversion (from_aos appends count vectors, to_aos copies out the
+// entities first .. first + count - 1)
+int physics_soa_from_aos_16(physics_soa_16_t* soa, const physics_vector_16_t* vectors, size_t count);
+int physics_soa_from_aos_32(physics_soa_32_t* soa, const physics_vector_32_t* vectors, size_t count);
+int physics_soa_from_aos_64(physics_soa_64_t* soa, const physics_vector_64_t* vectors, size_t count);
+int physics_soa_to_aos_16(const physics_soa_16_t* soa, size_t first, size_t count, physics_vector_16_t* vectors);
+int physics_soa_to_aos_32(const physics_soa_32_t* soa, size_t first, size_t count, physics_vector_32_t* vectors);
+int physics_soa_to_aos_64(const physics_soa_64_t* soa, size_t first, size_t count, physics_vector_64_t* vectors);
+
+// Field arrays by index (NULL for an invalid field)
+uint16_t* physics_soa_field_16(const physics_soa_16_t* soa, physics_field_t field);
+uint32_t* physics_soa_field_32(const physics_soa_32_t* soa, physics_field_t field);
+uint64_t* physics_soa_field_64(const physics_soa_64_t* soa, physics_field_t field);
+
+// Iteration: advances batch to the next run of at most batch_size entities
+// out of count (batch_size is rounded up to PHYSICS_SOA_GRANULE, so every
+// batch starts cache-line aligned in each field); false when done
+bool physics_soa_next_batch(size_t count, size_t batch_size, physics_soa_batch_t* batch);
+
+#endif // PHYSICS_H
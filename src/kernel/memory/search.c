@@ -0,0 +1,408 @@
+/**
+ * CompileOS Element Search Routines - Implementation
+ *
+ * Each variant turns a block of SEARCH_BLOCK_ELEMENTS elements into a
+ * 64-bit match mask (compare, then movemask after packing the compare
+ * results down to one byte or one lane per element). One driver walks the
+ * haystack: a scalar head up to vector alignment when the haystack is
+ * element-aligned, whole blocks, then a scalar tail, handing each mask to
+ * the requested mode. Vector loads are unaligned throughout, so haystacks
+ * that are not even element-aligned work too.
+ */
+
+#include "search.h"
+#include "../../hal/arch/x86_64/cpu.h"
+#include <immintrin.h>
+
+// Unaligned, aliasing element access for the scalar paths
+typedef uint16_t search_u16_t __attribute__((may_alias, aligned(1)));
+typedef uint32_t search_u32_t __attribute__((may_alias, aligned(1)));
+typedef uint64_t search_u64_t __attribute__((may_alias, aligned(1)));
+
+// Head elements are searched one at a time up to this address alignment
+#define SEARCH_ALIGNMENT 32
+
+// Block mask routine (SEARCH_BLOCK_ELEMENTS elements)
+typedef uint64_t (*search_block_t)(const char* p, uint64_t needle);
+
+// Dispatch table (indexed by width: 16, 32, 64 bits)
+typedef struct {
+    search_block_t block[3];
+} search_table_t;
+
+// What to do with each mask
+typedef enum {
+    SEARCH_MODE_FIRST,
+    SEARCH_MODE_COUNT,
+    SEARCH_MODE_ALL,
+    SEARCH_MODE_BITMAP
+} search_mode_t;
+
+// Driver state
+typedef struct {
+    search_mode_t mode;
+    size_t matches;
+    size_t first;
+    size_t* offsets;
+    size_t max_offsets;
+    uint64_t* bitmap;
+} search_scan_t;
+
+/**
+ * Population count (no popcnt instruction assumed)
+ */
+static inline size_t search_popcount(uint64_t mask) {
+    mask = mask - ((mask >> 1) & 0x5555555555555555ULL);
+    mask = (mask & 0x3333333333333333ULL) + ((mask >> 2) & 0x3333333333333333ULL);
+    mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (size_t)((mask * 0x0101010101010101ULL) >> 56);
+}
+
+/**
+ * Match mask for up to 64 elements, one at a time
+ */
+static uint64_t search_mask_scalar(const char* p, size_t count, size_t width, uint64_t needle) {
+    uint64_t mask = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value;
+        switch (width) {
+            case 2: value = *(const search_u16_t*)(p + i * 2); break;
+            case 4: value = *(const search_u32_t*)(p + i * 4); break;
+            default: value = *(const search_u64_t*)(p + i * 8); break;
+        }
+        mask |= (uint64_t)(value == needle) << i;
+    }
+    
+    return mask;
+}
+
+// Generic
+
+static uint64_t search_block_16_generic(const char* p, uint64_t needle) {
+    return search_mask_scalar(p, SEARCH_BLOCK_ELEMENTS, 2, needle);
+}
+
+static uint64_t search_block_32_generic(const char* p, uint64_t needle) {
+    return search_mask_scalar(p, SEARCH_BLOCK_ELEMENTS, 4, needle);
+}
+
+static uint64_t search_block_64_generic(const char* p, uint64_t needle) {
+    return search_mask_scalar(p, SEARCH_BLOCK_ELEMENTS, 8, needle);
+}
+
+// SSE2 (16-byte vectors; compare results are packed to one byte per element)
+
+static uint64_t search_block_16_sse2(const char* p, uint64_t needle) {
+    __m128i value = _mm_set1_epi16((short)needle);
+    uint64_t mask = 0;
+    
+    for (unsigned int i = 0; i < 4; i++, p += 32) {
+        __m128i a = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)p), value);
+        __m128i b = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(p + 16)), value);
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_packs_epi16(a, b)) << (i * 16);
+    }
+    
+    return mask;
+}
+
+static uint64_t search_block_32_sse2(const char* p, uint64_t needle) {
+    __m128i value = _mm_set1_epi32((int)needle);
+    uint64_t mask = 0;
+    
+    for (unsigned int i = 0; i < 4; i++, p += 64) {
+        __m128i a = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)p), value);
+        __m128i b = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(p + 16)), value);
+        __m128i c = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(p + 32)), value);
+        __m128i d = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(p + 48)), value);
+        __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(bytes) << (i * 16);
+    }
+    
+    return mask;
+}
+
+static uint64_t search_block_64_sse2(const char* p, uint64_t needle) {
+    __m128i value = _mm_set1_epi64x((long long)needle);
+    uint64_t mask = 0;
+    
+    // No 64-bit compare in SSE2: both 32-bit halves must match
+    for (unsigned int i = 0; i < SEARCH_BLOCK_ELEMENTS / 2; i++, p += 16) {
+        __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)p), value);
+        equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+        mask |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(equal)) << (i * 2);
+    }
+    
+    return mask;
+}
+
+// AVX2 (32-byte vectors)
+
+__attribute__((target("avx2")))
+static uint64_t search_block_16_avx2(const char* p, uint64_t needle) {
+    __m256i value = _mm256_set1_epi16((short)needle);
+    uint64_t mask = 0;
+    
+    // The pack works per 128-bit lane; the permute restores element order
+    for (unsigned int i = 0; i < 2; i++, p += 64) {
+        __m256i a = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)p), value);
+        __m256i b = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(p + 32)), value);
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(bytes) << (i * 32);
+    }
+    
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t search_block_32_avx2(const char* p, uint64_t needle) {
+    __m256i value = _mm256_set1_epi32((int)needle);
+    uint64_t mask = 0;
+    
+    for (unsigned int i = 0; i < SEARCH_BLOCK_ELEMENTS / 8; i++, p += 32) {
+        __m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)p), value);
+        mask |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(equal)) << (i * 8);
+    }
+    
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t search_block_64_avx2(const char* p, uint64_t needle) {
+    __m256i value = _mm256_set1_epi64x((long long)needle);
+    uint64_t mask = 0;
+    
+    for (unsigned int i = 0; i < SEARCH_BLOCK_ELEMENTS / 4; i++, p += 32) {
+        __m256i equal = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)p), value);
+        mask |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(equal)) << (i * 4);
+    }
+    
+    return mask;
+}
+
+// Variant tables
+static const search_table_t g_search_tables[SEARCH_VARIANT_COUNT] = {
+    [SEARCH_VARIANT_GENERIC] = { { search_block_16_generic, search_block_32_generic, search_block_64_generic } },
+    [SEARCH_VARIANT_SSE2] = { { search_block_16_sse2, search_block_32_sse2, search_block_64_sse2 } },
+    [SEARCH_VARIANT_AVX2] = { { search_block_16_avx2, search_block_32_avx2, search_block_64_avx2 } }
+};
+
+static const char* const g_search_variant_names[SEARCH_VARIANT_COUNT] = {
+    [SEARCH_VARIANT_GENERIC] = "generic",
+    [SEARCH_VARIANT_SSE2] = "sse2",
+    [SEARCH_VARIANT_AVX2] = "avx2"
+};
+
+// Routines state (generic until search_init has looked at the CPU)
+static struct {
+    bool initialized;
+    search_variant_t variant;
+    bool supported[SEARCH_VARIANT_COUNT];
+    search_table_t table;
+} g_search_state = {
+    false, SEARCH_VARIANT_GENERIC, { true },
+    { { search_block_16_generic, search_block_32_generic, search_block_64_generic } }
+};
+
+/**
+ * Hand one mask (bit i is element base + i) to the mode; returns true
+ * when the scan can stop
+ */
+static bool search_visit(search_scan_t* scan, size_t base, uint64_t mask) {
+    if (!mask) {
+        return false;
+    }
+    
+    switch (scan->mode) {
+        case SEARCH_MODE_FIRST:
+            scan->first = base + (size_t)__builtin_ctzll(mask);
+            scan->matches = 1;
+            return true;
+        
+        case SEARCH_MODE_COUNT:
+            scan->matches += search_popcount(mask);
+            return false;
+        
+        case SEARCH_MODE_ALL:
+            while (mask) {
+                if (scan->matches == scan->max_offsets) {
+                    return true;
+                }
+                scan->offsets[scan->matches++] = base + (size_t)__builtin_ctzll(mask);
+                mask &= mask - 1;
+            }
+            return scan->matches == scan->max_offsets;
+        
+        case SEARCH_MODE_BITMAP: {
+            // Blocks start wherever the head left off, so a mask can span two words
+            unsigned int shift = (unsigned int)(base % 64);
+            scan->bitmap[base / 64] |= mask << shift;
+            if (shift) {
+                uint64_t spill = mask >> (64 - shift);
+                if (spill) {
+                    scan->bitmap[base / 64 + 1] |= spill;
+                }
+            }
+            scan->matches += search_popcount(mask);
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * Walk the haystack in head, block and tail pieces
+ */
+static void search_scan(search_scan_t* scan, const void* haystack, size_t count, size_t width, uint64_t needle) {
+    const char* p = (const char*)haystack;
+    search_block_t block = g_search_state.table.block[width == 2 ? 0 : width == 4 ? 1 : 2];
+    size_t index = 0;
+    
+    // No element equals a needle wider than itself (the vector compares
+    // would only see its low bits)
+    if (width < 8 && needle >> (width * 8)) {
+        return;
+    }
+    
+    // Scalar head up to vector alignment (only reachable when element-aligned)
+    uintptr_t address = (uintptr_t)p;
+    if (address % width == 0) {
+        size_t head = ((SEARCH_ALIGNMENT - address % SEARCH_ALIGNMENT) % SEARCH_ALIGNMENT) / width;
+        if (head > count) {
+            head = count;
+        }
+        if (search_visit(scan, 0, search_mask_scalar(p, head, width, needle))) {
+            return;
+        }
+        index = head;
+    }
+    
+    for (; count - index >= SEARCH_BLOCK_ELEMENTS; index += SEARCH_BLOCK_ELEMENTS) {
+        if (search_visit(scan, index, block(p + index * width, needle))) {
+            return;
+        }
+    }
+    
+    search_visit(scan, index, search_mask_scalar(p + index * width, count - index, width, needle));
+}
+
+static bool search_width_valid(size_t width) {
+    return width == 2 || width == 4 || width == 8;
+}
+
+/**
+ * Detect the supported variants and select the best one
+ */
+void search_init(void) {
+    if (g_search_state.initialized) {
+        return;
+    }
+    
+    cpu_info_t cpu_info = {0};
+    cpu_detect(&cpu_info);
+    
+    g_search_state.supported[SEARCH_VARIANT_GENERIC] = true;
+    g_search_state.supported[SEARCH_VARIANT_SSE2] = cpu_info.features.sse2;
+    g_search_state.supported[SEARCH_VARIANT_AVX2] = cpu_info.features.avx2 && cpu_avx_usable(&cpu_info);
+    
+    for (int variant = SEARCH_VARIANT_COUNT - 1; variant >= 0; variant--) {
+        if (search_set_variant((search_variant_t)variant) == 0) {
+            break;
+        }
+    }
+    
+    g_search_state.initialized = true;
+}
+
+/**
+ * Check whether this CPU can run a variant
+ */
+bool search_variant_supported(search_variant_t variant) {
+    return variant < SEARCH_VARIANT_COUNT && g_search_state.supported[variant];
+}
+
+/**
+ * Switch all routines to a variant
+ */
+int search_set_variant(search_variant_t variant) {
+    if (!search_variant_supported(variant)) {
+        return -1;
+    }
+    
+    g_search_state.variant = variant;
+    g_search_state.table = g_search_tables[variant];
+    return 0;
+}
+
+/**
+ * Get the selected variant
+ */
+search_variant_t search_get_variant(void) {
+    return g_search_state.variant;
+}
+
+/**
+ * Get a variant's name
+ */
+const char* search_variant_name(search_variant_t variant) {
+    return variant < SEARCH_VARIANT_COUNT ? g_search_variant_names[variant] : "unknown";
+}
+
+/**
+ * Find the first element equal to needle
+ */
+const void* search_first(const void* haystack, size_t count, size_t width, uint64_t needle) {
+    if (!haystack || !search_width_valid(width)) {
+        return NULL;
+    }
+    
+    search_scan_t scan = { SEARCH_MODE_FIRST, 0, 0, NULL, 0, NULL };
+    search_scan(&scan, haystack, count, width, needle);
+    
+    return scan.matches ? (const char*)haystack + scan.first * width : NULL;
+}
+
+/**
+ * Count the elements equal to needle
+ */
+size_t search_count(const void* haystack, size_t count, size_t width, uint64_t needle) {
+    if (!haystack || !search_width_valid(width)) {
+        return 0;
+    }
+    
+    search_scan_t scan = { SEARCH_MODE_COUNT, 0, 0, NULL, 0, NULL };
+    search_scan(&scan, haystack, count, width, needle);
+    return scan.matches;
+}
+
+/**
+ * Collect the offsets of the elements equal to needle
+ */
+size_t search_all(const void* haystack, size_t count, size_t width, uint64_t needle,
+                  size_t* offsets, size_t max_offsets) {
+    if (!haystack || !offsets || max_offsets == 0 || !search_width_valid(width)) {
+        return 0;
+    }
+    
+    search_scan_t scan = { SEARCH_MODE_ALL, 0, 0, offsets, max_offsets, NULL };
+    search_scan(&scan, haystack, count, width, needle);
+    return scan.matches;
+}
+
+/**
+ * Mark the elements equal to needle in a bitmap
+ */
+size_t search_bitmap(const void* haystack, size_t count, size_t width, uint64_t needle, uint64_t* bitmap) {
+    if (!haystack || !bitmap || !search_width_valid(width)) {
+        return 0;
+    }
+    
+    for (size_t word = 0; word < (count + 63) / 64; word++) {
+        bitmap[word] = 0;
+    }
+    
+    search_scan_t scan = { SEARCH_MODE_BITMAP, 0, 0, NULL, 0, bitmap };
+    search_scan(&scan, haystack, count, width, needle);
+    return scan.matches;
+}
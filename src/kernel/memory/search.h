@@ -0,0 +1,49 @@
+/**
+ * CompileOS Element Search Routines - Header
+ *
+ * Search arrays of 16-, 32- or 64-bit elements for a value with SSE2 and
+ * AVX2 variants, one of which is selected at boot from the CPU feature
+ * bits. Besides the first match, a search can report every match offset,
+ * the number of matches or a bitmap of them.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Elements compared per vector block (one bit each in a 64-bit mask)
+#define SEARCH_BLOCK_ELEMENTS 64
+
+// Routine variants
+typedef enum {
+    SEARCH_VARIANT_GENERIC,
+    SEARCH_VARIANT_SSE2,
+    SEARCH_VARIANT_AVX2,
+    SEARCH_VARIANT_COUNT
+} search_variant_t;
+
+// Variant selection (init picks the best variant the CPU supports)
+void search_init(void);
+bool search_variant_supported(search_variant_t variant);
+int search_set_variant(search_variant_t variant);
+search_variant_t search_get_variant(void);
+const char* search_variant_name(search_variant_t variant);
+
+// Searches over count elements of width bytes (2, 4 or 8); the haystack
+// needs no alignment and offsets are element indices
+const void* search_first(const void* haystack, size_t count, size_t width, uint64_t needle);
+size_t search_count(const void* haystack, size_t count, size_t width, uint64_t needle);
+
+// Store up to max_offsets match offsets in ascending order; returns the
+// number stored (the scan stops once the buffer is full)
+size_t search_all(const void* haystack, size_t count, size_t width, uint64_t needle,
+                  size_t* offsets, size_t max_offsets);
+
+// Set bit i of bitmap (count / 64 words, rounded up) when element i
+// matches; returns the number of matches
+size_t search_bitmap(const void* haystack, size_t count, size_t width, uint64_t needle, uint64_t* bitmap);
+
+#endif // SEARCH_H
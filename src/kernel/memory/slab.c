@@ -0,0 +1,337 @@
+/**
+ * CompileOS Slab Allocator - Implementation
+ *
+ * Per-type object caches carved out of naturally aligned page blocks.
+ * The slab header sits at the start of each chunk, so an object's slab is
+ * found by masking its address; free objects are tracked in a small index
+ * stack after the header so freed objects keep their constructed state.
+ * A bitmap next to the stack marks which objects are free, so a second
+ * free of the same object is caught and ignored.
+ */
+
+#include "slab.h"
+#include "memory.h"
+#include "page.h"
+#include "../spinlock.h"
+#include <string.h>
+
+// Slab sizing
+#define SLAB_BASE_SIZE PAGE_SIZE
+#define SLAB_MAX_ORDER 6
+#define SLAB_MIN_OBJECTS 8
+#define SLAB_MAX_EMPTY 1
+
+// Slab header
+typedef struct slab {
+    struct slab* next;
+    struct slab* prev;
+    char* objects;
+    uint64_t* free_map;
+    uint16_t free_count;
+    uint16_t capacity;
+    uint16_t free_stack[];
+} slab_t;
+
+// Slab list
+typedef struct {
+    slab_t* head;
+    size_t count;
+} slab_list_t;
+
+// Object cache
+struct slab_cache {
+    char name[32];
+    size_t object_size;
+    size_t align;
+    size_t stride;
+    size_t slab_size;
+    unsigned int slab_order;
+    size_t map_offset;
+    size_t objects_offset;
+    uint16_t objects_per_slab;
+    slab_ctor_t ctor;
+    spinlock_t lock;
+    slab_list_t partial;
+    slab_list_t full;
+    slab_list_t empty;
+    size_t objects_in_use;
+    size_t total_allocations;
+    size_t total_frees;
+};
+
+static size_t slab_align_up(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+/**
+ * Bytes in front of the objects: header, free stack and free bitmap
+ */
+static size_t slab_map_offset(size_t count) {
+    return slab_align_up(sizeof(slab_t) + count * sizeof(uint16_t), sizeof(uint64_t));
+}
+
+static size_t slab_header_size(size_t count) {
+    return slab_map_offset(count) + (count + 63) / 64 * sizeof(uint64_t);
+}
+
+static bool slab_is_free(const slab_t* slab, uint16_t index) {
+    return (slab->free_map[index / 64] >> (index % 64)) & 1;
+}
+
+static void slab_list_push(slab_list_t* list, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = list->head;
+    if (list->head) {
+        list->head->prev = slab;
+    }
+    list->head = slab;
+    list->count++;
+}
+
+static void slab_list_remove(slab_list_t* list, slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        list->head = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+    list->count--;
+}
+
+/**
+ * Carve a new slab and run the constructor over its objects
+ */
+static slab_t* slab_create(slab_cache_t* cache) {
+    slab_t* slab = (slab_t*)page_alloc(cache->slab_order);
+    if (!slab) {
+        return NULL;
+    }
+    
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->objects = (char*)slab + cache->objects_offset;
+    slab->free_map = (uint64_t*)((char*)slab + cache->map_offset);
+    slab->capacity = cache->objects_per_slab;
+    slab->free_count = cache->objects_per_slab;
+    
+    // Every object starts out free
+    memset(slab->free_map, 0xFF, (slab->capacity + 63) / 64 * sizeof(uint64_t));
+    
+    for (uint16_t i = 0; i < slab->capacity; i++) {
+        // Hand out low addresses first
+        slab->free_stack[i] = (uint16_t)(slab->capacity - 1 - i);
+        if (cache->ctor) {
+            cache->ctor(slab->objects + (size_t)i * cache->stride);
+        }
+    }
+    
+    return slab;
+}
+
+static void slab_release(slab_cache_t* cache, slab_t* slab) {
+    page_free(slab, cache->slab_order);
+}
+
+/**
+ * Create an object cache
+ */
+slab_cache_t* slab_cache_create(const char* name, size_t object_size, size_t align, slab_ctor_t ctor) {
+    if (object_size == 0) {
+        return NULL;
+    }
+    
+    if (align == 0) {
+        align = SLAB_CACHE_LINE_SIZE;
+    }
+    if (align & (align - 1)) {
+        return NULL; // Alignment must be a power of two
+    }
+    
+    size_t stride = slab_align_up(object_size, align);
+    
+    // Pick the smallest slab that holds a useful number of objects
+    size_t slab_size = SLAB_BASE_SIZE;
+    size_t offset = 0;
+    size_t count = 0;
+    unsigned int order;
+    for (order = 0; order <= SLAB_MAX_ORDER; order++) {
+        slab_size = (size_t)SLAB_BASE_SIZE << order;
+        count = (slab_size - sizeof(slab_t)) / (stride + sizeof(uint16_t));
+        if (count > UINT16_MAX) {
+            count = UINT16_MAX;
+        }
+        while (count > 0) {
+            offset = slab_align_up(slab_header_size(count), align);
+            if (offset + count * stride <= slab_size) {
+                break;
+            }
+            count--;
+        }
+        if (count >= SLAB_MIN_OBJECTS) {
+            break;
+        }
+    }
+    
+    if (count == 0) {
+        return NULL;
+    }
+    if (order > SLAB_MAX_ORDER) {
+        order = SLAB_MAX_ORDER;
+    }
+    
+    slab_cache_t* cache = (slab_cache_t*)memory_alloc(sizeof(slab_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+    
+    memset(cache, 0, sizeof(slab_cache_t));
+    if (name) {
+        strncpy(cache->name, name, sizeof(cache->name) - 1);
+        cache->name[sizeof(cache->name) - 1] = '\0';
+    }
+    cache->object_size = object_size;
+    cache->align = align;
+    cache->stride = stride;
+    cache->slab_size = slab_size;
+    cache->slab_order = order;
+    cache->map_offset = slab_map_offset(count);
+    cache->objects_offset = offset;
+    cache->objects_per_slab = (uint16_t)count;
+    cache->ctor = ctor;
+    cache->lock = (spinlock_t)SPINLOCK_INIT;
+    
+    return cache;
+}
+
+/**
+ * Destroy an object cache and release all of its slabs
+ */
+void slab_cache_destroy(slab_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+    
+    slab_list_t* lists[] = { &cache->partial, &cache->full, &cache->empty };
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        slab_t* slab = lists[i]->head;
+        while (slab) {
+            slab_t* next = slab->next;
+            slab_release(cache, slab);
+            slab = next;
+        }
+    }
+    
+    memory_free(cache);
+}
+
+/**
+ * Allocate an object from a cache
+ */
+void* slab_alloc(slab_cache_t* cache) {
+    if (!cache) {
+        return NULL;
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&cache->lock);
+    
+    slab_t* slab = cache->partial.head;
+    if (!slab) {
+        slab = cache->empty.head;
+        if (slab) {
+            slab_list_remove(&cache->empty, slab);
+        } else {
+            slab = slab_create(cache);
+            if (!slab) {
+                spin_unlock_irqrestore(&cache->lock, irq_state);
+                return NULL;
+            }
+        }
+        slab_list_push(&cache->partial, slab);
+    }
+    
+    uint16_t index = slab->free_stack[--slab->free_count];
+    slab->free_map[index / 64] &= ~(1ULL << (index % 64));
+    if (slab->free_count == 0) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+    
+    cache->objects_in_use++;
+    cache->total_allocations++;
+    
+    spin_unlock_irqrestore(&cache->lock, irq_state);
+    return slab->objects + (size_t)index * cache->stride;
+}
+
+/**
+ * Return an object to its cache
+ */
+void slab_free(slab_cache_t* cache, void* object) {
+    if (!cache || !object) {
+        return;
+    }
+    
+    slab_t* slab = (slab_t*)((uintptr_t)object & ~(uintptr_t)(cache->slab_size - 1));
+    if ((char*)object < slab->objects) {
+        return; // Not an object from this cache
+    }
+    
+    size_t offset = (size_t)((char*)object - slab->objects);
+    if (offset % cache->stride != 0) {
+        return;
+    }
+    
+    uint16_t index = (uint16_t)(offset / cache->stride);
+    if (index >= slab->capacity) {
+        return;
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&cache->lock);
+    if (slab_is_free(slab, index)) {
+        spin_unlock_irqrestore(&cache->lock, irq_state);
+        return; // Double free
+    }
+    
+    if (slab->free_count == 0) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+    
+    slab->free_stack[slab->free_count++] = index;
+    slab->free_map[index / 64] |= 1ULL << (index % 64);
+    cache->objects_in_use--;
+    cache->total_frees++;
+    
+    if (slab->free_count == slab->capacity) {
+        slab_list_remove(&cache->partial, slab);
+        if (cache->empty.count >= SLAB_MAX_EMPTY) {
+            slab_release(cache, slab);
+        } else {
+            slab_list_push(&cache->empty, slab);
+        }
+    }
+    
+    spin_unlock_irqrestore(&cache->lock, irq_state);
+}
+
+/**
+ * Get cache statistics
+ */
+void slab_cache_get_stats(const slab_cache_t* cache, slab_cache_stats_t* stats) {
+    if (!cache || !stats) {
+        return;
+    }
+    
+    stats->object_size = cache->object_size;
+    stats->object_stride = cache->stride;
+    stats->objects_per_slab = cache->objects_per_slab;
+    stats->slab_size = cache->slab_size;
+    stats->slab_count = cache->partial.count + cache->full.count + cache->empty.count;
+    stats->objects_in_use = cache->objects_in_use;
+    stats->total_allocations = cache->total_allocations;
+    stats->total_frees = cache->total_frees;
+}
@@ -0,0 +1,46 @@
+/**
+ * CompileOS Slab Allocator - Header
+ *
+ * Object caches for fixed-size kernel objects
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Default object alignment (one cache line)
+#define SLAB_CACHE_LINE_SIZE 64
+
+// Object constructor, run once when a slab is carved into objects
+typedef void (*slab_ctor_t)(void* object);
+
+// Opaque object cache
+typedef struct slab_cache slab_cache_t;
+
+// Slab cache statistics
+typedef struct {
+    size_t object_size;
+    size_t object_stride;
+    size_t objects_per_slab;
+    size_t slab_size;
+    size_t slab_count;
+    size_t objects_in_use;
+    size_t total_allocations;
+    size_t total_frees;
+} slab_cache_stats_t;
+
+// Cache management
+slab_cache_t* slab_cache_create(const char* name, size_t object_size, size_t align, slab_ctor_t ctor);
+void slab_cache_destroy(slab_cache_t* cache);
+
+// Object allocation
+void* slab_alloc(slab_cache_t* cache);
+void slab_free(slab_cache_t* cache, void* object);
+
+// Cache statistics
+void slab_cache_get_stats(const slab_cache_t* cache, slab_cache_stats_t* stats);
+
+#endif // SLAB_H
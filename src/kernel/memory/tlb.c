@@ -0,0 +1,365 @@
+/**
+ * CompileOS TLB Management - Implementation
+ *
+ * With PCIDs every process address space keeps its TLB entries across
+ * switches. A space remembers the CPUs that have run it (cpu_mask); when
+ * its mappings change, CPUs currently running it are interrupted and the
+ * others only get a bit in stale_mask, which makes their next switch to the
+ * space flush its PCID. The kernel space's mappings are global pages seen
+ * from every space, so changes to it go to every CPU that is up.
+ *
+ * Only one shootdown is in flight at a time. CPUs waiting to start one, or
+ * spinning on a lock with interrupts enabled, still answer requests, which
+ * keeps two CPUs from waiting on each other.
+ */
+
+#include "tlb.h"
+#include "../spinlock.h"
+#include "../../hal/hal.h"
+#include "../../hal/arch/x86_64/cpu.h"
+
+// PCIDs available (PCID 0 is the kernel's and the fallback when all are taken)
+#define TLB_PCID_COUNT 4096
+
+// TLB state
+static struct {
+    bool initialized;
+    bool pcid;
+    bool invpcid;
+    paging_space_t* active[HAL_MAX_CPUS];
+    uint64_t online_mask;
+    uint64_t pcid_map[TLB_PCID_COUNT / 64];
+    
+    // Shootdown in flight (guarded by g_tlb_shootdown_lock)
+    const tlb_batch_t* request;
+    uint64_t pending_mask;
+    
+    tlb_stats_t stats;
+} g_tlb_state = {0};
+
+// Protects the PCID map
+static spinlock_t g_tlb_pcid_lock = SPINLOCK_INIT;
+
+// Serializes shootdowns
+static spinlock_t g_tlb_shootdown_lock = SPINLOCK_INIT;
+
+static uint32_t tlb_cpu(void) {
+    uint32_t cpu = hal_get_cpu_id();
+    return cpu < HAL_MAX_CPUS ? cpu : 0;
+}
+
+static void tlb_count(uint64_t* counter, uint64_t amount) {
+    __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+}
+
+/**
+ * Apply a batch on this CPU
+ */
+static void tlb_flush_local(const tlb_batch_t* batch) {
+    bool kernel = batch->space == paging_kernel_space();
+    
+    if (batch->full || batch->total_pages > TLB_FLUSH_ALL_PAGES) {
+        if (kernel) {
+            cpu_invalidate_tlb_global();
+        } else if (g_tlb_state.invpcid) {
+            cpu_invpcid(CPU_INVPCID_CONTEXT, batch->space->pcid, 0);
+        } else {
+            cpu_invalidate_tlb(); // Reloading CR3 flushes the current PCID
+        }
+        tlb_count(&g_tlb_state.stats.full_flushes, 1);
+        return;
+    }
+    
+    // INVLPG drops global entries too, so kernel pages need nothing more
+    for (size_t i = 0; i < batch->count; i++) {
+        for (uint64_t page = 0; page < batch->pages[i]; page++) {
+            cpu_invalidate_tlb_page(batch->starts[i] + page * PAGING_SIZE_4KB);
+        }
+    }
+    tlb_count(&g_tlb_state.stats.page_flushes, batch->total_pages);
+}
+
+/**
+ * Handle a pending shootdown request for this CPU, if any
+ */
+static void tlb_service(void) {
+    uint32_t cpu = tlb_cpu();
+    uint64_t bit = 1ULL << cpu;
+    
+    if (!(__atomic_load_n(&g_tlb_state.pending_mask, __ATOMIC_SEQ_CST) & bit)) {
+        return;
+    }
+    
+    const tlb_batch_t* request = g_tlb_state.request;
+    paging_space_t* space = request->space;
+    
+    // A CPU that has switched away meanwhile flushes on its way back
+    if (space == paging_kernel_space() || __atomic_load_n(&g_tlb_state.active[cpu], __ATOMIC_SEQ_CST) == space) {
+        __atomic_fetch_and(&space->stale_mask, ~bit, __ATOMIC_SEQ_CST);
+        tlb_flush_local(request);
+    }
+    
+    __atomic_fetch_and(&g_tlb_state.pending_mask, ~bit, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Inter-processor interrupt handler
+ */
+static void tlb_ipi_handler(void) {
+    tlb_service();
+}
+
+/**
+ * Have other CPUs apply a batch and wait until they all have
+ */
+static void tlb_shootdown(const tlb_batch_t* batch, uint64_t targets) {
+    while (!spin_trylock(&g_tlb_shootdown_lock)) {
+        tlb_service();
+        spin_pause();
+    }
+    
+    g_tlb_state.request = batch;
+    __atomic_store_n(&g_tlb_state.pending_mask, targets, __ATOMIC_SEQ_CST);
+    
+    for (uint32_t cpu = 0; cpu < HAL_MAX_CPUS; cpu++) {
+        if (!(targets & (1ULL << cpu))) {
+            continue;
+        }
+        
+        if (hal_ipi_send(cpu) == HAL_SUCCESS) {
+            tlb_count(&g_tlb_state.stats.ipis_sent, 1);
+        } else {
+            __atomic_fetch_and(&g_tlb_state.pending_mask, ~(1ULL << cpu), __ATOMIC_SEQ_CST);
+        }
+    }
+    tlb_count(&g_tlb_state.stats.shootdowns, 1);
+    
+    while (__atomic_load_n(&g_tlb_state.pending_mask, __ATOMIC_SEQ_CST)) {
+        spin_pause();
+    }
+    
+    g_tlb_state.request = NULL;
+    spin_unlock(&g_tlb_shootdown_lock);
+}
+
+/**
+ * Enable global pages and, where supported, PCIDs
+ */
+int tlb_init(void) {
+    if (g_tlb_state.initialized) {
+        return 0;
+    }
+    
+    cpu_info_t cpu_info = {0};
+    cpu_detect(&cpu_info);
+    g_tlb_state.pcid = cpu_info.features.pcid;
+    g_tlb_state.invpcid = cpu_info.features.pcid && cpu_info.features.invpcid;
+    
+    // CR4.PCIDE may only be set while the current PCID is 0, which holds
+    // until the first switch through tlb_activate
+    uint64_t cr4 = cpu_read_cr4() | CPU_CR4_PGE;
+    if (g_tlb_state.pcid) {
+        cr4 |= CPU_CR4_PCIDE;
+    }
+    cpu_write_cr4(cr4);
+    
+    g_tlb_state.pcid_map[0] = 1; // PCID 0
+    g_tlb_state.stats.pcid_enabled = g_tlb_state.pcid;
+    g_tlb_state.stats.invpcid = g_tlb_state.invpcid;
+    
+    // Without an interrupt controller only this CPU ever runs
+    hal_ipi_set_handler(tlb_ipi_handler);
+    
+    g_tlb_state.initialized = true;
+    return 0;
+}
+
+/**
+ * Give an address space a PCID of its own, if one is free
+ */
+void tlb_space_init(paging_space_t* space) {
+    space->pcid = 0;
+    space->cpu_mask = 0;
+    
+    // Whoever held the PCID before may have left entries on any CPU
+    space->stale_mask = ~0ULL;
+    
+    if (!g_tlb_state.pcid || space == paging_kernel_space()) {
+        return;
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_tlb_pcid_lock);
+    
+    for (size_t word = 0; word < TLB_PCID_COUNT / 64; word++) {
+        uint64_t free_bits = ~g_tlb_state.pcid_map[word];
+        if (free_bits) {
+            unsigned int bit = (unsigned int)__builtin_ctzll(free_bits);
+            g_tlb_state.pcid_map[word] |= 1ULL << bit;
+            space->pcid = (uint16_t)(word * 64 + bit);
+            g_tlb_state.stats.pcids_in_use++;
+            break;
+        }
+    }
+    
+    spin_unlock_irqrestore(&g_tlb_pcid_lock, irq_state);
+}
+
+/**
+ * Return an address space's PCID (the space must not be active anywhere)
+ */
+void tlb_space_release(paging_space_t* space) {
+    if (!space->pcid) {
+        return;
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_tlb_pcid_lock);
+    g_tlb_state.pcid_map[space->pcid / 64] &= ~(1ULL << (space->pcid % 64));
+    g_tlb_state.stats.pcids_in_use--;
+    spin_unlock_irqrestore(&g_tlb_pcid_lock, irq_state);
+    
+    space->pcid = 0;
+}
+
+/**
+ * Switch this CPU to an address space, keeping its TLB entries when its
+ * PCID has not gone stale here
+ */
+void tlb_activate(paging_space_t* space) {
+    uint32_t cpu = tlb_cpu();
+    uint64_t bit = 1ULL << cpu;
+    
+    __atomic_fetch_or(&g_tlb_state.online_mask, bit, __ATOMIC_SEQ_CST);
+    if (g_tlb_state.active[cpu] == space &&
+        (cpu_read_cr3() & PAGING_ADDRESS_MASK) == space->pml4_physical) {
+        return;
+    }
+    
+    // Publish the switch before checking for staleness; a concurrent
+    // shootdown either sees this CPU active or leaves the stale bit for it
+    __atomic_store_n(&g_tlb_state.active[cpu], space, __ATOMIC_SEQ_CST);
+    __atomic_fetch_or(&space->cpu_mask, bit, __ATOMIC_SEQ_CST);
+    bool stale = (__atomic_fetch_and(&space->stale_mask, ~bit, __ATOMIC_SEQ_CST) & bit) != 0;
+    
+    uint64_t cr3 = space->pml4_physical;
+    if (g_tlb_state.pcid) {
+        cr3 |= space->pcid;
+        
+        // PCID 0 may be shared, so switching to it always flushes
+        if (space->pcid && !stale) {
+            cr3 |= CPU_CR3_NO_FLUSH;
+            tlb_count(&g_tlb_state.stats.switches_kept, 1);
+        }
+    }
+    
+    cpu_write_cr3(cr3);
+    tlb_count(&g_tlb_state.stats.switches, 1);
+}
+
+/**
+ * Start an empty batch for an address space
+ */
+void tlb_batch_init(tlb_batch_t* batch, paging_space_t* space) {
+    batch->space = space;
+    batch->count = 0;
+    batch->total_pages = 0;
+    batch->full = false;
+}
+
+/**
+ * Add pages to invalidate (one address per large page is enough)
+ */
+void tlb_batch_add(tlb_batch_t* batch, uint64_t virtual_addr, uint64_t pages) {
+    if (batch->full || pages == 0) {
+        return;
+    }
+    
+    batch->total_pages += pages;
+    if (batch->total_pages > TLB_FLUSH_ALL_PAGES) {
+        batch->full = true;
+        return;
+    }
+    
+    // Extend the last range when the new one follows it
+    if (batch->count &&
+        batch->starts[batch->count - 1] + batch->pages[batch->count - 1] * PAGING_SIZE_4KB == virtual_addr) {
+        batch->pages[batch->count - 1] += pages;
+        return;
+    }
+    
+    if (batch->count == TLB_BATCH_RANGES) {
+        batch->full = true;
+        return;
+    }
+    
+    batch->starts[batch->count] = virtual_addr;
+    batch->pages[batch->count] = pages;
+    batch->count++;
+}
+
+/**
+ * Request a full flush of the batch's address space
+ */
+void tlb_batch_add_all(tlb_batch_t* batch) {
+    batch->full = true;
+}
+
+/**
+ * Invalidate everything collected, here and on the other CPUs that may
+ * hold entries, then empty the batch
+ */
+void tlb_batch_flush(tlb_batch_t* batch) {
+    if (!g_tlb_state.initialized || (!batch->full && batch->count == 0)) {
+        tlb_batch_init(batch, batch->space);
+        return;
+    }
+    
+    paging_space_t* space = batch->space;
+    uint32_t cpu = tlb_cpu();
+    uint64_t bit = 1ULL << cpu;
+    uint64_t targets = 0;
+    bool local = false;
+    
+    if (space == paging_kernel_space()) {
+        targets = __atomic_load_n(&g_tlb_state.online_mask, __ATOMIC_SEQ_CST) & ~bit;
+        local = true;
+    } else {
+        uint64_t users = __atomic_load_n(&space->cpu_mask, __ATOMIC_SEQ_CST);
+        local = __atomic_load_n(&g_tlb_state.active[cpu], __ATOMIC_SEQ_CST) == space;
+        
+        // Mark first, then look at who is running the space (see tlb_activate)
+        __atomic_fetch_or(&space->stale_mask, local ? users & ~bit : users, __ATOMIC_SEQ_CST);
+        
+        for (uint32_t other = 0; other < HAL_MAX_CPUS; other++) {
+            uint64_t other_bit = 1ULL << other;
+            if (other == cpu || !(users & other_bit)) {
+                continue;
+            }
+            
+            if (__atomic_load_n(&g_tlb_state.active[other], __ATOMIC_SEQ_CST) == space) {
+                targets |= other_bit;
+            } else {
+                tlb_count(&g_tlb_state.stats.ipis_avoided, 1);
+            }
+        }
+    }
+    
+    if (local) {
+        tlb_flush_local(batch);
+    }
+    if (targets) {
+        tlb_shootdown(batch, targets);
+    }
+    
+    tlb_batch_init(batch, space);
+}
+
+/**
+ * Get TLB statistics
+ */
+void tlb_get_stats(tlb_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    
+    *stats = g_tlb_state.stats;
+}
@@ -0,0 +1,63 @@
+/**
+ * CompileOS TLB Management - Header
+ *
+ * PCID-tagged address spaces, batched invalidation and cross-CPU
+ * shootdown limited to the CPUs that have used an address space
+ */
+
+#ifndef TLB_H
+#define TLB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "paging.h"
+
+// Ranges a batch collects before it degrades to a full flush
+#define TLB_BATCH_RANGES 16
+
+// Above this many pages a full flush is cheaper than single invalidations
+#define TLB_FLUSH_ALL_PAGES 32
+
+// Invalidation batch (collect with add, then flush once)
+typedef struct tlb_batch {
+    paging_space_t* space;
+    uint64_t starts[TLB_BATCH_RANGES];
+    uint64_t pages[TLB_BATCH_RANGES];
+    size_t count;
+    uint64_t total_pages;
+    bool full;
+} tlb_batch_t;
+
+// TLB statistics
+typedef struct {
+    bool pcid_enabled;
+    bool invpcid;
+    uint64_t pcids_in_use;
+    uint64_t page_flushes;
+    uint64_t full_flushes;
+    uint64_t switches;
+    uint64_t switches_kept;     // Address space switches that kept the TLB
+    uint64_t shootdowns;
+    uint64_t ipis_sent;
+    uint64_t ipis_avoided;      // CPUs marked to flush on their next switch instead
+} tlb_stats_t;
+
+// Initialization (enables global pages and PCIDs; called by paging_init)
+int tlb_init(void);
+
+// Address spaces (PCID assignment and switching)
+void tlb_space_init(paging_space_t* space);
+void tlb_space_release(paging_space_t* space);
+void tlb_activate(paging_space_t* space);
+
+// Batched invalidation
+void tlb_batch_init(tlb_batch_t* batch, paging_space_t* space);
+void tlb_batch_add(tlb_batch_t* batch, uint64_t virtual_addr, uint64_t pages);
+void tlb_batch_add_all(tlb_batch_t* batch);
+void tlb_batch_flush(tlb_batch_t* batch);
+
+// Statistics
+void tlb_get_stats(tlb_stats_t* stats);
+
+#endif // TLB_H
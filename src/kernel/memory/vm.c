@@ -0,0 +1,539 @@
+/**
+ * CompileOS Virtual Memory Areas - Implementation
+ *
+ * Each address space keeps a sorted list of areas. Nothing is mapped when
+ * an area is reserved; the page fault handler finds the area covering the
+ * faulting address and installs a zeroed page (demand paging) or, for a
+ * write to a read-only page of a writable area, a private copy of it
+ * (copy-on-write).
+ *
+ * Frames mapped by more than one area carry a reference count in a small
+ * hash table; frames missing from it have a single owner. All areas,
+ * counts and statistics are protected by one lock, taken with interrupts
+ * off, so faults are resolved one at a time. The fault path allocates from
+ * the page allocator and the slab caches only, never from the heap.
+ */
+
+#include "vm.h"
+#include "paging.h"
+#include "tlb.h"
+#include "page.h"
+#include "slab.h"
+#include "memops.h"
+#include "../spinlock.h"
+#include "../../hal/hal.h"
+#include "../../hal/arch/x86_64/cpu.h"
+#include "../../hal/arch/x86_64/interrupts.h"
+
+// Shared frame reference table size (power of two)
+#define VM_FRAME_BUCKETS 1024
+
+// Area
+typedef struct vm_area {
+    uint64_t start;
+    uint64_t end;
+    uint32_t flags;
+    uint32_t node;              // NUMA node for new pages (PAGE_NODE_LOCAL: faulting CPU's)
+    uint64_t resident_pages;
+    struct vm_area* next;
+} vm_area_t;
+
+// Address space
+struct vm_space {
+    paging_space_t* paging;
+    vm_area_t* areas;
+    uint64_t base;
+    uint64_t limit;
+};
+
+// Reference count of a frame mapped by two or more areas
+typedef struct vm_frame_ref {
+    uint64_t frame;
+    uint64_t refs;
+    struct vm_frame_ref* next;
+} vm_frame_ref_t;
+
+// Virtual memory state
+static struct {
+    bool initialized;
+    slab_cache_t* space_cache;
+    slab_cache_t* area_cache;
+    slab_cache_t* ref_cache;
+    vm_space_t kernel_space;
+    vm_space_t* current[HAL_MAX_CPUS];
+    vm_frame_ref_t* frame_refs[VM_FRAME_BUCKETS];
+    vm_stats_t stats;
+} g_vm_state = {0};
+
+// Protects every space's areas, the frame references and the statistics
+static spinlock_t g_vm_lock = SPINLOCK_INIT;
+
+static uint64_t vm_page_flags(uint32_t flags) {
+    return ((flags & VM_WRITE) ? PAGING_WRITABLE : 0) | ((flags & VM_EXEC) ? 0 : PAGING_NO_EXECUTE);
+}
+
+static vm_space_t* vm_current_space(void) {
+    uint32_t cpu = hal_get_cpu_id();
+    vm_space_t* space = cpu < HAL_MAX_CPUS ? g_vm_state.current[cpu] : NULL;
+    return space ? space : &g_vm_state.kernel_space;
+}
+
+/**
+ * Find the area containing an address
+ */
+static vm_area_t* vm_find_area(vm_space_t* space, uint64_t address) {
+    for (vm_area_t* area = space->areas; area && area->start <= address; area = area->next) {
+        if (address < area->end) {
+            return area;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Insert a new area in the first gap of the space's window that fits
+ */
+static vm_area_t* vm_insert_area(vm_space_t* space, uint64_t size, uint32_t flags, uint32_t node) {
+    uint64_t start = space->base;
+    vm_area_t** link = &space->areas;
+    
+    while (*link && (*link)->start - start < size) {
+        start = (*link)->end;
+        link = &(*link)->next;
+    }
+    if (space->limit - start < size) {
+        return NULL;
+    }
+    
+    vm_area_t* area = (vm_area_t*)slab_alloc(g_vm_state.area_cache);
+    if (!area) {
+        return NULL;
+    }
+    
+    area->start = start;
+    area->end = start + size;
+    area->flags = flags;
+    area->node = node;
+    area->resident_pages = 0;
+    area->next = *link;
+    *link = area;
+    
+    g_vm_state.stats.areas++;
+    g_vm_state.stats.reserved_bytes += size;
+    return area;
+}
+
+static vm_frame_ref_t** vm_frame_bucket(uint64_t frame) {
+    return &g_vm_state.frame_refs[(frame >> PAGE_SHIFT) & (VM_FRAME_BUCKETS - 1)];
+}
+
+static vm_frame_ref_t* vm_frame_find(uint64_t frame) {
+    for (vm_frame_ref_t* ref = *vm_frame_bucket(frame); ref; ref = ref->next) {
+        if (ref->frame == frame) {
+            return ref;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Take another reference to a frame
+ */
+static bool vm_frame_get(uint64_t frame) {
+    vm_frame_ref_t* ref = vm_frame_find(frame);
+    if (ref) {
+        ref->refs++;
+        return true;
+    }
+    
+    ref = (vm_frame_ref_t*)slab_alloc(g_vm_state.ref_cache);
+    if (!ref) {
+        return false;
+    }
+    
+    vm_frame_ref_t** bucket = vm_frame_bucket(frame);
+    ref->frame = frame;
+    ref->refs = 2;
+    ref->next = *bucket;
+    *bucket = ref;
+    
+    g_vm_state.stats.shared_frames++;
+    return true;
+}
+
+/**
+ * Drop one reference to a frame, returning true if the caller held the last
+ * one (the frame is then freed unless keep is set)
+ */
+static bool vm_frame_put(uint64_t frame, bool keep) {
+    vm_frame_ref_t** link = vm_frame_bucket(frame);
+    while (*link && (*link)->frame != frame) {
+        link = &(*link)->next;
+    }
+    
+    vm_frame_ref_t* ref = *link;
+    if (!ref) {
+        if (!keep) {
+            page_free((void*)(uintptr_t)frame, 0);
+        }
+        return true;
+    }
+    
+    // A single remaining owner is implied by the absence of an entry
+    if (--ref->refs == 1) {
+        *link = ref->next;
+        slab_free(g_vm_state.ref_cache, ref);
+        g_vm_state.stats.shared_frames--;
+    }
+    return false;
+}
+
+/**
+ * Unmap an area and drop its frames (lock held)
+ */
+static void vm_area_unmap(vm_space_t* space, vm_area_t* area) {
+    // Visit only the resident pages; the area may be mostly untouched
+    uint64_t page = area->start;
+    uint64_t frame;
+    while (area->resident_pages && paging_next_mapped(space->paging, &page, area->end, &frame)) {
+        vm_frame_put(frame, false);
+        area->resident_pages--;
+        g_vm_state.stats.resident_pages--;
+        page += PAGE_SIZE;
+    }
+    
+    paging_unmap(space->paging, area->start, area->end - area->start, NULL);
+}
+
+/**
+ * Unlink, unmap and free an area (lock held)
+ */
+static void vm_area_destroy(vm_space_t* space, vm_area_t* area) {
+    vm_area_t** link = &space->areas;
+    while (*link != area) {
+        link = &(*link)->next;
+    }
+    *link = area->next;
+    
+    vm_area_unmap(space, area);
+    
+    g_vm_state.stats.areas--;
+    g_vm_state.stats.reserved_bytes -= area->end - area->start;
+    slab_free(g_vm_state.area_cache, area);
+}
+
+/**
+ * Page fault handler registered with the interrupt layer
+ */
+static int vm_page_fault_handler(uint64_t address, uint64_t error_code) {
+    return vm_handle_fault(address, error_code);
+}
+
+/**
+ * Initialize the kernel area window and install the fault handler
+ */
+int vm_init(void) {
+    if (g_vm_state.initialized) {
+        return 0;
+    }
+    
+    g_vm_state.space_cache = slab_cache_create("vm_space", sizeof(vm_space_t), 0, NULL);
+    g_vm_state.area_cache = slab_cache_create("vm_area", sizeof(vm_area_t), 0, NULL);
+    g_vm_state.ref_cache = slab_cache_create("vm_frame_ref", sizeof(vm_frame_ref_t), 0, NULL);
+    if (!g_vm_state.space_cache || !g_vm_state.area_cache || !g_vm_state.ref_cache) {
+        return -1;
+    }
+    
+    // The window's PDPT must exist before any process space copies the
+    // kernel's top-level entries
+    paging_space_t* kernel = paging_kernel_space();
+    if (paging_reserve(kernel, VM_KERNEL_BASE, VM_KERNEL_SIZE) != 0) {
+        return -1;
+    }
+    
+    g_vm_state.kernel_space.paging = kernel;
+    g_vm_state.kernel_space.areas = NULL;
+    g_vm_state.kernel_space.base = VM_KERNEL_BASE;
+    g_vm_state.kernel_space.limit = VM_KERNEL_BASE + VM_KERNEL_SIZE;
+    
+    interrupts_set_page_fault_handler(vm_page_fault_handler);
+    
+    g_vm_state.initialized = true;
+    return 0;
+}
+
+/**
+ * Get the kernel address space
+ */
+vm_space_t* vm_kernel_space(void) {
+    return &g_vm_state.kernel_space;
+}
+
+/**
+ * Create a process address space
+ */
+vm_space_t* vm_space_create(void) {
+    if (!g_vm_state.initialized) {
+        return NULL;
+    }
+    
+    vm_space_t* space = (vm_space_t*)slab_alloc(g_vm_state.space_cache);
+    if (!space) {
+        return NULL;
+    }
+    
+    space->paging = paging_space_create();
+    if (!space->paging) {
+        slab_free(g_vm_state.space_cache, space);
+        return NULL;
+    }
+    
+    space->areas = NULL;
+    space->base = PAGING_USER_BASE;
+    space->limit = PAGING_USER_END;
+    return space;
+}
+
+/**
+ * Release every area of a process address space and free it
+ */
+void vm_space_destroy(vm_space_t* space) {
+    if (!space || space == &g_vm_state.kernel_space) {
+        return;
+    }
+    
+    // Leave the space first if this CPU is running in it
+    if (vm_current_space() == space) {
+        vm_space_activate(&g_vm_state.kernel_space);
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_vm_lock);
+    while (space->areas) {
+        vm_area_destroy(space, space->areas);
+    }
+    spin_unlock_irqrestore(&g_vm_lock, irq_state);
+    
+    paging_space_destroy(space->paging);
+    slab_free(g_vm_state.space_cache, space);
+}
+
+/**
+ * Switch the current CPU to an address space
+ */
+void vm_space_activate(vm_space_t* space) {
+    if (!g_vm_state.initialized || !space) {
+        return;
+    }
+    
+    uint32_t cpu = hal_get_cpu_id();
+    if (cpu < HAL_MAX_CPUS) {
+        g_vm_state.current[cpu] = space;
+    }
+    paging_activate(space->paging);
+}
+
+/**
+ * Reserve a lazily backed area
+ */
+void* vm_reserve(vm_space_t* space, size_t size, uint32_t flags) {
+    return vm_reserve_node(space, size, flags, PAGE_NODE_LOCAL);
+}
+
+/**
+ * Reserve a lazily backed area whose pages come from a NUMA node
+ */
+void* vm_reserve_node(vm_space_t* space, size_t size, uint32_t flags, uint32_t node) {
+    if (!g_vm_state.initialized || !space || size == 0 || !(flags & (VM_READ | VM_WRITE | VM_EXEC)) ||
+        (node != PAGE_NODE_LOCAL && node >= page_node_count())) {
+        return NULL;
+    }
+    
+    uint64_t length = ((uint64_t)size + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    if (length < size) {
+        return NULL;
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_vm_lock);
+    vm_area_t* area = vm_insert_area(space, length, flags, node);
+    spin_unlock_irqrestore(&g_vm_lock, irq_state);
+    
+    return area ? (void*)(uintptr_t)area->start : NULL;
+}
+
+/**
+ * Release an area and the pages backing it
+ */
+int vm_release(vm_space_t* space, void* address) {
+    if (!g_vm_state.initialized || !space) {
+        return -1;
+    }
+    
+    int result = -1;
+    uint64_t irq_state = spin_lock_irqsave(&g_vm_lock);
+    
+    vm_area_t* area = vm_find_area(space, (uint64_t)(uintptr_t)address);
+    if (area && area->start == (uint64_t)(uintptr_t)address) {
+        vm_area_destroy(space, area);
+        result = 0;
+    }
+    
+    spin_unlock_irqrestore(&g_vm_lock, irq_state);
+    return result;
+}
+
+/**
+ * Share an area copy-on-write with another process address space
+ */
+void* vm_share(vm_space_t* source, void* address, vm_space_t* target) {
+    if (!g_vm_state.initialized || !source || !target || source == target ||
+        source == &g_vm_state.kernel_space || target == &g_vm_state.kernel_space) {
+        return NULL;
+    }
+    
+    void* result = NULL;
+    uint64_t irq_state = spin_lock_irqsave(&g_vm_lock);
+    
+    vm_area_t* area = vm_find_area(source, (uint64_t)(uintptr_t)address);
+    vm_area_t* copy = NULL;
+    if (area && area->start == (uint64_t)(uintptr_t)address) {
+        copy = vm_insert_area(target, area->end - area->start, area->flags, area->node);
+    }
+    
+    if (copy) {
+        // Both sides map resident pages read-only; the first write copies
+        uint64_t flags = vm_page_flags(area->flags & ~VM_WRITE);
+        uint64_t found = 0;
+        bool failed = false;
+        
+        // The source loses write access page by page; flush once at the end
+        tlb_batch_t batch;
+        tlb_batch_init(&batch, source->paging);
+        
+        uint64_t frame;
+        for (uint64_t page = area->start;
+             found < area->resident_pages && paging_next_mapped(source->paging, &page, area->end, &frame);
+             page += PAGE_SIZE) {
+            found++;
+            
+            uint64_t target_page = copy->start + (page - area->start);
+            if (!vm_frame_get(frame)) {
+                failed = true;
+                break;
+            }
+            if (paging_map(target->paging, target_page, frame, PAGE_SIZE, flags, NULL) != 0) {
+                vm_frame_put(frame, true);
+                failed = true;
+                break;
+            }
+            copy->resident_pages++;
+            g_vm_state.stats.resident_pages++;
+            
+            if (area->flags & VM_WRITE) {
+                paging_protect(source->paging, page, PAGE_SIZE, flags, &batch);
+            }
+        }
+        tlb_batch_flush(&batch);
+        
+        if (failed) {
+            vm_area_destroy(target, copy);
+        } else {
+            result = (void*)(uintptr_t)copy->start;
+        }
+    }
+    
+    spin_unlock_irqrestore(&g_vm_lock, irq_state);
+    return result;
+}
+
+/**
+ * Resolve a page fault against the areas of the kernel window or the
+ * current address space
+ */
+int vm_handle_fault(uint64_t address, uint64_t error_code) {
+    if (!g_vm_state.initialized) {
+        return -1;
+    }
+    
+    uint64_t started = cpu_read_tsc();
+    uint64_t page = address & ~(uint64_t)(PAGE_SIZE - 1);
+    bool write = (error_code & PAGE_FAULT_WRITE) != 0;
+    int result = -1;
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_vm_lock);
+    
+    vm_space_t* space = address - VM_KERNEL_BASE < VM_KERNEL_SIZE ? &g_vm_state.kernel_space : vm_current_space();
+    vm_area_t* area = vm_find_area(space, address);
+    
+    // The area must allow the access; reserved bit faults are never ours
+    bool allowed = area && !(error_code & PAGE_FAULT_RESERVED) && (!write || (area->flags & VM_WRITE)) &&
+                   (!(error_code & PAGE_FAULT_FETCH) || (area->flags & VM_EXEC));
+    
+    if (allowed) {
+        uint64_t frame;
+        uint64_t flags;
+        bool present = paging_translate(space->paging, page, &frame, &flags);
+        
+        if (present && (!write || (flags & PAGING_WRITABLE))) {
+            // Resolved by another CPU meanwhile, or a stale TLB entry
+            result = 0;
+        } else if (!present) {
+            // Demand paging: first touch gets a zeroed page
+            void* fresh = page_alloc_node(0, PAGE_ALLOC_ZERO, area->node);
+            if (fresh && paging_map(space->paging, page, (uint64_t)(uintptr_t)fresh, PAGE_SIZE,
+                                    vm_page_flags(area->flags), NULL) == 0) {
+                area->resident_pages++;
+                g_vm_state.stats.resident_pages++;
+                g_vm_state.stats.demand_zero_faults++;
+                result = 0;
+            } else if (fresh) {
+                page_free(fresh, 0);
+            }
+        } else if (!vm_frame_find(frame)) {
+            // Copy-on-write with no other owner left: take the page over
+            if (paging_protect(space->paging, page, PAGE_SIZE, vm_page_flags(area->flags), NULL) == 0) {
+                g_vm_state.stats.cow_reuses++;
+                result = 0;
+            }
+        } else {
+            // Copy-on-write: give this area its own copy
+            void* copy = page_alloc_node(0, 0, area->node);
+            if (copy) {
+                memops_copy(copy, (const void*)(uintptr_t)frame, PAGE_SIZE);
+                if (paging_map(space->paging, page, (uint64_t)(uintptr_t)copy, PAGE_SIZE,
+                               vm_page_flags(area->flags), NULL) == 0) {
+                    vm_frame_put(frame, true);
+                    g_vm_state.stats.cow_copies++;
+                    result = 0;
+                } else {
+                    page_free(copy, 0);
+                }
+            }
+        }
+    }
+    
+    uint64_t cycles = cpu_read_tsc() - started;
+    g_vm_state.stats.faults++;
+    g_vm_state.stats.fault_cycles_total += cycles;
+    if (cycles > g_vm_state.stats.fault_cycles_max) {
+        g_vm_state.stats.fault_cycles_max = cycles;
+    }
+    if (result != 0) {
+        g_vm_state.stats.unresolved_faults++;
+    }
+    
+    spin_unlock_irqrestore(&g_vm_lock, irq_state);
+    return result;
+}
+
+/**
+ * Get virtual memory statistics
+ */
+void vm_get_stats(vm_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    
+    uint64_t irq_state = spin_lock_irqsave(&g_vm_lock);
+    *stats = g_vm_state.stats;
+    spin_unlock_irqrestore(&g_vm_lock, irq_state);
+}
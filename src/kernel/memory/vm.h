@@ -0,0 +1,69 @@
+/**
+ * CompileOS Virtual Memory Areas - Header
+ *
+ * Lazily backed address ranges: reserving an area costs no memory, pages
+ * are allocated zero-filled on first touch, and areas shared between
+ * address spaces are copied page by page on first write
+ */
+
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Area access rights
+#define VM_READ 0x1
+#define VM_WRITE 0x2
+#define VM_EXEC 0x4
+
+// Kernel area window (one PML4 entry, visible in every address space)
+#define VM_KERNEL_BASE 0xFFFF800000000000ULL
+#define VM_KERNEL_SIZE 0x0000008000000000ULL
+
+// Opaque address space
+typedef struct vm_space vm_space_t;
+
+// Virtual memory statistics (latencies in TSC cycles)
+typedef struct {
+    uint64_t faults;
+    uint64_t demand_zero_faults;
+    uint64_t cow_copies;
+    uint64_t cow_reuses;
+    uint64_t unresolved_faults;
+    uint64_t fault_cycles_total;
+    uint64_t fault_cycles_max;
+    uint64_t areas;
+    uint64_t reserved_bytes;
+    uint64_t resident_pages;
+    uint64_t shared_frames;
+} vm_stats_t;
+
+// Initialization (after paging_init; installs the page fault handler)
+int vm_init(void);
+vm_space_t* vm_kernel_space(void);
+
+// Process address spaces (areas go in the process-private paging range)
+vm_space_t* vm_space_create(void);
+void vm_space_destroy(vm_space_t* space);
+void vm_space_activate(vm_space_t* space);
+
+// Areas (size rounded up to whole pages; pages come in zeroed on first use,
+// from the faulting CPU's NUMA node unless the area names one)
+void* vm_reserve(vm_space_t* space, size_t size, uint32_t flags);
+void* vm_reserve_node(vm_space_t* space, size_t size, uint32_t flags, uint32_t node);
+int vm_release(vm_space_t* space, void* address);
+
+// Copy-on-write sharing: maps the area's resident pages read-only into
+// target at a free address (returned); either side copies a page when it
+// first writes to it
+void* vm_share(vm_space_t* source, void* address, vm_space_t* target);
+
+// Page fault entry point (returns 0 if the access can be retried)
+int vm_handle_fault(uint64_t address, uint64_t error_code);
+
+// Statistics
+void vm_get_stats(vm_stats_t* stats);
+
+#endif // VM_H
@@ -7,6 +7,7 @@
 #include "process.h"
 #include "../kernel.h"
 #include "../memory/memory.h"
+#include "../memory/slab.h"
 #include <string.h>
 
 // Process management state
@@ -16,6 +17,7 @@ static struct {
     process_t* current_process;
     process_id_t next_pid;
     uint32_t process_count;
+    slab_cache_t* process_cache;
 } g_process_state = {0};
 
 // Process list management
@@ -58,6 +60,12 @@ int process_init(void) {
     g_process_state.next_pid = 1;
     g_process_state.process_count = 0;
     
+    // Process control blocks come from a dedicated object cache
+    g_process_state.process_cache = slab_cache_create("process_t", sizeof(process_t), 0, NULL);
+    if (!g_process_state.process_cache) {
+        return -1;
+    }
+    
     g_process_state.initialized = true;
     return 0;
 }
@@ -71,15 +79,16 @@ process_id_t process_create(const char* name, void* entry_point, size_t stack_si
     }
     
     // Allocate process control block
-    process_t* process = (process_t*)memory_alloc(sizeof(process_t));
+    process_t* process = (process_t*)slab_alloc(g_process_state.process_cache);
     if (!process) {
         return 0;
     }
     
-    // Allocate stack
-    void* stack = memory_alloc(stack_size);
+    // Allocate a zeroed, page-aligned stack (whole-page stacks come from the
+    // pre-zeroed page pool)
+    void* stack = memory_alloc_aligned_zeroed(stack_size, MEMORY_PAGE_ALIGNMENT);
     if (!stack) {
-        memory_free(process);
+        slab_free(g_process_state.process_cache, process);
         return 0;
     }
     
@@ -89,6 +98,7 @@ process_id_t process_create(const char* name, void* entry_point, size_t stack_si
     process->priority = PROCESS_PRIORITY_NORMAL;
     process->stack_pointer = (void*)((char*)stack + stack_size);
     process->stack_size = stack_size;
+    process->address_space = vm_space_create();
     process->cpu_time_used = 0;
     process->last_run_time = 0;
     process->timeslice_remaining = 100; // Default timeslice
@@ -122,14 +132,20 @@ int process_terminate(process_id_t pid, uint32_t exit_code) {
     
     // Free stack memory
     void* stack = (void*)((char*)process->stack_pointer - process->stack_size);
-    memory_free(stack);
+    memory_free_aligned(stack);
+    
+    // Free the private areas and page tables
+    vm_space_destroy(process->address_space);
+    if (g_process_state.current_process == process) {
+        g_process_state.current_process = NULL;
+    }
     
     // Remove from process list
     process_remove_from_list(process);
     g_process_state.process_count--;
     
     // Free process control block
-    memory_free(process);
+    slab_free(g_process_state.process_cache, process);
     
     return 0;
 }
@@ -257,6 +273,9 @@ void process_schedule(void) {
         
         g_process_state.current_process = next_process;
         next_process->state = PROCESS_STATE_RUNNING;
+        
+        // Processes without a space of their own run in the kernel's
+        vm_space_activate(next_process->address_space ? next_process->address_space : vm_kernel_space());
     }
 }
 
@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "../memory/vm.h"
 
 // Process states
 typedef enum {
@@ -42,6 +43,7 @@ typedef struct process {
     void* heap_start;
     void* heap_end;
     size_t stack_size;
+    vm_space_t* address_space;  // Private areas (NULL before demand paging is up)
     
     // Scheduling information
     uint64_t cpu_time_used;
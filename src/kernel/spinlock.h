@@ -0,0 +1,66 @@
+/**
+ * CompileOS Spinlocks - Header
+ * 
+ * Test-and-test-and-set spinlocks, with variants that also keep local
+ * interrupts off while the lock is held
+ */
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../hal/hal.h"
+
+// Spinlock
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile ("pause");
+#endif
+}
+
+static inline void spin_lock(spinlock_t* lock) {
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+        // Spin on a plain read so waiters do not bounce the cache line
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            spin_pause();
+        }
+    }
+}
+
+static inline bool spin_trylock(spinlock_t* lock) {
+    return !__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void spin_unlock(spinlock_t* lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+// Locks also taken from interrupt handlers (waiters spin with interrupts
+// in their previous state and disable them only to take the lock)
+static inline uint64_t spin_lock_irqsave(spinlock_t* lock) {
+    for (;;) {
+        uint64_t state = hal_interrupt_save();
+        if (spin_trylock(lock)) {
+            return state;
+        }
+        hal_interrupt_restore(state);
+        
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            spin_pause();
+        }
+    }
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t* lock, uint64_t state) {
+    spin_unlock(lock);
+    hal_interrupt_restore(state);
+}
+
+#endif // SPINLOCK_H
@@ -0,0 +1,3076 @@
+/**
+ * CompileOS Memory Allocator Benchmark
+ *
+ * Builds the kernel heap (memory.c on top of page.c) as a host program
+ * against a fake HAL memory map and replays alloc/free traces through it.
+ * Reports throughput, per-operation latency, heap footprint against live
+ * bytes and external fragmentation so allocator changes can be compared.
+ * The memops command times each copy/fill/compare variant across sizes,
+ * the convert command each widening/narrowing variant, the search command
+ * each search variant in elements per second, the integrate command each
+ * physics integration variant in entities per second, the physics command
+ * checks the SoA containers and times their AoS conversion, the broadphase
+ * command the spatial hash in pairs per second, the bvh command the AABB
+ * tree in queries per second, the gather and packed commands each
+ * gather/scatter and bit-packing variant in elements per second, the
+ * arena command checks the arena allocator and times it against the heap,
+ * and the multibit command checks generic access and the region index and
+ * times region lookups.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "hal/hal.h"
+#include "kernel/memory/memory.h"
+#include "kernel/memory/page.h"
+#include "kernel/memory/arena.h"
+#include "kernel/memory/memops.h"
+#include "kernel/memory/convert.h"
+#include "kernel/memory/search.h"
+#include "kernel/memory/physics.h"
+#include "kernel/memory/integrate.h"
+#include "kernel/memory/broadphase.h"
+#include "kernel/memory/bvh.h"
+#include "kernel/memory/gather.h"
+#include "kernel/memory/packed.h"
+#include "kernel/memory/multibit.h"
+#include "kernel/memory/vm.h"
+
+// Defaults
+#define BENCH_DEFAULT_OPS 1000000
+#define BENCH_DEFAULT_SLOTS 10000
+#define BENCH_DEFAULT_ARENA_MB 512
+#define BENCH_DEFAULT_SEED 1
+#define BENCH_FRAG_SAMPLES 1024
+
+// memops table: sizes from 16 B to 64 MB, each timed over this many bytes
+#define BENCH_MEMOPS_MIN_SIZE 16
+#define BENCH_MEMOPS_MAX_SIZE (64 * 1024 * 1024)
+#define BENCH_MEMOPS_BYTES (256ULL * 1024 * 1024)
+
+// convert table: a cache-resident and a memory-sized array, each timed
+// over this many source elements
+#define BENCH_CONVERT_SMALL_COUNT 4096
+#define BENCH_CONVERT_LARGE_COUNT (8 * 1024 * 1024)
+#define BENCH_CONVERT_ELEMENTS (64ULL * 1024 * 1024)
+
+// search table: a cache-resident and a memory-sized haystack, each mode
+// timed over this many elements; the checks cover every length up to
+// BENCH_SEARCH_CHECK_COUNT at each byte offset below
+// BENCH_SEARCH_CHECK_OFFSETS
+#define BENCH_SEARCH_SMALL_COUNT 4096
+#define BENCH_SEARCH_LARGE_COUNT (8 * 1024 * 1024)
+#define BENCH_SEARCH_ELEMENTS (256ULL * 1024 * 1024)
+#define BENCH_SEARCH_CHECK_COUNT 200
+#define BENCH_SEARCH_CHECK_OFFSETS 40
+
+// integrate table: a cache-resident and a memory-sized entity count, each
+// timed over this many entity steps
+#define BENCH_INTEGRATE_SMALL_COUNT 4096
+#define BENCH_INTEGRATE_LARGE_COUNT (1024 * 1024)
+#define BENCH_INTEGRATE_ENTITIES (64ULL * 1024 * 1024)
+
+// physics run: containers grown from empty to this many entities are
+// checked, then AoS conversion is timed at a cache-resident and a
+// memory-sized count over this many entities
+#define BENCH_PHYSICS_CHECK_COUNT 5003
+#define BENCH_PHYSICS_SMALL_COUNT 4096
+#define BENCH_PHYSICS_LARGE_COUNT (1024 * 1024)
+#define BENCH_PHYSICS_ENTITIES (64ULL * 1024 * 1024)
+
+// broadphase run: entities in a world of 2^15 units per side (scaled up to
+// the wider coordinates), cells of 2^10 units, about eight neighbours each
+#define BENCH_BROADPHASE_COUNT (64 * 1024)
+#define BENCH_BROADPHASE_CHECK_COUNT 2048
+#define BENCH_BROADPHASE_STEPS 16
+#define BENCH_BROADPHASE_WORLD_BITS 15
+#define BENCH_BROADPHASE_CELL_BITS 10
+
+// bvh run: the broadphase world, each entity a cube one cell across with a
+// margin of two steps at full speed, and this many queries of each kind
+#define BENCH_BVH_QUERIES 4096
+#define BENCH_BVH_NEAREST 8
+
+// gather table: batches of this many elements, strided through or indexed
+// into a cache-resident and a memory-sized table, each timed over this
+// many elements
+#define BENCH_GATHER_COUNT 4096
+#define BENCH_GATHER_SMALL_BYTES (256 * 1024)
+#define BENCH_GATHER_LARGE_BYTES (256ULL * 1024 * 1024)
+#define BENCH_GATHER_INDICES (1024 * 1024)
+#define BENCH_GATHER_ELEMENTS (16ULL * 1024 * 1024)
+
+// packed table: an array of this many elements, each direction timed over
+// this many elements
+#define BENCH_PACKED_COUNT (64 * 1024)
+#define BENCH_PACKED_ELEMENTS (64ULL * 1024 * 1024)
+
+// arena run: the check makes this many allocations of up to this size in
+// an arena created this small, so it grows through several chunks (up to
+// arena.c's 1 MB chunk cap), and tries alignments up to this; throughput
+// is timed in batches of this many allocations over this many in total
+#define BENCH_ARENA_INITIAL_SIZE 1024
+#define BENCH_ARENA_CHECK_ALLOCS 20000
+#define BENCH_ARENA_CHECK_MAX_SIZE 512
+#define BENCH_ARENA_MAX_CHUNK_ORDER 8
+#define BENCH_ARENA_MAX_ALIGNMENT 4096
+#define BENCH_ARENA_BATCH 1024
+#define BENCH_ARENA_ALLOCS (64ULL * 1024 * 1024)
+
+// multibit run: the check makes this many random alloc/free steps with up
+// to this many live regions of up to this size (enough to double the node
+// pool and hash table several times), comparing with the shadow list every
+// this many steps; lookups are timed this many times per live count
+#define BENCH_MULTIBIT_STEPS 200000
+#define BENCH_MULTIBIT_LIVE 4096
+#define BENCH_MULTIBIT_MAX_SIZE 4096
+#define BENCH_MULTIBIT_VERIFY_INTERVAL 2000
+#define BENCH_MULTIBIT_LOOKUPS (16ULL * 1024 * 1024)
+
+// Trace operation kinds
+typedef enum {
+    BENCH_OP_ALLOC = 'a',
+    BENCH_OP_FREE = 'f',
+    BENCH_OP_REALLOC = 'r'
+} bench_op_kind_t;
+
+// Trace operation (slot identifies the live object)
+typedef struct {
+    uint8_t kind;
+    uint32_t slot;
+    uint32_t size;
+} bench_op_t;
+
+// Trace
+typedef struct {
+    const char* name;
+    bench_op_t* ops;
+    size_t count;
+    size_t capacity;
+    uint32_t slot_count;
+} bench_trace_t;
+
+// Benchmark options
+typedef struct {
+    size_t ops;
+    uint32_t slots;
+    size_t arena_mb;
+    uint64_t seed;
+    const char* record_file;
+} bench_options_t;
+
+// Fake physical memory handed to the page allocator
+static char* g_bench_arena = NULL;
+static size_t g_bench_arena_size = 0;
+
+// Random number state (xorshift64*)
+static uint64_t g_bench_rng = 1;
+
+/**
+ * Fake HAL memory map: one RAM region backed by a host allocation
+ */
+hal_status_t hal_memory_map(memory_region_t* regions, size_t max_regions, size_t* actual_count) {
+    if (!regions || !actual_count || max_regions == 0) {
+        return HAL_ERROR_INVALID_PARAM;
+    }
+    
+    if (!g_bench_arena) {
+        void* arena = NULL;
+        if (posix_memalign(&arena, (size_t)PAGE_SIZE << PAGE_ORDER_2MB, g_bench_arena_size) != 0) {
+            return HAL_ERROR_HARDWARE_FAILURE;
+        }
+        g_bench_arena = arena;
+    }
+    
+    regions[0].base_address = (uint64_t)(uintptr_t)g_bench_arena;
+    regions[0].size = g_bench_arena_size;
+    regions[0].type = MEMORY_TYPE_RAM;
+    regions[0].is_available = true;
+    *actual_count = 1;
+    
+    return HAL_SUCCESS;
+}
+
+/**
+ * Fake HAL CPU interface: the benchmark runs on a single CPU with nothing
+ * to mask
+ */
+uint32_t hal_get_cpu_id(void) {
+    return 0;
+}
+
+uint64_t hal_interrupt_save(void) {
+    return 0;
+}
+
+void hal_interrupt_restore(uint64_t state) {
+    (void)state;
+}
+
+/**
+ * Fake HAL NUMA topology: the arena is a single node
+ */
+uint32_t hal_numa_node_count(void) {
+    return 1;
+}
+
+uint32_t hal_numa_cpu_node(uint32_t cpu_id) {
+    (void)cpu_id;
+    return 0;
+}
+
+uint32_t hal_numa_distance(uint32_t from_node, uint32_t to_node) {
+    return from_node == to_node ? 10 : 20;
+}
+
+hal_status_t hal_numa_memory_map(numa_memory_region_t* regions, size_t max_regions, size_t* actual_count) {
+    (void)regions;
+    (void)max_regions;
+    *actual_count = 0;
+    return HAL_SUCCESS;
+}
+
+/**
+ * Fake virtual memory: no demand paging, so lazy reservations fail and
+ * their callers fall back to the heap
+ */
+vm_space_t* vm_kernel_space(void) {
+    return NULL;
+}
+
+void* vm_reserve_node(vm_space_t* space, size_t size, uint32_t flags, uint32_t node) {
+    (void)space;
+    (void)size;
+    (void)flags;
+    (void)node;
+    return NULL;
+}
+
+int vm_release(vm_space_t* space, void* address) {
+    (void)space;
+    (void)address;
+    return -1;
+}
+
+static uint64_t bench_random(void) {
+    g_bench_rng ^= g_bench_rng >> 12;
+    g_bench_rng ^= g_bench_rng << 25;
+    g_bench_rng ^= g_bench_rng >> 27;
+    return g_bench_rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double bench_random_unit(void) {
+    return (double)(bench_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int bench_trace_push(bench_trace_t* trace, uint8_t kind, uint32_t slot, uint32_t size) {
+    if (trace->count == trace->capacity) {
+        size_t capacity = trace->capacity ? trace->capacity * 2 : 4096;
+        bench_op_t* ops = realloc(trace->ops, capacity * sizeof(bench_op_t));
+        if (!ops) {
+            return -1;
+        }
+        trace->ops = ops;
+        trace->capacity = capacity;
+    }
+    
+    trace->ops[trace->count].kind = kind;
+    trace->ops[trace->count].slot = slot;
+    trace->ops[trace->count].size = size;
+    trace->count++;
+    
+    if (slot >= trace->slot_count) {
+        trace->slot_count = slot + 1;
+    }
+    return 0;
+}
+
+/**
+ * Uniform sizes (16 B - 4 KB), random slots, some reallocation
+ */
+static uint32_t bench_size_uniform(void) {
+    return 16 + (uint32_t)(bench_random() % (4096 - 16 + 1));
+}
+
+/**
+ * Power-law sizes: mostly small objects with a heavy tail up to 1 MB
+ */
+static uint32_t bench_size_powerlaw(void) {
+    double size = 16.0 * pow(1.0 - bench_random_unit(), -1.0 / 1.1);
+    if (size > 1024.0 * 1024.0) {
+        size = 1024.0 * 1024.0;
+    }
+    return (uint32_t)size;
+}
+
+static int bench_generate_random(bench_trace_t* trace, const bench_options_t* options, uint32_t (*size_fn)(void)) {
+    uint8_t* live = calloc(options->slots, 1);
+    if (!live) {
+        return -1;
+    }
+    
+    for (size_t i = 0; i < options->ops; i++) {
+        uint32_t slot = (uint32_t)(bench_random() % options->slots);
+        int result;
+        
+        if (!live[slot]) {
+            result = bench_trace_push(trace, BENCH_OP_ALLOC, slot, size_fn());
+            live[slot] = 1;
+        } else if (bench_random() % 10 == 0) {
+            result = bench_trace_push(trace, BENCH_OP_REALLOC, slot, size_fn());
+        } else {
+            result = bench_trace_push(trace, BENCH_OP_FREE, slot, 0);
+            live[slot] = 0;
+        }
+        
+        if (result != 0) {
+            free(live);
+            return -1;
+        }
+    }
+    
+    free(live);
+    return 0;
+}
+
+/**
+ * Producer/consumer: objects are freed in allocation order (FIFO) while
+ * the queue depth drifts between empty and the slot count
+ */
+static int bench_generate_prodcons(bench_trace_t* trace, const bench_options_t* options) {
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    uint32_t depth = 0;
+    double produce_bias = 0.5;
+    
+    for (size_t i = 0; i < options->ops; i++) {
+        // Let the producer run ahead or fall behind in phases
+        if (i % 4096 == 0) {
+            produce_bias = 0.3 + 0.4 * bench_random_unit();
+        }
+        
+        bool produce = depth == 0 || (depth < options->slots && bench_random_unit() < produce_bias);
+        int result;
+        
+        if (produce) {
+            uint32_t size = (bench_random() % 4 == 0) ? bench_size_powerlaw() : 64 + (uint32_t)(bench_random() % 448);
+            result = bench_trace_push(trace, BENCH_OP_ALLOC, tail, size);
+            tail = (tail + 1) % options->slots;
+            depth++;
+        } else {
+            result = bench_trace_push(trace, BENCH_OP_FREE, head, 0);
+            head = (head + 1) % options->slots;
+            depth--;
+        }
+        
+        if (result != 0) {
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Load a recorded trace: one operation per line, "a <slot> <size>",
+ * "f <slot>" or "r <slot> <size>"; blank lines and '#' comments are skipped
+ */
+static int bench_load_trace(bench_trace_t* trace, const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        printf("Error: Cannot open trace file %s\n", filename);
+        return -1;
+    }
+    
+    char line[128];
+    size_t line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        
+        char kind = 0;
+        unsigned long slot = 0;
+        unsigned long size = 0;
+        int fields = sscanf(line, " %c %lu %lu", &kind, &slot, &size);
+        if (fields <= 0 || kind == '#') {
+            continue;
+        }
+        
+        bool valid = (kind == BENCH_OP_FREE && fields >= 2) ||
+                     ((kind == BENCH_OP_ALLOC || kind == BENCH_OP_REALLOC) && fields == 3);
+        if (!valid || slot > UINT32_MAX - 1 || size > UINT32_MAX) {
+            printf("Error: %s:%zu: malformed trace line\n", filename, line_number);
+            fclose(file);
+            return -1;
+        }
+        
+        if (bench_trace_push(trace, (uint8_t)kind, (uint32_t)slot, (uint32_t)size) != 0) {
+            fclose(file);
+            return -1;
+        }
+    }
+    
+    fclose(file);
+    return 0;
+}
+
+static int bench_save_trace(const bench_trace_t* trace, const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        printf("Error: Cannot create trace file %s\n", filename);
+        return -1;
+    }
+    
+    fprintf(file, "# CompileOS allocator trace: %s\n", trace->name);
+    for (size_t i = 0; i < trace->count; i++) {
+        const bench_op_t* op = &trace->ops[i];
+        if (op->kind == BENCH_OP_FREE) {
+            fprintf(file, "f %u\n", op->slot);
+        } else {
+            fprintf(file, "%c %u %u\n", op->kind, op->slot, op->size);
+        }
+    }
+    
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Heap footprint: pages the heap has taken from the page allocator
+ */
+static uint64_t bench_heap_footprint(uint64_t baseline_free_pages) {
+    page_stats_t stats;
+    page_get_stats(&stats);
+    return (baseline_free_pages - stats.free_pages) * PAGE_SIZE;
+}
+
+static int bench_compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Apply one trace operation
+ */
+static inline void bench_apply(const bench_op_t* op, void** objects, uint32_t* sizes, uint64_t* live_bytes, size_t* failures) {
+    void* ptr;
+    
+    switch (op->kind) {
+        case BENCH_OP_ALLOC:
+            if (objects[op->slot]) {
+                memory_free(objects[op->slot]);
+                *live_bytes -= sizes[op->slot];
+            }
+            ptr = memory_alloc(op->size);
+            if (!ptr) {
+                (*failures)++;
+                sizes[op->slot] = 0;
+            } else {
+                *(volatile char*)ptr = 1;
+                sizes[op->slot] = op->size;
+                *live_bytes += op->size;
+            }
+            objects[op->slot] = ptr;
+            break;
+        case BENCH_OP_REALLOC:
+            if (op->size == 0) {
+                memory_free(objects[op->slot]);
+                *live_bytes -= sizes[op->slot];
+                objects[op->slot] = NULL;
+                sizes[op->slot] = 0;
+                break;
+            }
+            ptr = memory_realloc(objects[op->slot], op->size);
+            if (!ptr) {
+                (*failures)++;
+                break;
+            }
+            *live_bytes += (uint64_t)op->size - sizes[op->slot];
+            objects[op->slot] = ptr;
+            sizes[op->slot] = op->size;
+            break;
+        default:
+            if (objects[op->slot]) {
+                memory_free(objects[op->slot]);
+                *live_bytes -= sizes[op->slot];
+                objects[op->slot] = NULL;
+                sizes[op->slot] = 0;
+            }
+            break;
+    }
+}
+
+/**
+ * Throughput pass: replay the whole trace with no per-operation timing
+ */
+static int bench_run_throughput(const bench_trace_t* trace) {
+    if (memory_init() != 0) {
+        printf("Error: memory_init failed\n");
+        return 1;
+    }
+    
+    void** objects = calloc(trace->slot_count, sizeof(void*));
+    uint32_t* sizes = calloc(trace->slot_count, sizeof(uint32_t));
+    if (!objects || !sizes) {
+        return 1;
+    }
+    
+    uint64_t live_bytes = 0;
+    size_t failures = 0;
+    
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < trace->count; i++) {
+        bench_apply(&trace->ops[i], objects, sizes, &live_bytes, &failures);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    
+    double seconds = (double)elapsed / 1e9;
+    printf("%-10s %10zu %9.2f", trace->name, trace->count, seconds > 0 ? (double)trace->count / seconds / 1e6 : 0.0);
+    fflush(stdout);
+    return 0;
+}
+
+/**
+ * Measurement pass: per-operation latency, footprint and fragmentation
+ */
+static int bench_run_measure(const bench_trace_t* trace) {
+    // Everything the heap takes from the page allocator counts as footprint
+    page_stats_t page_stats;
+    if (page_init() != 0) {
+        return 1;
+    }
+    page_get_stats(&page_stats);
+    uint64_t baseline_free_pages = page_stats.free_pages;
+    
+    if (memory_init() != 0) {
+        return 1;
+    }
+    
+    void** objects = calloc(trace->slot_count, sizeof(void*));
+    uint32_t* sizes = calloc(trace->slot_count, sizeof(uint32_t));
+    uint32_t* latency = malloc((trace->count ? trace->count : 1) * sizeof(uint32_t));
+    if (!objects || !sizes || !latency) {
+        return 1;
+    }
+    
+    memory_stats_t memory_stats;
+    
+    // Timer overhead, subtracted from every sample
+    uint64_t overhead = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t t0 = bench_now_ns();
+        uint64_t t1 = bench_now_ns();
+        if (t1 - t0 < overhead) {
+            overhead = t1 - t0;
+        }
+    }
+    
+    uint64_t live_bytes = 0;
+    uint64_t peak_live = 0;
+    uint64_t peak_footprint = 0;
+    size_t failures = 0;
+    double fragmentation_sum = 0.0;
+    double fragmentation_max = 0.0;
+    size_t fragmentation_samples = 0;
+    size_t sample_interval = trace->count / BENCH_FRAG_SAMPLES;
+    if (sample_interval == 0) {
+        sample_interval = 1;
+    }
+    
+    for (size_t i = 0; i < trace->count; i++) {
+        const bench_op_t* op = &trace->ops[i];
+        uint64_t t0 = bench_now_ns();
+        bench_apply(op, objects, sizes, &live_bytes, &failures);
+        uint64_t t1 = bench_now_ns();
+        
+        uint64_t ns = t1 - t0 > overhead ? t1 - t0 - overhead : 0;
+        latency[i] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+        
+        if (live_bytes > peak_live) {
+            peak_live = live_bytes;
+        }
+        if (op->kind != BENCH_OP_FREE) {
+            uint64_t footprint = bench_heap_footprint(baseline_free_pages);
+            if (footprint > peak_footprint) {
+                peak_footprint = footprint;
+            }
+        }
+        
+        // External fragmentation: 1 - largest free block / free heap bytes
+        if ((i + 1) % sample_interval == 0) {
+            memory_get_stats(&memory_stats);
+            if (memory_stats.free_bytes) {
+                double fragmentation = (double)memory_stats.fragmentation_index / 1000.0;
+                fragmentation_sum += fragmentation;
+                if (fragmentation > fragmentation_max) {
+                    fragmentation_max = fragmentation;
+                }
+                fragmentation_samples++;
+            }
+        }
+    }
+    
+    qsort(latency, trace->count, sizeof(uint32_t), bench_compare_u32);
+    uint32_t p50 = trace->count ? latency[trace->count / 2] : 0;
+    uint32_t p99 = trace->count ? latency[(trace->count * 99) / 100] : 0;
+    
+    memory_get_stats(&memory_stats);
+    double visited = memory_stats.alloc_calls ? (double)memory_stats.blocks_visited / (double)memory_stats.alloc_calls : 0.0;
+    
+    double ratio = peak_live ? (double)peak_footprint / (double)peak_live : 0.0;
+    double fragmentation_mean = fragmentation_samples ? fragmentation_sum / (double)fragmentation_samples : 0.0;
+    
+    printf(" %7u %7u %7.2f %10.1f %10.1f %6.2fx %6.1f%% %6.1f%% %6zu\n",
+           p50, p99, visited,
+           (double)peak_live / 1024.0, (double)peak_footprint / 1024.0, ratio,
+           fragmentation_mean * 100.0, fragmentation_max * 100.0, failures);
+    return 0;
+}
+
+/**
+ * Run a pass in a child process so each one starts with a fresh heap
+ */
+static int bench_run_isolated(const bench_trace_t* trace, int (*pass)(const bench_trace_t*)) {
+    fflush(stdout);
+    
+    pid_t pid = fork();
+    if (pid < 0) {
+        printf("Error: fork failed\n");
+        return -1;
+    }
+    if (pid == 0) {
+        int result = pass(trace);
+        fflush(stdout);
+        _exit(result);
+    }
+    
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("\nError: %s pass failed\n", trace->name);
+        return -1;
+    }
+    return 0;
+}
+
+static int bench_run_trace(bench_trace_t* trace, const bench_options_t* options) {
+    static bool header_printed = false;
+    
+    if (!header_printed) {
+        printf("%-10s %10s %9s %7s %7s %7s %10s %10s %7s %7s %7s %6s\n",
+               "trace", "ops", "Mops/s", "p50 ns", "p99 ns", "visited", "live KB", "heap KB",
+               "heap/lv", "frag", "frag^", "fails");
+        header_printed = true;
+    }
+    
+    if (options->record_file && bench_save_trace(trace, options->record_file) != 0) {
+        return -1;
+    }
+    
+    if (bench_run_isolated(trace, bench_run_throughput) != 0 ||
+        bench_run_isolated(trace, bench_run_measure) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Time one routine at one size, returning GB/s
+ */
+static double bench_memops_rate(int op, char* dest, char* src, size_t size) {
+    size_t iterations = BENCH_MEMOPS_BYTES / size;
+    if (iterations < 4) {
+        iterations = 4;
+    }
+    
+    // Warm up (faults the buffers in and trains the branch predictors)
+    memops_copy(dest, src, size);
+    
+    volatile int sink = 0;
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        switch (op) {
+            case 0: memops_copy(dest, src, size); break;
+            case 1: memops_set(dest, (int)i, size); break;
+            default: sink += memops_compare(dest, src, size); break;
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    (void)sink;
+    
+    return elapsed ? (double)size * (double)iterations / (double)elapsed : 0.0;
+}
+
+/**
+ * Throughput table of every supported variant across sizes, marking the
+ * fastest variant per size so the crossover points stand out
+ */
+static int bench_run_memops(void) {
+    static const char* const op_names[] = { "copy", "set", "compare" };
+    
+    memops_init();
+    memops_variant_t selected = memops_get_variant();
+    
+    char* src = NULL;
+    char* dest = NULL;
+    if (posix_memalign((void**)&src, 64, BENCH_MEMOPS_MAX_SIZE) != 0 ||
+        posix_memalign((void**)&dest, 64, BENCH_MEMOPS_MAX_SIZE) != 0) {
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    memset(src, 0x5A, BENCH_MEMOPS_MAX_SIZE);
+    memset(dest, 0x5A, BENCH_MEMOPS_MAX_SIZE);
+    
+    printf("memops: boot selects %s, non-temporal stores from %zu KB (GB/s)\n",
+           memops_variant_name(selected), memops_get_nt_threshold() / 1024);
+    
+    for (int op = 0; op < 3; op++) {
+        printf("\n%-10s", op_names[op]);
+        for (int v = 0; v < MEMOPS_VARIANT_COUNT; v++) {
+            if (memops_variant_supported((memops_variant_t)v)) {
+                printf(" %9s", memops_variant_name((memops_variant_t)v));
+            }
+        }
+        printf("  best\n");
+        
+        for (size_t size = BENCH_MEMOPS_MIN_SIZE; size <= BENCH_MEMOPS_MAX_SIZE; size *= 4) {
+            if (size < 1024) {
+                printf("%7zu B ", size);
+            } else if (size < 1024 * 1024) {
+                printf("%7zu KB", size / 1024);
+            } else {
+                printf("%7zu MB", size / (1024 * 1024));
+            }
+            
+            double best_rate = 0.0;
+            memops_variant_t best = MEMOPS_VARIANT_GENERIC;
+            for (int v = 0; v < MEMOPS_VARIANT_COUNT; v++) {
+                if (memops_set_variant((memops_variant_t)v) != 0) {
+                    continue;
+                }
+                
+                // Compare needs equal buffers to scan all the way through
+                memset(dest, 0x5A, size);
+                double rate = bench_memops_rate(op, dest, src, size);
+                if (op == 1) {
+                    memset(dest, 0x5A, size);
+                }
+                printf(" %9.2f", rate);
+                
+                if (rate > best_rate) {
+                    best_rate = rate;
+                    best = (memops_variant_t)v;
+                }
+            }
+            printf("  %s\n", memops_variant_name(best));
+        }
+    }
+    
+    memops_set_variant(selected);
+    free(src);
+    free(dest);
+    return 0;
+}
+
+// Conversion pairs timed by the convert command
+typedef struct {
+    const char* name;
+    unsigned int src_bits;
+    unsigned int dest_bits;
+    convert_mode_t mode;
+} bench_convert_pair_t;
+
+static const bench_convert_pair_t g_bench_convert_pairs[] = {
+    { "16->32", 16, 32, CONVERT_TRUNCATE },
+    { "16->64", 16, 64, CONVERT_TRUNCATE },
+    { "32->64", 32, 64, CONVERT_TRUNCATE },
+    { "32->16", 32, 16, CONVERT_TRUNCATE },
+    { "32->16 sat", 32, 16, CONVERT_SATURATE },
+    { "64->16", 64, 16, CONVERT_TRUNCATE },
+    { "64->16 sat", 64, 16, CONVERT_SATURATE },
+    { "64->32", 64, 32, CONVERT_TRUNCATE },
+    { "64->32 sat", 64, 32, CONVERT_SATURATE }
+};
+
+static void bench_convert_apply(const bench_convert_pair_t* pair, void* dest, const void* src, size_t count) {
+    switch (pair->src_bits * 100 + pair->dest_bits) {
+        case 1632: convert_16_to_32(dest, src, count); break;
+        case 1664: convert_16_to_64(dest, src, count); break;
+        case 3264: convert_32_to_64(dest, src, count); break;
+        case 3216: convert_32_to_16(dest, src, count, pair->mode); break;
+        case 6416: convert_64_to_16(dest, src, count, pair->mode); break;
+        default: convert_64_to_32(dest, src, count, pair->mode); break;
+    }
+}
+
+/**
+ * Time one conversion at one array size, returning GB/s of bytes read plus
+ * bytes written
+ */
+static double bench_convert_rate(const bench_convert_pair_t* pair, void* dest, const void* src, size_t count) {
+    size_t iterations = BENCH_CONVERT_ELEMENTS / count;
+    if (iterations < 4) {
+        iterations = 4;
+    }
+    
+    bench_convert_apply(pair, dest, src, count);
+    
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        bench_convert_apply(pair, dest, src, count);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    
+    double bytes = (double)count * (pair->src_bits + pair->dest_bits) / 8.0 * (double)iterations;
+    return elapsed ? bytes / (double)elapsed : 0.0;
+}
+
+/**
+ * Throughput table of every supported conversion variant for a
+ * cache-resident and a memory-sized array; each variant's output is
+ * checked against the generic routine on mixed in-range and out-of-range
+ * values first
+ */
+static int bench_run_convert(void) {
+    convert_init();
+    convert_variant_t selected = convert_get_variant();
+    
+    size_t bytes = BENCH_CONVERT_LARGE_COUNT * sizeof(uint64_t);
+    uint64_t* src = NULL;
+    uint64_t* dest = NULL;
+    uint64_t* expected = NULL;
+    if (posix_memalign((void**)&src, 64, bytes) != 0 || posix_memalign((void**)&dest, 64, bytes) != 0 ||
+        posix_memalign((void**)&expected, 64, bytes) != 0) {
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    
+    // Mostly small values with a sprinkling of ones that overflow 16 and 32 bits
+    for (size_t i = 0; i < bytes / sizeof(uint64_t); i++) {
+        uint64_t value = bench_random();
+        src[i] = (i % 7 == 0) ? value : (i % 5 == 0) ? (value & 0x3FFFF) : (value & 0x7FFF);
+    }
+    
+    printf("convert: boot selects %s (GB/s read + written)\n\n", convert_variant_name(selected));
+    printf("%-12s %7s", "pair", "count");
+    for (int v = 0; v < CONVERT_VARIANT_COUNT; v++) {
+        if (convert_variant_supported((convert_variant_t)v)) {
+            printf(" %9s", convert_variant_name((convert_variant_t)v));
+        }
+    }
+    printf("  best\n");
+    
+    int result = 0;
+    for (size_t p = 0; p < sizeof(g_bench_convert_pairs) / sizeof(g_bench_convert_pairs[0]); p++) {
+        const bench_convert_pair_t* pair = &g_bench_convert_pairs[p];
+        size_t check_bytes = (size_t)BENCH_CONVERT_SMALL_COUNT * pair->dest_bits / 8 + 8;
+        
+        // Odd counts exercise the scalar tails
+        convert_set_variant(CONVERT_VARIANT_GENERIC);
+        bench_convert_apply(pair, expected, src, BENCH_CONVERT_SMALL_COUNT + 1);
+        for (int v = 1; v < CONVERT_VARIANT_COUNT; v++) {
+            if (convert_set_variant((convert_variant_t)v) != 0) {
+                continue;
+            }
+            memset(dest, 0, check_bytes);
+            bench_convert_apply(pair, dest, src, BENCH_CONVERT_SMALL_COUNT + 1);
+            if (memcmp(dest, expected, (BENCH_CONVERT_SMALL_COUNT + 1) * pair->dest_bits / 8) != 0) {
+                printf("Error: %s %s output differs from generic\n",
+                       pair->name, convert_variant_name((convert_variant_t)v));
+                result = 1;
+            }
+        }
+        
+        static const size_t counts[] = { BENCH_CONVERT_SMALL_COUNT, BENCH_CONVERT_LARGE_COUNT };
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            printf("%-12s %6zuK", pair->name, counts[c] / 1024);
+            
+            double best_rate = 0.0;
+            convert_variant_t best = CONVERT_VARIANT_GENERIC;
+            for (int v = 0; v < CONVERT_VARIANT_COUNT; v++) {
+                if (convert_set_variant((convert_variant_t)v) != 0) {
+                    continue;
+                }
+                
+                double rate = bench_convert_rate(pair, dest, src, counts[c]);
+                printf(" %9.2f", rate);
+                if (rate > best_rate) {
+                    best_rate = rate;
+                    best = (convert_variant_t)v;
+                }
+            }
+            printf("  %s\n", convert_variant_name(best));
+        }
+    }
+    
+    convert_set_variant(selected);
+    free(src);
+    free(dest);
+    free(expected);
+    return result;
+}
+
+// Search modes timed by the search command
+typedef enum {
+    BENCH_SEARCH_FIRST,
+    BENCH_SEARCH_COUNT,
+    BENCH_SEARCH_ALL,
+    BENCH_SEARCH_BITMAP,
+    BENCH_SEARCH_MODES
+} bench_search_mode_t;
+
+static const char* const g_bench_search_modes[BENCH_SEARCH_MODES] = { "first", "count", "all", "bitmap" };
+
+/**
+ * Element i of a haystack of any alignment, zero-extended
+ */
+static uint64_t bench_search_element(const char* haystack, size_t index, size_t width) {
+    uint64_t value = 0;
+    memcpy(&value, haystack + index * width, width);
+    return value;
+}
+
+/**
+ * Check one search of every mode against a brute-force scan. The offset
+ * list is also checked cut short, and the bitmap must leave the word
+ * after its last one alone.
+ */
+static bool bench_search_check_one(const char* haystack, size_t count, size_t width, uint64_t needle,
+                                   size_t* offsets, size_t* expected, uint64_t* bitmap) {
+    size_t matches = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (bench_search_element(haystack, i, width) == needle) {
+            expected[matches++] = i;
+        }
+    }
+    
+    const void* first = search_first(haystack, count, width, needle);
+    if (first != (matches ? haystack + expected[0] * width : NULL) ||
+        search_count(haystack, count, width, needle) != matches) {
+        return false;
+    }
+    
+    size_t limits[] = { count + 1, matches / 2 + 1 };
+    for (size_t l = 0; l < 2; l++) {
+        size_t stored = search_all(haystack, count, width, needle, offsets, limits[l]);
+        if (stored != (matches < limits[l] ? matches : limits[l]) ||
+            memcmp(offsets, expected, stored * sizeof(size_t)) != 0) {
+            return false;
+        }
+    }
+    
+    size_t words = (count + 63) / 64;
+    memset(bitmap, 0xA5, (words + 1) * sizeof(uint64_t));
+    if (search_bitmap(haystack, count, width, needle, bitmap) != matches ||
+        bitmap[words] != 0xA5A5A5A5A5A5A5A5ULL) {
+        return false;
+    }
+    for (size_t i = 0, m = 0; i < count; i++) {
+        bool set = (bitmap[i / 64] >> (i % 64)) & 1;
+        if (set != (m < matches && expected[m] == i)) {
+            return false;
+        }
+        m += set;
+    }
+    
+    return true;
+}
+
+/**
+ * Check a variant at one width against a brute-force scan for every
+ * length up to a few blocks at every byte offset within the head
+ * alignment, so heads, whole blocks and short tails all get covered. Half
+ * the elements match; the others differ from the needle in one bit. A
+ * needle wider than the elements must never match.
+ */
+static bool bench_search_check(size_t width, char* haystack, size_t* offsets, size_t* expected, uint64_t* bitmap) {
+    uint64_t mask = width == 8 ? ~0ULL : (1ULL << (width * 8)) - 1;
+    uint64_t needle = bench_random() & mask;
+    size_t bytes = (BENCH_SEARCH_CHECK_COUNT + BENCH_SEARCH_CHECK_OFFSETS) * width;
+    
+    for (size_t i = 0; i < bytes / width; i++) {
+        uint64_t value = (bench_random() & 1) ? needle : needle ^ (1ULL << (bench_random() % (width * 8)));
+        memcpy(haystack + i * width, &value, width);
+    }
+    
+    uint64_t needles[] = { needle, width == 8 ? needle : needle | (mask + 1) };
+    for (size_t offset = 0; offset < BENCH_SEARCH_CHECK_OFFSETS; offset++) {
+        for (size_t count = 0; count <= BENCH_SEARCH_CHECK_COUNT; count++) {
+            for (size_t n = 0; n < 2; n++) {
+                if (!bench_search_check_one(haystack + offset, count, width, needles[n], offsets, expected, bitmap)) {
+                    return false;
+                }
+            }
+        }
+    }
+    
+    return true;
+}
+
+static size_t bench_search_apply(bench_search_mode_t mode, const void* haystack, size_t count, size_t width,
+                                 uint64_t needle, size_t* offsets, uint64_t* bitmap) {
+    switch (mode) {
+        case BENCH_SEARCH_FIRST: return search_first(haystack, count, width, needle) != NULL;
+        case BENCH_SEARCH_COUNT: return search_count(haystack, count, width, needle);
+        case BENCH_SEARCH_ALL: return search_all(haystack, count, width, needle, offsets, count / 64 + 1);
+        default: return search_bitmap(haystack, count, width, needle, bitmap);
+    }
+}
+
+/**
+ * Time one mode at one haystack size, returning millions of elements
+ * searched per second
+ */
+static double bench_search_rate(bench_search_mode_t mode, const void* haystack, size_t count, size_t width,
+                                uint64_t needle, size_t* offsets, uint64_t* bitmap) {
+    size_t iterations = BENCH_SEARCH_ELEMENTS / count;
+    volatile size_t sink = 0;
+    
+    sink += bench_search_apply(mode, haystack, count, width, needle, offsets, bitmap);
+    
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        sink += bench_search_apply(mode, haystack, count, width, needle, offsets, bitmap);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    (void)sink;
+    
+    return elapsed ? (double)count * (double)iterations * 1000.0 / (double)elapsed : 0.0;
+}
+
+/**
+ * Elements/s table of every supported search variant for each mode and
+ * width over a cache-resident and a memory-sized haystack; each variant is
+ * checked against a brute-force scan first
+ */
+static int bench_run_search(void) {
+    search_init();
+    search_variant_t selected = search_get_variant();
+    
+    char* haystack = NULL;
+    size_t* offsets = malloc((BENCH_SEARCH_LARGE_COUNT / 64 + 1) * sizeof(size_t));
+    size_t* expected = malloc((BENCH_SEARCH_CHECK_COUNT + 1) * sizeof(size_t));
+    uint64_t* bitmap = malloc((BENCH_SEARCH_LARGE_COUNT / 64 + 1) * sizeof(uint64_t));
+    if (!offsets || !expected || !bitmap ||
+        posix_memalign((void**)&haystack, 64, BENCH_SEARCH_LARGE_COUNT * sizeof(uint64_t)) != 0) {
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    
+    int result = 0;
+    for (size_t width = 2; width <= 8; width *= 2) {
+        for (int v = 0; v < SEARCH_VARIANT_COUNT; v++) {
+            if (search_set_variant((search_variant_t)v) == 0 &&
+                !bench_search_check(width, haystack, offsets, expected, bitmap)) {
+                printf("Error: %zu-bit %s search differs from a plain scan\n", width * 8,
+                       search_variant_name((search_variant_t)v));
+                result = 1;
+            }
+        }
+    }
+    
+    printf("search: boot selects %s (M elements/s)\n\n", search_variant_name(selected));
+    printf("%-7s %5s %7s", "mode", "width", "count");
+    for (int v = 0; v < SEARCH_VARIANT_COUNT; v++) {
+        if (search_variant_supported((search_variant_t)v)) {
+            printf(" %9s", search_variant_name((search_variant_t)v));
+        }
+    }
+    printf("  best\n");
+    
+    for (size_t width = 2; width <= 8; width *= 2) {
+        // About one match per 1024 elements; "first" looks for a value that
+        // never occurs so it scans the whole haystack
+        uint64_t mask = width == 8 ? ~0ULL : (1ULL << (width * 8)) - 1;
+        uint64_t needle = 0x5A5A5A5A5A5A5A5AULL & mask;
+        uint64_t absent = needle ^ 1;
+        for (size_t i = 0; i < BENCH_SEARCH_LARGE_COUNT; i++) {
+            uint64_t value = bench_random() & mask;
+            if (bench_random() % 1024 == 0) {
+                value = needle;
+            } else if (value == needle || value == absent) {
+                value ^= 2;
+            }
+            memcpy(haystack + i * width, &value, width);
+        }
+        
+        for (int mode = 0; mode < BENCH_SEARCH_MODES; mode++) {
+            static const size_t counts[] = { BENCH_SEARCH_SMALL_COUNT, BENCH_SEARCH_LARGE_COUNT };
+            for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+                printf("%-7s %5zu %6zuK", g_bench_search_modes[mode], width * 8, counts[c] / 1024);
+                
+                double best_rate = 0.0;
+                search_variant_t best = SEARCH_VARIANT_GENERIC;
+                for (int v = 0; v < SEARCH_VARIANT_COUNT; v++) {
+                    if (search_set_variant((search_variant_t)v) != 0) {
+                        continue;
+                    }
+                    
+                    double rate = bench_search_rate((bench_search_mode_t)mode, haystack, counts[c], width,
+                                                    mode == BENCH_SEARCH_FIRST ? absent : needle, offsets, bitmap);
+                    printf(" %9.1f", rate);
+                    if (rate > best_rate) {
+                        best_rate = rate;
+                        best = (search_variant_t)v;
+                    }
+                }
+                printf("  %s\n", search_variant_name(best));
+            }
+        }
+    }
+    
+    search_set_variant(selected);
+    free(haystack);
+    free(offsets);
+    free(expected);
+    free(bitmap);
+    return result;
+}
+
+/**
+ * Point a SoA container of the given width at nine arrays of capacity
+ * elements laid out back to back in fields, and step it
+ */
+static void bench_integrate_soa(unsigned int bits, void* fields, size_t capacity, size_t count, integrate_mode_t mode) {
+    void* f[PHYSICS_FIELD_COUNT];
+    for (unsigned int i = 0; i < PHYSICS_FIELD_COUNT; i++) {
+        f[i] = (char*)fields + (size_t)i * capacity * bits / 8;
+    }
+    
+    if (bits == 16) {
+        physics_soa_16_t soa = { f[0], f[1], f[2], f[3], f[4], f[5], f[6], f[7], f[8], count, capacity };
+        integrate_soa_16(&soa, 0, count, mode);
+    } else if (bits == 32) {
+        physics_soa_32_t soa = { f[0], f[1], f[2], f[3], f[4], f[5], f[6], f[7], f[8], count, capacity };
+        integrate_soa_32(&soa, 0, count, mode);
+    } else {
+        physics_soa_64_t soa = { f[0], f[1], f[2], f[3], f[4], f[5], f[6], f[7], f[8], count, capacity };
+        integrate_soa_64(&soa, 0, count, mode);
+    }
+}
+
+static void bench_integrate_apply(unsigned int bits, bool soa, void* data, size_t capacity, size_t count, integrate_mode_t mode) {
+    if (soa) {
+        bench_integrate_soa(bits, data, capacity, count, mode);
+    } else if (bits == 16) {
+        integrate_aos_16(data, count, mode);
+    } else if (bits == 32) {
+        integrate_aos_32(data, count, mode);
+    } else {
+        integrate_aos_64(data, count, mode);
+    }
+}
+
+/**
+ * Time one step kind at one entity count, returning millions of entities
+ * stepped per second
+ */
+static double bench_integrate_rate(unsigned int bits, bool soa, void* data, size_t count, integrate_mode_t mode) {
+    size_t iterations = BENCH_INTEGRATE_ENTITIES / count;
+    if (iterations < 4) {
+        iterations = 4;
+    }
+    
+    bench_integrate_apply(bits, soa, data, count, count, mode);
+    
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        bench_integrate_apply(bits, soa, data, count, count, mode);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    
+    return elapsed ? (double)count * (double)iterations * 1000.0 / (double)elapsed : 0.0;
+}
+
+/**
+ * Check that integrate_partition hands out contiguous, granule-aligned
+ * ranges covering the whole count
+ */
+static int bench_integrate_check_partition(void) {
+    static const size_t counts[] = { 0, 1, 63, 64, 65, 1000, 4096, 100003 };
+    
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        for (uint32_t parts = 1; parts <= 9; parts++) {
+            size_t next = 0;
+            for (uint32_t part = 0; part < parts; part++) {
+                size_t first = 0;
+                size_t range = 0;
+                integrate_partition(counts[c], part, parts, &first, &range);
+                if (first != next || (range > 0 && first % INTEGRATE_PARTITION_GRANULE != 0)) {
+                    printf("Error: partition of %zu into %u leaves a gap at part %u\n", counts[c], parts, part);
+                    return 1;
+                }
+                next = first + range;
+            }
+            if (next != counts[c]) {
+                printf("Error: partition of %zu into %u covers %zu\n", counts[c], parts, next);
+                return 1;
+            }
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Entities-per-second table of every supported integration variant for
+ * both layouts, both overflow modes and a cache-resident and a
+ * memory-sized entity count; each variant's output is checked against the
+ * generic routine on values near the signed limits first
+ */
+static int bench_run_integrate(void) {
+    integrate_init();
+    integrate_variant_t selected = integrate_get_variant();
+    
+    size_t bytes = (size_t)BENCH_INTEGRATE_LARGE_COUNT * PHYSICS_FIELD_COUNT * sizeof(uint64_t);
+    uint64_t* source = NULL;
+    uint64_t* data = NULL;
+    uint64_t* expected = NULL;
+    if (posix_memalign((void**)&source, 64, bytes) != 0 || posix_memalign((void**)&data, 64, bytes) != 0 ||
+        posix_memalign((void**)&expected, 64, bytes) != 0) {
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    
+    // Small steps around zero with some values close to the signed limits
+    // of each width, so saturation triggers
+    for (size_t i = 0; i < bytes / sizeof(uint64_t); i++) {
+        uint64_t value = bench_random();
+        source[i] = (i % 5 == 0) ? value : (i % 3 == 0) ? (value & 0x7FFF7FFF7FFF7FFFULL) : (uint64_t)((int64_t)(value & 0xFF) - 128);
+    }
+    
+    int result = bench_integrate_check_partition();
+    
+    printf("integrate: boot selects %s (million entities per second)\n\n", integrate_variant_name(selected));
+    printf("%-16s %7s", "step", "count");
+    for (int v = 0; v < INTEGRATE_VARIANT_COUNT; v++) {
+        if (integrate_variant_supported((integrate_variant_t)v)) {
+            printf(" %9s", integrate_variant_name((integrate_variant_t)v));
+        }
+    }
+    printf("  best\n");
+    
+    static const unsigned int widths[] = { 16, 32, 64 };
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        for (int layout = 0; layout < 2; layout++) {
+            for (int mode = INTEGRATE_WRAP; mode <= INTEGRATE_SATURATE; mode++) {
+                unsigned int bits = widths[w];
+                bool soa = layout == 1;
+                char name[32];
+                snprintf(name, sizeof(name), "%u %s %s", bits, soa ? "soa" : "aos",
+                         mode == INTEGRATE_SATURATE ? "sat" : "wrap");
+                
+                // Odd counts exercise the scalar tails
+                size_t check = BENCH_INTEGRATE_SMALL_COUNT + 5;
+                size_t check_bytes = check * PHYSICS_FIELD_COUNT * bits / 8;
+                memcpy(expected, source, check_bytes);
+                integrate_set_variant(INTEGRATE_VARIANT_GENERIC);
+                bench_integrate_apply(bits, soa, expected, check, check, (integrate_mode_t)mode);
+                for (int v = 1; v < INTEGRATE_VARIANT_COUNT; v++) {
+                    if (integrate_set_variant((integrate_variant_t)v) != 0) {
+                        continue;
+                    }
+                    memcpy(data, source, check_bytes);
+                    bench_integrate_apply(bits, soa, data, check, check, (integrate_mode_t)mode);
+                    if (memcmp(data, expected, check_bytes) != 0) {
+                        printf("Error: %s %s output differs from generic\n",
+                               name, integrate_variant_name((integrate_variant_t)v));
+                        result = 1;
+                    }
+                }
+                
+                static const size_t counts[] = { BENCH_INTEGRATE_SMALL_COUNT, BENCH_INTEGRATE_LARGE_COUNT };
+                for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+                    printf("%-16s %6zuK", name, counts[c] / 1024);
+                    
+                    double best_rate = 0.0;
+                    integrate_variant_t best = INTEGRATE_VARIANT_GENERIC;
+                    for (int v = 0; v < INTEGRATE_VARIANT_COUNT; v++) {
+                        if (integrate_set_variant((integrate_variant_t)v) != 0) {
+                            continue;
+                        }
+                        
+                        memcpy(data, source, counts[c] * PHYSICS_FIELD_COUNT * bits / 8);
+                        double rate = bench_integrate_rate(bits, soa, data, counts[c], (integrate_mode_t)mode);
+                        printf(" %9.1f", rate);
+                        if (rate > best_rate) {
+                            best_rate = rate;
+                            best = (integrate_variant_t)v;
+                        }
+                    }
+                    printf("  %s\n", integrate_variant_name(best));
+                }
+            }
+        }
+    }
+    
+    integrate_set_variant(selected);
+    free(source);
+    free(data);
+    free(expected);
+    return result;
+}
+
+/**
+ * One SoA container of any width
+ */
+typedef union {
+    physics_soa_16_t s16;
+    physics_soa_32_t s32;
+    physics_soa_64_t s64;
+} bench_physics_soa_t;
+
+static int bench_physics_init(unsigned int bits, bench_physics_soa_t* soa, size_t capacity) {
+    return bits == 16 ? physics_soa_init_16(&soa->s16, capacity) :
+           bits == 32 ? physics_soa_init_32(&soa->s32, capacity) :
+                        physics_soa_init_64(&soa->s64, capacity);
+}
+
+static void bench_physics_destroy(unsigned int bits, bench_physics_soa_t* soa) {
+    if (bits == 16) {
+        physics_soa_destroy_16(&soa->s16);
+    } else if (bits == 32) {
+        physics_soa_destroy_32(&soa->s32);
+    } else {
+        physics_soa_destroy_64(&soa->s64);
+    }
+}
+
+static int bench_physics_push(unsigned int bits, bench_physics_soa_t* soa, const void* record) {
+    return bits == 16 ? physics_soa_push_16(&soa->s16, record) :
+           bits == 32 ? physics_soa_push_32(&soa->s32, record) :
+                        physics_soa_push_64(&soa->s64, record);
+}
+
+static int bench_physics_remove(unsigned int bits, bench_physics_soa_t* soa, size_t index) {
+    return bits == 16 ? physics_soa_remove_16(&soa->s16, index) :
+           bits == 32 ? physics_soa_remove_32(&soa->s32, index) :
+                        physics_soa_remove_64(&soa->s64, index);
+}
+
+static int bench_physics_set(unsigned int bits, bench_physics_soa_t* soa, size_t index, const void* record) {
+    return bits == 16 ? physics_soa_set_16(&soa->s16, index, record) :
+           bits == 32 ? physics_soa_set_32(&soa->s32, index, record) :
+                        physics_soa_set_64(&soa->s64, index, record);
+}
+
+static int bench_physics_get(unsigned int bits, const bench_physics_soa_t* soa, size_t index, void* record) {
+    return bits == 16 ? physics_soa_get_16(&soa->s16, index, record) :
+           bits == 32 ? physics_soa_get_32(&soa->s32, index, record) :
+                        physics_soa_get_64(&soa->s64, index, record);
+}
+
+static int bench_physics_resize(unsigned int bits, bench_physics_soa_t* soa, size_t count) {
+    return bits == 16 ? physics_soa_resize_16(&soa->s16, count) :
+           bits == 32 ? physics_soa_resize_32(&soa->s32, count) :
+                        physics_soa_resize_64(&soa->s64, count);
+}
+
+static int bench_physics_from_aos(unsigned int bits, bench_physics_soa_t* soa, const void* records, size_t count) {
+    return bits == 16 ? physics_soa_from_aos_16(&soa->s16, records, count) :
+           bits == 32 ? physics_soa_from_aos_32(&soa->s32, records, count) :
+                        physics_soa_from_aos_64(&soa->s64, records, count);
+}
+
+static int bench_physics_to_aos(unsigned int bits, const bench_physics_soa_t* soa, size_t first, size_t count,
+                                void* records) {
+    return bits == 16 ? physics_soa_to_aos_16(&soa->s16, first, count, records) :
+           bits == 32 ? physics_soa_to_aos_32(&soa->s32, first, count, records) :
+                        physics_soa_to_aos_64(&soa->s64, first, count, records);
+}
+
+static const void* bench_physics_field(unsigned int bits, const bench_physics_soa_t* soa, physics_field_t field) {
+    return bits == 16 ? (const void*)physics_soa_field_16(&soa->s16, field) :
+           bits == 32 ? (const void*)physics_soa_field_32(&soa->s32, field) :
+                        (const void*)physics_soa_field_64(&soa->s64, field);
+}
+
+static size_t bench_physics_count(unsigned int bits, const bench_physics_soa_t* soa) {
+    return bits == 16 ? soa->s16.count : bits == 32 ? soa->s32.count : soa->s64.count;
+}
+
+static size_t bench_physics_capacity(unsigned int bits, const bench_physics_soa_t* soa) {
+    return bits == 16 ? soa->s16.capacity : bits == 32 ? soa->s32.capacity : soa->s64.capacity;
+}
+
+/**
+ * Check that every field array is cache-line aligned and holds field f of
+ * the first count records
+ */
+static int bench_physics_check_fields(unsigned int bits, const bench_physics_soa_t* soa, const uint8_t* records,
+                                      size_t count) {
+    size_t width = bits / 8;
+    if (bench_physics_capacity(bits, soa) % PHYSICS_SOA_GRANULE != 0 || bench_physics_count(bits, soa) != count) {
+        return 1;
+    }
+    
+    for (unsigned int f = 0; f < PHYSICS_FIELD_COUNT; f++) {
+        const uint8_t* field = bench_physics_field(bits, soa, (physics_field_t)f);
+        if (!field || (uintptr_t)field % MEMORY_CACHE_LINE_SIZE != 0) {
+            return 1;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (memcmp(field + i * width, records + (i * PHYSICS_FIELD_COUNT + f) * width, width) != 0) {
+                return 1;
+            }
+        }
+    }
+    
+    return bench_physics_field(bits, soa, PHYSICS_FIELD_COUNT) == NULL ? 0 : 1;
+}
+
+/**
+ * Fill a container one push at a time and then in one from_aos call,
+ * growing it from empty through several reallocations, and check the
+ * fields, the to_aos round trip, set/get, swap removal and zero-filled
+ * growth against the source records
+ */
+static int bench_physics_check(unsigned int bits, const uint8_t* source, uint8_t* out) {
+    size_t record = PHYSICS_FIELD_COUNT * bits / 8;
+    size_t count = BENCH_PHYSICS_CHECK_COUNT;
+    size_t pushed = count / 3;
+    bench_physics_soa_t soa;
+    
+    if (bench_physics_init(bits, &soa, 0) != 0 || bench_physics_capacity(bits, &soa) != 0) {
+        printf("Error: %u-bit container init failed\n", bits);
+        return 1;
+    }
+    
+    int result = 0;
+    for (size_t i = 0; i < pushed && result == 0; i++) {
+        result = bench_physics_push(bits, &soa, source + i * record);
+    }
+    if (result != 0 || bench_physics_from_aos(bits, &soa, source + pushed * record, count - pushed) != 0 ||
+        bench_physics_check_fields(bits, &soa, source, count) != 0) {
+        printf("Error: %u-bit container does not hold the pushed records\n", bits);
+        bench_physics_destroy(bits, &soa);
+        return 1;
+    }
+    
+    // Round trip, whole and from an unaligned offset
+    size_t first = 7;
+    if (bench_physics_to_aos(bits, &soa, 0, count, out) != 0 || memcmp(out, source, count * record) != 0 ||
+        bench_physics_to_aos(bits, &soa, first, count - first, out) != 0 ||
+        memcmp(out, source + first * record, (count - first) * record) != 0 ||
+        bench_physics_to_aos(bits, &soa, first, count, out) == 0) {
+        printf("Error: %u-bit to_aos does not round-trip\n", bits);
+        result = 1;
+    }
+    
+    // set then get, and swap removal of entity 3 takes the last entity
+    if (bench_physics_set(bits, &soa, 5, source + 11 * record) != 0 || bench_physics_get(bits, &soa, 5, out) != 0 ||
+        memcmp(out, source + 11 * record, record) != 0 || bench_physics_set(bits, &soa, count, source) == 0) {
+        printf("Error: %u-bit set/get mismatch\n", bits);
+        result = 1;
+    }
+    if (bench_physics_remove(bits, &soa, 3) != 0 || bench_physics_count(bits, &soa) != count - 1 ||
+        bench_physics_get(bits, &soa, 3, out) != 0 || memcmp(out, source + (count - 1) * record, record) != 0 ||
+        bench_physics_remove(bits, &soa, count - 1) == 0) {
+        printf("Error: %u-bit swap removal mismatch\n", bits);
+        result = 1;
+    }
+    
+    // Growth through resize and a NULL push zero-fills the new entities
+    size_t grown = count + 2 * PHYSICS_SOA_GRANULE + 1;
+    if (bench_physics_resize(bits, &soa, grown - 1) != 0 || bench_physics_push(bits, &soa, NULL) != 0 ||
+        bench_physics_to_aos(bits, &soa, count - 1, grown - (count - 1), out) != 0) {
+        printf("Error: %u-bit resize failed\n", bits);
+        result = 1;
+    } else {
+        for (size_t i = 0; i < (grown - (count - 1)) * record; i++) {
+            if (out[i] != 0) {
+                printf("Error: %u-bit resize left entity %zu nonzero\n", bits, count - 1 + i / record);
+                result = 1;
+                break;
+            }
+        }
+    }
+    
+    bench_physics_destroy(bits, &soa);
+    return result;
+}
+
+/**
+ * Time one AoS conversion direction at one entity count, returning
+ * millions of entities converted per second
+ */
+static double bench_physics_rate(unsigned int bits, bool to_aos, bench_physics_soa_t* soa, uint8_t* records,
+                                 size_t count) {
+    size_t iterations = BENCH_PHYSICS_ENTITIES / count;
+    if (iterations < 4) {
+        iterations = 4;
+    }
+    
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        if (to_aos) {
+            bench_physics_to_aos(bits, soa, 0, count, records);
+        } else {
+            bench_physics_resize(bits, soa, 0);
+            bench_physics_from_aos(bits, soa, records, count);
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    
+    return elapsed ? (double)count * (double)iterations * 1000.0 / (double)elapsed : 0.0;
+}
+
+/**
+ * SoA container checks at every width, then the from_aos and to_aos
+ * conversion rate for a cache-resident and a memory-sized entity count
+ */
+static int bench_run_physics(void) {
+    g_bench_arena_size = (size_t)BENCH_DEFAULT_ARENA_MB << 20;
+    if (memory_init() != 0) {
+        printf("Error: memory_init failed\n");
+        return 1;
+    }
+    
+    size_t bytes = (size_t)BENCH_PHYSICS_LARGE_COUNT * PHYSICS_FIELD_COUNT * sizeof(uint64_t);
+    uint8_t* source = malloc(bytes);
+    uint8_t* out = malloc(bytes);
+    if (!source || !out) {
+        free(source);
+        free(out);
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < bytes; i++) {
+        source[i] = (uint8_t)bench_random();
+    }
+    
+    int result = 0;
+    static const unsigned int widths[] = { 16, 32, 64 };
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        result |= bench_physics_check(widths[w], source, out);
+    }
+    
+    printf("physics: AoS conversion (million entities per second)\n\n");
+    printf("%-6s %7s %9s %9s\n", "width", "count", "from_aos", "to_aos");
+    static const size_t counts[] = { BENCH_PHYSICS_SMALL_COUNT, BENCH_PHYSICS_LARGE_COUNT };
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]) && result == 0; w++) {
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            bench_physics_soa_t soa;
+            if (bench_physics_init(widths[w], &soa, counts[c]) != 0) {
+                printf("Error: out of memory\n");
+                result = 1;
+                break;
+            }
+            
+            double from_rate = bench_physics_rate(widths[w], false, &soa, source, counts[c]);
+            double to_rate = bench_physics_rate(widths[w], true, &soa, out, counts[c]);
+            printf("%-6u %6zuK %9.1f %9.1f\n", widths[w], counts[c] / 1024, from_rate, to_rate);
+            bench_physics_destroy(widths[w], &soa);
+        }
+    }
+    
+    free(source);
+    free(out);
+    return result;
+}
+
+/**
+ * Broadphase world: base positions and velocities in 16-bit units, and
+ * the coordinate arrays handed to the grid at one width
+ */
+typedef struct {
+    size_t count;
+    int64_t* position[3];
+    int64_t* velocity[3];
+    void* coordinate[3];
+} bench_world_t;
+
+static void bench_world_free(bench_world_t* world) {
+    for (int k = 0; k < 3; k++) {
+        free(world->position[k]);
+        free(world->velocity[k]);
+        free(world->coordinate[k]);
+    }
+}
+
+static int bench_world_create(bench_world_t* world, size_t count) {
+    memset(world, 0, sizeof(*world));
+    world->count = count;
+    
+    int64_t side = (int64_t)1 << BENCH_BROADPHASE_WORLD_BITS;
+    int64_t speed = (int64_t)1 << (BENCH_BROADPHASE_CELL_BITS - 3);
+    for (int k = 0; k < 3; k++) {
+        world->position[k] = malloc(count * sizeof(int64_t));
+        world->velocity[k] = malloc(count * sizeof(int64_t));
+        world->coordinate[k] = malloc(count * sizeof(uint64_t));
+        if (!world->position[k] || !world->velocity[k] || !world->coordinate[k]) {
+            bench_world_free(world);
+            return -1;
+        }
+        for (size_t i = 0; i < count; i++) {
+            world->position[k][i] = (int64_t)(bench_random() % (uint64_t)side);
+            world->velocity[k][i] = (int64_t)(bench_random() % (uint64_t)(2 * speed + 1)) - speed;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Move every entity, bouncing off the world's walls
+ */
+static void bench_world_step(bench_world_t* world) {
+    int64_t side = (int64_t)1 << BENCH_BROADPHASE_WORLD_BITS;
+    for (int k = 0; k < 3; k++) {
+        for (size_t i = 0; i < world->count; i++) {
+            int64_t p = world->position[k][i] + world->velocity[k][i];
+            if (p < 0 || p >= side) {
+                world->velocity[k][i] = -world->velocity[k][i];
+                p = world->position[k][i];
+            }
+            world->position[k][i] = p;
+        }
+    }
+}
+
+/**
+ * Write the positions at a width, shifted up by scale (bits - 16 fills it)
+ */
+static void bench_world_coordinates(bench_world_t* world, unsigned int bits, unsigned int scale) {
+    for (int k = 0; k < 3; k++) {
+        for (size_t i = 0; i < world->count; i++) {
+            uint64_t value = (uint64_t)world->position[k][i] << scale;
+            if (bits == 16) {
+                ((uint16_t*)world->coordinate[k])[i] = (uint16_t)value;
+            } else if (bits == 32) {
+                ((uint32_t*)world->coordinate[k])[i] = (uint32_t)value;
+            } else {
+                ((uint64_t*)world->coordinate[k])[i] = value;
+            }
+        }
+    }
+}
+
+static int bench_world_update(broadphase_t* grid, bench_world_t* world, unsigned int bits) {
+    if (bits == 16) {
+        return broadphase_update_16(grid, world->coordinate[0], world->coordinate[1], world->coordinate[2], world->count);
+    }
+    if (bits == 32) {
+        return broadphase_update_32(grid, world->coordinate[0], world->coordinate[1], world->coordinate[2], world->count);
+    }
+    return broadphase_update_64(grid, world->coordinate[0], world->coordinate[1], world->coordinate[2], world->count);
+}
+
+/**
+ * Brute-force pair count over the base positions
+ */
+static size_t bench_world_pairs(const bench_world_t* world, int64_t radius) {
+    size_t pairs = 0;
+    for (size_t i = 0; i < world->count; i++) {
+        for (size_t j = i + 1; j < world->count; j++) {
+            int64_t distance = 0;
+            for (int k = 0; k < 3; k++) {
+                int64_t d = world->position[k][i] - world->position[k][j];
+                distance += d * d;
+            }
+            pairs += distance <= radius * radius;
+        }
+    }
+    return pairs;
+}
+
+/**
+ * Spatial hash run at each coordinate width: a small world checked against
+ * brute force, then a large one stepped and rebinned, reporting update
+ * rate, the share of entities changing bucket, candidates tested per pair
+ * found and pairs found per second
+ */
+static int bench_run_broadphase(void) {
+    g_bench_arena_size = (size_t)BENCH_DEFAULT_ARENA_MB << 20;
+    if (memory_init() != 0) {
+        printf("Error: memory_init failed\n");
+        return 1;
+    }
+    
+    bench_world_t check;
+    bench_world_t world;
+    if (bench_world_create(&check, BENCH_BROADPHASE_CHECK_COUNT) != 0) {
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    if (bench_world_create(&world, BENCH_BROADPHASE_COUNT) != 0) {
+        bench_world_free(&check);
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    
+    // Each query radius is one cell
+    int64_t radius = (int64_t)1 << BENCH_BROADPHASE_CELL_BITS;
+    size_t expected = bench_world_pairs(&check, radius);
+    
+    printf("broadphase: %d entities, %d steps, radius = cell edge\n\n", BENCH_BROADPHASE_COUNT, BENCH_BROADPHASE_STEPS);
+    printf("%-6s %12s %8s %12s %10s %12s\n", "width", "update Me/s", "moved", "pairs/step", "cand/pair", "Mpairs/s");
+    
+    int result = 0;
+    static const unsigned int widths[] = { 16, 32, 64 };
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        unsigned int bits = widths[w];
+        unsigned int scale = bits - 16;
+        uint64_t scaled_radius = (uint64_t)radius << scale;
+        
+        broadphase_t grid;
+        if (broadphase_init(&grid, BENCH_BROADPHASE_CELL_BITS + scale) != 0) {
+            printf("Error: broadphase_init failed\n");
+            result = 1;
+            break;
+        }
+        
+        bench_world_coordinates(&check, bits, scale);
+        if (bench_world_update(&grid, &check, bits) != 0) {
+            printf("Error: broadphase update failed\n");
+            result = 1;
+        }
+        size_t found = broadphase_pairs(&grid, scaled_radius, NULL, 0);
+        if (found != expected) {
+            printf("Error: %u-bit grid found %zu pairs, brute force %zu\n", bits, found, expected);
+            result = 1;
+        }
+        
+        // A fresh grid per width so the statistics cover only the timed steps
+        broadphase_destroy(&grid);
+        broadphase_init(&grid, BENCH_BROADPHASE_CELL_BITS + scale);
+        bench_world_coordinates(&world, bits, scale);
+        bench_world_update(&grid, &world, bits);
+        
+        uint64_t update_ns = 0;
+        uint64_t pairs_ns = 0;
+        size_t moved = 0;
+        size_t pairs = 0;
+        broadphase_stats_t before;
+        broadphase_get_stats(&grid, &before);
+        for (int step = 0; step < BENCH_BROADPHASE_STEPS; step++) {
+            bench_world_step(&world);
+            bench_world_coordinates(&world, bits, scale);
+            
+            uint64_t start = bench_now_ns();
+            if (bench_world_update(&grid, &world, bits) != 0) {
+                printf("Error: broadphase update failed\n");
+                result = 1;
+                break;
+            }
+            uint64_t middle = bench_now_ns();
+            pairs += broadphase_pairs(&grid, scaled_radius, NULL, 0);
+            pairs_ns += bench_now_ns() - middle;
+            update_ns += middle - start;
+            
+            broadphase_stats_t stats;
+            broadphase_get_stats(&grid, &stats);
+            moved += stats.moved;
+        }
+        
+        broadphase_stats_t after;
+        broadphase_get_stats(&grid, &after);
+        double entities = (double)BENCH_BROADPHASE_COUNT * BENCH_BROADPHASE_STEPS;
+        printf("%-6u %12.1f %7.1f%% %12zu %10.2f %12.1f\n", bits,
+               update_ns ? entities * 1000.0 / (double)update_ns : 0.0,
+               100.0 * (double)moved / entities,
+               pairs / BENCH_BROADPHASE_STEPS,
+               pairs ? (double)(after.candidates - before.candidates) / (double)pairs : 0.0,
+               pairs_ns ? (double)pairs * 1000.0 / (double)pairs_ns : 0.0);
+        
+        broadphase_destroy(&grid);
+    }
+    
+    bench_world_free(&check);
+    bench_world_free(&world);
+    return result;
+}
+
+/**
+ * AABB tree bench: queries are drawn in base units and scaled per width
+ */
+typedef struct {
+    int64_t point[3];
+    int64_t end[3];
+} bench_query_t;
+
+typedef struct {
+    int64_t distance;
+    uint32_t entity;
+} bench_neighbour_t;
+
+static int bench_neighbour_compare(const void* a, const void* b) {
+    const bench_neighbour_t* x = (const bench_neighbour_t*)a;
+    const bench_neighbour_t* y = (const bench_neighbour_t*)b;
+    if (x->distance != y->distance) {
+        return x->distance < y->distance ? -1 : 1;
+    }
+    return x->entity < y->entity ? -1 : x->entity > y->entity;
+}
+
+/**
+ * Shift for a width: 16-bit units fill 16 and 32 bits, and stop short of
+ * BVH_COORD_LIMIT at 64
+ */
+static unsigned int bench_bvh_scale(unsigned int bits) {
+    return bits == 64 ? 46 : bits - 16;
+}
+
+static int bench_world_tree(bvh_t* tree, bench_world_t* world, unsigned int bits) {
+    if (bits == 16) {
+        return bvh_update_16(tree, world->coordinate[0], world->coordinate[1], world->coordinate[2], world->count);
+    }
+    if (bits == 32) {
+        return bvh_update_32(tree, world->coordinate[0], world->coordinate[1], world->coordinate[2], world->count);
+    }
+    return bvh_update_64(tree, world->coordinate[0], world->coordinate[1], world->coordinate[2], world->count);
+}
+
+/**
+ * Random queries: a point anywhere in the world and a segment end up to
+ * an eighth of the world away
+ */
+static void bench_queries_create(bench_query_t* queries, size_t count) {
+    int64_t side = (int64_t)1 << BENCH_BROADPHASE_WORLD_BITS;
+    int64_t reach = side / 8;
+    for (size_t q = 0; q < count; q++) {
+        for (int k = 0; k < 3; k++) {
+            queries[q].point[k] = (int64_t)(bench_random() % (uint64_t)side);
+            queries[q].end[k] = queries[q].point[k] + (int64_t)(bench_random() % (uint64_t)(2 * reach + 1)) - reach;
+        }
+    }
+}
+
+/**
+ * Query box: one cell either side of the point
+ */
+static void bench_query_box(const bench_query_t* query, unsigned int scale, bvh_aabb_t* box) {
+    int64_t cell = (int64_t)1 << BENCH_BROADPHASE_CELL_BITS;
+    for (int k = 0; k < 3; k++) {
+        box->min[k] = (int64_t)((uint64_t)(query->point[k] - cell) << scale);
+        box->max[k] = (int64_t)((uint64_t)(query->point[k] + cell) << scale);
+    }
+}
+
+/**
+ * Brute-force check of the box and nearest queries over the base positions
+ * (entity boxes extend extent either side)
+ */
+static int bench_bvh_check(bvh_t* tree, const bench_world_t* world, const bench_query_t* queries, size_t count,
+                           unsigned int scale, int64_t extent) {
+    int64_t cell = (int64_t)1 << BENCH_BROADPHASE_CELL_BITS;
+    bench_neighbour_t* neighbours = malloc(world->count * sizeof(bench_neighbour_t));
+    uint32_t nearest[BENCH_BVH_NEAREST];
+    if (!neighbours) {
+        return -1;
+    }
+    
+    int result = 0;
+    for (size_t q = 0; q < count && result == 0; q++) {
+        const int64_t* point = queries[q].point;
+        size_t overlaps = 0;
+        for (size_t i = 0; i < world->count; i++) {
+            int64_t distance = 0;
+            bool overlap = true;
+            for (int k = 0; k < 3; k++) {
+                int64_t d = world->position[k][i] - point[k];
+                if (d < 0) d = -d;
+                overlap = overlap && d <= cell + extent;
+                d = d > extent ? d - extent : 0;
+                distance += d * d;
+            }
+            overlaps += overlap;
+            neighbours[i].distance = distance;
+            neighbours[i].entity = (uint32_t)i;
+        }
+        qsort(neighbours, world->count, sizeof(bench_neighbour_t), bench_neighbour_compare);
+        
+        bvh_aabb_t box;
+        bench_query_box(&queries[q], scale, &box);
+        size_t found = bvh_query_aabb(tree, &box, NULL, 0);
+        if (found != overlaps) {
+            printf("Error: box query found %zu entities, brute force %zu\n", found, overlaps);
+            result = -1;
+        }
+        
+        size_t stored = bvh_query_nearest(tree, (int64_t)((uint64_t)point[0] << scale),
+                                          (int64_t)((uint64_t)point[1] << scale),
+                                          (int64_t)((uint64_t)point[2] << scale), nearest, BENCH_BVH_NEAREST);
+        for (size_t n = 0; n < BENCH_BVH_NEAREST; n++) {
+            if (stored != BENCH_BVH_NEAREST || nearest[n] != neighbours[n].entity) {
+                printf("Error: nearest query differs from brute force at rank %zu\n", n);
+                result = -1;
+                break;
+            }
+        }
+    }
+    
+    free(neighbours);
+    return result;
+}
+
+/**
+ * AABB tree run at each coordinate width: a small world checked against
+ * brute force, then a large one stepped and updated, reporting update
+ * rate, the share of entities that left their fattened box, tree height
+ * and box, ray and nearest queries per second
+ */
+static int bench_run_bvh(void) {
+    g_bench_arena_size = (size_t)BENCH_DEFAULT_ARENA_MB << 20;
+    if (memory_init() != 0) {
+        printf("Error: memory_init failed\n");
+        return 1;
+    }
+    
+    bench_world_t check;
+    bench_world_t world;
+    bench_query_t* queries = malloc(BENCH_BVH_QUERIES * sizeof(bench_query_t));
+    uint32_t* found = malloc(BENCH_BROADPHASE_COUNT * sizeof(uint32_t));
+    if (!queries || !found || bench_world_create(&check, BENCH_BROADPHASE_CHECK_COUNT) != 0) {
+        free(queries);
+        free(found);
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    if (bench_world_create(&world, BENCH_BROADPHASE_COUNT) != 0) {
+        bench_world_free(&check);
+        free(queries);
+        free(found);
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    bench_queries_create(queries, BENCH_BVH_QUERIES);
+    
+    // Cubes one cell across, fattened by two steps at full speed
+    int64_t extent = (int64_t)1 << (BENCH_BROADPHASE_CELL_BITS - 1);
+    int64_t margin = (int64_t)1 << (BENCH_BROADPHASE_CELL_BITS - 2);
+    
+    printf("bvh: %d entities, %d steps, %d queries of each kind, %d nearest\n\n",
+           BENCH_BROADPHASE_COUNT, BENCH_BROADPHASE_STEPS, BENCH_BVH_QUERIES, BENCH_BVH_NEAREST);
+    printf("%-6s %12s %8s %7s %10s %10s %10s\n", "width", "update Me/s", "moved", "height", "box kq/s", "ray kq/s",
+           "near kq/s");
+    
+    int result = 0;
+    static const unsigned int widths[] = { 16, 32, 64 };
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        unsigned int bits = widths[w];
+        unsigned int scale = bench_bvh_scale(bits);
+        
+        bvh_t tree;
+        if (bvh_init(&tree, (uint64_t)extent << scale, (uint64_t)margin << scale) != 0) {
+            printf("Error: bvh_init failed\n");
+            result = 1;
+            break;
+        }
+        
+        bench_world_coordinates(&check, bits, scale);
+        if (bench_world_tree(&tree, &check, bits) != 0 ||
+            bench_bvh_check(&tree, &check, queries, BENCH_BVH_QUERIES / 16, scale, extent) != 0) {
+            printf("Error: %u-bit tree check failed\n", bits);
+            result = 1;
+        }
+        
+        // A fresh tree per width so the statistics cover only the timed steps
+        bvh_destroy(&tree);
+        bvh_init(&tree, (uint64_t)extent << scale, (uint64_t)margin << scale);
+        bench_world_coordinates(&world, bits, scale);
+        bench_world_tree(&tree, &world, bits);
+        
+        uint64_t update_ns = 0;
+        size_t moved = 0;
+        for (int step = 0; step < BENCH_BROADPHASE_STEPS; step++) {
+            bench_world_step(&world);
+            bench_world_coordinates(&world, bits, scale);
+            
+            uint64_t start = bench_now_ns();
+            if (bench_world_tree(&tree, &world, bits) != 0) {
+                printf("Error: bvh update failed\n");
+                result = 1;
+                break;
+            }
+            update_ns += bench_now_ns() - start;
+            
+            bvh_stats_t stats;
+            bvh_get_stats(&tree, &stats);
+            moved += stats.reinserted;
+        }
+        
+        // Each query kind over the final positions
+        uint64_t start = bench_now_ns();
+        size_t matches = 0;
+        for (size_t q = 0; q < BENCH_BVH_QUERIES; q++) {
+            bvh_aabb_t box;
+            bench_query_box(&queries[q], scale, &box);
+            matches += bvh_query_aabb(&tree, &box, found, BENCH_BROADPHASE_COUNT);
+        }
+        uint64_t box_ns = bench_now_ns() - start;
+        
+        start = bench_now_ns();
+        for (size_t q = 0; q < BENCH_BVH_QUERIES; q++) {
+            bvh_ray_t ray;
+            bvh_hit_t hit;
+            for (int k = 0; k < 3; k++) {
+                ray.origin[k] = (int64_t)((uint64_t)queries[q].point[k] << scale);
+                ray.end[k] = (int64_t)((uint64_t)queries[q].end[k] << scale);
+            }
+            matches += bvh_raycast(&tree, &ray, &hit);
+        }
+        uint64_t ray_ns = bench_now_ns() - start;
+        
+        start = bench_now_ns();
+        for (size_t q = 0; q < BENCH_BVH_QUERIES; q++) {
+            const int64_t* point = queries[q].point;
+            matches += bvh_query_nearest(&tree, (int64_t)((uint64_t)point[0] << scale),
+                                         (int64_t)((uint64_t)point[1] << scale),
+                                         (int64_t)((uint64_t)point[2] << scale), found, BENCH_BVH_NEAREST);
+        }
+        uint64_t nearest_ns = bench_now_ns() - start;
+        
+        bvh_stats_t stats;
+        bvh_get_stats(&tree, &stats);
+        double entities = (double)BENCH_BROADPHASE_COUNT * BENCH_BROADPHASE_STEPS;
+        double queries_us = (double)BENCH_BVH_QUERIES * 1e6;
+        printf("%-6u %12.1f %7.1f%% %7zu %10.1f %10.1f %10.1f\n", bits,
+               update_ns ? entities * 1000.0 / (double)update_ns : 0.0,
+               100.0 * (double)moved / entities,
+               bvh_height(&tree),
+               box_ns ? queries_us / (double)box_ns : 0.0,
+               ray_ns ? queries_us / (double)ray_ns : 0.0,
+               nearest_ns ? queries_us / (double)nearest_ns : 0.0);
+        
+        if (matches == 0) {
+            printf("Error: %u-bit queries matched nothing\n", bits);
+            result = 1;
+        }
+        bvh_destroy(&tree);
+    }
+    
+    bench_world_free(&check);
+    bench_world_free(&world);
+    free(queries);
+    free(found);
+    return result;
+}
+
+static void bench_trace_reset(bench_trace_t* trace, const char* name) {
+    trace->name = name;
+    trace->count = 0;
+    trace->slot_count = 0;
+}
+
+// Access patterns timed by the gather command
+typedef struct {
+    const char* name;
+    size_t stride_elements;     // Stride in elements (0: none)
+    size_t stride_bytes;        // Stride in bytes added to that (0 with no stride: indexed)
+    size_t table_bytes;         // Span the elements are spread over
+} bench_access_t;
+
+static const bench_access_t g_bench_accesses[] = {
+    { "field", PHYSICS_FIELD_COUNT, 0, BENCH_GATHER_LARGE_BYTES },
+    { "page", 0, 4096, BENCH_GATHER_LARGE_BYTES },
+    { "index 256K", 0, 0, BENCH_GATHER_SMALL_BYTES },
+    { "index 256M", 0, 0, BENCH_GATHER_LARGE_BYTES }
+};
+
+/**
+ * Byte stride of an access pattern at one width (0 for index lists)
+ */
+static size_t bench_access_stride(const bench_access_t* access, size_t width) {
+    return access->stride_elements * width + access->stride_bytes;
+}
+
+/**
+ * Gather or scatter the call-th batch of count elements; strided batches
+ * walk on through the table and indexed ones through the index list
+ */
+static void bench_gather_apply(const bench_access_t* access, bool scatter, size_t width, char* table,
+                               void* dense, const uint32_t* indices, size_t count, size_t call) {
+    size_t stride = bench_access_stride(access, width);
+    
+    if (stride == 0) {
+        const uint32_t* batch = indices + (call * count) % BENCH_GATHER_INDICES;
+        if (scatter) {
+            scatter_indexed(table, batch, dense, count, width);
+        } else {
+            gather_indexed(dense, table, batch, count, width);
+        }
+        return;
+    }
+    
+    size_t span = count * stride;
+    char* base = table + (call * span) % (access->table_bytes - span);
+    if (scatter) {
+        scatter_strided(base, (ptrdiff_t)stride, dense, count, width);
+    } else {
+        gather_strided(dense, base, (ptrdiff_t)stride, count, width);
+    }
+}
+
+/**
+ * Time one access pattern, returning millions of elements per second
+ */
+static double bench_gather_rate(const bench_access_t* access, bool scatter, size_t width, char* table,
+                                void* dense, const uint32_t* indices) {
+    size_t calls = BENCH_GATHER_ELEMENTS / BENCH_GATHER_COUNT;
+    
+    bench_gather_apply(access, scatter, width, table, dense, indices, BENCH_GATHER_COUNT, 0);
+    
+    uint64_t start = bench_now_ns();
+    for (size_t call = 0; call < calls; call++) {
+        bench_gather_apply(access, scatter, width, table, dense, indices, BENCH_GATHER_COUNT, call);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    
+    return elapsed ? (double)BENCH_GATHER_ELEMENTS * 1000.0 / (double)elapsed : 0.0;
+}
+
+/**
+ * Check a variant against the generic routines on an odd count at a
+ * 2-byte offset. A scatter is read back with the generic gather after
+ * poisoning the same elements, so it must land every value it was given.
+ */
+static bool bench_gather_check(const bench_access_t* access, bool scatter, size_t width, gather_variant_t variant,
+                               char* table, char* dense, char* expected, const uint32_t* indices) {
+    size_t count = BENCH_GATHER_COUNT - 3;
+    size_t bytes = count * width;
+    char* base = table + 2;
+    
+    if (scatter) {
+        for (size_t i = 0; i < bytes; i++) {
+            dense[bytes + i] = (char)~dense[i];
+        }
+        gather_set_variant(GATHER_VARIANT_GENERIC);
+        bench_gather_apply(access, true, width, base, dense + bytes, indices, count, 0);
+        gather_set_variant(variant);
+        bench_gather_apply(access, true, width, base, dense, indices, count, 0);
+        gather_set_variant(GATHER_VARIANT_GENERIC);
+        bench_gather_apply(access, false, width, base, expected, indices, count, 0);
+        
+        // With repeated indices the last write wins: gather the generic
+        // scatter's result the same way
+        bench_gather_apply(access, true, width, base, dense + bytes, indices, count, 0);
+        bench_gather_apply(access, true, width, base, dense, indices, count, 0);
+        bench_gather_apply(access, false, width, base, dense + bytes, indices, count, 0);
+        return memcmp(expected, dense + bytes, bytes) == 0;
+    }
+    
+    gather_set_variant(GATHER_VARIANT_GENERIC);
+    bench_gather_apply(access, false, width, base, expected, indices, count, 0);
+    gather_set_variant(variant);
+    bench_gather_apply(access, false, width, base, dense, indices, count, 0);
+    return memcmp(expected, dense, bytes) == 0;
+}
+
+/**
+ * Elements/s table of every supported gather variant for strided and
+ * indexed access at each width, gathering into and scattering out of a
+ * dense buffer; each variant's result is checked against the generic
+ * routines first
+ */
+static int bench_run_gather(void) {
+    gather_init();
+    gather_variant_t selected = gather_get_variant();
+    
+    char* table = NULL;
+    char* dense = NULL;
+    char* expected = NULL;
+    uint32_t* indices = malloc(BENCH_GATHER_INDICES * sizeof(uint32_t));
+    if (!indices || posix_memalign((void**)&table, 64, BENCH_GATHER_LARGE_BYTES + 64) != 0 ||
+        posix_memalign((void**)&dense, 64, 2 * BENCH_GATHER_COUNT * sizeof(uint64_t)) != 0 ||
+        posix_memalign((void**)&expected, 64, BENCH_GATHER_COUNT * sizeof(uint64_t)) != 0) {
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    
+    for (size_t i = 0; i < (BENCH_GATHER_LARGE_BYTES + 64) / sizeof(uint64_t); i++) {
+        ((uint64_t*)table)[i] = bench_random();
+    }
+    for (size_t i = 0; i < BENCH_GATHER_COUNT; i++) {
+        ((uint64_t*)dense)[i] = bench_random();
+    }
+    
+    printf("gather: boot selects %s (M elements/s)\n\n", gather_variant_name(selected));
+    printf("%-10s %-7s %5s", "access", "op", "width");
+    for (int v = 0; v < GATHER_VARIANT_COUNT; v++) {
+        if (gather_variant_supported((gather_variant_t)v)) {
+            printf(" %9s", gather_variant_name((gather_variant_t)v));
+        }
+    }
+    printf("  best\n");
+    
+    int result = 0;
+    for (size_t a = 0; a < sizeof(g_bench_accesses) / sizeof(g_bench_accesses[0]); a++) {
+        const bench_access_t* access = &g_bench_accesses[a];
+        
+        for (size_t width = 2; width <= 8; width *= 2) {
+            // Indices stay clear of the table's last element
+            if (bench_access_stride(access, width) == 0) {
+                for (size_t i = 0; i < BENCH_GATHER_INDICES; i++) {
+                    indices[i] = (uint32_t)(bench_random() % (access->table_bytes / width - 1));
+                }
+            }
+            
+            for (int op = 0; op < 2; op++) {
+                bool scatter = op == 1;
+                printf("%-10s %-7s %5zu", access->name, scatter ? "scatter" : "gather", width * 8);
+                
+                double best_rate = 0.0;
+                gather_variant_t best = GATHER_VARIANT_GENERIC;
+                for (int v = 0; v < GATHER_VARIANT_COUNT; v++) {
+                    if (!gather_variant_supported((gather_variant_t)v)) {
+                        continue;
+                    }
+                    
+                    if (v != GATHER_VARIANT_GENERIC &&
+                        !bench_gather_check(access, scatter, width, (gather_variant_t)v, table, dense, expected,
+                                            indices)) {
+                        printf("\nError: %s %s %zu-bit %s result differs from generic\n", access->name,
+                               scatter ? "scatter" : "gather", width * 8, gather_variant_name((gather_variant_t)v));
+                        result = 1;
+                    }
+                    
+                    gather_set_variant((gather_variant_t)v);
+                    double rate = bench_gather_rate(access, scatter, width, table, dense, indices);
+                    printf(" %9.1f", rate);
+                    if (rate > best_rate) {
+                        best_rate = rate;
+                        best = (gather_variant_t)v;
+                    }
+                }
+                printf("  %s\n", gather_variant_name(best));
+            }
+        }
+    }
+    
+    gather_set_variant(selected);
+    free(table);
+    free(dense);
+    free(expected);
+    free(indices);
+    return result;
+}
+
+/**
+ * Unpack or pack a whole array through lanes of the given width
+ */
+static void bench_packed_apply(packed_array_t* array, bool pack, size_t lane_bits, void* lanes) {
+    size_t count = array->count;
+    
+    if (lane_bits == 16) {
+        if (pack) {
+            packed_pack_16(array, 0, count, lanes, CONVERT_TRUNCATE);
+        } else {
+            packed_unpack_16(array, 0, count, lanes);
+        }
+    } else if (lane_bits == 32) {
+        if (pack) {
+            packed_pack_32(array, 0, count, lanes, CONVERT_TRUNCATE);
+        } else {
+            packed_unpack_32(array, 0, count, lanes);
+        }
+    } else {
+        if (pack) {
+            packed_pack_64(array, 0, count, lanes, CONVERT_TRUNCATE);
+        } else {
+            packed_unpack_64(array, 0, count, lanes);
+        }
+    }
+}
+
+/**
+ * Time one direction at one lane width, returning millions of elements per
+ * second
+ */
+static double bench_packed_rate(packed_array_t* array, bool pack, size_t lane_bits, void* lanes) {
+    size_t iterations = BENCH_PACKED_ELEMENTS / array->count;
+    
+    bench_packed_apply(array, pack, lane_bits, lanes);
+    
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        bench_packed_apply(array, pack, lane_bits, lanes);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    
+    return elapsed ? (double)array->count * (double)iterations * 1000.0 / (double)elapsed : 0.0;
+}
+
+/**
+ * Elements/s table of every supported packing variant for a few element
+ * widths, unpacking into and packing from each lane width that holds
+ * them; each variant's lanes and words are checked against the generic
+ * routines first
+ */
+static int bench_run_packed(void) {
+    static const unsigned int widths[] = { 10, 12, 20, 40 };
+    
+    packed_init();
+    packed_variant_t selected = packed_get_variant();
+    
+    size_t words = packed_words(PACKED_MAX_BITS, BENCH_PACKED_COUNT);
+    uint64_t* storage = NULL;
+    uint64_t* expected_words = NULL;
+    uint64_t* lanes = NULL;
+    uint64_t* expected = NULL;
+    if (posix_memalign((void**)&storage, 64, words * sizeof(uint64_t)) != 0 ||
+        posix_memalign((void**)&expected_words, 64, words * sizeof(uint64_t)) != 0 ||
+        posix_memalign((void**)&lanes, 64, BENCH_PACKED_COUNT * sizeof(uint64_t)) != 0 ||
+        posix_memalign((void**)&expected, 64, BENCH_PACKED_COUNT * sizeof(uint64_t)) != 0) {
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    
+    printf("packed: boot selects %s (M elements/s)\n\n", packed_variant_name(selected));
+    printf("%-5s %-7s %5s", "bits", "op", "lanes");
+    for (int v = 0; v < PACKED_VARIANT_COUNT; v++) {
+        if (packed_variant_supported((packed_variant_t)v)) {
+            printf(" %9s", packed_variant_name((packed_variant_t)v));
+        }
+    }
+    printf("  best\n");
+    
+    int result = 0;
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        packed_array_t array;
+        packed_attach(&array, storage, widths[w], BENCH_PACKED_COUNT);
+        for (size_t i = 0; i < BENCH_PACKED_COUNT; i++) {
+            lanes[i] = bench_random();
+        }
+        
+        // Bits past the last element stay clear, as a fresh pack leaves them
+        memset(storage, 0, words * sizeof(uint64_t));
+        packed_set_variant(PACKED_VARIANT_GENERIC);
+        packed_pack_64(&array, 0, BENCH_PACKED_COUNT, lanes, CONVERT_TRUNCATE);
+        
+        for (size_t lane_bits = 16; lane_bits <= 64; lane_bits *= 2) {
+            if (widths[w] > lane_bits) {
+                continue;
+            }
+            size_t lane_bytes = BENCH_PACKED_COUNT * lane_bits / 8;
+            
+            for (int op = 0; op < 2; op++) {
+                bool pack = op == 1;
+                printf("%-5u %-7s %5zu", widths[w], pack ? "pack" : "unpack", lane_bits);
+                
+                // Unpack checks compare lanes, pack checks the words they
+                // give back from the same lanes
+                packed_set_variant(PACKED_VARIANT_GENERIC);
+                bench_packed_apply(&array, false, lane_bits, expected);
+                memcpy(expected_words, storage, words * sizeof(uint64_t));
+                
+                double best_rate = 0.0;
+                packed_variant_t best = PACKED_VARIANT_GENERIC;
+                for (int v = 0; v < PACKED_VARIANT_COUNT; v++) {
+                    if (packed_set_variant((packed_variant_t)v) != 0) {
+                        continue;
+                    }
+                    
+                    bool same;
+                    if (pack) {
+                        memcpy(lanes, expected, lane_bytes);
+                        memset(storage, 0, words * sizeof(uint64_t));
+                        bench_packed_apply(&array, true, lane_bits, lanes);
+                        same = memcmp(storage, expected_words, words * sizeof(uint64_t)) == 0;
+                        memcpy(storage, expected_words, words * sizeof(uint64_t));
+                    } else {
+                        bench_packed_apply(&array, false, lane_bits, lanes);
+                        same = memcmp(lanes, expected, lane_bytes) == 0;
+                    }
+                    if (!same) {
+                        printf("\nError: %u-bit %s %zu-bit lanes %s result differs from generic\n", widths[w],
+                               pack ? "pack" : "unpack", lane_bits, packed_variant_name((packed_variant_t)v));
+                        result = 1;
+                    }
+                    
+                    memcpy(lanes, expected, lane_bytes);
+                    double rate = bench_packed_rate(&array, pack, lane_bits, lanes);
+                    printf(" %9.1f", rate);
+                    if (rate > best_rate) {
+                        best_rate = rate;
+                        best = (packed_variant_t)v;
+                    }
+                }
+                printf("  %s\n", packed_variant_name(best));
+            }
+        }
+    }
+    
+    packed_set_variant(selected);
+    free(storage);
+    free(expected_words);
+    free(lanes);
+    free(expected);
+    return result;
+}
+
+/**
+ * Check that every byte of the first count check allocations still holds
+ * the index it was filled with (overlapping allocations would clobber it)
+ */
+static int bench_arena_check_fill(uint8_t* const* pointers, const uint32_t* sizes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        for (uint32_t b = 0; b < sizes[i]; b++) {
+            if (pointers[i][b] != (uint8_t)i) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Check the arena allocator: the bump fast path, chunk growth, aligned
+ * allocation, reset reusing the retained chunks, mark/rewind across a
+ * chunk boundary and string copies; the page allocator must get every
+ * chunk back on destroy
+ */
+static int bench_arena_check(uint8_t** pointers, uint32_t* sizes) {
+    page_stats_t before;
+    page_get_stats(&before);
+    
+    arena_t* arena = arena_create(BENCH_ARENA_INITIAL_SIZE);
+    if (!arena || arena->chunk_count != 1) {
+        printf("Error: arena_create failed\n");
+        return 1;
+    }
+    
+    // Fast path: small allocations are consecutive, aligned slots of the
+    // first chunk
+    uint8_t* first = arena_alloc(arena, 1);
+    uint8_t* second = arena_alloc(arena, ARENA_ALIGNMENT + 1);
+    uint8_t* third = arena_alloc(arena, 1);
+    if (!first || (uintptr_t)first % ARENA_ALIGNMENT != 0 || second != first + ARENA_ALIGNMENT ||
+        third != second + 2 * ARENA_ALIGNMENT || arena->current != arena->first) {
+        printf("Error: arena fast path hands out %p %p %p\n", (void*)first, (void*)second, (void*)third);
+        arena_destroy(arena);
+        return 1;
+    }
+    arena_reset(arena);
+    
+    // Slow path: enough random allocations for several chunks, each chunk
+    // at least one order larger than the last until the cap
+    int result = 0;
+    for (size_t i = 0; i < BENCH_ARENA_CHECK_ALLOCS; i++) {
+        sizes[i] = 1 + (uint32_t)(bench_random() % BENCH_ARENA_CHECK_MAX_SIZE);
+        pointers[i] = arena_alloc(arena, sizes[i]);
+        if (!pointers[i] || (uintptr_t)pointers[i] % ARENA_ALIGNMENT != 0) {
+            printf("Error: arena allocation %zu failed or is misaligned\n", i);
+            arena_destroy(arena);
+            return 1;
+        }
+        memset(pointers[i], (int)(uint8_t)i, sizes[i]);
+    }
+    
+    size_t chunks = arena->chunk_count;
+    unsigned int order = arena->first->order;
+    for (arena_chunk_t* chunk = arena->first->next; chunk; chunk = chunk->next) {
+        if (chunk->order < order || (chunk->order == order && order < BENCH_ARENA_MAX_CHUNK_ORDER)) {
+            printf("Error: arena chunk of order %u follows order %u\n", chunk->order, order);
+            result = 1;
+        }
+        order = chunk->order;
+    }
+    if (chunks < 3 || bench_arena_check_fill(pointers, sizes, BENCH_ARENA_CHECK_ALLOCS) != 0) {
+        printf("Error: arena grew to %zu chunks or allocations overlap\n", chunks);
+        result = 1;
+    }
+    
+    // Reset keeps the chunks: replaying the same sizes lands on the same
+    // addresses without taking a page
+    arena_reset(arena);
+    page_stats_t held;
+    page_get_stats(&held);
+    for (size_t i = 0; i < BENCH_ARENA_CHECK_ALLOCS; i++) {
+        if (arena_alloc(arena, sizes[i]) != pointers[i]) {
+            printf("Error: arena allocation %zu moved after reset\n", i);
+            result = 1;
+            break;
+        }
+    }
+    page_stats_t reused;
+    page_get_stats(&reused);
+    if (arena->chunk_count != chunks || reused.free_pages != held.free_pages || arena->reset_count != 2) {
+        printf("Error: arena reset did not reuse its chunks\n");
+        result = 1;
+    }
+    
+    // Aligned allocations, both in the current chunk and forcing a new one
+    arena_reset(arena);
+    for (size_t alignment = 2 * ARENA_ALIGNMENT; alignment <= BENCH_ARENA_MAX_ALIGNMENT; alignment *= 2) {
+        for (size_t size = 1; size <= 2 * BENCH_ARENA_MAX_ALIGNMENT; size = size * 3 + 1) {
+            uint8_t* ptr = arena_alloc_aligned(arena, size, alignment);
+            if (!ptr || (uintptr_t)ptr % alignment != 0) {
+                printf("Error: arena_alloc_aligned(%zu, %zu) returned %p\n", size, alignment, (void*)ptr);
+                result = 1;
+            }
+        }
+    }
+    if (arena_alloc_aligned(arena, 16, 48) != NULL) {
+        printf("Error: arena_alloc_aligned accepted a non-power-of-two alignment\n");
+        result = 1;
+    }
+    
+    // Rewind across a chunk boundary: allocate past the end of the current
+    // chunk, then return to the mark and get the same address again
+    arena_reset(arena);
+    arena_alloc(arena, 1);
+    arena_mark_t mark = arena_mark(arena);
+    uint8_t* marked = arena_alloc(arena, 1);
+    while (arena->current == mark.chunk) {
+        arena_alloc(arena, BENCH_ARENA_CHECK_MAX_SIZE);
+    }
+    arena_rewind(arena, mark);
+    if (arena->current != mark.chunk || arena_alloc(arena, 1) != marked) {
+        printf("Error: arena_rewind did not return to the mark\n");
+        result = 1;
+    }
+    
+    // String copies
+    static const char text[] = "scratch string";
+    char* copy = arena_strdup(arena, text);
+    char* prefix = arena_strndup(arena, text, 7);
+    char* whole = arena_strndup(arena, text, sizeof(text) + 10);
+    if (!copy || copy == text || strcmp(copy, text) != 0 || !prefix || strcmp(prefix, "scratch") != 0 ||
+        !whole || strcmp(whole, text) != 0 || arena_strdup(arena, NULL) != NULL) {
+        printf("Error: arena string copies differ\n");
+        result = 1;
+    }
+    
+    arena_destroy(arena);
+    page_stats_t after;
+    page_get_stats(&after);
+    if (after.free_pages != before.free_pages) {
+        printf("Error: arena_destroy leaked %lld pages\n",
+               (long long)before.free_pages - (long long)after.free_pages);
+        result = 1;
+    }
+    
+    return result;
+}
+
+/**
+ * Arena checks, then small-allocation throughput of the arena (bump and
+ * reset per batch) against memory_alloc/memory_free of the same sizes
+ */
+static int bench_run_arena(void) {
+    g_bench_arena_size = (size_t)BENCH_DEFAULT_ARENA_MB << 20;
+    if (memory_init() != 0) {
+        printf("Error: memory_init failed\n");
+        return 1;
+    }
+    
+    uint8_t** pointers = malloc(BENCH_ARENA_CHECK_ALLOCS * sizeof(uint8_t*));
+    uint32_t* sizes = malloc(BENCH_ARENA_CHECK_ALLOCS * sizeof(uint32_t));
+    void** batch = malloc(BENCH_ARENA_BATCH * sizeof(void*));
+    if (!pointers || !sizes || !batch) {
+        free(pointers);
+        free(sizes);
+        free(batch);
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    
+    int result = bench_arena_check(pointers, sizes);
+    
+    printf("arena: batches of %d allocations (million allocations per second)\n\n", BENCH_ARENA_BATCH);
+    printf("%-6s %9s %9s\n", "size", "arena", "heap");
+    static const uint32_t batch_sizes[] = { 16, 64, 256 };
+    for (size_t s = 0; s < sizeof(batch_sizes) / sizeof(batch_sizes[0]) && result == 0; s++) {
+        arena_t* arena = arena_create(BENCH_ARENA_BATCH * batch_sizes[s]);
+        if (!arena) {
+            printf("Error: arena_create failed\n");
+            result = 1;
+            break;
+        }
+        
+        size_t batches = BENCH_ARENA_ALLOCS / BENCH_ARENA_BATCH;
+        uint64_t start = bench_now_ns();
+        for (size_t b = 0; b < batches; b++) {
+            for (size_t i = 0; i < BENCH_ARENA_BATCH; i++) {
+                batch[i] = arena_alloc(arena, batch_sizes[s]);
+            }
+            arena_reset(arena);
+        }
+        uint64_t arena_ns = bench_now_ns() - start;
+        arena_destroy(arena);
+        
+        start = bench_now_ns();
+        for (size_t b = 0; b < batches; b++) {
+            for (size_t i = 0; i < BENCH_ARENA_BATCH; i++) {
+                batch[i] = memory_alloc(batch_sizes[s]);
+            }
+            for (size_t i = 0; i < BENCH_ARENA_BATCH; i++) {
+                memory_free(batch[i]);
+            }
+        }
+        uint64_t heap_ns = bench_now_ns() - start;
+        
+        double total = (double)batches * BENCH_ARENA_BATCH * 1000.0;
+        printf("%-6u %9.1f %9.1f\n", batch_sizes[s], arena_ns ? total / (double)arena_ns : 0.0,
+               heap_ns ? total / (double)heap_ns : 0.0);
+    }
+    
+    free(pointers);
+    free(sizes);
+    free(batch);
+    return result;
+}
+
+/**
+ * Round-trip memory_write_generic/memory_read_generic in each mode at
+ * each aligned offset of a 16-byte block: only the mode's bytes change, at
+ * either end, and
+ * the read matches the fixed-width accessor. A bad mode or NULL pointer
+ * must fail without touching the value.
+ */
+static int bench_multibit_check_generic(void) {
+    static const memory_mode_t modes[] = { MEMORY_MODE_16BIT, MEMORY_MODE_32BIT, MEMORY_MODE_64BIT };
+    static const uint64_t pattern = 0x8877665544332211ULL;
+    
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        size_t width = (size_t)modes[m] / 8;
+        for (size_t offset = 0; offset + width <= 16; offset += width) {
+            uint64_t block[2];
+            uint8_t* memory = (uint8_t*)block;
+            memset(block, 0xA5, sizeof(block));
+            
+            union { uint16_t u16; uint32_t u32; uint64_t u64; uint8_t bytes[8]; } in, out;
+            in.u64 = pattern ^ (offset * 0x0101010101010101ULL);
+            out.u64 = ~0ULL;
+            memory_write_generic(memory + offset, &in, modes[m]);
+            int status = memory_read_generic(memory + offset, &out, modes[m]);
+            
+            bool ok = status == 0 && memcmp(out.bytes, in.bytes, width) == 0 &&
+                      memcmp(memory + offset, in.bytes, width) == 0;
+            for (size_t b = width; b < sizeof(out.bytes); b++) {
+                ok = ok && out.bytes[b] == 0xFF;
+            }
+            for (size_t b = 0; b < sizeof(block); b++) {
+                ok = ok && (b - offset < width || memory[b] == 0xA5);
+            }
+            
+            uint64_t fixed = modes[m] == MEMORY_MODE_16BIT ? memory_read16(memory + offset) :
+                             modes[m] == MEMORY_MODE_32BIT ? memory_read32(memory + offset) :
+                             memory_read64(memory + offset);
+            uint64_t generic = modes[m] == MEMORY_MODE_16BIT ? out.u16 :
+                               modes[m] == MEMORY_MODE_32BIT ? out.u32 : out.u64;
+            if (!ok || fixed != generic) {
+                printf("Error: %u-bit generic access at offset %zu does not round-trip\n", (unsigned)modes[m], offset);
+                return 1;
+            }
+        }
+    }
+    
+    uint64_t value = pattern;
+    uint64_t word = 0;
+    if (memory_read_generic(&word, &value, (memory_mode_t)8) != -1 || value != pattern ||
+        memory_read_generic(NULL, &value, MEMORY_MODE_64BIT) != -1 ||
+        memory_read_generic(&word, NULL, MEMORY_MODE_64BIT) != -1) {
+        printf("Error: memory_read_generic accepted a bad mode or pointer\n");
+        return 1;
+    }
+    memory_write_generic(&word, &value, (memory_mode_t)8);
+    if (word != 0) {
+        printf("Error: memory_write_generic stored with a bad mode\n");
+        return 1;
+    }
+    
+    return 0;
+}
+
+static int bench_multibit_compare(const void* a, const void* b) {
+    uint64_t x = ((const multibit_memory_region_t*)a)->base_address;
+    uint64_t y = ((const multibit_memory_region_t*)b)->base_address;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Region of the address-sorted shadow list containing address (NULL when
+ * there is none)
+ */
+static const multibit_memory_region_t* bench_multibit_expect(const multibit_memory_region_t* sorted, size_t count,
+                                                             uint64_t address) {
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (sorted[mid].base_address <= address) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    if (low == 0 || address - sorted[low - 1].base_address >= sorted[low - 1].size) {
+        return NULL;
+    }
+    return &sorted[low - 1];
+}
+
+/**
+ * Compare the region index with the shadow list: get_regions must list
+ * the same regions in address order, and find_region must agree with a
+ * search of the shadow at each region's base, interior, last byte and the
+ * byte just past it
+ */
+static int bench_multibit_verify(const multibit_memory_region_t* live, size_t count,
+                                 multibit_memory_region_t* sorted, multibit_memory_region_t* listed) {
+    memcpy(sorted, live, count * sizeof(multibit_memory_region_t));
+    qsort(sorted, count, sizeof(multibit_memory_region_t), bench_multibit_compare);
+    
+    size_t listed_count = 0;
+    if (multibit_memory_get_regions(listed, BENCH_MULTIBIT_LIVE + 1, &listed_count) != 0 || listed_count != count) {
+        printf("Error: multibit_memory_get_regions listed %zu of %zu regions\n", listed_count, count);
+        return 1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (listed[i].base_address != sorted[i].base_address || listed[i].size != sorted[i].size ||
+            listed[i].bit_mode != sorted[i].bit_mode) {
+            printf("Error: region %zu listed at 0x%llx, expected 0x%llx\n", i,
+                   (unsigned long long)listed[i].base_address, (unsigned long long)sorted[i].base_address);
+            return 1;
+        }
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        uint64_t base = sorted[i].base_address;
+        uint64_t probes[] = { base, base + sorted[i].size / 2, base + sorted[i].size - 1, base + sorted[i].size };
+        for (size_t p = 0; p < sizeof(probes) / sizeof(probes[0]); p++) {
+            const multibit_memory_region_t* expected = bench_multibit_expect(sorted, count, probes[p]);
+            multibit_memory_region_t found;
+            int status = multibit_memory_find_region(probes[p], &found);
+            if ((status == 0) != (expected != NULL) || (expected && found.base_address != expected->base_address)) {
+                printf("Error: multibit_memory_find_region(0x%llx) disagrees with the shadow list\n",
+                       (unsigned long long)probes[p]);
+                return 1;
+            }
+        }
+    }
+    
+    if (count > 0 && multibit_memory_find_region(sorted[0].base_address - 1, NULL) == 0) {
+        printf("Error: multibit_memory_find_region found a region below the lowest one\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Check the region index with random allocations and frees against a
+ * shadow list: filling up grows the node pool and hash table and rotates
+ * the treap, and frees delete from both (the hash by backward shift, so a
+ * broken probe run shows up as a later free or find that misses). Freeing
+ * a region twice must fail, and draining must leave nothing indexed.
+ */
+static int bench_multibit_check_regions(multibit_memory_region_t* live, multibit_memory_region_t* sorted,
+                                        multibit_memory_region_t* listed) {
+    static const memory_mode_t modes[] = { MEMORY_MODE_16BIT, MEMORY_MODE_32BIT, MEMORY_MODE_64BIT };
+    size_t count = 0;
+    size_t peak = 0;
+    
+    // The first half of the steps mostly allocates, the second mostly frees
+    for (size_t step = 0; step < BENCH_MULTIBIT_STEPS; step++) {
+        uint64_t alloc_percent = step < BENCH_MULTIBIT_STEPS / 2 ? 70 : 30;
+        if (count == 0 || (count < BENCH_MULTIBIT_LIVE && bench_random() % 100 < alloc_percent)) {
+            memory_mode_t mode = modes[bench_random() % 3];
+            size_t size = 1 + (size_t)(bench_random() % BENCH_MULTIBIT_MAX_SIZE);
+            if (multibit_memory_alloc_region(mode, size, &live[count]) != 0 || live[count].size != size ||
+                live[count].bit_mode != mode) {
+                printf("Error: multibit_memory_alloc_region failed at step %zu\n", step);
+                return 1;
+            }
+            count++;
+            peak = count > peak ? count : peak;
+        } else {
+            size_t i = (size_t)(bench_random() % count);
+            multibit_memory_region_t freed = live[i];
+            if (multibit_memory_free_region(&freed) != 0) {
+                printf("Error: multibit_memory_free_region missed a live region at step %zu\n", step);
+                return 1;
+            }
+            if (multibit_memory_free_region(&freed) == 0) {
+                printf("Error: multibit_memory_free_region freed a region twice at step %zu\n", step);
+                return 1;
+            }
+            live[i] = live[--count];
+        }
+        
+        if ((step + 1) % BENCH_MULTIBIT_VERIFY_INTERVAL == 0 && bench_multibit_verify(live, count, sorted, listed) != 0) {
+            return 1;
+        }
+    }
+    
+    // Drain in random order, checking as the index empties
+    while (count > 0) {
+        size_t i = (size_t)(bench_random() % count);
+        if (multibit_memory_free_region(&live[i]) != 0) {
+            printf("Error: multibit_memory_free_region missed a live region while draining\n");
+            return 1;
+        }
+        live[i] = live[--count];
+        if (count % (BENCH_MULTIBIT_LIVE / 8) == 0 && bench_multibit_verify(live, count, sorted, listed) != 0) {
+            return 1;
+        }
+    }
+    
+    multibit_memory_stats_t stats;
+    multibit_memory_get_stats(&stats);
+    if (stats.total_16bit_allocations || stats.total_32bit_allocations || stats.total_64bit_allocations ||
+        stats.total_16bit_memory || stats.total_32bit_memory || stats.total_64bit_memory) {
+        printf("Error: multibit statistics not back to zero after draining\n");
+        return 1;
+    }
+    if (peak < BENCH_MULTIBIT_LIVE / 2) {
+        printf("Error: region check peaked at only %zu live regions\n", peak);
+        return 1;
+    }
+    
+    return 0;
+}
+
+/**
+ * Multibit checks, then region lookups (find_region at interior
+ * addresses) and alloc/free pairs per second by number of live regions
+ */
+static int bench_run_multibit(void) {
+    g_bench_arena_size = (size_t)BENCH_DEFAULT_ARENA_MB << 20;
+    if (memory_init() != 0 || multibit_memory_init() != 0) {
+        printf("Error: memory_init failed\n");
+        return 1;
+    }
+    
+    multibit_memory_region_t* live = malloc(BENCH_MULTIBIT_LIVE * sizeof(multibit_memory_region_t));
+    multibit_memory_region_t* sorted = malloc(BENCH_MULTIBIT_LIVE * sizeof(multibit_memory_region_t));
+    multibit_memory_region_t* listed = malloc((BENCH_MULTIBIT_LIVE + 1) * sizeof(multibit_memory_region_t));
+    if (!live || !sorted || !listed) {
+        free(live);
+        free(sorted);
+        free(listed);
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    
+    int result = bench_multibit_check_generic();
+    if (result == 0) {
+        result = bench_multibit_check_regions(live, sorted, listed);
+    }
+    
+    printf("multibit: region index (million operations per second)\n\n");
+    printf("%-6s %9s %11s\n", "live", "find", "alloc+free");
+    static const size_t live_counts[] = { 64, 512, BENCH_MULTIBIT_LIVE };
+    for (size_t c = 0; c < sizeof(live_counts) / sizeof(live_counts[0]) && result == 0; c++) {
+        size_t count = 0;
+        while (count < live_counts[c] && multibit_memory_alloc_region(MEMORY_MODE_32BIT, 64, &live[count]) == 0) {
+            count++;
+        }
+        if (count < live_counts[c]) {
+            printf("Error: multibit_memory_alloc_region failed\n");
+            while (count > 0) {
+                multibit_memory_free_region(&live[--count]);
+            }
+            result = 1;
+            break;
+        }
+        
+        size_t misses = 0;
+        uint64_t start = bench_now_ns();
+        for (size_t n = 0; n < BENCH_MULTIBIT_LOOKUPS; n++) {
+            const multibit_memory_region_t* target = &live[n % count];
+            misses += multibit_memory_find_region(target->base_address + (n & 63), NULL) != 0;
+        }
+        uint64_t find_ns = bench_now_ns() - start;
+        
+        size_t pairs = BENCH_MULTIBIT_LOOKUPS / 16;
+        start = bench_now_ns();
+        for (size_t n = 0; n < pairs; n++) {
+            size_t i = n % count;
+            misses += multibit_memory_free_region(&live[i]) != 0;
+            misses += multibit_memory_alloc_region(MEMORY_MODE_32BIT, 64, &live[i]) != 0;
+        }
+        uint64_t pair_ns = bench_now_ns() - start;
+        
+        for (size_t i = 0; i < count; i++) {
+            multibit_memory_free_region(&live[i]);
+        }
+        if (misses) {
+            printf("Error: %zu region lookups or reallocations failed\n", misses);
+            result = 1;
+            break;
+        }
+        
+        printf("%-6zu %9.1f %11.1f\n", count,
+               find_ns ? (double)BENCH_MULTIBIT_LOOKUPS * 1000.0 / (double)find_ns : 0.0,
+               pair_ns ? (double)pairs * 1000.0 / (double)pair_ns : 0.0);
+    }
+    
+    free(live);
+    free(sorted);
+    free(listed);
+    return result;
+}
+
+static void bench_usage(const char* program) {
+    printf("Usage: %s <trace> [options]\n", program);
+    printf("Traces:\n");
+    printf("  uniform            - Uniform sizes 16 B - 4 KB, random lifetimes\n");
+    printf("  powerlaw           - Power-law sizes up to 1 MB, random lifetimes\n");
+    printf("  prodcons           - FIFO lifetimes with a drifting queue depth\n");
+    printf("  all                - All synthetic traces\n");
+    printf("  replay <file>      - Recorded trace (a <slot> <size> / f <slot> / r <slot> <size>)\n");
+    printf("  memops             - Copy/fill/compare throughput per variant and size\n");
+    printf("  convert            - Widening/narrowing throughput per variant and pair\n");
+    printf("  search             - First/count/all/bitmap search elements/s per variant and width\n");
+    printf("  integrate          - Physics step entities/s per variant, layout and mode\n");
+    printf("  physics            - SoA container checks and AoS conversion entities/s per width\n");
+    printf("  broadphase         - Spatial hash update rate and pairs/s per coordinate width\n");
+    printf("  bvh                - AABB tree update rate and box/ray/nearest queries/s per width\n");
+    printf("  gather             - Strided/indexed gather and scatter elements/s per variant\n");
+    printf("  packed             - Bit-packed array pack/unpack elements/s per variant and width\n");
+    printf("  arena              - Arena allocator checks and allocations/s against the heap\n");
+    printf("  multibit           - Generic access and region index checks, lookups/s by live count\n");
+    printf("Options:\n");
+    printf("  -n <ops>           - Operations per synthetic trace (default %d)\n", BENCH_DEFAULT_OPS);
+    printf("  -s <slots>         - Maximum live objects (default %d)\n", BENCH_DEFAULT_SLOTS);
+    printf("  -m <MB>            - Fake physical memory size (default %d)\n", BENCH_DEFAULT_ARENA_MB);
+    printf("  -r <seed>          - Random seed (default %d)\n", BENCH_DEFAULT_SEED);
+    printf("  -w <file>          - Record the generated trace to a file (single trace)\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+    
+    bench_options_t options = {
+        BENCH_DEFAULT_OPS, BENCH_DEFAULT_SLOTS, BENCH_DEFAULT_ARENA_MB, BENCH_DEFAULT_SEED, NULL
+    };
+    
+    const char* command = argv[1];
+    const char* replay_file = NULL;
+    int arg = 2;
+    
+    if (strcmp(command, "memops") == 0) {
+        return bench_run_memops() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "convert") == 0) {
+        return bench_run_convert() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "search") == 0) {
+        return bench_run_search() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "integrate") == 0) {
+        return bench_run_integrate() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "physics") == 0) {
+        return bench_run_physics() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "broadphase") == 0) {
+        return bench_run_broadphase() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "bvh") == 0) {
+        return bench_run_bvh() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "gather") == 0) {
+        return bench_run_gather() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "packed") == 0) {
+        return bench_run_packed() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "arena") == 0) {
+        return bench_run_arena() == 0 ? 0 : 1;
+    }
+    if (strcmp(command, "multibit") == 0) {
+        return bench_run_multibit() == 0 ? 0 : 1;
+    }
+    
+    if (strcmp(command, "replay") == 0) {
+        if (argc < 3) {
+            bench_usage(argv[0]);
+            return 1;
+        }
+        replay_file = argv[2];
+        arg = 3;
+    }
+    
+    for (; arg < argc; arg++) {
+        if (arg + 1 >= argc || argv[arg][0] != '-') {
+            bench_usage(argv[0]);
+            return 1;
+        }
+        
+        const char* value = argv[++arg];
+        switch (argv[arg - 1][1]) {
+            case 'n': options.ops = (size_t)strtoull(value, NULL, 0); break;
+            case 's': options.slots = (uint32_t)strtoul(value, NULL, 0); break;
+            case 'm': options.arena_mb = (size_t)strtoull(value, NULL, 0); break;
+            case 'r': options.seed = strtoull(value, NULL, 0); break;
+            case 'w': options.record_file = value; break;
+            default:
+                bench_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    if (options.slots == 0 || options.arena_mb == 0 ||
+        (options.record_file && (replay_file || strcmp(command, "all") == 0))) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+    
+    g_bench_arena_size = options.arena_mb << 20;
+    g_bench_rng = options.seed ? options.seed : 1;
+    
+    bench_trace_t trace = {0};
+    int result = 0;
+    
+    if (replay_file) {
+        bench_trace_reset(&trace, "replay");
+        result = bench_load_trace(&trace, replay_file);
+        if (result == 0) {
+            result = bench_run_trace(&trace, &options);
+        }
+    } else {
+        static const char* const names[] = { "uniform", "powerlaw", "prodcons" };
+        bool all = strcmp(command, "all") == 0;
+        bool found = false;
+        
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]) && result == 0; i++) {
+            if (!all && strcmp(command, names[i]) != 0) {
+                continue;
+            }
+            found = true;
+            
+            bench_trace_reset(&trace, names[i]);
+            if (i == 0) {
+                result = bench_generate_random(&trace, &options, bench_size_uniform);
+            } else if (i == 1) {
+                result = bench_generate_random(&trace, &options, bench_size_powerlaw);
+            } else {
+                result = bench_generate_prodcons(&trace, &options);
+            }
+            
+            if (result == 0) {
+                result = bench_run_trace(&trace, &options);
+            }
+        }
+        
+        if (!found) {
+            bench_usage(argv[0]);
+            result = -1;
+        }
+    }
+    
+    free(trace.ops);
+    return result == 0 ? 0 : 1;
+}